@@ -7,13 +7,15 @@
 */
 
 #include "DES.h"
+#include "DESBitslice.h"
 
 void prepareKey( byte key[ BLOCK_BYTES ], char const *textKey )
 {
 
-    strncpy( (char *)key, textKey, BYTE_SIZE );
+    size_t len = strlen( textKey );
 
-    memset( key + strlen(textKey), 0, BLOCK_BYTES - strlen(textKey) );
+    memset( key, 0, BLOCK_BYTES );
+    memcpy( key, textKey, len < BLOCK_BYTES ? len : BLOCK_BYTES );
 }
 
 /**
@@ -260,3 +262,36 @@ void decryptBlock( DESBlock *block, byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ]
     permute( block->data, decryptedBlock, finalPerm, BLOCK_BYTES * BYTE_SIZE );
 
 }
+
+/**
+    Run count blocks through the bitsliced engine, 64 at a time.
+    @param blocks array of blocks to encrypt or decrypt in place
+    @param count number of blocks in the array
+    @param K a 2D array of bytes with each array representing a subkey
+    @param decrypt true to decrypt, false to encrypt
+*/
+static void cryptBlocks( DESBlock blocks[], int count,
+                         byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ], bool decrypt )
+{
+    uint64_t KP[ ROUND_COUNT ][ SUBKEY_BITS ];
+    bitsliceKeyPlanes( KP, K );
+
+    uint64_t planes[ BLOCK_BITS ];
+    for ( int i = 0; i < count; i += BITSLICE_WIDTH ) {
+        int n = count - i < BITSLICE_WIDTH ? count - i : BITSLICE_WIDTH;
+
+        bitsliceLoad( planes, blocks[ i ].data, sizeof( DESBlock ), n );
+        bitsliceCrypt( planes, KP, decrypt );
+        bitsliceStore( blocks[ i ].data, sizeof( DESBlock ), planes, n );
+    }
+}
+
+void encryptBlocks( DESBlock blocks[], int count, byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] )
+{
+    cryptBlocks( blocks, count, K, false );
+}
+
+void decryptBlocks( DESBlock blocks[], int count, byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] )
+{
+    cryptBlocks( blocks, count, K, true );
+}
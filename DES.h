@@ -4,6 +4,9 @@
     Header for the DES Implementation.
 */
 
+#ifndef DES_H
+#define DES_H
+
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -143,3 +146,26 @@ void encryptBlock( DESBlock *block, byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ]
     @param K a 2D array of bytes with each array representing a subkey
 */
 void decryptBlock( DESBlock *block, byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] );
+
+/**
+    This function performs the encrypt operation on count blocks at
+    once, using the subkeys in the K array. The blocks are run through
+    the bitsliced engine 64 at a time, and the result is the same as
+    calling encryptBlock() on each block in turn.
+    @param blocks array of blocks to encrypt in place
+    @param count number of blocks in the array
+    @param K a 2D array of bytes with each array representing a subkey
+*/
+void encryptBlocks( DESBlock blocks[], int count, byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] );
+
+/**
+    This function performs the decrypt operation on count blocks at
+    once, using the subkeys in the K array. The result is the same as
+    calling decryptBlock() on each block in turn.
+    @param blocks array of blocks to decrypt in place
+    @param count number of blocks in the array
+    @param K a 2D array of bytes with each array representing a subkey
+*/
+void decryptBlocks( DESBlock blocks[], int count, byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] );
+
+#endif
@@ -0,0 +1,777 @@
+/**
+    @file DESBench.c
+    @author John Butterfield (jpbutte2)
+    Timing harness for the DES components. Each benchmark is warmed up,
+    then timed over a number of runs, and the median and spread of the
+    time per operation are reported along with cycles per byte, as a
+    table and optionally as CSV or JSON. The reference functions from
+    DES.c are covered along with every faster engine, including each
+    bitsliced kernel the processor can run.
+
+    usage: DESBench [--runs <n>] [--filter <text>] [--csv <file>] [--json <file>]
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "DESKey.h"
+#include "DESTable.h"
+#include "DESPerm.h"
+#include "DESBitslice.h"
+#include "DESEngine.h"
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+/** Shortest time each timed run should take, in seconds. */
+#define SAMPLE_SECONDS 0.02
+
+/** Number of untimed runs before the timed ones. */
+#define WARMUP_RUNS 3
+
+/** Number of timed runs, unless --runs says otherwise. */
+#define DEFAULT_RUNS 15
+
+/** Most timed runs allowed by --runs. */
+#define MAX_RUNS 1001
+
+/** Number of blocks the buffer benchmarks work on at a time. */
+#define BUFFER_BLOCKS 4096
+
+/** Most benchmarks there can be. */
+#define MAX_BENCHES 32
+
+/** Longest benchmark name. */
+#define NAME_LENGTH 32
+
+/** Type for one benchmark. */
+typedef struct Bench Bench;
+
+struct Bench {
+  /** Name to report. */
+  char name[ NAME_LENGTH ];
+
+  /** What one operation is. */
+  char const *unit;
+
+  /** Bytes of data one operation processes, or 0 if that doesn't apply. */
+  int bytes;
+
+  /** Function that performs the operation n times. */
+  void (*run)( Bench const *bench, long n );
+
+  /** Kernel to run, for the bitsliced kernel benchmarks. */
+  BitsliceKernel const *kernel;
+};
+
+/** Type for the summary of a benchmark's timed runs. */
+typedef struct {
+  /** The benchmark. */
+  Bench const *bench;
+
+  /** Median time per operation, in nanoseconds. */
+  double median;
+
+  /** 10th percentile of the time per operation. */
+  double p10;
+
+  /** 90th percentile of the time per operation. */
+  double p90;
+
+  /** Median cycles per byte, or a negative number if unknown. */
+  double cyclesPerByte;
+} Result;
+
+/** Sink for results, so the compiler can't discard the work. */
+static volatile byte sink;
+
+/** Key the benchmarks start from. */
+static byte const benchKey[ BLOCK_BYTES ] = { 0x13, 0x34, 0x57, 0x79, 0x9B, 0xBC, 0xDF, 0xF1 };
+
+/** Subkeys from generateSubkeys(), for the reference functions. */
+static byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
+
+/** Subkeys split for the table-driven engine. */
+static byte KS[ ROUND_COUNT ][ SBOX_COUNT ];
+
+/** Key context for single DES. */
+static DESKey single;
+
+/** Key context for triple DES. */
+static DESKey triple;
+
+/** Subkey planes for the bitsliced kernels. */
+static uint64_t KP[ DES_MAX_STAGES ][ ROUND_COUNT ][ SUBKEY_BITS ];
+
+/** Data the buffer benchmarks work on. */
+static byte buffer[ BUFFER_BLOCKS * BLOCK_BYTES ];
+
+/** Blocks for encryptBlocks() and decryptBlocks(). */
+static DESBlock blocks[ BUFFER_BLOCKS ];
+
+/**
+    Return the current time from a monotonic clock.
+    @return time in seconds
+*/
+static double now( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+    Return the processor's time stamp counter, which counts at a fixed
+    rate close to the nominal clock speed.
+    @return the counter, or 0 where there isn't one
+*/
+static uint64_t cycleCount( void )
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+    Run permute() n times with the final permutation.
+    @param bench the benchmark
+    @param n number of operations
+*/
+static void runPermute( Bench const *bench, long n )
+{
+    byte in[ BLOCK_BYTES ] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    byte out[ BLOCK_BYTES ];
+
+    for ( long i = 0; i < n; i++ ) {
+        permute( out, in, finalPerm, BLOCK_BITS );
+        in[ 0 ] ^= out[ 0 ];
+    }
+    sink ^= in[ 0 ];
+}
+
+/**
+    Run initialPermFast() n times.
+    @param bench the benchmark
+    @param n number of operations
+*/
+static void runInitialPermFast( Bench const *bench, long n )
+{
+    uint64_t x = 0x0123456789ABCDEFull;
+
+    for ( long i = 0; i < n; i++ ) {
+        x = initialPermFast( x ) + i;
+    }
+    sink ^= x;
+}
+
+/**
+    Run sBox() n times, going through the eight S-boxes in turn.
+    @param bench the benchmark
+    @param n number of operations
+*/
+static void runSBox( Bench const *bench, long n )
+{
+    byte in[ SUBKEY_BYTES ] = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC };
+    byte out[ 1 ];
+
+    for ( long i = 0; i < n; i++ ) {
+        sBox( out, in, i & ( SBOX_COUNT - 1 ) );
+        in[ i % SUBKEY_BYTES ] ^= out[ 0 ];
+    }
+    sink ^= in[ 0 ];
+}
+
+/**
+    Run fFunction() n times.
+    @param bench the benchmark
+    @param n number of operations
+*/
+static void runFFunction( Bench const *bench, long n )
+{
+    byte R[ BLOCK_HALF_BYTES ] = { 0xF0, 0xAA, 0xF0, 0xAA };
+    byte result[ BLOCK_HALF_BYTES ];
+
+    for ( long i = 0; i < n; i++ ) {
+        fFunction( result, R, K[ 1 ] );
+        R[ 0 ] ^= result[ 0 ];
+    }
+    sink ^= R[ 0 ];
+}
+
+/**
+    Set up n different keys with generateSubkeys().
+    @param bench the benchmark
+    @param n number of keys to set up
+*/
+static void runGenerateSubkeys( Bench const *bench, long n )
+{
+    byte key[ BLOCK_BYTES ];
+    byte subkeys[ ROUND_COUNT ][ SUBKEY_BYTES ];
+    memcpy( key, benchKey, BLOCK_BYTES );
+
+    for ( long i = 0; i < n; i++ ) {
+        key[ i % BLOCK_BYTES ] ^= i;
+        generateSubkeys( subkeys, key );
+        sink ^= subkeys[ ROUND_COUNT - 1 ][ 0 ];
+    }
+}
+
+/**
+    Set up n different keys with desKeySetup().
+    @param bench the benchmark
+    @param n number of keys to set up
+*/
+static void runKeySetup( Bench const *bench, long n )
+{
+    byte key[ BLOCK_BYTES ];
+    DESKey ctx;
+    memcpy( key, benchKey, BLOCK_BYTES );
+
+    for ( long i = 0; i < n; i++ ) {
+        key[ i % BLOCK_BYTES ] ^= i;
+        desKeySetup( &ctx, key );
+        sink ^= ctx.enc[ 0 ][ ROUND_COUNT - 1 ][ 0 ];
+    }
+}
+
+/**
+    Encrypt one block n times with encryptBlock().
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runEncryptBlock( Bench const *bench, long n )
+{
+    DESBlock block = { { 1, 2, 3, 4, 5, 6, 7, 8 }, BLOCK_BYTES };
+
+    for ( long i = 0; i < n; i++ ) {
+        encryptBlock( &block, K );
+    }
+    sink ^= block.data[ 0 ];
+}
+
+/**
+    Decrypt one block n times with decryptBlock().
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runDecryptBlock( Bench const *bench, long n )
+{
+    DESBlock block = { { 1, 2, 3, 4, 5, 6, 7, 8 }, BLOCK_BYTES };
+
+    for ( long i = 0; i < n; i++ ) {
+        decryptBlock( &block, K );
+    }
+    sink ^= block.data[ 0 ];
+}
+
+/**
+    Encrypt n blocks with encryptBlocks(), BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runEncryptBlocks( Bench const *bench, long n )
+{
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        int count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        encryptBlocks( blocks, count, K );
+    }
+    sink ^= blocks[ 0 ].data[ 0 ];
+}
+
+/**
+    Decrypt n blocks with decryptBlocks(), BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runDecryptBlocks( Bench const *bench, long n )
+{
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        int count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        decryptBlocks( blocks, count, K );
+    }
+    sink ^= blocks[ 0 ].data[ 0 ];
+}
+
+/**
+    Encrypt one block n times with tableEncryptBlock().
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runTableBlock( Bench const *bench, long n )
+{
+    DESBlock block = { { 1, 2, 3, 4, 5, 6, 7, 8 }, BLOCK_BYTES };
+
+    for ( long i = 0; i < n; i++ ) {
+        tableEncryptBlock( &block, KS );
+    }
+    sink ^= block.data[ 0 ];
+}
+
+/**
+    Encrypt one block held in a word n times with tableCrypt64().
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runTableCrypt64( Bench const *bench, long n )
+{
+    uint64_t x = 0x0123456789ABCDEFull;
+
+    for ( long i = 0; i < n; i++ ) {
+        x = tableCrypt64( x, single.enc, single.stages );
+    }
+    sink ^= x;
+}
+
+/**
+    Encrypt n blocks, rounded up to whole groups, with one of the
+    bitsliced kernels.
+    @param bench the benchmark, which names the kernel
+    @param n number of blocks
+*/
+static void runKernel( Bench const *bench, long n )
+{
+    int width = bench->kernel->width;
+
+    for ( long done = 0; done < n; done += width ) {
+        bench->kernel->crypt( buffer, buffer, width,
+                              (uint64_t const (*)[ ROUND_COUNT ][ SUBKEY_BITS ]) KP, 1 );
+    }
+    sink ^= buffer[ 0 ];
+}
+
+/**
+    Encrypt n blocks with desEncryptBuffer(), BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runEncryptBuffer( Bench const *bench, long n )
+{
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        size_t count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        desEncryptBuffer( &single, buffer, buffer, count );
+    }
+    sink ^= buffer[ 0 ];
+}
+
+/**
+    Decrypt n blocks with desDecryptBuffer(), BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runDecryptBuffer( Bench const *bench, long n )
+{
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        size_t count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        desDecryptBuffer( &single, buffer, buffer, count );
+    }
+    sink ^= buffer[ 0 ];
+}
+
+/**
+    Encrypt n blocks with triple DES, BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runTripleBuffer( Bench const *bench, long n )
+{
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        size_t count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        desEncryptBuffer( &triple, buffer, buffer, count );
+    }
+    sink ^= buffer[ 0 ];
+}
+
+/**
+    Encrypt n blocks in counter mode, BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runCtr( Bench const *bench, long n )
+{
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        size_t count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        desCtrCrypt( &single, 1, done * BLOCK_BYTES, buffer, buffer, count * BLOCK_BYTES );
+    }
+    sink ^= buffer[ 0 ];
+}
+
+/**
+    Encrypt n blocks in CBC mode, BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runCbcEncrypt( Bench const *bench, long n )
+{
+    uint64_t iv = 1;
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        size_t count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        desCbcEncrypt( &single, &iv, buffer, buffer, count );
+    }
+    sink ^= buffer[ 0 ];
+}
+
+/**
+    Decrypt n blocks in CBC mode, BUFFER_BLOCKS at a time.
+    @param bench the benchmark
+    @param n number of blocks
+*/
+static void runCbcDecrypt( Bench const *bench, long n )
+{
+    uint64_t iv = 1;
+    for ( long done = 0; done < n; done += BUFFER_BLOCKS ) {
+        size_t count = n - done < BUFFER_BLOCKS ? n - done : BUFFER_BLOCKS;
+        desCbcDecrypt( &single, &iv, buffer, buffer, count );
+    }
+    sink ^= buffer[ 0 ];
+}
+
+/**
+    Add a benchmark to the list.
+    @param list the list of benchmarks
+    @param count number of benchmarks in the list, incremented
+    @param name name to report
+    @param unit what one operation is
+    @param bytes bytes of data per operation, or 0
+    @param run function that performs the operation n times
+    @param kernel kernel to run, or NULL
+*/
+static void addBench( Bench list[], int *count, char const *name, char const *unit, int bytes,
+                      void (*run)( Bench const *, long ), BitsliceKernel const *kernel )
+{
+    Bench *bench = &list[ ( *count )++ ];
+    snprintf( bench->name, sizeof( bench->name ), "%s", name );
+    bench->unit = unit;
+    bench->bytes = bytes;
+    bench->run = run;
+    bench->kernel = kernel;
+}
+
+/**
+    Make the list of benchmarks: the reference functions, then each
+    engine, with one entry for every bitsliced kernel this processor
+    can run.
+    @param list where to store the benchmarks
+    @return number of benchmarks
+*/
+static int listBenches( Bench list[ MAX_BENCHES ] )
+{
+    int count = 0;
+    addBench( list, &count, "permute", "call", 0, runPermute, NULL );
+    addBench( list, &count, "sBox", "call", 0, runSBox, NULL );
+    addBench( list, &count, "fFunction", "call", 0, runFFunction, NULL );
+    addBench( list, &count, "generateSubkeys", "key", 0, runGenerateSubkeys, NULL );
+    addBench( list, &count, "encryptBlock", "block", BLOCK_BYTES, runEncryptBlock, NULL );
+    addBench( list, &count, "decryptBlock", "block", BLOCK_BYTES, runDecryptBlock, NULL );
+    addBench( list, &count, "encryptBlocks", "block", BLOCK_BYTES, runEncryptBlocks, NULL );
+    addBench( list, &count, "decryptBlocks", "block", BLOCK_BYTES, runDecryptBlocks, NULL );
+    addBench( list, &count, "initialPermFast", "call", 0, runInitialPermFast, NULL );
+    addBench( list, &count, "desKeySetup", "key", 0, runKeySetup, NULL );
+    addBench( list, &count, "tableEncryptBlock", "block", BLOCK_BYTES, runTableBlock, NULL );
+    addBench( list, &count, "tableCrypt64", "block", BLOCK_BYTES, runTableCrypt64, NULL );
+
+    BitsliceKernel const *kernels[ BITSLICE_KERNEL_MAX ];
+    int kernelCount = bitsliceKernels( kernels );
+    for ( int k = 0; k < kernelCount; k++ ) {
+        char name[ NAME_LENGTH ];
+        snprintf( name, sizeof( name ), "bitslice/%s", kernels[ k ]->name );
+        addBench( list, &count, name, "block", BLOCK_BYTES, runKernel, kernels[ k ] );
+    }
+
+    addBench( list, &count, "desEncryptBuffer", "block", BLOCK_BYTES, runEncryptBuffer, NULL );
+    addBench( list, &count, "desDecryptBuffer", "block", BLOCK_BYTES, runDecryptBuffer, NULL );
+    addBench( list, &count, "desEncryptBuffer/3des", "block", BLOCK_BYTES, runTripleBuffer,
+              NULL );
+    addBench( list, &count, "desCtrCrypt", "block", BLOCK_BYTES, runCtr, NULL );
+    addBench( list, &count, "desCbcEncrypt", "block", BLOCK_BYTES, runCbcEncrypt, NULL );
+    addBench( list, &count, "desCbcDecrypt", "block", BLOCK_BYTES, runCbcDecrypt, NULL );
+
+    return count;
+}
+
+/**
+    Compare two doubles for qsort().
+    @param a pointer to the first value
+    @param b pointer to the second value
+    @return negative, zero or positive as a is less than, equal to or
+    greater than b
+*/
+static int compareDoubles( void const *a, void const *b )
+{
+    double x = *(double const *) a, y = *(double const *) b;
+    return ( x > y ) - ( x < y );
+}
+
+/**
+    Return a percentile of sorted values, interpolating between the two
+    nearest values.
+    @param values the values, in increasing order
+    @param n number of values
+    @param p the percentile, from 0 to 100
+    @return the percentile
+*/
+static double percentile( double const values[], int n, double p )
+{
+    double at = p / 100 * ( n - 1 );
+    int i = at;
+    if ( i >= n - 1 ) {
+        return values[ n - 1 ];
+    }
+    return values[ i ] + ( at - i ) * ( values[ i + 1 ] - values[ i ] );
+}
+
+/**
+    Time a benchmark. The repetition count is doubled until one run
+    takes at least SAMPLE_SECONDS, then there are WARMUP_RUNS untimed
+    runs and the given number of timed ones.
+    @param bench the benchmark
+    @param runs number of timed runs
+    @param result where to store the summary
+*/
+static void measure( Bench const *bench, int runs, Result *result )
+{
+    long n = 1;
+    for ( ;; ) {
+        double start = now();
+        bench->run( bench, n );
+        if ( now() - start >= SAMPLE_SECONDS ) {
+            break;
+        }
+        n *= 2;
+    }
+
+    for ( int i = 0; i < WARMUP_RUNS; i++ ) {
+        bench->run( bench, n );
+    }
+
+    double ns[ MAX_RUNS ], cycles[ MAX_RUNS ];
+    for ( int i = 0; i < runs; i++ ) {
+        uint64_t startCycles = cycleCount();
+        double start = now();
+        bench->run( bench, n );
+        ns[ i ] = ( now() - start ) * 1e9 / n;
+        cycles[ i ] = (double) ( cycleCount() - startCycles ) / n;
+    }
+
+    qsort( ns, runs, sizeof( double ), compareDoubles );
+    qsort( cycles, runs, sizeof( double ), compareDoubles );
+
+    result->bench = bench;
+    result->median = percentile( ns, runs, 50 );
+    result->p10 = percentile( ns, runs, 10 );
+    result->p90 = percentile( ns, runs, 90 );
+    result->cyclesPerByte = -1;
+#ifdef HAVE_TSC
+    if ( bench->bytes > 0 ) {
+        result->cyclesPerByte = percentile( cycles, runs, 50 ) / bench->bytes;
+    }
+#endif
+}
+
+/**
+    Return the throughput for a result in megabytes per second.
+    @param result the result
+    @return the throughput, or a negative number if it doesn't apply
+*/
+static double megabytesPerSecond( Result const *result )
+{
+    if ( result->bench->bytes == 0 ) {
+        return -1;
+    }
+    return result->bench->bytes / result->median * 1e3;
+}
+
+/**
+    Print one line of the results table.
+    @param result the result to print
+*/
+static void printRow( Result const *result )
+{
+    printf( "%-22s %-6s %12.2f %12.2f %12.2f", result->bench->name, result->bench->unit,
+            result->median, result->p10, result->p90 );
+
+    if ( result->cyclesPerByte >= 0 ) {
+        printf( " %12.2f", result->cyclesPerByte );
+    } else {
+        printf( " %12s", "-" );
+    }
+
+    double mbs = megabytesPerSecond( result );
+    if ( mbs >= 0 ) {
+        printf( " %10.1f\n", mbs );
+    } else {
+        printf( " %10s\n", "-" );
+    }
+    fflush( stdout );
+}
+
+/**
+    Write the results as CSV, one line per benchmark after a header.
+    Values that don't apply are left empty.
+    @param fp the file to write to
+    @param results the results
+    @param count number of results
+    @param runs number of timed runs behind each result
+*/
+static void writeCsv( FILE *fp, Result const results[], int count, int runs )
+{
+    fprintf( fp, "name,unit,bytes_per_op,runs,median_ns,p10_ns,p90_ns,cycles_per_byte,mb_per_s\n" );
+    for ( int i = 0; i < count; i++ ) {
+        Result const *r = &results[ i ];
+        fprintf( fp, "%s,%s,%d,%d,%.3f,%.3f,%.3f,", r->bench->name, r->bench->unit,
+                 r->bench->bytes, runs, r->median, r->p10, r->p90 );
+        if ( r->cyclesPerByte >= 0 ) {
+            fprintf( fp, "%.3f", r->cyclesPerByte );
+        }
+        fprintf( fp, "," );
+        if ( r->bench->bytes > 0 ) {
+            fprintf( fp, "%.3f", megabytesPerSecond( r ) );
+        }
+        fprintf( fp, "\n" );
+    }
+}
+
+/**
+    Write the results as a JSON object with a results array. Values
+    that don't apply are null.
+    @param fp the file to write to
+    @param results the results
+    @param count number of results
+    @param runs number of timed runs behind each result
+*/
+static void writeJson( FILE *fp, Result const results[], int count, int runs )
+{
+    fprintf( fp, "{\n  \"runs\": %d,\n  \"warmup_runs\": %d,\n  \"results\": [\n", runs,
+             WARMUP_RUNS );
+    for ( int i = 0; i < count; i++ ) {
+        Result const *r = &results[ i ];
+        fprintf( fp, "    { \"name\": \"%s\", \"unit\": \"%s\", \"bytes_per_op\": %d, "
+                 "\"median_ns\": %.3f, \"p10_ns\": %.3f, \"p90_ns\": %.3f, ",
+                 r->bench->name, r->bench->unit, r->bench->bytes, r->median, r->p10, r->p90 );
+        if ( r->cyclesPerByte >= 0 ) {
+            fprintf( fp, "\"cycles_per_byte\": %.3f, ", r->cyclesPerByte );
+        } else {
+            fprintf( fp, "\"cycles_per_byte\": null, " );
+        }
+        if ( r->bench->bytes > 0 ) {
+            fprintf( fp, "\"mb_per_s\": %.3f }", megabytesPerSecond( r ) );
+        } else {
+            fprintf( fp, "\"mb_per_s\": null }" );
+        }
+        fprintf( fp, "%s\n", i + 1 < count ? "," : "" );
+    }
+    fprintf( fp, "  ]\n}\n" );
+}
+
+/**
+    Write the results to a file with the given writer.
+    @param name name of the file
+    @param write function that writes the results
+    @param results the results
+    @param count number of results
+    @param runs number of timed runs behind each result
+    @return true if the file was written
+*/
+static bool saveResults( char const *name,
+                         void (*write)( FILE *, Result const [], int, int ),
+                         Result const results[], int count, int runs )
+{
+    FILE *fp = fopen( name, "w" );
+    if ( fp == NULL ) {
+        perror( name );
+        return false;
+    }
+
+    write( fp, results, count, runs );
+    return fclose( fp ) == 0;
+}
+
+/**
+    Set up the keys and data the benchmarks use.
+*/
+static void setUp( void )
+{
+    byte key2[ BLOCK_BYTES ] = { 0x0E, 0x32, 0x92, 0x32, 0xEA, 0x6D, 0x0D, 0x73 };
+    byte key3[ BLOCK_BYTES ] = { 0x13, 0x34, 0x57, 0x79, 0x9B, 0xBC, 0xDF, 0xF2 };
+
+    generateSubkeys( K, benchKey );
+    tableSubkeys( KS, (byte const (*)[ SUBKEY_BYTES ]) K );
+    desKeySetup( &single, benchKey );
+    desTripleKeySetup( &triple, benchKey, key2, key3 );
+    desKeyPlanes( KP, &single, false );
+
+    for ( size_t i = 0; i < sizeof( buffer ); i++ ) {
+        buffer[ i ] = i * 131 + 7;
+    }
+    for ( int i = 0; i < BUFFER_BLOCKS; i++ ) {
+        memcpy( blocks[ i ].data, buffer + i * BLOCK_BYTES, BLOCK_BYTES );
+        blocks[ i ].len = BLOCK_BYTES;
+    }
+}
+
+/**
+    Main method for the benchmark program.
+    @param argc Number of command line arguments
+    @param argv Array of strings of command line arguments
+    @return the program exit status
+*/
+int main( int argc, char *argv[] )
+{
+    int runs = DEFAULT_RUNS;
+    char const *filter = NULL, *csvFile = NULL, *jsonFile = NULL;
+
+    for ( int i = 1; i < argc; i++ ) {
+        if ( i + 1 < argc && strcmp( argv[ i ], "--runs" ) == 0 ) {
+            runs = atoi( argv[ ++i ] );
+        } else if ( i + 1 < argc && strcmp( argv[ i ], "--filter" ) == 0 ) {
+            filter = argv[ ++i ];
+        } else if ( i + 1 < argc && strcmp( argv[ i ], "--csv" ) == 0 ) {
+            csvFile = argv[ ++i ];
+        } else if ( i + 1 < argc && strcmp( argv[ i ], "--json" ) == 0 ) {
+            jsonFile = argv[ ++i ];
+        } else {
+            runs = 0;
+            break;
+        }
+    }
+
+    if ( runs < 1 || runs > MAX_RUNS ) {
+        fprintf( stderr, "usage: DESBench [--runs <n>] [--filter <text>] [--csv <file>] "
+                 "[--json <file>]\n" );
+        exit( 1 );
+    }
+
+    setUp();
+
+    Bench benches[ MAX_BENCHES ];
+    int benchCount = listBenches( benches );
+    Result results[ MAX_BENCHES ];
+    int count = 0;
+
+    printf( "%-22s %-6s %12s %12s %12s %12s %10s\n", "benchmark", "op", "median ns/op",
+            "p10 ns/op", "p90 ns/op", "cycles/byte", "MB/s" );
+    for ( int i = 0; i < benchCount; i++ ) {
+        if ( filter != NULL && strstr( benches[ i ].name, filter ) == NULL ) {
+            continue;
+        }
+        measure( &benches[ i ], runs, &results[ count ] );
+        printRow( &results[ count ] );
+        count++;
+    }
+
+    bool ok = true;
+    if ( csvFile != NULL ) {
+        ok = saveResults( csvFile, writeCsv, results, count, runs ) && ok;
+    }
+    if ( jsonFile != NULL ) {
+        ok = saveResults( jsonFile, writeJson, results, count, runs ) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
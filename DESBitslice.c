@@ -0,0 +1,141 @@
+/**
+    @file DESBitslice.c
+    @author John Butterfield (jpbutte2)
+    Bitsliced implementation of DES. Each S-box is written as a network
+    of AND, OR, XOR and NOT gates that computes its four output bits
+    from its six input bits, so one pass through the gates evaluates
+    the S-box for 64 blocks at once. The gates themselves live in
+    DESBitsliceKernel.h, which this file instantiates for 64-bit words;
+    wider versions of the same code are picked at run time when the
+    processor has them.
+*/
+
+#include <pthread.h>
+#include "DESBitslice.h"
+
+/** A plain 64-bit word holds one plane of 64 blocks. */
+#define BS_WORD uint64_t
+#define BS_LANES 1
+#define BS_LANE( v, g ) ( v )
+
+#include "DESBitsliceKernel.h"
+
+/** The portable kernel, available everywhere. */
+static BitsliceKernel const scalarKernel = { "scalar", BS_BLOCKS, cryptKernel };
+
+/** Kernels this processor can run, widest first. */
+static BitsliceKernel const *kernels[ BITSLICE_KERNEL_MAX ];
+
+/** Number of entries in kernels. */
+static int kernelCount;
+
+/** Makes sure kernels is filled in exactly once. */
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+/** Zero-based bit of the key that each bit of each subkey is a copy
+    of, indexed like the key planes from 1 to 16. */
+static int keyBitSource[ ROUND_COUNT ][ SUBKEY_BITS ];
+
+/** Makes sure keyBitSource is filled in exactly once. */
+static pthread_once_t keyBitSourceOnce = PTHREAD_ONCE_INIT;
+
+/**
+    Fill in the list of kernels, checking which instruction set
+    extensions the processor and operating system support.
+*/
+static void findKernels( void )
+{
+#ifdef DES_X86_KERNELS
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx512f" ) ) {
+        kernels[ kernelCount++ ] = &bitsliceAVX512;
+    }
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        kernels[ kernelCount++ ] = &bitsliceAVX2;
+    }
+#endif
+    kernels[ kernelCount++ ] = &scalarKernel;
+}
+
+int bitsliceKernels( BitsliceKernel const *list[ BITSLICE_KERNEL_MAX ] )
+{
+    pthread_once( &kernelsOnce, findKernels );
+
+    for ( int i = 0; i < kernelCount; i++ ) {
+        list[ i ] = kernels[ i ];
+    }
+    return kernelCount;
+}
+
+void bitsliceKeyPlanes( uint64_t KP[ ROUND_COUNT ][ SUBKEY_BITS ],
+                        byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] )
+{
+    for ( int i = 1; i < ROUND_COUNT; i++ ) {
+        for ( int j = 0; j < SUBKEY_BITS; j++ ) {
+            // All ones if the key bit is set, all zeros if it is clear
+            KP[ i ][ j ] = -(uint64_t) getBit( K[ i ], j + 1 );
+        }
+    }
+}
+
+/**
+    Work out where each subkey bit comes from, following PC-1, the
+    rotations and PC-2 back to the key.
+*/
+static void findKeyBitSources( void )
+{
+    int shift = 0;
+    for ( int i = 1; i < ROUND_COUNT; i++ ) {
+        shift += subkeyShiftSchedule[ i ];
+
+        for ( int j = 0; j < SUBKEY_BITS; j++ ) {
+            // Bit q of C_i D_i was bit q + shift of C_0 or of D_0
+            int q = subkeyPerm[ j ] - 1;
+            if ( q < SUBKEY_HALF_BITS ) {
+                keyBitSource[ i ][ j ] = leftSubkeyPerm[ ( q + shift ) % SUBKEY_HALF_BITS ] - 1;
+            } else {
+                q -= SUBKEY_HALF_BITS;
+                keyBitSource[ i ][ j ] = rightSubkeyPerm[ ( q + shift ) % SUBKEY_HALF_BITS ] - 1;
+            }
+        }
+    }
+}
+
+void bitsliceKeySchedule( uint64_t KP[ ROUND_COUNT ][ SUBKEY_BITS ],
+                          uint64_t const keyPlanes[ BLOCK_BITS ] )
+{
+    pthread_once( &keyBitSourceOnce, findKeyBitSources );
+
+    for ( int i = 1; i < ROUND_COUNT; i++ ) {
+        for ( int j = 0; j < SUBKEY_BITS; j++ ) {
+            KP[ i ][ j ] = keyPlanes[ keyBitSource[ i ][ j ] ];
+        }
+    }
+}
+
+void bitsliceTranspose( uint64_t m[ BLOCK_BITS ] )
+{
+    transposePlanes( m );
+}
+
+void bitsliceLoad( uint64_t planes[ BLOCK_BITS ], byte const *src, size_t stride, int n )
+{
+    loadPlanes( planes, src, stride, n );
+}
+
+void bitsliceStore( byte *dst, size_t stride, uint64_t planes[ BLOCK_BITS ], int n )
+{
+    storePlanes( dst, stride, planes, n );
+}
+
+void bitsliceCrypt( uint64_t planes[ BLOCK_BITS ],
+                    uint64_t const KP[ ROUND_COUNT ][ SUBKEY_BITS ], bool decrypt )
+{
+    cryptPlanes( planes, (uint64_t const (*)[ ROUND_COUNT ][ SUBKEY_BITS ]) KP, 1, decrypt );
+}
+
+void bitsliceCryptStages( uint64_t planes[ BLOCK_BITS ],
+                          uint64_t const KP[][ ROUND_COUNT ][ SUBKEY_BITS ], int stages )
+{
+    cryptPlanes( planes, KP, stages, false );
+}
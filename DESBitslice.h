@@ -0,0 +1,130 @@
+/**
+    @file DESBitslice.h
+    @author John Butterfield (jpbutte2)
+    Header for the bitsliced DES engine. This component runs DES on
+    64 blocks at a time. The blocks are transposed into 64 bit-planes,
+    where word i holds bit i + 1 of every block, and the S-boxes are
+    evaluated as networks of boolean gates on whole words.
+*/
+
+#ifndef DESBITSLICE_H
+#define DESBITSLICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "DES.h"
+
+/** Number of blocks the bitsliced engine processes side by side. */
+#define BITSLICE_WIDTH 64
+
+/** Largest number of kernels bitsliceKernels() can report. */
+#define BITSLICE_KERNEL_MAX 3
+
+/** A version of the bitsliced engine built for one kind of register. */
+typedef struct {
+  /** Short name for the kernel, such as "avx2". */
+  char const *name;
+
+  /** Number of blocks the kernel processes in one call. */
+  int width;
+
+  /** Encrypts or decrypts n consecutive blocks from src into dst, where
+      n is at most width, applying the stages of key planes in KP in
+      order. dst may be the same as src. */
+  void ( *crypt )( byte *dst, byte const *src, int n,
+                   uint64_t const KP[][ ROUND_COUNT ][ SUBKEY_BITS ], int stages );
+} BitsliceKernel;
+
+#ifdef DES_X86_KERNELS
+/** Kernel on 512-bit AVX-512 registers, in DESBitsliceAVX512.c. */
+extern BitsliceKernel const bitsliceAVX512;
+
+/** Kernel on 256-bit AVX2 registers, in DESBitsliceAVX2.c. */
+extern BitsliceKernel const bitsliceAVX2;
+#endif
+
+/**
+    This function lists the kernels that this processor can run,
+    widest first. The portable 64-bit kernel is always last.
+    @param list where to store the kernels
+    @return number of kernels stored in list
+*/
+int bitsliceKernels( BitsliceKernel const *list[ BITSLICE_KERNEL_MAX ] );
+
+/**
+    This function expands the subkeys in K into key planes for the
+    bitsliced engine. Every bit of every subkey becomes a word of all
+    ones or all zeros, so the same key is applied to all 64 blocks.
+    Like K, the planes are indexed from KP[ 1 ] to KP[ 16 ].
+    @param KP the key planes to fill in
+    @param K a 2D array of bytes with each array representing a subkey
+*/
+void bitsliceKeyPlanes( uint64_t KP[ ROUND_COUNT ][ SUBKEY_BITS ],
+                        byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] );
+
+/**
+    This function runs the key schedule on 64 keys at once, for trying
+    many keys on the same block. The keys are given as bit-planes, the
+    way bitsliceLoad() leaves 64 blocks, so plane i holds bit i + 1 of
+    every key, and each key's subkeys end up in its own lane of KP.
+    PC-1, the rotations and PC-2 only move bits around, so every subkey
+    plane is just a copy of one key plane, and the parity bits are
+    never used.
+    @param KP the key planes to fill in, indexed from 1 to 16
+    @param keyPlanes the keys, as bit-planes
+*/
+void bitsliceKeySchedule( uint64_t KP[ ROUND_COUNT ][ SUBKEY_BITS ],
+                          uint64_t const keyPlanes[ BLOCK_BITS ] );
+
+/**
+    This function transposes a 64 x 64 bit matrix in place. Bit 63 - c
+    of word r is swapped with bit 63 - r of word c, so the same call
+    turns 64 blocks into 64 bit-planes and back again.
+    @param m array of 64 words to transpose
+*/
+void bitsliceTranspose( uint64_t m[ BLOCK_BITS ] );
+
+/**
+    This function loads n blocks into bit-planes. Block j is read from
+    src + j * stride, and blocks past n are treated as zeros.
+    @param planes the resulting bit-planes
+    @param src address of the first block
+    @param stride number of bytes from the start of one block to the next
+    @param n number of blocks to load, at most BITSLICE_WIDTH
+*/
+void bitsliceLoad( uint64_t planes[ BLOCK_BITS ], byte const *src, size_t stride, int n );
+
+/**
+    This function stores the first n blocks held in the given bit-planes.
+    Block j is written to dst + j * stride. The planes are destroyed.
+    @param dst address of the first block
+    @param stride number of bytes from the start of one block to the next
+    @param planes the bit-planes to store
+    @param n number of blocks to store, at most BITSLICE_WIDTH
+*/
+void bitsliceStore( byte *dst, size_t stride, uint64_t planes[ BLOCK_BITS ], int n );
+
+/**
+    This function runs the initial permutation, the 16 rounds and the
+    final permutation on 64 blocks held in bit-planes.
+    @param planes the bit-planes to encrypt or decrypt in place
+    @param KP key planes, indexed from 1 to 16
+    @param decrypt true if the subkeys should be applied in reverse order
+*/
+void bitsliceCrypt( uint64_t planes[ BLOCK_BITS ],
+                    uint64_t const KP[ ROUND_COUNT ][ SUBKEY_BITS ], bool decrypt );
+
+/**
+    This function runs the initial permutation, 16 rounds for each
+    stage and the final permutation on 64 blocks held in bit-planes,
+    keeping the blocks as L and R from the first round to the last.
+    This is how triple DES avoids the FP and IP pairs between stages.
+    @param planes the bit-planes to encrypt or decrypt in place
+    @param KP key planes for each stage, indexed from 1 to 16 in the
+    order they are applied
+    @param stages number of stages in KP
+*/
+void bitsliceCryptStages( uint64_t planes[ BLOCK_BITS ],
+                          uint64_t const KP[][ ROUND_COUNT ][ SUBKEY_BITS ], int stages );
+
+#endif
@@ -0,0 +1,20 @@
+/**
+    @file DESBitsliceAVX2.c
+    @author John Butterfield (jpbutte2)
+    The bitsliced DES kernel on 256-bit vectors, for 256 blocks at a
+    time. This file is compiled with -mavx2, and is only called after
+    DESBitslice.c has checked that the processor supports it.
+*/
+
+#include "DESBitslice.h"
+
+/** One plane of 256 blocks: 4 64-bit lanes of 64 blocks each. */
+typedef uint64_t PlaneWord __attribute__ (( vector_size( 32 ) ));
+
+#define BS_WORD PlaneWord
+#define BS_LANES 4
+#define BS_LANE( v, g ) ( v )[ g ]
+
+#include "DESBitsliceKernel.h"
+
+BitsliceKernel const bitsliceAVX2 = { "avx2", BS_BLOCKS, cryptKernel };
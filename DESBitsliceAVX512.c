@@ -0,0 +1,20 @@
+/**
+    @file DESBitsliceAVX512.c
+    @author John Butterfield (jpbutte2)
+    The bitsliced DES kernel on 512-bit vectors, for 512 blocks at a
+    time. This file is compiled with -mavx512f, and is only called after
+    DESBitslice.c has checked that the processor supports it.
+*/
+
+#include "DESBitslice.h"
+
+/** One plane of 512 blocks: 8 64-bit lanes of 64 blocks each. */
+typedef uint64_t PlaneWord __attribute__ (( vector_size( 64 ) ));
+
+#define BS_WORD PlaneWord
+#define BS_LANES 8
+#define BS_LANE( v, g ) ( v )[ g ]
+
+#include "DESBitsliceKernel.h"
+
+BitsliceKernel const bitsliceAVX512 = { "avx512", BS_BLOCKS, cryptKernel };
@@ -0,0 +1,1065 @@
+/**
+    @file DESBitsliceKernel.h
+    @author John Butterfield (jpbutte2)
+    Bitsliced DES kernel, written once for any word type. A source file
+    defines BS_WORD as the type of one bit-plane, BS_LANES as the
+    number of 64-bit lanes in it and BS_LANE( v, g ) to name lane g of
+    a plane, and then includes this file. DESBitslice.c uses plain
+    64-bit words, and the SIMD versions use GCC vector types of 256 or
+    512 bits, compiled with the matching -m flags, so the S-box gates
+    run on 64 * BS_LANES blocks at once. Everything here is static, so
+    each including file gets its own copy.
+
+    The S-box networks were derived from sBoxTable by Shannon
+    expansion on the input bits, sharing common sub-expressions between
+    the four outputs. The permutations cost nothing in this
+    representation: IP, E, P and the final permutation only decide
+    which plane is used where.
+*/
+
+#ifndef BS_WORD
+#error "Define BS_WORD, BS_LANES and BS_LANE before including DESBitsliceKernel.h"
+#endif
+
+#include "DESBitslice.h"
+#include "DESPerm.h"
+
+/** Number of blocks held in a set of BS_WORD bit-planes. */
+#define BS_BLOCKS ( BITSLICE_WIDTH * BS_LANES )
+
+/** Gate network for S1.  XORs the four output bits of S1,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s1( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = ~a5;
+    BS_WORD x1 = a2 ^ x0;
+    BS_WORD x2 = ~a2;
+    BS_WORD x3 = x2 & a3;
+    BS_WORD x4 = x1 ^ x3;
+    BS_WORD x5 = a5 & a3;
+    BS_WORD x6 = x1 ^ x5;
+    BS_WORD x7 = x4 ^ x6;
+    BS_WORD x8 = x7 & a4;
+    BS_WORD x9 = x4 ^ x8;
+    BS_WORD x10 = ~x4;
+    BS_WORD x11 = x0 & a3;
+    BS_WORD x12 = a2 ^ x11;
+    BS_WORD x13 = x10 ^ x12;
+    BS_WORD x14 = x13 & a4;
+    BS_WORD x15 = x10 ^ x14;
+    BS_WORD x16 = x9 ^ x15;
+    BS_WORD x17 = x16 & a6;
+    BS_WORD x18 = x9 ^ x17;
+    BS_WORD x19 = x2 | x0;
+    BS_WORD x20 = x2 & a5;
+    BS_WORD x21 = x19 ^ x11;
+    BS_WORD x22 = x12 ^ x21;
+    BS_WORD x23 = x22 & a4;
+    BS_WORD x24 = x12 ^ x23;
+    BS_WORD x25 = ~x1;
+    BS_WORD x26 = ~x20;
+    BS_WORD x27 = x26 & a3;
+    BS_WORD x28 = x22 ^ x27;
+    BS_WORD x29 = ~x19;
+    BS_WORD x30 = x1 ^ x29;
+    BS_WORD x31 = x30 & a3;
+    BS_WORD x32 = x1 ^ x31;
+    BS_WORD x33 = x28 ^ x32;
+    BS_WORD x34 = x33 & a4;
+    BS_WORD x35 = x28 ^ x34;
+    BS_WORD x36 = x24 ^ x35;
+    BS_WORD x37 = x36 & a6;
+    BS_WORD x38 = x24 ^ x37;
+    BS_WORD x39 = x18 ^ x38;
+    BS_WORD x40 = x39 & a1;
+    BS_WORD x41 = x18 ^ x40;
+    BS_WORD x42 = ~x12;
+    BS_WORD x43 = x26 ^ x11;
+    BS_WORD x44 = ~x30;
+    BS_WORD x45 = x44 & a4;
+    BS_WORD x46 = x42 ^ x45;
+    BS_WORD x47 = a5 ^ x3;
+    BS_WORD x48 = x25 & a3;
+    BS_WORD x49 = x19 ^ x48;
+    BS_WORD x50 = x43 & a4;
+    BS_WORD x51 = x47 ^ x50;
+    BS_WORD x52 = x46 ^ x51;
+    BS_WORD x53 = x52 & a6;
+    BS_WORD x54 = x46 ^ x53;
+    BS_WORD x55 = x44 & a3;
+    BS_WORD x56 = x26 ^ x55;
+    BS_WORD x57 = ~x22;
+    BS_WORD x58 = x1 ^ x27;
+    BS_WORD x59 = x56 ^ x58;
+    BS_WORD x60 = x59 & a4;
+    BS_WORD x61 = x56 ^ x60;
+    BS_WORD x62 = a4 ^ x49;
+    BS_WORD x63 = x61 ^ x62;
+    BS_WORD x64 = x63 & a6;
+    BS_WORD x65 = x61 ^ x64;
+    BS_WORD x66 = x54 ^ x65;
+    BS_WORD x67 = x66 & a1;
+    BS_WORD x68 = x54 ^ x67;
+    BS_WORD x69 = x4 & a4;
+    BS_WORD x70 = x56 ^ x69;
+    BS_WORD x71 = x44 ^ x27;
+    BS_WORD x72 = x19 & a4;
+    BS_WORD x73 = x71 ^ x72;
+    BS_WORD x74 = x70 ^ x73;
+    BS_WORD x75 = x74 & a6;
+    BS_WORD x76 = x70 ^ x75;
+    BS_WORD x77 = x57 ^ x5;
+    BS_WORD x78 = x26 & a4;
+    BS_WORD x79 = x77 ^ x78;
+    BS_WORD x80 = x21 & a4;
+    BS_WORD x81 = x58 ^ x80;
+    BS_WORD x82 = x79 ^ x81;
+    BS_WORD x83 = x82 & a6;
+    BS_WORD x84 = x79 ^ x83;
+    BS_WORD x85 = x76 ^ x84;
+    BS_WORD x86 = x85 & a1;
+    BS_WORD x87 = x76 ^ x86;
+    BS_WORD x88 = x2 ^ x5;
+    BS_WORD x89 = x77 ^ x72;
+    BS_WORD x90 = ~x56;
+    BS_WORD x91 = x90 ^ x23;
+    BS_WORD x92 = x89 ^ x91;
+    BS_WORD x93 = x92 & a6;
+    BS_WORD x94 = x89 ^ x93;
+    BS_WORD x95 = ~x88;
+    BS_WORD x96 = x10 ^ x95;
+    BS_WORD x97 = x96 & a4;
+    BS_WORD x98 = x10 ^ x97;
+    BS_WORD x99 = a3 ^ x26;
+    BS_WORD x100 = x1 & a4;
+    BS_WORD x101 = x99 ^ x100;
+    BS_WORD x102 = x98 ^ x101;
+    BS_WORD x103 = x102 & a6;
+    BS_WORD x104 = x98 ^ x103;
+    BS_WORD x105 = x94 ^ x104;
+    BS_WORD x106 = x105 & a1;
+    BS_WORD x107 = x94 ^ x106;
+    *out1 ^= x41;
+    *out2 ^= x68;
+    *out3 ^= x87;
+    *out4 ^= x107;
+}
+
+/** Gate network for S2.  XORs the four output bits of S2,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s2( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = ~a5;
+    BS_WORD x1 = a3 ^ x0;
+    BS_WORD x2 = ~x1;
+    BS_WORD x3 = a6 ^ x1;
+    BS_WORD x4 = ~a3;
+    BS_WORD x5 = a5 & a4;
+    BS_WORD x6 = x3 ^ x5;
+    BS_WORD x7 = x4 | a5;
+    BS_WORD x8 = x2 ^ x7;
+    BS_WORD x9 = x8 & a6;
+    BS_WORD x10 = x2 ^ x9;
+    BS_WORD x11 = x4 & x0;
+    BS_WORD x12 = x2 ^ x11;
+    BS_WORD x13 = x12 & a6;
+    BS_WORD x14 = x2 ^ x13;
+    BS_WORD x15 = x10 ^ x14;
+    BS_WORD x16 = x15 & a4;
+    BS_WORD x17 = x10 ^ x16;
+    BS_WORD x18 = x6 ^ x17;
+    BS_WORD x19 = x18 & a1;
+    BS_WORD x20 = x6 ^ x19;
+    BS_WORD x21 = a3 & a6;
+    BS_WORD x22 = x0 ^ x21;
+    BS_WORD x23 = a4 ^ x22;
+    BS_WORD x24 = a4 ^ x14;
+    BS_WORD x25 = x23 ^ x24;
+    BS_WORD x26 = x25 & a1;
+    BS_WORD x27 = x23 ^ x26;
+    BS_WORD x28 = x20 ^ x27;
+    BS_WORD x29 = x28 & a2;
+    BS_WORD x30 = x20 ^ x29;
+    BS_WORD x31 = x4 & a6;
+    BS_WORD x32 = x0 ^ x31;
+    BS_WORD x33 = x11 & a6;
+    BS_WORD x34 = a5 ^ x33;
+    BS_WORD x35 = x32 ^ x34;
+    BS_WORD x36 = x35 & a4;
+    BS_WORD x37 = x32 ^ x36;
+    BS_WORD x38 = a1 ^ x37;
+    BS_WORD x39 = x2 ^ x31;
+    BS_WORD x40 = ~x12;
+    BS_WORD x41 = x9 & a4;
+    BS_WORD x42 = x39 ^ x41;
+    BS_WORD x43 = x7 & a6;
+    BS_WORD x44 = x11 ^ x43;
+    BS_WORD x45 = x7 ^ x21;
+    BS_WORD x46 = x44 ^ x45;
+    BS_WORD x47 = x46 & a4;
+    BS_WORD x48 = x44 ^ x47;
+    BS_WORD x49 = x42 ^ x48;
+    BS_WORD x50 = x49 & a1;
+    BS_WORD x51 = x42 ^ x50;
+    BS_WORD x52 = x38 ^ x51;
+    BS_WORD x53 = x52 & a2;
+    BS_WORD x54 = x38 ^ x53;
+    BS_WORD x55 = x45 & a4;
+    BS_WORD x56 = x8 ^ x55;
+    BS_WORD x57 = x2 ^ x15;
+    BS_WORD x58 = x0 & a4;
+    BS_WORD x59 = x57 ^ x58;
+    BS_WORD x60 = x56 ^ x59;
+    BS_WORD x61 = x60 & a1;
+    BS_WORD x62 = x56 ^ x61;
+    BS_WORD x63 = ~x8;
+    BS_WORD x64 = ~x7;
+    BS_WORD x65 = x2 & a6;
+    BS_WORD x66 = x63 ^ x65;
+    BS_WORD x67 = x66 ^ x3;
+    BS_WORD x68 = x67 & a4;
+    BS_WORD x69 = x66 ^ x68;
+    BS_WORD x70 = x40 ^ x43;
+    BS_WORD x71 = x2 & a4;
+    BS_WORD x72 = x70 ^ x71;
+    BS_WORD x73 = x69 ^ x72;
+    BS_WORD x74 = x73 & a1;
+    BS_WORD x75 = x69 ^ x74;
+    BS_WORD x76 = x62 ^ x75;
+    BS_WORD x77 = x76 & a2;
+    BS_WORD x78 = x62 ^ x77;
+    BS_WORD x79 = ~x15;
+    BS_WORD x80 = x79 & a4;
+    BS_WORD x81 = x45 ^ x80;
+    BS_WORD x82 = a4 ^ x9;
+    BS_WORD x83 = x81 ^ x82;
+    BS_WORD x84 = x83 & a1;
+    BS_WORD x85 = x81 ^ x84;
+    BS_WORD x86 = x25 ^ x58;
+    BS_WORD x87 = x64 & a6;
+    BS_WORD x88 = x8 ^ x87;
+    BS_WORD x89 = x40 ^ x33;
+    BS_WORD x90 = x88 ^ x89;
+    BS_WORD x91 = x90 & a4;
+    BS_WORD x92 = x88 ^ x91;
+    BS_WORD x93 = x86 ^ x92;
+    BS_WORD x94 = x93 & a1;
+    BS_WORD x95 = x86 ^ x94;
+    BS_WORD x96 = x85 ^ x95;
+    BS_WORD x97 = x96 & a2;
+    BS_WORD x98 = x85 ^ x97;
+    *out1 ^= x30;
+    *out2 ^= x54;
+    *out3 ^= x78;
+    *out4 ^= x98;
+}
+
+/** Gate network for S3.  XORs the four output bits of S3,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s3( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = ~a5;
+    BS_WORD x1 = a2 ^ x0;
+    BS_WORD x2 = x0 | a6;
+    BS_WORD x3 = a2 & x2;
+    BS_WORD x4 = x1 ^ x3;
+    BS_WORD x5 = x4 & a3;
+    BS_WORD x6 = x1 ^ x5;
+    BS_WORD x7 = ~a6;
+    BS_WORD x8 = a5 | x7;
+    BS_WORD x9 = a5 ^ x7;
+    BS_WORD x10 = ~x2;
+    BS_WORD x11 = x10 & a2;
+    BS_WORD x12 = x8 ^ x11;
+    BS_WORD x13 = ~x9;
+    BS_WORD x14 = a2 ^ x9;
+    BS_WORD x15 = x12 ^ x14;
+    BS_WORD x16 = x15 & a3;
+    BS_WORD x17 = x12 ^ x16;
+    BS_WORD x18 = x6 ^ x17;
+    BS_WORD x19 = x18 & a4;
+    BS_WORD x20 = x6 ^ x19;
+    BS_WORD x21 = x9 ^ x16;
+    BS_WORD x22 = a4 ^ x21;
+    BS_WORD x23 = x20 ^ x22;
+    BS_WORD x24 = x23 & a1;
+    BS_WORD x25 = x20 ^ x24;
+    BS_WORD x26 = a6 ^ x10;
+    BS_WORD x27 = x26 & a2;
+    BS_WORD x28 = a6 ^ x27;
+    BS_WORD x29 = x28 ^ x14;
+    BS_WORD x30 = x29 & a3;
+    BS_WORD x31 = x28 ^ x30;
+    BS_WORD x32 = x0 | x7;
+    BS_WORD x33 = x7 & a2;
+    BS_WORD x34 = x32 ^ x33;
+    BS_WORD x35 = x15 ^ x34;
+    BS_WORD x36 = x35 & a3;
+    BS_WORD x37 = x15 ^ x36;
+    BS_WORD x38 = x31 ^ x37;
+    BS_WORD x39 = x38 & a4;
+    BS_WORD x40 = x31 ^ x39;
+    BS_WORD x41 = a2 ^ x7;
+    BS_WORD x42 = x0 & a3;
+    BS_WORD x43 = x41 ^ x42;
+    BS_WORD x44 = x0 ^ x33;
+    BS_WORD x45 = x2 & a3;
+    BS_WORD x46 = x44 ^ x45;
+    BS_WORD x47 = x43 ^ x46;
+    BS_WORD x48 = x47 & a4;
+    BS_WORD x49 = x43 ^ x48;
+    BS_WORD x50 = x40 ^ x49;
+    BS_WORD x51 = x50 & a1;
+    BS_WORD x52 = x40 ^ x51;
+    BS_WORD x53 = x9 ^ x3;
+    BS_WORD x54 = x32 ^ x27;
+    BS_WORD x55 = x53 ^ x54;
+    BS_WORD x56 = x55 & a3;
+    BS_WORD x57 = x53 ^ x56;
+    BS_WORD x58 = ~x32;
+    BS_WORD x59 = x58 & a2;
+    BS_WORD x60 = x10 ^ x59;
+    BS_WORD x61 = a3 ^ x60;
+    BS_WORD x62 = x57 ^ x61;
+    BS_WORD x63 = x62 & a4;
+    BS_WORD x64 = x57 ^ x63;
+    BS_WORD x65 = ~x44;
+    BS_WORD x66 = x65 ^ x13;
+    BS_WORD x67 = x66 & a3;
+    BS_WORD x68 = x65 ^ x67;
+    BS_WORD x69 = x9 ^ x27;
+    BS_WORD x70 = x3 ^ x69;
+    BS_WORD x71 = x70 & a3;
+    BS_WORD x72 = x3 ^ x71;
+    BS_WORD x73 = x68 ^ x72;
+    BS_WORD x74 = x73 & a4;
+    BS_WORD x75 = x68 ^ x74;
+    BS_WORD x76 = x64 ^ x75;
+    BS_WORD x77 = x76 & a1;
+    BS_WORD x78 = x64 ^ x77;
+    BS_WORD x79 = ~x41;
+    BS_WORD x80 = a5 & a3;
+    BS_WORD x81 = x79 ^ x80;
+    BS_WORD x82 = x0 & a4;
+    BS_WORD x83 = x81 ^ x82;
+    BS_WORD x84 = x32 & a2;
+    BS_WORD x85 = a5 ^ x84;
+    BS_WORD x86 = x35 ^ x85;
+    BS_WORD x87 = x86 & a3;
+    BS_WORD x88 = x35 ^ x87;
+    BS_WORD x89 = ~x69;
+    BS_WORD x90 = x8 & a2;
+    BS_WORD x91 = x9 ^ x90;
+    BS_WORD x92 = x89 ^ x91;
+    BS_WORD x93 = x92 & a3;
+    BS_WORD x94 = x89 ^ x93;
+    BS_WORD x95 = x88 ^ x94;
+    BS_WORD x96 = x95 & a4;
+    BS_WORD x97 = x88 ^ x96;
+    BS_WORD x98 = x83 ^ x97;
+    BS_WORD x99 = x98 & a1;
+    BS_WORD x100 = x83 ^ x99;
+    *out1 ^= x25;
+    *out2 ^= x52;
+    *out3 ^= x78;
+    *out4 ^= x100;
+}
+
+/** Gate network for S4.  XORs the four output bits of S4,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s4( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = ~a4;
+    BS_WORD x1 = a3 ^ x0;
+    BS_WORD x2 = ~a3;
+    BS_WORD x3 = x2 & a5;
+    BS_WORD x4 = a4 ^ x3;
+    BS_WORD x5 = ~x1;
+    BS_WORD x6 = a4 & a5;
+    BS_WORD x7 = x5 ^ x6;
+    BS_WORD x8 = x4 ^ x7;
+    BS_WORD x9 = x8 & a2;
+    BS_WORD x10 = x4 ^ x9;
+    BS_WORD x11 = x2 | x0;
+    BS_WORD x12 = x11 ^ a3;
+    BS_WORD x13 = x12 & a5;
+    BS_WORD x14 = x11 ^ x13;
+    BS_WORD x15 = x2 & a4;
+    BS_WORD x16 = x1 ^ x13;
+    BS_WORD x17 = x14 ^ x16;
+    BS_WORD x18 = x17 & a2;
+    BS_WORD x19 = x14 ^ x18;
+    BS_WORD x20 = x10 ^ x19;
+    BS_WORD x21 = x20 & a1;
+    BS_WORD x22 = x10 ^ x21;
+    BS_WORD x23 = x5 & a5;
+    BS_WORD x24 = x2 ^ x23;
+    BS_WORD x25 = x12 & a2;
+    BS_WORD x26 = x24 ^ x25;
+    BS_WORD x27 = x0 & a5;
+    BS_WORD x28 = a3 ^ x27;
+    BS_WORD x29 = ~x7;
+    BS_WORD x30 = x29 & a2;
+    BS_WORD x31 = x28 ^ x30;
+    BS_WORD x32 = x26 ^ x31;
+    BS_WORD x33 = x32 & a1;
+    BS_WORD x34 = x26 ^ x33;
+    BS_WORD x35 = x22 ^ x34;
+    BS_WORD x36 = x35 & a6;
+    BS_WORD x37 = x22 ^ x36;
+    BS_WORD x38 = ~x35;
+    BS_WORD x39 = x38 & a6;
+    BS_WORD x40 = x34 ^ x39;
+    BS_WORD x41 = ~x15;
+    BS_WORD x42 = x41 & a5;
+    BS_WORD x43 = x2 ^ x42;
+    BS_WORD x44 = x11 & a2;
+    BS_WORD x45 = x43 ^ x44;
+    BS_WORD x46 = a3 & a5;
+    BS_WORD x47 = x1 ^ x46;
+    BS_WORD x48 = ~x28;
+    BS_WORD x49 = x47 ^ x48;
+    BS_WORD x50 = x49 & a2;
+    BS_WORD x51 = x47 ^ x50;
+    BS_WORD x52 = x45 ^ x51;
+    BS_WORD x53 = x52 & a1;
+    BS_WORD x54 = x45 ^ x53;
+    BS_WORD x55 = x28 & a2;
+    BS_WORD x56 = x7 ^ x55;
+    BS_WORD x57 = x0 ^ x23;
+    BS_WORD x58 = x41 & a2;
+    BS_WORD x59 = x57 ^ x58;
+    BS_WORD x60 = x56 ^ x59;
+    BS_WORD x61 = x60 & a1;
+    BS_WORD x62 = x56 ^ x61;
+    BS_WORD x63 = x54 ^ x62;
+    BS_WORD x64 = x63 & a6;
+    BS_WORD x65 = x54 ^ x64;
+    BS_WORD x66 = ~x62;
+    BS_WORD x67 = ~x63;
+    BS_WORD x68 = x67 & a6;
+    BS_WORD x69 = x66 ^ x68;
+    *out1 ^= x37;
+    *out2 ^= x40;
+    *out3 ^= x65;
+    *out4 ^= x69;
+}
+
+/** Gate network for S5.  XORs the four output bits of S5,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s5( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = a1 & a3;
+    BS_WORD x1 = ~a3;
+    BS_WORD x2 = x0 ^ x1;
+    BS_WORD x3 = x2 & a6;
+    BS_WORD x4 = x0 ^ x3;
+    BS_WORD x5 = ~x0;
+    BS_WORD x6 = a6 ^ x5;
+    BS_WORD x7 = x4 ^ x6;
+    BS_WORD x8 = x7 & a2;
+    BS_WORD x9 = x4 ^ x8;
+    BS_WORD x10 = ~a1;
+    BS_WORD x11 = x10 | a3;
+    BS_WORD x12 = x11 ^ x2;
+    BS_WORD x13 = x12 & a6;
+    BS_WORD x14 = x11 ^ x13;
+    BS_WORD x15 = ~x11;
+    BS_WORD x16 = ~x2;
+    BS_WORD x17 = x16 & a6;
+    BS_WORD x18 = x15 ^ x17;
+    BS_WORD x19 = x14 ^ x18;
+    BS_WORD x20 = x19 & a2;
+    BS_WORD x21 = x14 ^ x20;
+    BS_WORD x22 = x9 ^ x21;
+    BS_WORD x23 = x22 & a5;
+    BS_WORD x24 = x9 ^ x23;
+    BS_WORD x25 = x15 & a6;
+    BS_WORD x26 = x16 ^ x25;
+    BS_WORD x27 = x1 & a6;
+    BS_WORD x28 = x12 ^ x27;
+    BS_WORD x29 = x26 ^ x28;
+    BS_WORD x30 = x29 & a2;
+    BS_WORD x31 = x26 ^ x30;
+    BS_WORD x32 = ~x12;
+    BS_WORD x33 = a1 ^ x27;
+    BS_WORD x34 = x11 ^ x1;
+    BS_WORD x35 = x34 & a6;
+    BS_WORD x36 = x11 ^ x35;
+    BS_WORD x37 = x33 ^ x36;
+    BS_WORD x38 = x37 & a2;
+    BS_WORD x39 = x33 ^ x38;
+    BS_WORD x40 = x31 ^ x39;
+    BS_WORD x41 = x40 & a5;
+    BS_WORD x42 = x31 ^ x41;
+    BS_WORD x43 = x24 ^ x42;
+    BS_WORD x44 = x43 & a4;
+    BS_WORD x45 = x24 ^ x44;
+    BS_WORD x46 = x11 & a6;
+    BS_WORD x47 = x34 ^ x46;
+    BS_WORD x48 = x28 ^ x47;
+    BS_WORD x49 = x48 & a2;
+    BS_WORD x50 = x28 ^ x49;
+    BS_WORD x51 = x10 & a6;
+    BS_WORD x52 = ~x13;
+    BS_WORD x53 = x52 & a5;
+    BS_WORD x54 = x50 ^ x53;
+    BS_WORD x55 = a6 ^ x32;
+    BS_WORD x56 = a2 ^ x55;
+    BS_WORD x57 = x11 & a5;
+    BS_WORD x58 = x56 ^ x57;
+    BS_WORD x59 = x54 ^ x58;
+    BS_WORD x60 = x59 & a4;
+    BS_WORD x61 = x54 ^ x60;
+    BS_WORD x62 = a1 ^ x17;
+    BS_WORD x63 = x36 ^ x62;
+    BS_WORD x64 = x63 & a2;
+    BS_WORD x65 = x36 ^ x64;
+    BS_WORD x66 = x12 ^ x3;
+    BS_WORD x67 = ~x63;
+    BS_WORD x68 = x66 ^ x67;
+    BS_WORD x69 = x68 & a2;
+    BS_WORD x70 = x66 ^ x69;
+    BS_WORD x71 = x65 ^ x70;
+    BS_WORD x72 = x71 & a5;
+    BS_WORD x73 = x65 ^ x72;
+    BS_WORD x74 = a3 ^ x51;
+    BS_WORD x75 = ~x62;
+    BS_WORD x76 = x74 ^ x75;
+    BS_WORD x77 = x76 & a2;
+    BS_WORD x78 = x74 ^ x77;
+    BS_WORD x79 = x12 ^ x17;
+    BS_WORD x80 = a2 ^ x79;
+    BS_WORD x81 = x78 ^ x80;
+    BS_WORD x82 = x81 & a5;
+    BS_WORD x83 = x78 ^ x82;
+    BS_WORD x84 = x73 ^ x83;
+    BS_WORD x85 = x84 & a4;
+    BS_WORD x86 = x73 ^ x85;
+    BS_WORD x87 = x16 ^ x35;
+    BS_WORD x88 = x87 ^ x28;
+    BS_WORD x89 = x88 & a2;
+    BS_WORD x90 = x87 ^ x89;
+    BS_WORD x91 = ~x37;
+    BS_WORD x92 = x1 & a2;
+    BS_WORD x93 = x91 ^ x92;
+    BS_WORD x94 = x90 ^ x93;
+    BS_WORD x95 = x94 & a5;
+    BS_WORD x96 = x90 ^ x95;
+    BS_WORD x97 = a1 & a6;
+    BS_WORD x98 = x34 ^ x97;
+    BS_WORD x99 = x98 ^ x20;
+    BS_WORD x100 = x1 ^ x46;
+    BS_WORD x101 = x16 & a2;
+    BS_WORD x102 = x100 ^ x101;
+    BS_WORD x103 = x99 ^ x102;
+    BS_WORD x104 = x103 & a5;
+    BS_WORD x105 = x99 ^ x104;
+    BS_WORD x106 = x96 ^ x105;
+    BS_WORD x107 = x106 & a4;
+    BS_WORD x108 = x96 ^ x107;
+    *out1 ^= x45;
+    *out2 ^= x61;
+    *out3 ^= x86;
+    *out4 ^= x108;
+}
+
+/** Gate network for S6.  XORs the four output bits of S6,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s6( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = ~a5;
+    BS_WORD x1 = a2 ^ x0;
+    BS_WORD x2 = a2 & a3;
+    BS_WORD x3 = x1 ^ x2;
+    BS_WORD x4 = ~a2;
+    BS_WORD x5 = x1 & a3;
+    BS_WORD x6 = x4 ^ x5;
+    BS_WORD x7 = x3 ^ x6;
+    BS_WORD x8 = x7 & a4;
+    BS_WORD x9 = x3 ^ x8;
+    BS_WORD x10 = x7 & a1;
+    BS_WORD x11 = x9 ^ x10;
+    BS_WORD x12 = x0 & a3;
+    BS_WORD x13 = ~x2;
+    BS_WORD x14 = x13 & a4;
+    BS_WORD x15 = x6 ^ x14;
+    BS_WORD x16 = x4 & x0;
+    BS_WORD x17 = a2 ^ x16;
+    BS_WORD x18 = x17 & a3;
+    BS_WORD x19 = a2 ^ x18;
+    BS_WORD x20 = ~x16;
+    BS_WORD x21 = x20 & a4;
+    BS_WORD x22 = x19 ^ x21;
+    BS_WORD x23 = x15 ^ x22;
+    BS_WORD x24 = x23 & a1;
+    BS_WORD x25 = x15 ^ x24;
+    BS_WORD x26 = x11 ^ x25;
+    BS_WORD x27 = x26 & a6;
+    BS_WORD x28 = x11 ^ x27;
+    BS_WORD x29 = x1 ^ x12;
+    BS_WORD x30 = a3 ^ a5;
+    BS_WORD x31 = x29 ^ x30;
+    BS_WORD x32 = x31 & a4;
+    BS_WORD x33 = x29 ^ x32;
+    BS_WORD x34 = ~x1;
+    BS_WORD x35 = a2 & a5;
+    BS_WORD x36 = x20 & a3;
+    BS_WORD x37 = x34 ^ x36;
+    BS_WORD x38 = ~x35;
+    BS_WORD x39 = x38 ^ x36;
+    BS_WORD x40 = x16 & a4;
+    BS_WORD x41 = x37 ^ x40;
+    BS_WORD x42 = x33 ^ x41;
+    BS_WORD x43 = x42 & a1;
+    BS_WORD x44 = x33 ^ x43;
+    BS_WORD x45 = ~x29;
+    BS_WORD x46 = a3 ^ x17;
+    BS_WORD x47 = x45 ^ x46;
+    BS_WORD x48 = x47 & a4;
+    BS_WORD x49 = x45 ^ x48;
+    BS_WORD x50 = a3 ^ x1;
+    BS_WORD x51 = x4 & a3;
+    BS_WORD x52 = a5 ^ x51;
+    BS_WORD x53 = x50 ^ x52;
+    BS_WORD x54 = x53 & a4;
+    BS_WORD x55 = x50 ^ x54;
+    BS_WORD x56 = x49 ^ x55;
+    BS_WORD x57 = x56 & a1;
+    BS_WORD x58 = x49 ^ x57;
+    BS_WORD x59 = x44 ^ x58;
+    BS_WORD x60 = x59 & a6;
+    BS_WORD x61 = x44 ^ x60;
+    BS_WORD x62 = x38 & a4;
+    BS_WORD x63 = x36 ^ x62;
+    BS_WORD x64 = x38 & a3;
+    BS_WORD x65 = x34 ^ x64;
+    BS_WORD x66 = a4 ^ x65;
+    BS_WORD x67 = x63 ^ x66;
+    BS_WORD x68 = x67 & a1;
+    BS_WORD x69 = x63 ^ x68;
+    BS_WORD x70 = x17 & a4;
+    BS_WORD x71 = x39 ^ x70;
+    BS_WORD x72 = a5 & a3;
+    BS_WORD x73 = x20 ^ x72;
+    BS_WORD x74 = x73 ^ x62;
+    BS_WORD x75 = x71 ^ x74;
+    BS_WORD x76 = x75 & a1;
+    BS_WORD x77 = x71 ^ x76;
+    BS_WORD x78 = x69 ^ x77;
+    BS_WORD x79 = x78 & a6;
+    BS_WORD x80 = x69 ^ x79;
+    BS_WORD x81 = ~x6;
+    BS_WORD x82 = x81 & a4;
+    BS_WORD x83 = x52 ^ x82;
+    BS_WORD x84 = x0 ^ x5;
+    BS_WORD x85 = ~x3;
+    BS_WORD x86 = x85 & a4;
+    BS_WORD x87 = x84 ^ x86;
+    BS_WORD x88 = x83 ^ x87;
+    BS_WORD x89 = x88 & a1;
+    BS_WORD x90 = x83 ^ x89;
+    BS_WORD x91 = x52 ^ x21;
+    BS_WORD x92 = a5 & a4;
+    BS_WORD x93 = x45 ^ x92;
+    BS_WORD x94 = x91 ^ x93;
+    BS_WORD x95 = x94 & a1;
+    BS_WORD x96 = x91 ^ x95;
+    BS_WORD x97 = x90 ^ x96;
+    BS_WORD x98 = x97 & a6;
+    BS_WORD x99 = x90 ^ x98;
+    *out1 ^= x28;
+    *out2 ^= x61;
+    *out3 ^= x80;
+    *out4 ^= x99;
+}
+
+/** Gate network for S7.  XORs the four output bits of S7,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s7( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = ~a5;
+    BS_WORD x1 = a2 ^ a5;
+    BS_WORD x2 = a2 & a4;
+    BS_WORD x3 = a5 ^ x2;
+    BS_WORD x4 = ~x1;
+    BS_WORD x5 = ~a2;
+    BS_WORD x6 = a5 & a4;
+    BS_WORD x7 = x4 ^ x6;
+    BS_WORD x8 = x3 ^ x7;
+    BS_WORD x9 = x8 & a3;
+    BS_WORD x10 = x3 ^ x9;
+    BS_WORD x11 = x5 | a5;
+    BS_WORD x12 = a2 ^ x11;
+    BS_WORD x13 = x12 & a4;
+    BS_WORD x14 = a2 ^ x13;
+    BS_WORD x15 = x5 & x0;
+    BS_WORD x16 = x15 ^ x13;
+    BS_WORD x17 = x14 ^ x16;
+    BS_WORD x18 = x17 & a3;
+    BS_WORD x19 = x14 ^ x18;
+    BS_WORD x20 = x10 ^ x19;
+    BS_WORD x21 = x20 & a1;
+    BS_WORD x22 = x10 ^ x21;
+    BS_WORD x23 = ~x3;
+    BS_WORD x24 = a3 ^ x23;
+    BS_WORD x25 = x17 & a4;
+    BS_WORD x26 = x1 ^ x25;
+    BS_WORD x27 = ~x17;
+    BS_WORD x28 = x27 & a3;
+    BS_WORD x29 = x26 ^ x28;
+    BS_WORD x30 = x24 ^ x29;
+    BS_WORD x31 = x30 & a1;
+    BS_WORD x32 = x24 ^ x31;
+    BS_WORD x33 = x22 ^ x32;
+    BS_WORD x34 = x33 & a6;
+    BS_WORD x35 = x22 ^ x34;
+    BS_WORD x36 = x5 & a4;
+    BS_WORD x37 = x4 ^ x36;
+    BS_WORD x38 = a2 & a3;
+    BS_WORD x39 = x37 ^ x38;
+    BS_WORD x40 = x39 ^ x10;
+    BS_WORD x41 = x40 & a1;
+    BS_WORD x42 = x39 ^ x41;
+    BS_WORD x43 = ~x15;
+    BS_WORD x44 = x11 & a4;
+    BS_WORD x45 = x0 ^ x44;
+    BS_WORD x46 = x15 & a4;
+    BS_WORD x47 = x4 ^ x46;
+    BS_WORD x48 = x45 ^ x47;
+    BS_WORD x49 = x48 & a3;
+    BS_WORD x50 = x45 ^ x49;
+    BS_WORD x51 = ~x2;
+    BS_WORD x52 = x51 & a3;
+    BS_WORD x53 = x4 ^ x52;
+    BS_WORD x54 = x50 ^ x53;
+    BS_WORD x55 = x54 & a1;
+    BS_WORD x56 = x50 ^ x55;
+    BS_WORD x57 = x42 ^ x56;
+    BS_WORD x58 = x57 & a6;
+    BS_WORD x59 = x42 ^ x58;
+    BS_WORD x60 = a3 ^ x26;
+    BS_WORD x61 = x4 & a4;
+    BS_WORD x62 = a2 ^ x61;
+    BS_WORD x63 = x43 & a3;
+    BS_WORD x64 = x62 ^ x63;
+    BS_WORD x65 = x60 ^ x64;
+    BS_WORD x66 = x65 & a1;
+    BS_WORD x67 = x60 ^ x66;
+    BS_WORD x68 = a4 ^ a2;
+    BS_WORD x69 = x61 & a3;
+    BS_WORD x70 = x68 ^ x69;
+    BS_WORD x71 = x5 ^ x44;
+    BS_WORD x72 = a3 ^ x71;
+    BS_WORD x73 = x70 ^ x72;
+    BS_WORD x74 = x73 & a1;
+    BS_WORD x75 = x70 ^ x74;
+    BS_WORD x76 = x67 ^ x75;
+    BS_WORD x77 = x76 & a6;
+    BS_WORD x78 = x67 ^ x77;
+    BS_WORD x79 = ~x7;
+    BS_WORD x80 = a4 ^ x0;
+    BS_WORD x81 = x79 ^ x80;
+    BS_WORD x82 = x81 & a3;
+    BS_WORD x83 = x79 ^ x82;
+    BS_WORD x84 = a1 ^ x83;
+    BS_WORD x85 = x43 & a4;
+    BS_WORD x86 = x4 ^ x85;
+    BS_WORD x87 = x86 ^ x82;
+    BS_WORD x88 = ~x16;
+    BS_WORD x89 = a3 ^ x88;
+    BS_WORD x90 = x87 ^ x89;
+    BS_WORD x91 = x90 & a1;
+    BS_WORD x92 = x87 ^ x91;
+    BS_WORD x93 = x84 ^ x92;
+    BS_WORD x94 = x93 & a6;
+    BS_WORD x95 = x84 ^ x94;
+    *out1 ^= x35;
+    *out2 ^= x59;
+    *out3 ^= x78;
+    *out4 ^= x95;
+}
+
+/** Gate network for S8.  XORs the four output bits of S8,
+    selected by the six input planes a1 .. a6, into out1 .. out4. */
+static inline void s8( BS_WORD a1, BS_WORD a2, BS_WORD a3,
+                       BS_WORD a4, BS_WORD a5, BS_WORD a6,
+                       BS_WORD *out1, BS_WORD *out2,
+                       BS_WORD *out3, BS_WORD *out4 )
+{
+    BS_WORD x0 = ~a3;
+    BS_WORD x1 = x0 | a4;
+    BS_WORD x2 = a5 ^ x1;
+    BS_WORD x3 = ~a4;
+    BS_WORD x4 = a3 ^ x3;
+    BS_WORD x5 = a4 & a5;
+    BS_WORD x6 = x4 ^ x5;
+    BS_WORD x7 = x2 ^ x6;
+    BS_WORD x8 = x7 & a2;
+    BS_WORD x9 = x2 ^ x8;
+    BS_WORD x10 = x4 & a5;
+    BS_WORD x11 = a3 ^ x10;
+    BS_WORD x12 = ~x4;
+    BS_WORD x13 = a3 & a5;
+    BS_WORD x14 = x12 ^ x13;
+    BS_WORD x15 = x11 ^ x14;
+    BS_WORD x16 = x15 & a2;
+    BS_WORD x17 = x11 ^ x16;
+    BS_WORD x18 = x9 ^ x17;
+    BS_WORD x19 = x18 & a1;
+    BS_WORD x20 = x9 ^ x19;
+    BS_WORD x21 = x3 & a5;
+    BS_WORD x22 = x12 ^ x21;
+    BS_WORD x23 = ~x5;
+    BS_WORD x24 = x23 & a2;
+    BS_WORD x25 = x22 ^ x24;
+    BS_WORD x26 = x12 & a5;
+    BS_WORD x27 = a4 ^ x26;
+    BS_WORD x28 = ~x14;
+    BS_WORD x29 = x28 & a2;
+    BS_WORD x30 = x27 ^ x29;
+    BS_WORD x31 = x25 ^ x30;
+    BS_WORD x32 = x31 & a1;
+    BS_WORD x33 = x25 ^ x32;
+    BS_WORD x34 = x20 ^ x33;
+    BS_WORD x35 = x34 & a6;
+    BS_WORD x36 = x20 ^ x35;
+    BS_WORD x37 = x0 & a5;
+    BS_WORD x38 = x3 ^ x37;
+    BS_WORD x39 = ~x22;
+    BS_WORD x40 = x39 & a2;
+    BS_WORD x41 = x38 ^ x40;
+    BS_WORD x42 = a5 ^ a3;
+    BS_WORD x43 = x2 ^ x42;
+    BS_WORD x44 = x43 & a2;
+    BS_WORD x45 = x2 ^ x44;
+    BS_WORD x46 = x41 ^ x45;
+    BS_WORD x47 = x46 & a1;
+    BS_WORD x48 = x41 ^ x47;
+    BS_WORD x49 = ~x41;
+    BS_WORD x50 = a2 ^ x14;
+    BS_WORD x51 = x49 ^ x50;
+    BS_WORD x52 = x51 & a1;
+    BS_WORD x53 = x49 ^ x52;
+    BS_WORD x54 = x48 ^ x53;
+    BS_WORD x55 = x54 & a6;
+    BS_WORD x56 = x48 ^ x55;
+    BS_WORD x57 = a2 ^ x11;
+    BS_WORD x58 = ~x37;
+    BS_WORD x59 = x58 & a2;
+    BS_WORD x60 = x4 ^ x59;
+    BS_WORD x61 = x57 ^ x60;
+    BS_WORD x62 = x61 & a1;
+    BS_WORD x63 = x57 ^ x62;
+    BS_WORD x64 = x0 & a4;
+    BS_WORD x65 = a3 | a4;
+    BS_WORD x66 = x64 ^ x13;
+    BS_WORD x67 = x11 ^ x66;
+    BS_WORD x68 = x67 & a2;
+    BS_WORD x69 = x11 ^ x68;
+    BS_WORD x70 = x0 ^ x21;
+    BS_WORD x71 = x65 & a2;
+    BS_WORD x72 = x70 ^ x71;
+    BS_WORD x73 = x69 ^ x72;
+    BS_WORD x74 = x73 & a1;
+    BS_WORD x75 = x69 ^ x74;
+    BS_WORD x76 = x63 ^ x75;
+    BS_WORD x77 = x76 & a6;
+    BS_WORD x78 = x63 ^ x77;
+    BS_WORD x79 = ~x33;
+    BS_WORD x80 = x65 & a5;
+    BS_WORD x81 = x1 ^ x80;
+    BS_WORD x82 = x1 & a5;
+    BS_WORD x83 = x70 & a2;
+    BS_WORD x84 = x81 ^ x83;
+    BS_WORD x85 = x82 ^ x44;
+    BS_WORD x86 = x84 ^ x85;
+    BS_WORD x87 = x86 & a1;
+    BS_WORD x88 = x84 ^ x87;
+    BS_WORD x89 = x79 ^ x88;
+    BS_WORD x90 = x89 & a6;
+    BS_WORD x91 = x79 ^ x90;
+    *out1 ^= x36;
+    *out2 ^= x56;
+    *out3 ^= x78;
+    *out4 ^= x91;
+}
+
+/**
+    Transpose the 64 x 64 bit matrix in each lane of m in place, so
+    bit j of word i of a lane swaps with bit i of word j. Every lane is
+    transposed at once by the same shifts and masks.
+    @param m array of 64 words to transpose
+*/
+static void transposePlanes( BS_WORD m[ BLOCK_BITS ] )
+{
+    // Swap ever smaller square sub-blocks across the diagonal
+    uint64_t mask = 0x00000000FFFFFFFFULL;
+    for ( int j = BLOCK_HALF_BITS; j != 0; j >>= 1, mask ^= ( mask << j ) ) {
+        for ( int k = 0; k < BLOCK_BITS; k = ( ( k | j ) + 1 ) & ~j ) {
+            BS_WORD t = ( m[ k ] ^ ( m[ k | j ] >> j ) ) & mask;
+            m[ k ] ^= t;
+            m[ k | j ] ^= ( t << j );
+        }
+    }
+}
+
+/**
+    Load n consecutive blocks into bit-planes. Block g * 64 + j goes in
+    row j of lane g before the transpose, and blocks past n are zero.
+    @param planes the resulting bit-planes
+    @param src address of the first block
+    @param stride number of bytes from the start of one block to the next
+    @param n number of blocks to load, at most BS_BLOCKS
+*/
+static void loadPlanes( BS_WORD planes[ BLOCK_BITS ], byte const *src, size_t stride, int n )
+{
+    for ( int j = 0; j < BLOCK_BITS; j++ ) {
+        for ( int g = 0; g < BS_LANES; g++ ) {
+            int idx = g * BITSLICE_WIDTH + j;
+            BS_LANE( planes[ j ], g ) = idx < n ? loadBlock64( src + idx * stride ) : 0;
+        }
+    }
+
+    transposePlanes( planes );
+}
+
+/**
+    Store the first n blocks held in bit-planes. The planes are
+    destroyed.
+    @param dst address of the first block
+    @param stride number of bytes from the start of one block to the next
+    @param planes the bit-planes to store
+    @param n number of blocks to store, at most BS_BLOCKS
+*/
+static void storePlanes( byte *dst, size_t stride, BS_WORD planes[ BLOCK_BITS ], int n )
+{
+    transposePlanes( planes );
+
+    for ( int j = 0; j < BLOCK_BITS; j++ ) {
+        for ( int g = 0; g < BS_LANES; g++ ) {
+            int idx = g * BITSLICE_WIDTH + j;
+            if ( idx < n ) {
+                storeBlock64( dst + idx * stride, BS_LANE( planes[ j ], g ) );
+            }
+        }
+    }
+}
+
+/**
+    Run IP, 16 rounds for each stage and FP on the blocks in a set of
+    bit-planes. Key planes are whole 64-bit words of zeros or ones,
+    so they apply to every lane alike.
+    @param planes the bit-planes to encrypt or decrypt in place
+    @param KP key planes for each stage, indexed from 1 to 16
+    @param stages number of stages in KP
+    @param reverse true if the subkeys of each stage should be applied
+    from 16 down to 1
+*/
+static void cryptPlanes( BS_WORD planes[ BLOCK_BITS ],
+                         uint64_t const KP[][ ROUND_COUNT ][ SUBKEY_BITS ], int stages,
+                         bool reverse )
+{
+    // Zero-based plane index for each bit of the expanded R
+    int e[ SUBKEY_BITS ];
+    for ( int i = 0; i < SUBKEY_BITS; i++ ) {
+        e[ i ] = expandedRSelector[ i ] - 1;
+    }
+
+    // Where each S-box output bit lands after fFunctionPerm
+    int p[ BLOCK_HALF_BITS ];
+    for ( int i = 0; i < BLOCK_HALF_BITS; i++ ) {
+        p[ fFunctionPerm[ i ] - 1 ] = i;
+    }
+
+    // Initial permutation
+    BS_WORD LR[ BLOCK_BITS ];
+    for ( int i = 0; i < BLOCK_HALF_BITS; i++ ) {
+        LR[ i ] = planes[ leftInitialPerm[ i ] - 1 ];
+        LR[ i + BLOCK_HALF_BITS ] = planes[ rightInitialPerm[ i ] - 1 ];
+    }
+
+    BS_WORD *L = LR;
+    BS_WORD *R = LR + BLOCK_HALF_BITS;
+
+    for ( int s = 0; s < stages; s++ ) {
+        // R16 L16 of one stage is L0 R0 of the next
+        if ( s > 0 ) {
+            BS_WORD *t = L;
+            L = R;
+            R = t;
+        }
+
+        for ( int i = 1; i < ROUND_COUNT; i++ ) {
+            uint64_t const *k = KP[ s ][ reverse ? ROUND_COUNT - i : i ];
+
+            // The S-box gates XOR f( R, K ) straight into L
+#define SBOX( fn, s ) \
+            fn( R[ e[ 6 * s ] ] ^ k[ 6 * s ], R[ e[ 6 * s + 1 ] ] ^ k[ 6 * s + 1 ], \
+                R[ e[ 6 * s + 2 ] ] ^ k[ 6 * s + 2 ], R[ e[ 6 * s + 3 ] ] ^ k[ 6 * s + 3 ], \
+                R[ e[ 6 * s + 4 ] ] ^ k[ 6 * s + 4 ], R[ e[ 6 * s + 5 ] ] ^ k[ 6 * s + 5 ], \
+                &L[ p[ 4 * s ] ], &L[ p[ 4 * s + 1 ] ], &L[ p[ 4 * s + 2 ] ], \
+                &L[ p[ 4 * s + 3 ] ] )
+
+            SBOX( s1, 0 );
+            SBOX( s2, 1 );
+            SBOX( s3, 2 );
+            SBOX( s4, 3 );
+            SBOX( s5, 4 );
+            SBOX( s6, 5 );
+            SBOX( s7, 6 );
+            SBOX( s8, 7 );
+#undef SBOX
+
+            // L becomes the old R
+            BS_WORD *t = L;
+            L = R;
+            R = t;
+        }
+    }
+
+    // Final permutation of R16 L16
+    for ( int i = 0; i < BLOCK_BITS; i++ ) {
+        int idx = finalPerm[ i ] - 1;
+        planes[ i ] = idx < BLOCK_HALF_BITS ? R[ idx ] : L[ idx - BLOCK_HALF_BITS ];
+    }
+}
+
+/**
+    Encrypt or decrypt up to BS_BLOCKS consecutive blocks. This is the
+    function each kernel exports through its BitsliceKernel.
+    @param dst where the result goes
+    @param src the input blocks
+    @param n number of blocks, at most BS_BLOCKS
+    @param KP key planes for each stage, in the order they are applied
+    @param stages number of stages in KP
+*/
+static void cryptKernel( byte *dst, byte const *src, int n,
+                         uint64_t const KP[][ ROUND_COUNT ][ SUBKEY_BITS ], int stages )
+{
+    BS_WORD planes[ BLOCK_BITS ];
+    loadPlanes( planes, src, BLOCK_BYTES, n );
+    cryptPlanes( planes, KP, stages, false );
+    storePlanes( dst, BLOCK_BYTES, planes, n );
+}
@@ -0,0 +1,424 @@
+/**
+    @file DESContext.c
+    @author John Butterfield (jpbutte2)
+    Context component. It runs the modes of operation on top of the
+    buffer engine, and reads and writes files in the same format as the
+    encrypt and decrypt programs.
+*/
+
+#include <errno.h>
+#include "DESContext.h"
+#include "DESEngine.h"
+#include "DESPerm.h"
+#include "io.h"
+#include "pool.h"
+
+/** A key that is ready to use with a mode of operation. */
+struct DESContext {
+  /** The key schedule. */
+  DESKey key;
+
+  /** The mode of operation. */
+  CipherMode mode;
+};
+
+/**
+    Round a number of bytes up to a whole number of blocks.
+    @param len number of bytes
+    @return len rounded up to a multiple of BLOCK_BYTES
+*/
+static size_t roundToBlocks( size_t len )
+{
+    return ( len + BLOCK_BYTES - 1 ) / BLOCK_BYTES * BLOCK_BYTES;
+}
+
+/**
+    Allocate a context with the given mode.
+    @param mode the mode of operation
+    @return the context, with its key still to be set up, or NULL
+*/
+static DESContext *allocContext( CipherMode mode )
+{
+    DESContext *ctx = malloc( sizeof( DESContext ) );
+    if ( ctx != NULL ) {
+        ctx->mode = mode;
+    }
+    return ctx;
+}
+
+DESContext *desContextCreate( byte const key[ BLOCK_BYTES ], CipherMode mode )
+{
+    DESContext *ctx = allocContext( mode );
+    if ( ctx != NULL ) {
+        desKeySetup( &ctx->key, key );
+    }
+    return ctx;
+}
+
+DESContext *desContextCreateTriple( byte const key1[ BLOCK_BYTES ],
+                                    byte const key2[ BLOCK_BYTES ],
+                                    byte const key3[ BLOCK_BYTES ], CipherMode mode )
+{
+    DESContext *ctx = allocContext( mode );
+    if ( ctx != NULL ) {
+        desTripleKeySetup( &ctx->key, key1, key2, key3 );
+    }
+    return ctx;
+}
+
+void desContextFree( DESContext *ctx )
+{
+    if ( ctx == NULL ) {
+        return;
+    }
+
+    // Don't leave the subkeys lying around in freed memory
+    volatile byte *p = (volatile byte *) ctx;
+    for ( size_t i = 0; i < sizeof( DESContext ); i++ ) {
+        p[ i ] = 0;
+    }
+    free( ctx );
+}
+
+bool desContextSetEngine( DESContext *ctx, DESEngine const *engine )
+{
+    if ( !desEngineSelfTest( engine ) ) {
+        return false;
+    }
+
+    desKeyUseEngine( &ctx->key, engine );
+    return true;
+}
+
+CipherMode desContextMode( DESContext const *ctx )
+{
+    return ctx->mode;
+}
+
+void desCryptBlocks( DESContext const *ctx, bool decrypt, byte *dst, byte const *src,
+                     size_t len )
+{
+    size_t full = len / BLOCK_BYTES;
+    size_t tail = len % BLOCK_BYTES;
+
+    if ( decrypt ) {
+        desDecryptBuffer( &ctx->key, dst, src, full );
+    } else {
+        desEncryptBuffer( &ctx->key, dst, src, full );
+    }
+
+    if ( tail > 0 ) {
+        byte block[ BLOCK_BYTES ] = { 0 };
+        memcpy( block, src + full * BLOCK_BYTES, tail );
+
+        if ( decrypt ) {
+            desDecryptBuffer( &ctx->key, block, block, 1 );
+            memcpy( dst + full * BLOCK_BYTES, block, tail );
+        } else {
+            desEncryptBuffer( &ctx->key, dst + full * BLOCK_BYTES, block, 1 );
+        }
+    }
+}
+
+size_t desOutputBound( DESContext const *ctx, bool decrypt, size_t len )
+{
+    if ( !decrypt && ctx->mode == MODE_ECB ) {
+        return roundToBlocks( len );
+    }
+
+    // CBC always adds between 1 and 8 bytes of padding
+    if ( !decrypt && ctx->mode == MODE_CBC ) {
+        return len / BLOCK_BYTES * BLOCK_BYTES + BLOCK_BYTES;
+    }
+
+    return len;
+}
+
+void desStreamInit( DESStream *stream, bool decrypt, uint64_t nonce )
+{
+    stream->decrypt = decrypt;
+    stream->nonce = nonce;
+    stream->pos = 0;
+    stream->chain = nonce;
+}
+
+/**
+    Remove the zero padding from each decrypted block and pack what is
+    left of the blocks together at the start of data.
+    @param data the decrypted blocks
+    @param len number of bytes of data that came from the file
+    @return number of bytes left after removing the padding
+*/
+static size_t stripPadding( byte *data, size_t len )
+{
+    size_t outLen = 0;
+
+    for ( size_t start = 0; start < len; start += BLOCK_BYTES ) {
+        byte *block = data + start;
+        size_t blockLen = len - start < BLOCK_BYTES ? len - start : BLOCK_BYTES;
+
+        // Check for padding
+        while ( blockLen > 0 && block[ blockLen - 1 ] == '\0' ) {
+            blockLen--;
+        }
+
+        if ( data + outLen != block ) {
+            memmove( data + outLen, block, blockLen );
+        }
+        outLen += blockLen;
+    }
+
+    return outLen;
+}
+
+/**
+    Encrypt or decrypt a piece of a CBC stream. Encryption pads the last
+    piece out to a whole number of blocks with PKCS#7 padding: n bytes,
+    each holding n, with a whole block of padding if the data ends on a
+    block boundary. Decryption checks and removes that padding.
+    @param ctx the context
+    @param stream the stream, whose chain is updated
+    @param dst where the result goes
+    @param src the input bytes
+    @param len number of input bytes
+    @param last true if this piece is the end of the stream
+    @return number of bytes left in dst, or DES_INVALID
+*/
+static size_t cryptCbc( DESContext const *ctx, DESStream *stream, byte *dst, byte const *src,
+                        size_t len, bool last )
+{
+    size_t full = len / BLOCK_BYTES;
+
+    if ( !stream->decrypt ) {
+        desCbcEncrypt( &ctx->key, &stream->chain, dst, src, full );
+        if ( !last ) {
+            return full * BLOCK_BYTES;
+        }
+
+        byte block[ BLOCK_BYTES ];
+        size_t tail = len - full * BLOCK_BYTES;
+        memcpy( block, src + full * BLOCK_BYTES, tail );
+        memset( block + tail, BLOCK_BYTES - tail, BLOCK_BYTES - tail );
+        desCbcEncrypt( &ctx->key, &stream->chain, dst + full * BLOCK_BYTES, block, 1 );
+        return ( full + 1 ) * BLOCK_BYTES;
+    }
+
+    if ( len != full * BLOCK_BYTES || ( last && len == 0 ) ) {
+        return DES_INVALID;
+    }
+
+    desCbcDecrypt( &ctx->key, &stream->chain, dst, src, full );
+    if ( !last ) {
+        return len;
+    }
+
+    byte pad = dst[ len - 1 ];
+    if ( pad == 0 || pad > BLOCK_BYTES ) {
+        return DES_INVALID;
+    }
+    for ( size_t i = len - pad; i < len; i++ ) {
+        if ( dst[ i ] != pad ) {
+            return DES_INVALID;
+        }
+    }
+
+    return len - pad;
+}
+
+size_t desStreamCrypt( DESContext const *ctx, DESStream *stream, byte *dst, byte const *src,
+                       size_t len, bool last )
+{
+    size_t outLen;
+    if ( ctx->mode == MODE_CTR ) {
+        desCtrCrypt( &ctx->key, stream->nonce, stream->pos, dst, src, len );
+        outLen = len;
+    } else if ( ctx->mode == MODE_CBC ) {
+        outLen = cryptCbc( ctx, stream, dst, src, len, last );
+    } else {
+        desCryptBlocks( ctx, stream->decrypt, dst, src, len );
+        outLen = stream->decrypt ? stripPadding( dst, len ) : roundToBlocks( len );
+    }
+
+    stream->pos += len;
+    return outLen;
+}
+
+size_t desEncrypt( DESContext const *ctx, uint64_t nonce, byte *dst, byte const *src,
+                   size_t len )
+{
+    DESStream stream;
+    desStreamInit( &stream, false, nonce );
+    return desStreamCrypt( ctx, &stream, dst, src, len, true );
+}
+
+size_t desDecrypt( DESContext const *ctx, uint64_t nonce, byte *dst, byte const *src,
+                   size_t len )
+{
+    DESStream stream;
+    desStreamInit( &stream, true, nonce );
+    return desStreamCrypt( ctx, &stream, dst, src, len, true );
+}
+
+bool desCbcEncryptMany( DESContext const *ctx, int count, uint64_t const iv[],
+                        byte *const dst[], byte const *const src[], size_t const len[] )
+{
+    if ( count == 0 ) {
+        return true;
+    }
+
+    uint64_t *chain = malloc( 2 * count * sizeof( uint64_t ) );
+    byte **to = malloc( count * sizeof( byte * ) );
+    byte const **from = malloc( count * sizeof( byte const * ) );
+    int *active = malloc( count * sizeof( int ) );
+    byte *tails = malloc( count * BLOCK_BYTES );
+    if ( chain == NULL || to == NULL || from == NULL || active == NULL || tails == NULL ) {
+        free( chain );
+        free( to );
+        free( from );
+        free( active );
+        free( tails );
+        return false;
+    }
+    uint64_t *batchChain = chain + count;
+
+    // The padded last blocks are set aside first, since dst may be src
+    for ( int s = 0; s < count; s++ ) {
+        size_t full = len[ s ] / BLOCK_BYTES;
+        size_t tail = len[ s ] - full * BLOCK_BYTES;
+        memcpy( tails + s * BLOCK_BYTES, src[ s ] + full * BLOCK_BYTES, tail );
+        memset( tails + s * BLOCK_BYTES + tail, BLOCK_BYTES - tail, BLOCK_BYTES - tail );
+        chain[ s ] = iv[ s ];
+    }
+
+    // Every message with whole blocks left takes part, as far as the
+    // shortest of them goes, so there are at most count rounds
+    size_t done = 0;
+    while ( true ) {
+        int n = 0;
+        size_t step = 0;
+        for ( int s = 0; s < count; s++ ) {
+            size_t left = len[ s ] / BLOCK_BYTES - done;
+            if ( len[ s ] / BLOCK_BYTES > done ) {
+                active[ n++ ] = s;
+                step = step == 0 || left < step ? left : step;
+            }
+        }
+        if ( n == 0 ) {
+            break;
+        }
+
+        for ( int i = 0; i < n; i++ ) {
+            to[ i ] = dst[ active[ i ] ] + done * BLOCK_BYTES;
+            from[ i ] = src[ active[ i ] ] + done * BLOCK_BYTES;
+            batchChain[ i ] = chain[ active[ i ] ];
+        }
+        desCbcEncryptInterleaved( &ctx->key, n, batchChain, to, from, step );
+        for ( int i = 0; i < n; i++ ) {
+            chain[ active[ i ] ] = batchChain[ i ];
+        }
+        done += step;
+    }
+
+    // The padding blocks all go through together at the end
+    for ( int s = 0; s < count; s++ ) {
+        to[ s ] = dst[ s ] + len[ s ] / BLOCK_BYTES * BLOCK_BYTES;
+        from[ s ] = tails + s * BLOCK_BYTES;
+    }
+    desCbcEncryptInterleaved( &ctx->key, count, chain, to, from, 1 );
+
+    free( chain );
+    free( to );
+    free( from );
+    free( active );
+    free( tails );
+    return true;
+}
+
+/**
+    Run the rest of a file through a stream, a chunk at a time.
+    @param ctx the context
+    @param stream the stream, already past any header
+    @param inputFile the file to read from
+    @param outputFile the file to write to
+    @return true if successful
+*/
+static bool cryptFileData( DESContext const *ctx, DESStream *stream, FILE *inputFile,
+                           FILE *outputFile )
+{
+    // Room for a chunk and a block of CBC padding
+    byte *data = poolTake( DEFAULT_CHUNK_BYTES + BLOCK_BYTES, false );
+    if ( data == NULL ) {
+        return false;
+    }
+
+    bool ok = true, last = false;
+    do {
+        // An empty input still gets its end handled, for padding
+        size_t len = readFull( inputFile, data, DEFAULT_CHUNK_BYTES, &last );
+        if ( ferror( inputFile ) || ( len == 0 && stream->pos > 0 ) ) {
+            ok = !ferror( inputFile );
+            break;
+        }
+
+        size_t outLen = desStreamCrypt( ctx, stream, data, data, len, last );
+        if ( outLen == DES_INVALID ) {
+            errno = 0;
+            ok = false;
+        } else if ( fwrite( data, sizeof( byte ), outLen, outputFile ) != outLen ) {
+            ok = false;
+        }
+    } while ( ok && !last );
+
+    poolGive( data, DEFAULT_CHUNK_BYTES + BLOCK_BYTES );
+    return ok;
+}
+
+bool desEncryptFile( DESContext const *ctx, FILE *inputFile, FILE *outputFile )
+{
+    uint64_t nonce = 0;
+    if ( ctx->mode != MODE_ECB ) {
+        byte header[ HEADER_BYTES ];
+        if ( !randomBytes( header, BLOCK_BYTES ) ) {
+            return false;
+        }
+        nonce = loadBlock64( header );
+
+        encodeHeader( header, ctx->mode, nonce, 0 );
+        if ( fwrite( header, sizeof( byte ), HEADER_BYTES, outputFile ) != HEADER_BYTES ) {
+            return false;
+        }
+    }
+
+    DESStream stream;
+    desStreamInit( &stream, false, nonce );
+    return cryptFileData( ctx, &stream, inputFile, outputFile );
+}
+
+bool desDecryptFile( DESContext const *ctx, FILE *inputFile, FILE *outputFile )
+{
+    uint64_t nonce = 0;
+    if ( ctx->mode != MODE_ECB ) {
+        byte header[ HEADER_BYTES ];
+        if ( fread( header, sizeof( byte ), HEADER_BYTES, inputFile ) != HEADER_BYTES ) {
+            if ( !ferror( inputFile ) ) {
+                errno = 0;
+            }
+            return false;
+        }
+        // Compressed and indexed files need the frames the programs write
+        int flags;
+        if ( !decodeHeader( header, ctx->mode, &nonce, &flags ) || flags != 0 ) {
+            errno = 0;
+            return false;
+        }
+    }
+
+    DESStream stream;
+    desStreamInit( &stream, true, nonce );
+    return cryptFileData( ctx, &stream, inputFile, outputFile );
+}
+
+void desReleaseBuffers( void )
+{
+    poolTrim();
+}
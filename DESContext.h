@@ -0,0 +1,234 @@
+/**
+    @file DESContext.h
+    @author John Butterfield (jpbutte2)
+    Header for the context interface to DES, the public face of libdes.
+    A context is created once from a key and a mode of operation, and
+    can then encrypt or decrypt any number of buffers, streams or files
+    without redoing the key schedule. Apart from choosing its engine
+    straight after it is created, a context is never changed, so any
+    number of threads can share one; the position in a stream of data
+    lives in a DESStream owned by the caller. The library keeps no
+    global state that changes after start-up, other than the engine
+    registry and its self-test results, which are filled in once, and
+    a cache of the file calls' chunk buffers, which
+    desReleaseBuffers() empties.
+*/
+
+#ifndef DESCONTEXT_H
+#define DESCONTEXT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "DES.h"
+#include "DESEngine.h"
+
+/** Returned in place of a length when the input isn't valid ciphertext. */
+#define DES_INVALID ( (size_t) -1 )
+
+/** How blocks are chained together. The values are stored in file
+    headers, so they must not change. */
+typedef enum {
+  /** Each block on its own, with no header, as the original programs did. */
+  MODE_ECB = 0,
+
+  /** Counter mode, with the starting counter in a header. */
+  MODE_CTR = 1,
+
+  /** Cipher block chaining, with the IV in a header and PKCS#7 padding. */
+  MODE_CBC = 2
+} CipherMode;
+
+/** A key that is ready to use with a mode of operation. */
+typedef struct DESContext DESContext;
+
+/** Position in a stream of data being encrypted or decrypted. */
+typedef struct {
+  /** True to decrypt, false to encrypt. */
+  bool decrypt;
+
+  /** Starting counter for CTR, or the IV for CBC. */
+  uint64_t nonce;
+
+  /** Number of bytes of the stream processed so far. */
+  uint64_t pos;
+
+  /** Last ciphertext block so far, which the next block chains from in
+      CBC mode. */
+  uint64_t chain;
+} DESStream;
+
+/**
+    This function creates a context for single DES.
+    @param key the key, with the parity bits ignored
+    @param mode the mode of operation
+    @return the new context, or NULL if there isn't enough memory
+*/
+DESContext *desContextCreate( byte const key[ BLOCK_BYTES ], CipherMode mode );
+
+/**
+    This function creates a context for triple DES in EDE form, as
+    desTripleKeySetup() describes.
+    @param key1 key for the first stage of encryption
+    @param key2 key for the middle stage
+    @param key3 key for the last stage of encryption
+    @param mode the mode of operation
+    @return the new context, or NULL if there isn't enough memory
+*/
+DESContext *desContextCreateTriple( byte const key1[ BLOCK_BYTES ],
+                                    byte const key2[ BLOCK_BYTES ],
+                                    byte const key3[ BLOCK_BYTES ], CipherMode mode );
+
+/**
+    This function frees a context, first clearing the key schedule.
+    @param ctx the context, or NULL
+*/
+void desContextFree( DESContext *ctx );
+
+/**
+    This function chooses the engine a context runs on, in place of
+    "auto", which picks the fastest engine for each run of blocks. The
+    engine has to pass desEngineSelfTest() first. Call this before the
+    context is shared between threads.
+    @param ctx the context
+    @param engine the engine, from desEngines() or desEngineFind()
+    @return true if the engine is now in use, false if it failed its
+    self-test, leaving the context as it was
+*/
+bool desContextSetEngine( DESContext *ctx, DESEngine const *engine );
+
+/**
+    This function returns the mode of operation of a context.
+    @param ctx the context
+    @return its mode
+*/
+CipherMode desContextMode( DESContext const *ctx );
+
+/**
+    This function encrypts or decrypts len bytes from src into dst one
+    block at a time, with no chaining and no padding removed. A short
+    last block is padded with zeros before it goes through the cipher.
+    When decrypting, only len bytes are written to dst; when encrypting,
+    the padded block is written. dst may be the same as src.
+    @param ctx the context, whose mode is ignored
+    @param decrypt true to decrypt, false to encrypt
+    @param dst where the result goes
+    @param src the input bytes
+    @param len number of input bytes
+*/
+void desCryptBlocks( DESContext const *ctx, bool decrypt, byte *dst, byte const *src,
+                     size_t len );
+
+/**
+    This function returns the most output that encrypting or decrypting
+    len bytes can produce in the context's mode, so the caller knows
+    how much room dst needs.
+    @param ctx the context
+    @param decrypt true to decrypt, false to encrypt
+    @param len number of input bytes
+    @return the most output bytes
+*/
+size_t desOutputBound( DESContext const *ctx, bool decrypt, size_t len );
+
+/**
+    This function starts a stream at its first byte.
+    @param stream the stream to set up
+    @param decrypt true to decrypt, false to encrypt
+    @param nonce starting counter for CTR or IV for CBC; ignored for ECB
+*/
+void desStreamInit( DESStream *stream, bool decrypt, uint64_t nonce );
+
+/**
+    This function encrypts or decrypts the next len bytes of a stream.
+    Only the last piece of a stream can end partway through a block.
+    ECB pads the last block with zeros, and decryption removes trailing
+    zeros from every block, as the original programs did. CBC pads the
+    last piece with PKCS#7 padding, and decryption checks and removes
+    it. CTR needs no padding. dst may be the same as src, and needs
+    room for desOutputBound() bytes.
+    @param ctx the context
+    @param stream the stream, which is moved past the piece
+    @param dst where the result goes
+    @param src the input bytes
+    @param len number of input bytes
+    @param last true if this piece is the end of the stream
+    @return number of bytes stored in dst, or DES_INVALID
+*/
+size_t desStreamCrypt( DESContext const *ctx, DESStream *stream, byte *dst, byte const *src,
+                       size_t len, bool last );
+
+/**
+    This function encrypts a whole message held in memory.
+    @param ctx the context
+    @param nonce starting counter for CTR or IV for CBC; ignored for ECB
+    @param dst where the ciphertext goes, with room for desOutputBound()
+    bytes
+    @param src the plaintext
+    @param len number of plaintext bytes
+    @return number of ciphertext bytes
+*/
+size_t desEncrypt( DESContext const *ctx, uint64_t nonce, byte *dst, byte const *src,
+                   size_t len );
+
+/**
+    This function decrypts a whole message held in memory.
+    @param ctx the context
+    @param nonce starting counter for CTR or IV for CBC; ignored for ECB
+    @param dst where the plaintext goes, with room for len bytes
+    @param src the ciphertext
+    @param len number of ciphertext bytes
+    @return number of plaintext bytes, or DES_INVALID
+*/
+size_t desDecrypt( DESContext const *ctx, uint64_t nonce, byte *dst, byte const *src,
+                   size_t len );
+
+/**
+    This function encrypts several whole messages in CBC mode side by
+    side, with PKCS#7 padding on each. A message only chains through
+    its own blocks, so block j of every message can go through the
+    cipher at once, on the bitsliced engine when there are enough of
+    them. Gives the same result as desEncrypt() on each message.
+    @param ctx the context; its mode is taken to be CBC
+    @param count number of messages
+    @param iv the IV of each message
+    @param dst where the ciphertext of each message goes, with room for
+    desOutputBound() bytes; it may be the same as src
+    @param src the plaintext of each message
+    @param len number of plaintext bytes in each message
+    @return false with errno set if there isn't enough memory
+*/
+bool desCbcEncryptMany( DESContext const *ctx, int count, uint64_t const iv[],
+                        byte *const dst[], byte const *const src[], size_t const len[] );
+
+/**
+    This function encrypts everything left in one file into another, in
+    the same format as the encrypt program: CTR and CBC output starts
+    with a header holding a random nonce. Compressed and indexed files
+    aren't written or read here, only by the programs.
+    @param ctx the context
+    @param inputFile the file to read from
+    @param outputFile the file to write to
+    @return true if successful, with errno set if not
+*/
+bool desEncryptFile( DESContext const *ctx, FILE *inputFile, FILE *outputFile );
+
+/**
+    This function decrypts everything left in one file into another, in
+    the same format as the decrypt program.
+    @param ctx the context
+    @param inputFile the file to read from
+    @param outputFile the file to write to
+    @return true if successful; false with errno set if reading or
+    writing failed, or with errno zero if the input isn't valid
+    ciphertext
+*/
+bool desDecryptFile( DESContext const *ctx, FILE *inputFile, FILE *outputFile );
+
+/**
+    This function gives back to the system the chunk buffers the file
+    calls keep for reuse. It must not be called while another thread is
+    in a libdes call.
+*/
+void desReleaseBuffers( void );
+
+#endif
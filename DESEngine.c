@@ -0,0 +1,622 @@
+/**
+    @file DESEngine.c
+    @author John Butterfield (jpbutte2)
+    Buffer interface to DES. Long runs of blocks go through the widest
+    bitsliced kernel the processor supports, and whatever is left over
+    goes through the table-driven engine. Counter mode builds its keystream
+    a batch at a time with the same code, and CBC decryption works a
+    batch at a time too. Each of these ways of running DES is also an
+    engine in a registry, so a key can be tied to just one of them, and
+    every engine is checked against answers from the reference before
+    its first use.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DESEngine.h"
+#include "DESTable.h"
+#include "DESPerm.h"
+
+/** Number of different blocks the self-test encrypts. */
+#define SELF_TEST_BLOCKS 8
+
+/** The key and first block of the example in DES Algorithm
+    Illustrated, which the self-test starts from. */
+#define KNOWN_KEY 0x133457799BBCDFF1ull
+#define KNOWN_PLAIN 0x0123456789ABCDEFull
+
+/** What the reference engine makes of the self-test blocks with the
+    single and the triple DES key. The first is the published answer
+    for the example. */
+static uint64_t const knownCipher[ 2 ][ SELF_TEST_BLOCKS ] = {
+  { 0x85E813540F0AB405ull, 0x46341597B5C9931Dull, 0x19B058AEA403D730ull, 0x9207F0472DC847D1ull,
+    0x8CC26CE92C919909ull, 0xCBB86E445B3C9656ull, 0xF0261506B0B70ECFull, 0x22F82BC73F763023ull },
+  { 0xE7AF653D14F082B2ull, 0xC140EC5B9804E6AFull, 0x1200ED322E992F38ull, 0xF8CEDBB7E8EB3803ull,
+    0x7EF3DDF58D321569ull, 0xF3DD341999A00A55ull, 0xFF7EC7DE38C4EE7Bull, 0x130980AE213E8010ull }
+};
+
+/** Longest run of blocks desEngineCrossCheck() uses. */
+#define CROSS_CHECK_RUN 2048
+
+/** The engines this processor can run, in the order desEngines()
+    reports them. */
+static DESEngine engines[ DES_ENGINE_MAX ];
+
+/** Number of entries in engines. */
+static int engineCount;
+
+/** Names of the bitsliced engines. */
+static char kernelNames[ BITSLICE_KERNEL_MAX ][ 32 ];
+
+/** Makes sure engines is filled in exactly once. */
+static pthread_once_t enginesOnce = PTHREAD_ONCE_INIT;
+
+/** Self-test result for each engine: zero if it hasn't run yet, 1 if
+    it passed and -1 if it failed. */
+static int selfTestResult[ DES_ENGINE_MAX ];
+
+/** Protects selfTestResult. */
+static pthread_mutex_t selfTestLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Keys and blocks for the self-test. */
+static struct {
+  /** A single DES key and a triple DES key. */
+  DESKey keys[ 2 ];
+
+  /** The blocks to encrypt, starting with the published example. */
+  uint64_t plain[ SELF_TEST_BLOCKS ];
+} selfTest;
+
+/** Makes sure selfTest is filled in exactly once. */
+static pthread_once_t selfTestOnce = PTHREAD_ONCE_INIT;
+
+/**
+    Find the key planes a key context keeps for the bitsliced kernels.
+    @param ctx the key
+    @param decrypt true for the decryption planes
+    @return the planes for each stage
+*/
+static uint64_t const ( *keyPlanes( DESKey const *ctx, bool decrypt ) )[ ROUND_COUNT ][ SUBKEY_BITS ]
+{
+    return decrypt ? ctx->decPlanes : ctx->encPlanes;
+}
+
+/**
+    Encrypt or decrypt a run of blocks one at a time with the SP tables.
+    This is the "table" engine.
+    @param engine the engine
+    @param ctx the key to use
+    @param dst where the result goes
+    @param src the input blocks
+    @param nblocks number of blocks
+    @param decrypt true to decrypt, false to encrypt
+*/
+static void tableCrypt( DESEngine const *engine, DESKey const *ctx, uint8_t *dst,
+                        uint8_t const *src, size_t nblocks, bool decrypt )
+{
+    byte const (*KS)[ ROUND_COUNT ][ SBOX_COUNT ] = decrypt ? ctx->dec : ctx->enc;
+    for ( size_t i = 0; i < nblocks; i++ ) {
+        storeBlock64( dst + i * BLOCK_BYTES,
+                      tableCrypt64( loadBlock64( src + i * BLOCK_BYTES ), KS, ctx->stages ) );
+    }
+}
+
+/**
+    Encrypt or decrypt a run of blocks, with the widest bitsliced
+    kernel the blocks fill and the table engine for short runs. This is
+    the "auto" engine.
+    @param engine the engine
+    @param ctx the key to use
+    @param dst where the result goes
+    @param src the input blocks
+    @param nblocks number of blocks
+    @param decrypt true to decrypt, false to encrypt
+*/
+static void autoCrypt( DESEngine const *engine, DESKey const *ctx, uint8_t *dst,
+                       uint8_t const *src, size_t nblocks, bool decrypt )
+{
+    if ( nblocks >= BITSLICE_MIN_BLOCKS ) {
+        BitsliceKernel const *kernels[ BITSLICE_KERNEL_MAX ];
+        int count = bitsliceKernels( kernels );
+
+        while ( nblocks >= BITSLICE_MIN_BLOCKS ) {
+            // Use the widest kernel the blocks fill, down to the 64-bit
+            // kernel, which also takes a short last group
+            int k = 0;
+            while ( k < count - 1 && nblocks < (size_t) kernels[ k ]->width ) {
+                k++;
+            }
+            int n = nblocks < (size_t) kernels[ k ]->width ? nblocks : kernels[ k ]->width;
+
+            kernels[ k ]->crypt( dst, src, n, keyPlanes( ctx, decrypt ), ctx->stages );
+
+            src += n * BLOCK_BYTES;
+            dst += n * BLOCK_BYTES;
+            nblocks -= n;
+        }
+    }
+
+    tableCrypt( engine, ctx, dst, src, nblocks, decrypt );
+}
+
+/**
+    Encrypt or decrypt a run of blocks with the bit-by-bit functions in
+    DES.c. Each stage is a call to encryptBlock() with that stage's
+    subkeys; the final permutation of one stage and the initial
+    permutation of the next cancel out. This is the "reference" engine.
+    @param engine the engine
+    @param ctx the key to use
+    @param dst where the result goes
+    @param src the input blocks
+    @param nblocks number of blocks
+    @param decrypt true to decrypt, false to encrypt
+*/
+static void referenceCrypt( DESEngine const *engine, DESKey const *ctx, uint8_t *dst,
+                            uint8_t const *src, size_t nblocks, bool decrypt )
+{
+    byte const (*KS)[ ROUND_COUNT ][ SBOX_COUNT ] = decrypt ? ctx->dec : ctx->enc;
+
+    // Pack the 6-bit chunks back into the subkeys DES.c uses
+    byte K[ DES_MAX_STAGES ][ ROUND_COUNT ][ SUBKEY_BYTES ];
+    for ( int s = 0; s < ctx->stages; s++ ) {
+        for ( int i = 1; i < ROUND_COUNT; i++ ) {
+            uint64_t sub = 0;
+            for ( int j = 0; j < SBOX_COUNT; j++ ) {
+                sub = ( sub << SBOX_INPUT_BITS ) | KS[ s ][ i ][ j ];
+            }
+            for ( int b = SUBKEY_BYTES - 1; b >= 0; b-- ) {
+                K[ s ][ i ][ b ] = sub;
+                sub >>= BYTE_SIZE;
+            }
+        }
+    }
+
+    for ( size_t i = 0; i < nblocks; i++ ) {
+        DESBlock block;
+        memcpy( block.data, src + i * BLOCK_BYTES, BLOCK_BYTES );
+        block.len = BLOCK_BYTES;
+        for ( int s = 0; s < ctx->stages; s++ ) {
+            encryptBlock( &block, (byte const (*)[ SUBKEY_BYTES ]) K[ s ] );
+        }
+        memcpy( dst + i * BLOCK_BYTES, block.data, BLOCK_BYTES );
+    }
+}
+
+/**
+    Encrypt or decrypt a run of blocks with one bitsliced kernel, a
+    group of its width at a time, including a short group at the end.
+    These are the "bitslice-" engines.
+    @param engine the engine, whose impl is the kernel
+    @param ctx the key to use
+    @param dst where the result goes
+    @param src the input blocks
+    @param nblocks number of blocks
+    @param decrypt true to decrypt, false to encrypt
+*/
+static void kernelCrypt( DESEngine const *engine, DESKey const *ctx, uint8_t *dst,
+                         uint8_t const *src, size_t nblocks, bool decrypt )
+{
+    BitsliceKernel const *kernel = engine->impl;
+    while ( nblocks > 0 ) {
+        int n = nblocks < (size_t) kernel->width ? nblocks : kernel->width;
+        kernel->crypt( dst, src, n, keyPlanes( ctx, decrypt ), ctx->stages );
+
+        src += n * BLOCK_BYTES;
+        dst += n * BLOCK_BYTES;
+        nblocks -= n;
+    }
+}
+
+/**
+    Add an engine to the registry.
+    @param name its name
+    @param caps its capabilities
+    @param width its width
+    @param crypt its crypt function
+    @param impl what crypt needs to know, or NULL
+*/
+static void addEngine( char const *name, unsigned caps, int width,
+                       void ( *crypt )( DESEngine const *, DESKey const *, uint8_t *,
+                                        uint8_t const *, size_t, bool ),
+                       void const *impl )
+{
+    engines[ engineCount++ ] = (DESEngine) { name, caps, width, crypt, impl };
+}
+
+/**
+    Fill in the registry from the kernels this processor can run.
+*/
+static void findEngines( void )
+{
+    BitsliceKernel const *kernels[ BITSLICE_KERNEL_MAX ];
+    int count = bitsliceKernels( kernels );
+
+    // The portable kernel is always last
+    unsigned autoCaps = DES_ENGINE_TRIPLE | DES_ENGINE_BITSLICED;
+    if ( count > 1 ) {
+        autoCaps |= DES_ENGINE_SIMD;
+    }
+
+    addEngine( "auto", autoCaps, kernels[ 0 ]->width, autoCrypt, NULL );
+    addEngine( "reference", DES_ENGINE_TRIPLE, 1, referenceCrypt, NULL );
+    addEngine( "table", DES_ENGINE_TRIPLE, 1, tableCrypt, NULL );
+
+    for ( int k = 0; k < count; k++ ) {
+        unsigned caps = DES_ENGINE_TRIPLE | DES_ENGINE_BITSLICED;
+        if ( k < count - 1 ) {
+            caps |= DES_ENGINE_SIMD;
+        }
+
+        snprintf( kernelNames[ k ], sizeof( kernelNames[ k ] ), "bitslice-%s",
+                  kernels[ k ]->name );
+        addEngine( kernelNames[ k ], caps, kernels[ k ]->width, kernelCrypt, kernels[ k ] );
+    }
+}
+
+int desEngines( DESEngine const *list[ DES_ENGINE_MAX ] )
+{
+    pthread_once( &enginesOnce, findEngines );
+
+    for ( int i = 0; i < engineCount; i++ ) {
+        list[ i ] = &engines[ i ];
+    }
+    return engineCount;
+}
+
+DESEngine const *desEngineFind( char const *name )
+{
+    pthread_once( &enginesOnce, findEngines );
+
+    for ( int i = 0; i < engineCount; i++ ) {
+        if ( strcmp( engines[ i ].name, name ) == 0 ) {
+            return &engines[ i ];
+        }
+    }
+    return NULL;
+}
+
+/**
+    Set up the self-test keys and blocks.
+*/
+static void prepareSelfTest( void )
+{
+    byte key[ BLOCK_BYTES ], key2[ BLOCK_BYTES ], key3[ BLOCK_BYTES ];
+    storeBlock64( key, KNOWN_KEY );
+    storeBlock64( key2, ~KNOWN_KEY );
+    storeBlock64( key3, KNOWN_KEY ^ KNOWN_PLAIN );
+    desKeySetup( &selfTest.keys[ 0 ], key );
+    desTripleKeySetup( &selfTest.keys[ 1 ], key, key2, key3 );
+
+    // The published example, then blocks with every byte different
+    for ( int i = 0; i < SELF_TEST_BLOCKS; i++ ) {
+        selfTest.plain[ i ] = KNOWN_PLAIN * ( 2 * i + 1 ) + i;
+    }
+}
+
+/**
+    Run the self-test on an engine.
+    @param engine the engine
+    @return true if it passed
+*/
+static bool runSelfTest( DESEngine const *engine )
+{
+    pthread_once( &selfTestOnce, prepareSelfTest );
+
+    // Auto is only as good as every engine it can pick
+    if ( engine->crypt == autoCrypt ) {
+        for ( int i = 0; i < engineCount; i++ ) {
+            if ( engines[ i ].crypt != autoCrypt && engines[ i ].crypt != referenceCrypt &&
+                 !desEngineSelfTest( &engines[ i ] ) ) {
+                return false;
+            }
+        }
+    }
+
+    size_t n = engine->width + SELF_TEST_EXTRA_BLOCKS;
+    byte *in = malloc( n * BLOCK_BYTES );
+    byte *out = malloc( n * BLOCK_BYTES );
+    bool ok = in != NULL && out != NULL;
+
+    for ( int k = 0; ok && k < 2; k++ ) {
+        for ( int decrypt = 0; ok && decrypt < 2; decrypt++ ) {
+            uint64_t const *from = decrypt ? knownCipher[ k ] : selfTest.plain;
+            uint64_t const *to = decrypt ? selfTest.plain : knownCipher[ k ];
+
+            for ( size_t i = 0; i < n; i++ ) {
+                storeBlock64( in + i * BLOCK_BYTES, from[ i % SELF_TEST_BLOCKS ] );
+            }
+            engine->crypt( engine, &selfTest.keys[ k ], out, in, n, decrypt );
+            for ( size_t i = 0; ok && i < n; i++ ) {
+                ok = loadBlock64( out + i * BLOCK_BYTES ) == to[ i % SELF_TEST_BLOCKS ];
+            }
+        }
+    }
+
+    free( in );
+    free( out );
+    return ok;
+}
+
+bool desEngineSelfTest( DESEngine const *engine )
+{
+    pthread_once( &enginesOnce, findEngines );
+
+    // Engines from outside the registry are tested every time
+    int index = 0;
+    while ( index < engineCount && engine != &engines[ index ] ) {
+        index++;
+    }
+    if ( index == engineCount ) {
+        return runSelfTest( engine );
+    }
+
+    pthread_mutex_lock( &selfTestLock );
+    int result = selfTestResult[ index ];
+    pthread_mutex_unlock( &selfTestLock );
+
+    // Two threads may both run a test the first time, which is harmless
+    if ( result == 0 ) {
+        result = runSelfTest( engine ) ? 1 : -1;
+        pthread_mutex_lock( &selfTestLock );
+        selfTestResult[ index ] = result;
+        pthread_mutex_unlock( &selfTestLock );
+    }
+
+    return result > 0;
+}
+
+/**
+    Step a pseudo-random generator (xorshift64*).
+    @param state the generator's state, which must not be zero
+    @return the next pseudo-random number
+*/
+static uint64_t nextRandom( uint64_t *state )
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+size_t desEngineCrossCheck( DESEngine const *engine, DESEngine const *against, uint64_t seed,
+                            size_t nblocks )
+{
+    byte *in = malloc( CROSS_CHECK_RUN * BLOCK_BYTES );
+    byte *out = malloc( CROSS_CHECK_RUN * BLOCK_BYTES );
+    byte *expect = malloc( CROSS_CHECK_RUN * BLOCK_BYTES );
+    if ( in == NULL || out == NULL || expect == NULL ) {
+        free( in );
+        free( out );
+        free( expect );
+        return SIZE_MAX;
+    }
+
+    uint64_t state = seed ? seed : KNOWN_KEY;
+    size_t wrong = 0;
+    bool triple = false;
+
+    while ( nblocks > 0 ) {
+        byte key[ DES_MAX_STAGES ][ BLOCK_BYTES ];
+        for ( int k = 0; k < DES_MAX_STAGES; k++ ) {
+            storeBlock64( key[ k ], nextRandom( &state ) );
+        }
+        DESKey ctx;
+        if ( triple ) {
+            desTripleKeySetup( &ctx, key[ 0 ], key[ 1 ], key[ 2 ] );
+        } else {
+            desKeySetup( &ctx, key[ 0 ] );
+        }
+        triple = !triple;
+
+        // Any length up to the limit, so short groups get checked too
+        size_t n = 1 + nextRandom( &state ) % CROSS_CHECK_RUN;
+        if ( n > nblocks ) {
+            n = nblocks;
+        }
+        for ( size_t i = 0; i < n; i++ ) {
+            storeBlock64( in + i * BLOCK_BYTES, nextRandom( &state ) );
+        }
+
+        for ( int decrypt = 0; decrypt < 2; decrypt++ ) {
+            engine->crypt( engine, &ctx, out, in, n, decrypt );
+            against->crypt( against, &ctx, expect, in, n, decrypt );
+            for ( size_t i = 0; i < n; i++ ) {
+                if ( memcmp( out + i * BLOCK_BYTES, expect + i * BLOCK_BYTES,
+                             BLOCK_BYTES ) != 0 ) {
+                    wrong++;
+                }
+            }
+        }
+
+        nblocks -= n;
+    }
+
+    free( in );
+    free( out );
+    free( expect );
+    return wrong;
+}
+
+void desKeyUseEngine( DESKey *ctx, DESEngine const *engine )
+{
+    // Auto is the default, which also keeps its own choices for CBC
+    ctx->engine = engine != NULL && engine->crypt != autoCrypt ? engine : NULL;
+}
+
+/**
+    Encrypt or decrypt a run of blocks on the key's engine.
+    @param ctx the key to use
+    @param dst where the result goes
+    @param src the input blocks
+    @param nblocks number of blocks
+    @param decrypt true to decrypt, false to encrypt
+*/
+static void cryptBuffer( DESKey const *ctx, uint8_t *dst, uint8_t const *src,
+                         size_t nblocks, bool decrypt )
+{
+    if ( ctx->engine != NULL ) {
+        ctx->engine->crypt( ctx->engine, ctx, dst, src, nblocks, decrypt );
+    } else {
+        autoCrypt( NULL, ctx, dst, src, nblocks, decrypt );
+    }
+}
+
+void desEncryptBuffer( DESKey const *ctx, uint8_t *dst, uint8_t const *src, size_t nblocks )
+{
+    cryptBuffer( ctx, dst, src, nblocks, false );
+}
+
+void desDecryptBuffer( DESKey const *ctx, uint8_t *dst, uint8_t const *src, size_t nblocks )
+{
+    cryptBuffer( ctx, dst, src, nblocks, true );
+}
+
+/**
+    XOR len bytes of src with the keystream into dst, a word at a time
+    where possible.
+    @param dst where the result goes
+    @param src the input bytes
+    @param ks the keystream
+    @param len number of bytes
+*/
+static void xorKeystream( uint8_t *dst, uint8_t const *src, uint8_t const *ks, size_t len )
+{
+    size_t i = 0;
+    for ( ; i + sizeof( uint64_t ) <= len; i += sizeof( uint64_t ) ) {
+        uint64_t a, b;
+        memcpy( &a, src + i, sizeof( a ) );
+        memcpy( &b, ks + i, sizeof( b ) );
+        a ^= b;
+        memcpy( dst + i, &a, sizeof( a ) );
+    }
+
+    for ( ; i < len; i++ ) {
+        dst[ i ] = src[ i ] ^ ks[ i ];
+    }
+}
+
+void desCtrCrypt( DESKey const *ctx, uint64_t nonce, uint64_t pos,
+                  uint8_t *dst, uint8_t const *src, size_t len )
+{
+    uint8_t ks[ KEYSTREAM_BLOCKS * BLOCK_BYTES ];
+    uint64_t counter = nonce + pos / BLOCK_BYTES;
+    size_t skip = pos % BLOCK_BYTES;
+
+    while ( len > 0 ) {
+        size_t nblocks = ( skip + len + BLOCK_BYTES - 1 ) / BLOCK_BYTES;
+        if ( nblocks > KEYSTREAM_BLOCKS ) {
+            nblocks = KEYSTREAM_BLOCKS;
+        }
+
+        for ( size_t i = 0; i < nblocks; i++ ) {
+            storeBlock64( ks + i * BLOCK_BYTES, counter + i );
+        }
+        cryptBuffer( ctx, ks, ks, nblocks, false );
+
+        // Only the first batch can start partway through a block
+        size_t n = nblocks * BLOCK_BYTES - skip;
+        if ( n > len ) {
+            n = len;
+        }
+        xorKeystream( dst, src, ks + skip, n );
+
+        dst += n;
+        src += n;
+        len -= n;
+        counter += nblocks;
+        skip = 0;
+    }
+}
+
+void desCbcEncrypt( DESKey const *ctx, uint64_t *iv, uint8_t *dst, uint8_t const *src,
+                    size_t nblocks )
+{
+    // Each block needs the one before, and a bitsliced engine would run
+    // a whole pass of its kernel for every block, so only an engine that
+    // works a block at a time gets them
+    bool oneByOne = ctx->engine != NULL && !( ctx->engine->caps & DES_ENGINE_BITSLICED );
+
+    uint64_t chain = *iv;
+    for ( size_t i = 0; i < nblocks; i++ ) {
+        if ( oneByOne ) {
+            storeBlock64( dst + i * BLOCK_BYTES, loadBlock64( src + i * BLOCK_BYTES ) ^ chain );
+            cryptBuffer( ctx, dst + i * BLOCK_BYTES, dst + i * BLOCK_BYTES, 1, false );
+            chain = loadBlock64( dst + i * BLOCK_BYTES );
+        } else {
+            chain = tableCrypt64( loadBlock64( src + i * BLOCK_BYTES ) ^ chain, ctx->enc,
+                                  ctx->stages );
+            storeBlock64( dst + i * BLOCK_BYTES, chain );
+        }
+    }
+
+    *iv = chain;
+}
+
+void desCbcDecrypt( DESKey const *ctx, uint64_t *iv, uint8_t *dst, uint8_t const *src,
+                    size_t nblocks )
+{
+    // The block to chain from goes just before a copy of the
+    // ciphertext, so dst can overwrite src and the whole batch can be
+    // XORed with its ciphertext shifted along one block
+    uint8_t cipher[ ( CBC_BATCH_BLOCKS + 1 ) * BLOCK_BYTES ];
+    storeBlock64( cipher, *iv );
+
+    while ( nblocks > 0 ) {
+        size_t n = nblocks < CBC_BATCH_BLOCKS ? nblocks : CBC_BATCH_BLOCKS;
+        memcpy( cipher + BLOCK_BYTES, src, n * BLOCK_BYTES );
+        cryptBuffer( ctx, dst, cipher + BLOCK_BYTES, n, true );
+        xorKeystream( dst, dst, cipher, n * BLOCK_BYTES );
+
+        memcpy( cipher, cipher + n * BLOCK_BYTES, BLOCK_BYTES );
+        src += n * BLOCK_BYTES;
+        dst += n * BLOCK_BYTES;
+        nblocks -= n;
+    }
+
+    *iv = loadBlock64( cipher );
+}
+
+void desCbcEncryptInterleaved( DESKey const *ctx, int count, uint64_t iv[],
+                               uint8_t *const dst[], uint8_t const *const src[],
+                               size_t nblocks )
+{
+    // An engine that works a block at a time gets the streams one by one
+    bool bitsliced = ctx->engine == NULL || ( ctx->engine->caps & DES_ENGINE_BITSLICED );
+    if ( count < BITSLICE_MIN_BLOCKS || !bitsliced ) {
+        for ( int s = 0; s < count; s++ ) {
+            desCbcEncrypt( ctx, &iv[ s ], dst[ s ], src[ s ], nblocks );
+        }
+        return;
+    }
+
+    // A chosen bitsliced engine runs on its own kernel, and auto on the
+    // portable one, which is always last
+    BitsliceKernel const *kernel = ctx->engine != NULL ? ctx->engine->impl : NULL;
+    if ( kernel == NULL ) {
+        BitsliceKernel const *kernels[ BITSLICE_KERNEL_MAX ];
+        kernel = kernels[ bitsliceKernels( kernels ) - 1 ];
+    }
+    int width = kernel->width;
+    uint8_t batch[ width * BLOCK_BYTES ];
+
+    for ( int first = 0; first < count; first += width ) {
+        int n = count - first < width ? count - first : width;
+        uint64_t *chain = iv + first;
+
+        for ( size_t j = 0; j < nblocks; j++ ) {
+            size_t at = j * BLOCK_BYTES;
+            for ( int s = 0; s < n; s++ ) {
+                storeBlock64( batch + s * BLOCK_BYTES,
+                              loadBlock64( src[ first + s ] + at ) ^ chain[ s ] );
+            }
+
+            kernel->crypt( batch, batch, n, keyPlanes( ctx, false ), ctx->stages );
+
+            for ( int s = 0; s < n; s++ ) {
+                chain[ s ] = loadBlock64( batch + s * BLOCK_BYTES );
+                storeBlock64( dst[ first + s ] + at, chain[ s ] );
+            }
+        }
+    }
+}
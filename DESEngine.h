@@ -0,0 +1,223 @@
+/**
+    @file DESEngine.h
+    @author John Butterfield (jpbutte2)
+    Header for the buffer interface to DES. This component encrypts or
+    decrypts a run of consecutive 8-byte blocks in one call, and picks
+    the fastest engine for the job internally, unless the key names an
+    engine to use. The engines are listed in a registry, and each one
+    checks itself against the reference implementation in DES.c before
+    it is first used.
+*/
+
+#ifndef DESENGINE_H
+#define DESENGINE_H
+
+#include <stdint.h>
+#include "DESKey.h"
+#include "DESBitslice.h"
+
+/** Smallest number of blocks worth a pass of the bitsliced engine.
+    Shorter runs are done one block at a time with the SP tables. */
+#define BITSLICE_MIN_BLOCKS 40
+
+/** Largest number of engines desEngines() can report: auto, the
+    reference, the table engine and one per bitsliced kernel. */
+#define DES_ENGINE_MAX ( 3 + BITSLICE_KERNEL_MAX )
+
+/** Capability: the engine runs triple DES as well as single DES. */
+#define DES_ENGINE_TRIPLE 0x1
+
+/** Capability: the engine works on many blocks side by side, so it is
+    slow on runs much shorter than its width. */
+#define DES_ENGINE_BITSLICED 0x2
+
+/** Capability: the engine uses vector instructions. It is only listed
+    when the processor supports them. */
+#define DES_ENGINE_SIMD 0x4
+
+/** Number of blocks the self-test runs through each engine beyond a
+    whole group of its width, so a short group is checked too. */
+#define SELF_TEST_EXTRA_BLOCKS 11
+
+/** Type for one way of running DES on a buffer of blocks. */
+typedef struct DESEngine DESEngine;
+
+struct DESEngine {
+  /** Name to select the engine by, such as "table". */
+  char const *name;
+
+  /** DES_ENGINE_ flags for what the engine can do. */
+  unsigned caps;
+
+  /** Number of blocks the engine works on at once. Runs that are a
+      multiple of it make the best use of the engine. */
+  int width;
+
+  /** Encrypts or decrypts nblocks blocks from src into dst with the
+      subkeys in ctx, ignoring ctx->engine. dst may be the same as src. */
+  void ( *crypt )( DESEngine const *engine, DESKey const *ctx, uint8_t *dst,
+                   uint8_t const *src, size_t nblocks, bool decrypt );
+
+  /** Whatever crypt needs to know about the engine, such as its
+      bitsliced kernel. */
+  void const *impl;
+};
+
+/**
+    This function lists the engines this processor can run. The first
+    is "auto", which picks the fastest engine for each run of blocks
+    and is what a key uses by default. Then come "reference", the
+    bit-by-bit functions in DES.c, "table", the SP-table engine, and
+    one "bitslice-" engine per bitsliced kernel, widest first.
+    @param list where to store the engines
+    @return number of engines stored in list
+*/
+int desEngines( DESEngine const *list[ DES_ENGINE_MAX ] );
+
+/**
+    This function looks an engine up by name.
+    @param name the name of the engine
+    @return the engine, or NULL if there is no engine by that name that
+    this processor can run
+*/
+DESEngine const *desEngineFind( char const *name );
+
+/**
+    This function checks an engine against known answers: what the
+    reference implementation makes of a fixed set of blocks, starting
+    with the published example. The engine has to give the same results
+    for a whole group of its width plus a few blocks, encrypting and
+    decrypting, with single and triple DES. The "auto"
+    engine also needs every engine it can pick to pass. The result for
+    each registered engine is worked out on first use and remembered,
+    so this is cheap to call again.
+    @param engine the engine to check
+    @return true if the engine gave every expected answer
+*/
+bool desEngineSelfTest( DESEngine const *engine );
+
+/**
+    This function compares two engines on pseudo-random data in bulk:
+    runs of random length, each under a new random key, alternating
+    between single and triple DES, are encrypted and decrypted by both
+    engines. The same seed always gives the same data, so a failure can
+    be reproduced.
+    @param engine the engine to check
+    @param against the engine it should agree with
+    @param seed where to start the pseudo-random data
+    @param nblocks number of blocks to compare
+    @return number of blocks on which the engines disagreed, or
+    SIZE_MAX if there wasn't enough memory
+*/
+size_t desEngineCrossCheck( DESEngine const *engine, DESEngine const *against, uint64_t seed,
+                            size_t nblocks );
+
+/**
+    This function makes the buffer functions run on the given engine
+    for this key. The engine should have passed desEngineSelfTest().
+    @param ctx the key
+    @param engine the engine, or NULL or the "auto" engine for the
+    default
+*/
+void desKeyUseEngine( DESKey *ctx, DESEngine const *engine );
+
+/** Number of keystream blocks generated at a time in counter mode. */
+#define KEYSTREAM_BLOCKS 512
+
+/**
+    This function encrypts nblocks consecutive blocks from src into dst.
+    The pointers need no particular alignment, and dst may be the same
+    as src to encrypt in place.
+    @param ctx the key to encrypt with
+    @param dst where the ciphertext goes
+    @param src the plaintext
+    @param nblocks number of 8-byte blocks to encrypt
+*/
+void desEncryptBuffer( DESKey const *ctx, uint8_t *dst, uint8_t const *src, size_t nblocks );
+
+/**
+    This function decrypts nblocks consecutive blocks from src into dst.
+    The pointers need no particular alignment, and dst may be the same
+    as src to decrypt in place.
+    @param ctx the key to decrypt with
+    @param dst where the plaintext goes
+    @param src the ciphertext
+    @param nblocks number of 8-byte blocks to decrypt
+*/
+void desDecryptBuffer( DESKey const *ctx, uint8_t *dst, uint8_t const *src, size_t nblocks );
+
+/** Number of blocks decrypted at a time in CBC mode. */
+#define CBC_BATCH_BLOCKS 512
+
+/**
+    This function encrypts or decrypts len bytes in counter (CTR) mode,
+    which are the same operation. Block i of the keystream is the
+    encryption of nonce + i, taken as a big-endian 64-bit number and
+    wrapping around, and it is XORed into bytes 8i through 8i + 7 of
+    the stream. Since any block of keystream can be computed on its
+    own, pos can be any byte position in the stream, so a range of a
+    file can be processed without touching the rest. No padding is
+    needed. dst may be the same as src.
+    @param ctx the key to encrypt the counter blocks with
+    @param nonce the counter value for the first block of the stream
+    @param pos position in the stream of the first byte of src
+    @param dst where the result goes
+    @param src the input bytes
+    @param len number of bytes to process
+*/
+void desCtrCrypt( DESKey const *ctx, uint64_t nonce, uint64_t pos,
+                  uint8_t *dst, uint8_t const *src, size_t len );
+
+/**
+    This function encrypts nblocks blocks in cipher block chaining (CBC)
+    mode. Each plaintext block is XORed with the ciphertext block before
+    it, or with *iv for the first block, before it is encrypted. Every
+    block depends on the one before, so this works a block at a time,
+    with the SP tables unless the key's engine is one that also works a
+    block at a time. dst may be the same as src.
+    @param ctx the key to encrypt with
+    @param iv the block to chain from, which is replaced with the last
+    ciphertext block so the next call can carry on
+    @param dst where the ciphertext goes
+    @param src the plaintext
+    @param nblocks number of 8-byte blocks to encrypt
+*/
+void desCbcEncrypt( DESKey const *ctx, uint64_t *iv, uint8_t *dst, uint8_t const *src,
+                    size_t nblocks );
+
+/**
+    This function decrypts nblocks blocks in CBC mode. Each plaintext
+    block only depends on two ciphertext blocks, so the blocks are
+    decrypted in batches with the fastest engine and then XORed with
+    the ciphertext blocks before them. dst may be the same as src.
+    @param ctx the key to decrypt with
+    @param iv the block to chain from, which is replaced with the last
+    ciphertext block so the next call can carry on
+    @param dst where the plaintext goes
+    @param src the ciphertext
+    @param nblocks number of 8-byte blocks to decrypt
+*/
+void desCbcDecrypt( DESKey const *ctx, uint64_t *iv, uint8_t *dst, uint8_t const *src,
+                    size_t nblocks );
+
+/**
+    This function encrypts count independent streams of nblocks blocks
+    each in CBC mode. Encrypting one stream is serial, but block j of
+    every stream can be encrypted at the same time, so the streams go
+    through a bitsliced kernel side by side, as many at a time as the
+    kernel is wide: the key's engine's own kernel if it has one, and
+    the portable one otherwise.
+    Gives the same result as calling desCbcEncrypt() on each stream.
+    @param ctx the key to encrypt with
+    @param count number of streams
+    @param iv the block each stream chains from, replaced with its last
+    ciphertext block
+    @param dst where the ciphertext for each stream goes
+    @param src the plaintext of each stream
+    @param nblocks number of 8-byte blocks in each stream
+*/
+void desCbcEncryptInterleaved( DESKey const *ctx, int count, uint64_t iv[],
+                               uint8_t *const dst[], uint8_t const *const src[],
+                               size_t nblocks );
+
+#endif
@@ -0,0 +1,119 @@
+/**
+    @file DESKey.c
+    @author John Butterfield (jpbutte2)
+    Word-based key schedule. C and D live in the low 28 bits of two
+    words, so each round's rotation is a couple of shifts, and PC-2 is
+    applied with a compiled plan instead of bit by bit.
+*/
+
+#include <string.h>
+#include "DESKey.h"
+#include "DESPerm.h"
+
+/** Mask for the low-order 6 bits of a word. */
+#define CHUNK_MASK ( ( 1 << SBOX_INPUT_BITS ) - 1 )
+
+/**
+    Rotate the 28 bits in the low end of a word left.
+    @param x the value to rotate
+    @param n number of bits to rotate by
+    @return the rotated value
+*/
+static inline uint32_t leftRotate28( uint32_t x, int n )
+{
+    return ( ( x << n ) | ( x >> ( SUBKEY_HALF_BITS - n ) ) ) & SUBKEY_HALF_MASK;
+}
+
+/**
+    Do the key schedule for one key into one stage of a key context:
+    its encryption subkeys go in enc[ stage ] and its decryption
+    subkeys in dec[ stage ]. C and D are only filled in for stage 0.
+    @param ctx the key context
+    @param stage the stage to fill in
+    @param key array of bytes representing the input key
+*/
+static void scheduleKey( DESKey *ctx, int stage, byte const key[ BLOCK_BYTES ] )
+{
+    // PC-1 leaves C0 D0 in the top 56 bits
+    uint64_t cd = applyPermPlan( standardPlan( PLAN_PC1 ), loadBlock64( key ) );
+    uint32_t C = cd >> ( BLOCK_BITS - SUBKEY_HALF_BITS );
+    uint32_t D = ( cd >> ( BLOCK_BITS - C_D_BITS ) ) & SUBKEY_HALF_MASK;
+    if ( stage == 0 ) {
+        ctx->C = C;
+        ctx->D = D;
+    }
+
+    PermPlan const *pc2 = standardPlan( PLAN_PC2 );
+    for ( int i = 1; i < ROUND_COUNT; i++ ) {
+        C = leftRotate28( C, subkeyShiftSchedule[ i ] );
+        D = leftRotate28( D, subkeyShiftSchedule[ i ] );
+
+        // Put C D back in the top 56 bits for PC-2
+        cd = ( (uint64_t) C << ( BLOCK_BITS - SUBKEY_HALF_BITS ) ) |
+             ( (uint64_t) D << ( BLOCK_BITS - C_D_BITS ) );
+        uint64_t sub = applyPermPlan( pc2, cd );
+
+        for ( int j = 0; j < SBOX_COUNT; j++ ) {
+            byte chunk = ( sub >> ( BLOCK_BITS - SBOX_INPUT_BITS * ( j + 1 ) ) ) & CHUNK_MASK;
+            ctx->enc[ stage ][ i ][ j ] = chunk;
+            ctx->dec[ stage ][ ROUND_COUNT - i ][ j ] = chunk;
+        }
+    }
+}
+
+/**
+    Swap the subkeys of two stages, which may be for encryption or
+    decryption.
+    @param a the subkeys of one stage
+    @param b the subkeys of the other
+*/
+static void swapStages( byte a[ ROUND_COUNT ][ SBOX_COUNT ], byte b[ ROUND_COUNT ][ SBOX_COUNT ] )
+{
+    byte t[ ROUND_COUNT ][ SBOX_COUNT ];
+    memcpy( t, a, sizeof( t ) );
+    memcpy( a, b, sizeof( t ) );
+    memcpy( b, t, sizeof( t ) );
+}
+
+void desKeySetup( DESKey *ctx, byte const key[ BLOCK_BYTES ] )
+{
+    ctx->stages = 1;
+    ctx->engine = NULL;
+    scheduleKey( ctx, 0, key );
+    desKeyPlanes( ctx->encPlanes, ctx, false );
+    desKeyPlanes( ctx->decPlanes, ctx, true );
+}
+
+void desTripleKeySetup( DESKey *ctx, byte const key1[ BLOCK_BYTES ],
+                        byte const key2[ BLOCK_BYTES ], byte const key3[ BLOCK_BYTES ] )
+{
+    ctx->stages = 3;
+    ctx->engine = NULL;
+    scheduleKey( ctx, 0, key1 );
+    scheduleKey( ctx, 1, key2 );
+    scheduleKey( ctx, 2, key3 );
+
+    // Encrypt with key1, decrypt with key2, encrypt with key3, and
+    // undo that in reverse
+    swapStages( ctx->enc[ 1 ], ctx->dec[ 1 ] );
+    swapStages( ctx->dec[ 0 ], ctx->dec[ 2 ] );
+
+    desKeyPlanes( ctx->encPlanes, ctx, false );
+    desKeyPlanes( ctx->decPlanes, ctx, true );
+}
+
+void desKeyPlanes( uint64_t KP[ DES_MAX_STAGES ][ ROUND_COUNT ][ SUBKEY_BITS ],
+                   DESKey const *ctx, bool decrypt )
+{
+    byte const (*KS)[ ROUND_COUNT ][ SBOX_COUNT ] = decrypt ? ctx->dec : ctx->enc;
+
+    for ( int s = 0; s < ctx->stages; s++ ) {
+        for ( int i = 1; i < ROUND_COUNT; i++ ) {
+            for ( int j = 0; j < SUBKEY_BITS; j++ ) {
+                int bit = ( KS[ s ][ i ][ j / SBOX_INPUT_BITS ] >>
+                            ( SBOX_INPUT_BITS - 1 - j % SBOX_INPUT_BITS ) ) & 1;
+                KP[ s ][ i ][ j ] = -(uint64_t) bit;
+            }
+        }
+    }
+}
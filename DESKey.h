@@ -0,0 +1,95 @@
+/**
+    @file DESKey.h
+    @author John Butterfield (jpbutte2)
+    Header for the key context. A DESKey is set up once from a key, or
+    from three keys for triple DES, and then holds everything the fast
+    engines need, so callers that change keys often don't have to go
+    through generateSubkeys().
+*/
+
+#ifndef DESKEY_H
+#define DESKEY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "DES.h"
+
+/** Mask for the 28 bits of C or D held in a word. */
+#define SUBKEY_HALF_MASK ( ( 1u << SUBKEY_HALF_BITS ) - 1 )
+
+/** Largest number of DES passes a key context can chain together. */
+#define DES_MAX_STAGES 3
+
+/** Type used to represent a key that is ready to use. Each stage is
+    one pass of 16 rounds. Single DES has one stage, and triple DES has
+    three, run back to back with no final or initial permutation in
+    between, since the two cancel out. The key planes for the
+    bitsliced kernels are expanded once here, so buffer calls don't
+    redo them. */
+typedef struct {
+  /** Number of stages, 1 for DES or 3 for triple DES. */
+  int stages;
+
+  /** C0, the left half of PC-1 of the first key, in the low 28 bits. */
+  uint32_t C;
+
+  /** D0, the right half of PC-1 of the first key, in the low 28 bits. */
+  uint32_t D;
+
+  /** Subkeys for rounds 1 .. 16 of each stage of encryption, in the
+      order they are applied, each split into eight 6-bit chunks for
+      the table-driven rounds. For single DES, enc[ 0 ][ i ] is K_i. */
+  byte enc[ DES_MAX_STAGES ][ ROUND_COUNT ][ SBOX_COUNT ];
+
+  /** The same for decryption. For single DES, enc[ 0 ][ i ] is
+      dec[ 0 ][ 17 - i ]. */
+  byte dec[ DES_MAX_STAGES ][ ROUND_COUNT ][ SBOX_COUNT ];
+
+  /** Key planes of enc for the bitsliced kernels, from desKeyPlanes(). */
+  uint64_t encPlanes[ DES_MAX_STAGES ][ ROUND_COUNT ][ SUBKEY_BITS ];
+
+  /** Key planes of dec for the bitsliced kernels. */
+  uint64_t decPlanes[ DES_MAX_STAGES ][ ROUND_COUNT ][ SUBKEY_BITS ];
+
+  /** Engine the buffer functions in DESEngine.h run on, or NULL to
+      let them pick the fastest for each run. The setup functions
+      leave it NULL. */
+  struct DESEngine const *engine;
+} DESKey;
+
+/**
+    This function sets up a key context from the given key. It does the
+    key schedule on C and D held as 28-bit words, using compiled plans
+    for PC-1 and PC-2.
+    @param ctx the key context to fill in
+    @param key array of bytes representing the input key
+*/
+void desKeySetup( DESKey *ctx, byte const key[ BLOCK_BYTES ] );
+
+/**
+    This function sets up a key context for triple DES in EDE form:
+    encryption is E( key3, D( key2, E( key1, block ) ) ). Passing the
+    same key for key1 and key3 gives two-key triple DES, and passing
+    the same key for all three gives single DES, only slower.
+    @param ctx the key context to fill in
+    @param key1 key for the first stage of encryption
+    @param key2 key for the middle stage
+    @param key3 key for the last stage of encryption
+*/
+void desTripleKeySetup( DESKey *ctx, byte const key1[ BLOCK_BYTES ],
+                        byte const key2[ BLOCK_BYTES ], byte const key3[ BLOCK_BYTES ] );
+
+/**
+    This function expands the subkeys of each stage of a key context
+    into key planes for the bitsliced engine, as bitsliceKeyPlanes()
+    does for K, in the order bitsliceCryptStages() applies them. The
+    setup functions already keep the result in encPlanes and decPlanes.
+    @param KP the key planes to fill in, for each stage indexed from 1
+    to 16
+    @param ctx the key context to expand
+    @param decrypt true for the decryption subkeys, false for encryption
+*/
+void desKeyPlanes( uint64_t KP[ DES_MAX_STAGES ][ ROUND_COUNT ][ SUBKEY_BITS ],
+                   DESKey const *ctx, bool decrypt );
+
+#endif
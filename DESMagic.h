@@ -4,6 +4,9 @@
     Magic numbers and constants used in the DES algorithm.
 */
 
+#ifndef DESMAGIC_H
+#define DESMAGIC_H
+
 /** Type used to represent a byte. */
 typedef unsigned char byte;
 
@@ -22,21 +25,21 @@ typedef unsigned char byte;
 /** Permutation table for creating C_0 used in subkey generation.
     This is the first 28 elements from the PC-1 table in DES
     Algorithm Illustrated. */
-extern int leftSubkeyPerm[ SUBKEY_HALF_BITS ];
+extern int const leftSubkeyPerm[ SUBKEY_HALF_BITS ];
 
 /** Permutation table for creating D_0 using in subkey generation.
     This is the second 28 elements from the PC-1 table in DES
     Algorithm Illustrated. */
-extern int rightSubkeyPerm[ SUBKEY_HALF_BITS ];
+extern int const rightSubkeyPerm[ SUBKEY_HALF_BITS ];
 
 /** Sequence of shift operations applied to C_i and D_i during subkey
     generation.  This table doesn't have a name in the DES
     Algorithm Illustrated article. */
-extern int subkeyShiftSchedule[ ROUND_COUNT ];
+extern int const subkeyShiftSchedule[ ROUND_COUNT ];
 
 /** Permutation table for selecting bits for each 48-bit subkey.  This
     is PC-2 table in DES Algorithm Illustrated. */
-extern int subkeyPerm[ SUBKEY_BITS ];
+extern int const subkeyPerm[ SUBKEY_BITS ];
 
 /** Number of bits in a DES block. */
 #define BLOCK_BITS 64
@@ -47,17 +50,17 @@ extern int subkeyPerm[ SUBKEY_BITS ];
 /** Permutation table for creating L_0 during encryption.
     This is the first 32 elements from the IP table in DES
     Algorithm Illustrated. */
-extern int leftInitialPerm[ BLOCK_HALF_BITS ];
+extern int const leftInitialPerm[ BLOCK_HALF_BITS ];
 
 /** Permutation table for creating R_0 during encryption.
     This is the second 32 elements from the IP table in DES
     Algorithm Illustrated. */
-extern int rightInitialPerm[ BLOCK_HALF_BITS ];
+extern int const rightInitialPerm[ BLOCK_HALF_BITS ];
 
 /** Permutation table for selecting bits for the expanded half block.
     This is used compute the E function described in DES Algorithm
     Illustrated. */
-extern int expandedRSelector[ SUBKEY_BITS ];
+extern int const expandedRSelector[ SUBKEY_BITS ];
 
 /** Number of different S-Box talbes used in the f() funciton. */
 #define SBOX_COUNT 8
@@ -82,14 +85,16 @@ extern int expandedRSelector[ SUBKEY_BITS ];
     zero makes the indexing of the input and output bits for the S-Box
     a little easier to work with.
 */
-extern int sBoxTable[ SBOX_COUNT ][ SBOX_ROWS ][ SBOX_COLS ];
+extern int const sBoxTable[ SBOX_COUNT ][ SBOX_ROWS ][ SBOX_COLS ];
 
 /** This is all of the permutation applied at the end of the
     fFunction. In the DES Algorithm Illustrated article, it's called
     P. */
-extern int fFunctionPerm[ BLOCK_HALF_BITS ];
+extern int const fFunctionPerm[ BLOCK_HALF_BITS ];
 
 /** This is the final permutation performed after 16 rounds.  It
     rearranges bits of R_16 L_16 to create the encrypted block. It's
     called IP^-1 in the DES Algorithm Illustrated article. */
-extern int finalPerm[ BLOCK_BITS ];
+extern int const finalPerm[ BLOCK_BITS ];
+
+#endif
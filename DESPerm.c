@@ -0,0 +1,118 @@
+/**
+    @file DESPerm.c
+    @author John Butterfield (jpbutte2)
+    Compiled permutation plans. Since every output bit comes from
+    exactly one input bit, the output of a permutation is the OR of
+    what each input byte contributes on its own, and that contribution
+    can be looked up once the plan has been built.
+*/
+
+#include <pthread.h>
+#include "DESPerm.h"
+
+/** Prebuilt plans for the permutations in DESMagic.c. */
+static PermPlan plans[ PLAN_COUNT ];
+
+/** Makes sure the prebuilt plans are compiled exactly once. */
+static pthread_once_t plansOnce = PTHREAD_ONCE_INIT;
+
+void compilePermPlan( PermPlan *plan, int const perm[], int n, int inBits )
+{
+    plan->inBytes = ROUND_TO_BYTES( inBits );
+    memset( plan->table, 0, sizeof( plan->table ) );
+
+    for ( int i = 0; i < n; i++ ) {
+        int src = perm[ i ] - 1;
+        int byteIndex = src / BYTE_SIZE;
+        int mask = 1 << ( ( BYTE_SIZE - 1 ) - src % BYTE_SIZE );
+
+        // Every value of the source byte with this bit set sets output bit i + 1
+        for ( int v = 0; v < BYTE_VALUES; v++ ) {
+            if ( v & mask ) {
+                plan->table[ byteIndex ][ v ] |= 1ULL << ( ( BLOCK_BITS - 1 ) - i );
+            }
+        }
+    }
+}
+
+uint64_t applyPermPlan( PermPlan const *plan, uint64_t in )
+{
+    uint64_t out = 0;
+    for ( int i = 0; i < plan->inBytes; i++ ) {
+        out |= plan->table[ i ][ ( in >> ( BLOCK_BITS - BYTE_SIZE * ( i + 1 ) ) ) & 0xFF ];
+    }
+
+    return out;
+}
+
+/**
+    Compile the plans for all the permutations in DESMagic.c.
+*/
+static void compileStandardPlans( void )
+{
+    int perm[ BLOCK_BITS ];
+
+    memcpy( perm, leftInitialPerm, sizeof( leftInitialPerm ) );
+    memcpy( perm + BLOCK_HALF_BITS, rightInitialPerm, sizeof( rightInitialPerm ) );
+    compilePermPlan( &plans[ PLAN_IP ], perm, BLOCK_BITS, BLOCK_BITS );
+
+    compilePermPlan( &plans[ PLAN_FP ], finalPerm, BLOCK_BITS, BLOCK_BITS );
+
+    memcpy( perm, leftSubkeyPerm, sizeof( leftSubkeyPerm ) );
+    memcpy( perm + SUBKEY_HALF_BITS, rightSubkeyPerm, sizeof( rightSubkeyPerm ) );
+    compilePermPlan( &plans[ PLAN_PC1 ], perm, C_D_BITS, BLOCK_BITS );
+
+    compilePermPlan( &plans[ PLAN_PC2 ], subkeyPerm, SUBKEY_BITS, C_D_BITS );
+
+    compilePermPlan( &plans[ PLAN_E ], expandedRSelector, SUBKEY_BITS, BLOCK_HALF_BITS );
+}
+
+PermPlan const *standardPlan( PlanId id )
+{
+    pthread_once( &plansOnce, compileStandardPlans );
+
+    return &plans[ id ];
+}
+
+/**
+    Swap the bits of b selected by mask with the bits of a that sit n
+    positions higher.
+    @param a word holding the higher group of bits
+    @param b word holding the lower group of bits
+    @param n distance between the bits being swapped
+    @param mask bits of b to swap
+*/
+static inline void deltaSwap( uint32_t *a, uint32_t *b, int n, uint32_t mask )
+{
+    uint32_t t = ( ( *a >> n ) ^ *b ) & mask;
+    *b ^= t;
+    *a ^= t << n;
+}
+
+uint64_t initialPermFast( uint64_t block )
+{
+    uint32_t l = block >> BLOCK_HALF_BITS;
+    uint32_t r = block;
+
+    deltaSwap( &l, &r, 4, 0x0F0F0F0F );
+    deltaSwap( &l, &r, 16, 0x0000FFFF );
+    deltaSwap( &r, &l, 2, 0x33333333 );
+    deltaSwap( &r, &l, 8, 0x00FF00FF );
+    deltaSwap( &l, &r, 1, 0x55555555 );
+
+    return ( (uint64_t) l << BLOCK_HALF_BITS ) | r;
+}
+
+uint64_t finalPermFast( uint64_t block )
+{
+    uint32_t l = block >> BLOCK_HALF_BITS;
+    uint32_t r = block;
+
+    deltaSwap( &l, &r, 1, 0x55555555 );
+    deltaSwap( &r, &l, 8, 0x00FF00FF );
+    deltaSwap( &r, &l, 2, 0x33333333 );
+    deltaSwap( &l, &r, 16, 0x0000FFFF );
+    deltaSwap( &l, &r, 4, 0x0F0F0F0F );
+
+    return ( (uint64_t) l << BLOCK_HALF_BITS ) | r;
+}
@@ -0,0 +1,126 @@
+/**
+    @file DESPerm.h
+    @author John Butterfield (jpbutte2)
+    Header for compiled permutation plans. A plan is built once from a
+    permutation table like the ones in DESMagic.c, and then permutes a
+    whole value with one table lookup per input byte instead of one
+    getBit() and putBit() per output bit.
+*/
+
+#ifndef DESPERM_H
+#define DESPERM_H
+
+#include <stdint.h>
+#include "DES.h"
+
+/** Number of different values a byte can hold. */
+#define BYTE_VALUES 256
+
+/** Type used to represent a compiled permutation. Values going into
+    and coming out of a plan are held in a 64-bit word, left aligned,
+    so bit 1 of the value is the high-order bit of the word. */
+typedef struct {
+  /** Number of input bytes that the permutation reads from. */
+  int inBytes;
+
+  /** For each input byte and each value of that byte, the output bits
+      that the byte contributes. */
+  uint64_t table[ BLOCK_BYTES ][ BYTE_VALUES ];
+} PermPlan;
+
+/** The permutations from DESMagic.c that have prebuilt plans. */
+typedef enum {
+  /** IP, leftInitialPerm followed by rightInitialPerm, 64 to 64 bits. */
+  PLAN_IP,
+
+  /** IP^-1, finalPerm, 64 to 64 bits. */
+  PLAN_FP,
+
+  /** PC-1, leftSubkeyPerm followed by rightSubkeyPerm, 64 to 56 bits. */
+  PLAN_PC1,
+
+  /** PC-2, subkeyPerm, 56 to 48 bits. */
+  PLAN_PC2,
+
+  /** E, expandedRSelector, 32 to 48 bits. */
+  PLAN_E,
+
+  /** Number of prebuilt plans. */
+  PLAN_COUNT
+} PlanId;
+
+/**
+    This function compiles a permutation into a plan. Output bit i + 1
+    of the plan is input bit perm[ i ], for the first n elements of perm.
+    @param plan the plan to fill in
+    @param perm array of ints representing the input bit for each output bit
+    @param n the number of bits to permute, at most 64
+    @param inBits the number of bits in the input, at most 64
+*/
+void compilePermPlan( PermPlan *plan, int const perm[], int n, int inBits );
+
+/**
+    This function applies a compiled plan to a left-aligned value.
+    @param plan the plan to apply
+    @param in the value to permute
+    @return the permuted value, left aligned
+*/
+uint64_t applyPermPlan( PermPlan const *plan, uint64_t in );
+
+/**
+    This function returns the plan for one of the permutations in
+    DESMagic.c. The plans are all compiled the first time one is
+    requested, and it's safe to call from several threads.
+    @param id which permutation to return
+    @return the compiled plan
+*/
+PermPlan const *standardPlan( PlanId id );
+
+/**
+    This function performs the initial permutation on a block held in
+    a word, using a short sequence of delta swaps. The result holds L0
+    in the high-order half and R0 in the low-order half.
+    @param block the block, with its first byte in the high-order bits
+    @return the permuted block
+*/
+uint64_t initialPermFast( uint64_t block );
+
+/**
+    This function performs the final permutation on R16 L16 held in a
+    word, using the delta swaps of initialPermFast() in reverse order.
+    @param block R16 in the high-order half and L16 in the low-order half
+    @return the permuted block, with its first byte in the high-order bits
+*/
+uint64_t finalPermFast( uint64_t block );
+
+/**
+    This function loads a block into a word, with the first byte in
+    the high-order bits. The bytes don't need to be aligned.
+    @param data the bytes to load
+    @return the resulting word
+*/
+static inline uint64_t loadBlock64( byte const data[ BLOCK_BYTES ] )
+{
+    uint64_t x = 0;
+    for ( int i = 0; i < BLOCK_BYTES; i++ ) {
+        x = ( x << BYTE_SIZE ) | data[ i ];
+    }
+
+    return x;
+}
+
+/**
+    This function stores a word as a block, with the high-order bits in
+    the first byte. The bytes don't need to be aligned.
+    @param data the bytes to fill in
+    @param x the word to store
+*/
+static inline void storeBlock64( byte data[ BLOCK_BYTES ], uint64_t x )
+{
+    for ( int i = BLOCK_BYTES - 1; i >= 0; i-- ) {
+        data[ i ] = x;
+        x >>= BYTE_SIZE;
+    }
+}
+
+#endif
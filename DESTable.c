@@ -0,0 +1,177 @@
+/**
+    @file DESTable.c
+    @author John Butterfield (jpbutte2)
+    Table-driven implementation of the DES rounds. The S-box lookup and
+    the P permutation that follows it are folded into one table per
+    S-box, so the f function is eight lookups ORed together.
+*/
+
+#include <pthread.h>
+#include "DESTable.h"
+#include "DESPerm.h"
+
+/** Combined S-box and P-permutation tables, built on first use. */
+static uint32_t SP[ SBOX_COUNT ][ SP_ENTRIES ];
+
+/** Makes sure the SP tables are built exactly once, even with threads. */
+static pthread_once_t spOnce = PTHREAD_ONCE_INIT;
+
+/** Mask for the low-order 6 bits of a word. */
+#define CHUNK_MASK ( SP_ENTRIES - 1 )
+
+/**
+    Fill in the SP tables from sBoxTable and fFunctionPerm.
+*/
+static void buildSPTables( void )
+{
+    for ( int i = 0; i < SBOX_COUNT; i++ ) {
+        for ( int v = 0; v < SP_ENTRIES; v++ ) {
+            // Outer bits pick the row, inner four bits pick the column
+            int row = ( ( v >> ( SBOX_INPUT_BITS - 2 ) ) & 2 ) | ( v & 1 );
+            int column = ( v >> 1 ) & ( SBOX_COLS - 1 );
+            int value = sBoxTable[ i ][ row ][ column ];
+
+            // Send each output bit where fFunctionPerm puts it
+            uint32_t entry = 0;
+            for ( int j = 0; j < BLOCK_HALF_BITS; j++ ) {
+                int src = fFunctionPerm[ j ] - 1 - i * SBOX_OUTPUT_BITS;
+                if ( src >= 0 && src < SBOX_OUTPUT_BITS &&
+                     ( ( value >> ( SBOX_OUTPUT_BITS - 1 - src ) ) & 1 ) ) {
+                    entry |= 1u << ( BLOCK_HALF_BITS - 1 - j );
+                }
+            }
+            SP[ i ][ v ] = entry;
+        }
+    }
+}
+
+uint32_t const *spTable( int idx )
+{
+    pthread_once( &spOnce, buildSPTables );
+
+    return SP[ idx ];
+}
+
+void tableSubkeys( byte KS[ ROUND_COUNT ][ SBOX_COUNT ],
+                   byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] )
+{
+    for ( int i = 1; i < ROUND_COUNT; i++ ) {
+        uint64_t k = 0;
+        for ( int j = 0; j < SUBKEY_BYTES; j++ ) {
+            k = ( k << BYTE_SIZE ) | K[ i ][ j ];
+        }
+
+        for ( int j = 0; j < SBOX_COUNT; j++ ) {
+            KS[ i ][ j ] = ( k >> ( SUBKEY_BITS - SBOX_INPUT_BITS * ( j + 1 ) ) ) & CHUNK_MASK;
+        }
+    }
+}
+
+/**
+    Rotate a 32-bit word right by n bits.
+    @param x the word to rotate
+    @param n number of bits to rotate by, from 0 to 31
+    @return the rotated word
+*/
+static inline uint32_t rotr32( uint32_t x, int n )
+{
+    return ( x >> n ) | ( x << ( ( BLOCK_HALF_BITS - n ) & ( BLOCK_HALF_BITS - 1 ) ) );
+}
+
+/**
+    Compute the f function with the SP tables, which must already be built.
+    @param R the right half of the block
+    @param k subkey split into 6-bit chunks
+    @return the result of the f function
+*/
+static inline uint32_t spFunction( uint32_t R, byte const k[ SBOX_COUNT ] )
+{
+    // Chunk i of E( R ) is bits 4i .. 4i + 5 of R, wrapping around at
+    // both ends, so it sits in the low 6 bits after a right rotate.
+    return SP[ 0 ][ ( rotr32( R, 27 ) & CHUNK_MASK ) ^ k[ 0 ] ] |
+           SP[ 1 ][ ( ( R >> 23 ) & CHUNK_MASK ) ^ k[ 1 ] ] |
+           SP[ 2 ][ ( ( R >> 19 ) & CHUNK_MASK ) ^ k[ 2 ] ] |
+           SP[ 3 ][ ( ( R >> 15 ) & CHUNK_MASK ) ^ k[ 3 ] ] |
+           SP[ 4 ][ ( ( R >> 11 ) & CHUNK_MASK ) ^ k[ 4 ] ] |
+           SP[ 5 ][ ( ( R >> 7 ) & CHUNK_MASK ) ^ k[ 5 ] ] |
+           SP[ 6 ][ ( ( R >> 3 ) & CHUNK_MASK ) ^ k[ 6 ] ] |
+           SP[ 7 ][ ( rotr32( R, 31 ) & CHUNK_MASK ) ^ k[ 7 ] ];
+}
+
+uint32_t tableFFunction( uint32_t R, byte const k[ SBOX_COUNT ] )
+{
+    pthread_once( &spOnce, buildSPTables );
+
+    return spFunction( R, k );
+}
+
+void tableRounds( uint32_t *L, uint32_t *R, byte const KS[ ROUND_COUNT ][ SBOX_COUNT ],
+                  bool decrypt )
+{
+    pthread_once( &spOnce, buildSPTables );
+
+    uint32_t l = *L, r = *R;
+    for ( int i = 1; i < ROUND_COUNT; i++ ) {
+        uint32_t newR = l ^ spFunction( r, KS[ decrypt ? ROUND_COUNT - i : i ] );
+        l = r;
+        r = newR;
+    }
+
+    *L = l;
+    *R = r;
+}
+
+/**
+    Encrypt or decrypt one block with the table-driven rounds.
+    @param block the block to encrypt or decrypt in place
+    @param KS subkeys split by tableSubkeys()
+    @param decrypt true to decrypt, false to encrypt
+*/
+static void tableCryptBlock( DESBlock *block, byte const KS[ ROUND_COUNT ][ SBOX_COUNT ],
+                             bool decrypt )
+{
+    // Initial permutation
+    uint64_t lr = initialPermFast( loadBlock64( block->data ) );
+    uint32_t l = lr >> BLOCK_HALF_BITS, r = lr;
+
+    tableRounds( &l, &r, KS, decrypt );
+
+    // Final permutation of R16 L16
+    storeBlock64( block->data, finalPermFast( ( (uint64_t) r << BLOCK_HALF_BITS ) | l ) );
+}
+
+void tableEncryptBlock( DESBlock *block, byte const KS[ ROUND_COUNT ][ SBOX_COUNT ] )
+{
+    tableCryptBlock( block, KS, false );
+}
+
+void tableDecryptBlock( DESBlock *block, byte const KS[ ROUND_COUNT ][ SBOX_COUNT ] )
+{
+    tableCryptBlock( block, KS, true );
+}
+
+uint64_t tableCrypt64( uint64_t block, byte const KS[][ ROUND_COUNT ][ SBOX_COUNT ],
+                       int stages )
+{
+    pthread_once( &spOnce, buildSPTables );
+
+    uint64_t lr = initialPermFast( block );
+    uint32_t l = lr >> BLOCK_HALF_BITS, r = lr;
+
+    for ( int s = 0; s < stages; s++ ) {
+        // R16 L16 of one stage is L0 R0 of the next
+        if ( s > 0 ) {
+            uint32_t t = l;
+            l = r;
+            r = t;
+        }
+
+        for ( int i = 1; i < ROUND_COUNT; i++ ) {
+            uint32_t newR = l ^ spFunction( r, KS[ s ][ i ] );
+            l = r;
+            r = newR;
+        }
+    }
+
+    return finalPermFast( ( (uint64_t) r << BLOCK_HALF_BITS ) | l );
+}
@@ -0,0 +1,98 @@
+/**
+    @file DESTable.h
+    @author John Butterfield (jpbutte2)
+    Header for the table-driven DES engine. This component keeps the
+    halves of a block in 32-bit words and computes the f function with
+    eight combined S-box and P-permutation (SP) tables, so a round is a
+    handful of shifts, masks and table lookups.
+*/
+
+#ifndef DESTABLE_H
+#define DESTABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "DES.h"
+
+/** Number of entries in each SP table, one for every 6-bit S-box input. */
+#define SP_ENTRIES ( 1 << SBOX_INPUT_BITS )
+
+/**
+    This function returns the combined S-box and P-permutation table
+    for the S-box with the given index. Entry v of the table is the
+    32-bit result of fFunctionPerm applied to the 4-bit output of
+    sBoxTable[ idx ] for input v, placed where the S-box output lands.
+    The tables are built from sBoxTable and fFunctionPerm on first use,
+    and it's safe to call from several threads.
+    @param idx index of the S-box, from 0 to 7
+    @return the 64-entry SP table for that S-box
+*/
+uint32_t const *spTable( int idx );
+
+/**
+    This function splits the subkeys in K into the layout used by the
+    table-driven round function: one byte for each of the eight 6-bit
+    chunks of a subkey. Like K, the result is indexed from KS[ 1 ] to
+    KS[ 16 ].
+    @param KS the split subkeys
+    @param K a 2D array of bytes with each array representing a subkey
+*/
+void tableSubkeys( byte KS[ ROUND_COUNT ][ SBOX_COUNT ],
+                   byte const K[ ROUND_COUNT ][ SUBKEY_BYTES ] );
+
+/**
+    This computes the f function on a 32-bit value R held in a word,
+    with bit 1 of R in the high-order bit. The E expansion is done with
+    rotates and masks, and each 6-bit chunk of E( R ) XOR K selects an
+    entry from the SP tables.
+    @param R the right half of the block
+    @param k subkey split into 6-bit chunks by tableSubkeys()
+    @return the result of the f function, in the same layout as R
+*/
+uint32_t tableFFunction( uint32_t R, byte const k[ SBOX_COUNT ] );
+
+/**
+    This function runs the 16 rounds on a block that has already been
+    through the initial permutation. On return, L and R hold L16 and
+    R16.
+    @param L the left half of the block
+    @param R the right half of the block
+    @param KS subkeys split by tableSubkeys()
+    @param decrypt true if the subkeys should be applied in reverse order
+*/
+void tableRounds( uint32_t *L, uint32_t *R, byte const KS[ ROUND_COUNT ][ SBOX_COUNT ],
+                  bool decrypt );
+
+/**
+    This function performs the encrypt operation on the byte array in
+    block with the table-driven engine.
+    @param block a pointer to a structure representing a block of
+                memory to encrypt
+    @param KS subkeys split by tableSubkeys()
+*/
+void tableEncryptBlock( DESBlock *block, byte const KS[ ROUND_COUNT ][ SBOX_COUNT ] );
+
+/**
+    This function performs the decrypt operation on the byte array in
+    block with the table-driven engine.
+    @param block a pointer to a structure representing a block of
+                memory to decrypt
+    @param KS subkeys split by tableSubkeys()
+*/
+void tableDecryptBlock( DESBlock *block, byte const KS[ ROUND_COUNT ][ SBOX_COUNT ] );
+
+/**
+    This function runs a whole block held in a word through IP, 16
+    rounds for each stage and FP, applying the subkeys of each stage in
+    KS from KS[ s ][ 1 ] to KS[ s ][ 16 ]. Between stages the halves
+    are just swapped, since FP followed by IP does nothing. Passing the
+    dec field of a DESKey decrypts the block.
+    @param block the block, with its first byte in the high-order bits
+    @param KS subkeys for each stage, split into 6-bit chunks
+    @param stages number of stages in KS
+    @return the encrypted or decrypted block
+*/
+uint64_t tableCrypt64( uint64_t block, byte const KS[][ ROUND_COUNT ][ SBOX_COUNT ],
+                       int stages );
+
+#endif
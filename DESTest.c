@@ -1,10 +1,27 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
 #include "DES.h"
+#include "DESTable.h"
+#include "DESPerm.h"
+#include "DESKey.h"
+#include "DESEngine.h"
+#include "DESBitslice.h"
+#include "DESContext.h"
+#include "io.h"
+#include "pool.h"
+#include "lz.h"
+#include "frame.h"
+#include "container.h"
 
 /** Number of tests we should have, if they're all turned on. */
-#define EXPECTED_TOTAL 46
+#define EXPECTED_TOTAL 108
 
 /** Total number or tests we tried. */
 static int totalTests = 0;
@@ -34,6 +51,36 @@ bool cmpBytes( byte const A[], byte const B[], int n )
   return true;
 }
 
+/** Like the table engine, but gets the last block of every run wrong,
+    to make sure the engine checks catch it. */
+static void brokenCrypt( DESEngine const *engine, DESKey const *ctx, uint8_t *dst,
+                         uint8_t const *src, size_t nblocks, bool decrypt )
+{
+  DESEngine const *table = desEngineFind( "table" );
+  table->crypt( table, ctx, dst, src, nblocks, decrypt );
+  if ( nblocks > 0 )
+    dst[ nblocks * BLOCK_BYTES - 1 ] ^= 1;
+}
+
+/** Takes and gives back pool buffers many times, marking each one
+    while it has it, and returns non-NULL if another thread was handed
+    the same buffer at the same time. */
+static void *poolChurn( void *arg )
+{
+  uintptr_t mark = (uintptr_t) arg;
+  bool clash = false;
+  for ( int i = 0; i < 20000; i++ ) {
+    byte *buffer = poolTake( 3000, false );
+    if ( buffer == NULL )
+      return (void *) 1;
+    ( (uintptr_t *) buffer )[ 1 ] = mark;
+    sched_yield();
+    clash = clash || ( (uintptr_t *) buffer )[ 1 ] != mark;
+    poolGive( buffer, 3000 );
+  }
+  return clash ? (void *) 1 : NULL;
+}
+
 int main()
 {
   // As you finish parts of your implementation, move this directive
@@ -283,6 +330,685 @@ int main()
                                               0x89, 0xAB, 0xCD, 0xEF}, 8 ) );
   }
 
+  ////////////////////////////////////////////////////////////////////////
+  // Test encryptBlocks() and decryptBlocks()
+
+  {
+    // Same example as above, through the bitsliced engine.
+    byte key[ BLOCK_BYTES ] = { 0x13, 0x34, 0x57, 0x79,
+      0x9B, 0xBC, 0xDF, 0xF1 };
+    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
+    generateSubkeys( K, key );
+
+    DESBlock block = { { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF }, 8 };
+    encryptBlocks( &block, 1, K );
+    TestCase( cmpBytes( block.data, (byte []){0x85, 0xE8, 0x13, 0x54,
+                                              0x0F, 0x0A, 0xB4, 0x05}, 8 ) );
+
+    decryptBlocks( &block, 1, K );
+    TestCase( cmpBytes( block.data, (byte []){0x01, 0x23, 0x45, 0x67,
+                                              0x89, 0xAB, 0xCD, 0xEF}, 8 ) );
+  }
+
+  {
+    // More than one group of 64, checked block by block against encryptBlock().
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "Claudius" );
+    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
+    generateSubkeys( K, key );
+
+    DESBlock plain[ 150 ], batch[ 150 ];
+    for ( int i = 0; i < 150; i++ ) {
+      for ( int j = 0; j < BLOCK_BYTES; j++ )
+        plain[ i ].data[ j ] = ( i * 37 + j * 101 + ( i >> 3 ) ) & 0xFF;
+      plain[ i ].len = BLOCK_BYTES;
+      batch[ i ] = plain[ i ];
+    }
+
+    encryptBlocks( batch, 150, K );
+    bool same = true;
+    for ( int i = 0; i < 150; i++ ) {
+      DESBlock single = plain[ i ];
+      encryptBlock( &single, K );
+      same = same && cmpBytes( single.data, batch[ i ].data, BLOCK_BYTES );
+    }
+    TestCase( same );
+
+    decryptBlocks( batch, 150, K );
+    same = true;
+    for ( int i = 0; i < 150; i++ )
+      same = same && cmpBytes( plain[ i ].data, batch[ i ].data, BLOCK_BYTES );
+    TestCase( same );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test tableFFunction(), tableEncryptBlock() and tableDecryptBlock()
+
+  {
+    // Same f function example as above, with R in a word.
+    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ] = {
+      {}, {0x1B, 0x02, 0xEF, 0xFC, 0x70, 0x72 } };
+    byte KS[ ROUND_COUNT ][ SBOX_COUNT ];
+    tableSubkeys( KS, K );
+
+    TestCase( tableFFunction( 0xF0AAF0AA, KS[ 1 ] ) == 0x234AA9BB );
+  }
+
+  {
+    byte key[ BLOCK_BYTES ] = { 0x13, 0x34, 0x57, 0x79,
+      0x9B, 0xBC, 0xDF, 0xF1 };
+    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
+    generateSubkeys( K, key );
+    byte KS[ ROUND_COUNT ][ SBOX_COUNT ];
+    tableSubkeys( KS, K );
+
+    DESBlock block = { { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF }, 8 };
+    tableEncryptBlock( &block, KS );
+    TestCase( cmpBytes( block.data, (byte []){0x85, 0xE8, 0x13, 0x54,
+                                              0x0F, 0x0A, 0xB4, 0x05}, 8 ) );
+
+    tableDecryptBlock( &block, KS );
+    TestCase( cmpBytes( block.data, (byte []){0x01, 0x23, 0x45, 0x67,
+                                              0x89, 0xAB, 0xCD, 0xEF}, 8 ) );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test compilePermPlan(), initialPermFast() and finalPermFast()
+
+  {
+    // Same permutation as the permute() test, left aligned in a word.
+    int perm[ 16 ] = { 7, 14, 12, 13, 1, 6, 11, 8, 4, 16, 15, 10, 3, 5, 9, 2 };
+    PermPlan plan;
+    compilePermPlan( &plan, perm, 16, 16 );
+
+    TestCase( applyPermPlan( &plan, 0xBCD6ULL << 48 ) == 0x6CBEULL << 48 );
+  }
+
+  {
+    // IP of the DES Algorithm Illustrated message gives L0 and R0.
+    uint64_t block = 0x0123456789ABCDEFULL;
+    TestCase( initialPermFast( block ) == 0xCC00CCFFF0AAF0AAULL );
+    TestCase( applyPermPlan( standardPlan( PLAN_IP ), block ) == 0xCC00CCFFF0AAF0AAULL );
+
+    // Both forms of the final permutation undo it again.
+    TestCase( finalPermFast( 0xCC00CCFFF0AAF0AAULL ) == block );
+    TestCase( applyPermPlan( standardPlan( PLAN_FP ), 0xCC00CCFFF0AAF0AAULL ) == block );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test desKeySetup()
+
+  {
+    // Same key as the generateSubkeys() test.
+    byte key[ BLOCK_BYTES ] = { 0x13, 0x34, 0x57, 0x79,
+      0x9B, 0xBC, 0xDF, 0xF1 };
+    DESKey ctx;
+    desKeySetup( &ctx, key );
+
+    // C0 and D0 from the DES Algorithm Illustrated article.
+    TestCase( ctx.C == 0xF0CCAAF && ctx.D == 0x556678F );
+
+    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
+    generateSubkeys( K, key );
+    byte KS[ ROUND_COUNT ][ SBOX_COUNT ];
+    tableSubkeys( KS, K );
+
+    bool same = true;
+    for ( int i = 1; i < ROUND_COUNT; i++ ) {
+      same = same && cmpBytes( ctx.enc[ 0 ][ i ], KS[ i ], SBOX_COUNT );
+      same = same && cmpBytes( ctx.dec[ 0 ][ ROUND_COUNT - i ], KS[ i ], SBOX_COUNT );
+    }
+    TestCase( same );
+  }
+
+  ////////////////////////////////////////////////////////////////////////
+  // Test desEncryptBuffer() and desDecryptBuffer()
+
+  {
+    // 100 blocks at an odd address, so both engines get used on
+    // unaligned data, encrypted in place.
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "passw0rd" );
+    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
+    generateSubkeys( K, key );
+    DESKey ctx;
+    desKeySetup( &ctx, key );
+
+    byte plain[ 100 * BLOCK_BYTES ], store[ 100 * BLOCK_BYTES + 1 ];
+    byte *buffer = store + 1;
+    for ( int i = 0; i < 100 * BLOCK_BYTES; i++ )
+      plain[ i ] = buffer[ i ] = ( i * 29 + ( i >> 5 ) ) & 0xFF;
+
+    desEncryptBuffer( &ctx, buffer, buffer, 100 );
+    bool same = true;
+    for ( int i = 0; i < 100; i++ ) {
+      DESBlock block;
+      memcpy( block.data, plain + i * BLOCK_BYTES, BLOCK_BYTES );
+      encryptBlock( &block, K );
+      same = same && cmpBytes( block.data, buffer + i * BLOCK_BYTES, BLOCK_BYTES );
+    }
+    TestCase( same );
+
+    // Decrypt into a separate buffer.
+    byte result[ 100 * BLOCK_BYTES ];
+    desDecryptBuffer( &ctx, result, buffer, 100 );
+    TestCase( cmpBytes( result, plain, 100 * BLOCK_BYTES ) );
+  }
+
+  // Test desCtrCrypt()
+
+  {
+    // 1000 bytes, so the keystream comes from both engines and ends
+    // partway through a block, with a nonce that wraps around.
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "Claudius" );
+    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
+    generateSubkeys( K, key );
+    DESKey ctx;
+    desKeySetup( &ctx, key );
+
+    uint64_t nonce = 0xFFFFFFFFFFFFFFF0ULL;
+    byte plain[ 1000 ], cipher[ 1000 ];
+    for ( int i = 0; i < 1000; i++ )
+      plain[ i ] = ( i * 13 + 7 ) & 0xFF;
+
+    desCtrCrypt( &ctx, nonce, 0, cipher, plain, 1000 );
+    bool same = true;
+    for ( int i = 0; i < 1000; i++ ) {
+      DESBlock block;
+      storeBlock64( block.data, nonce + i / BLOCK_BYTES );
+      encryptBlock( &block, K );
+      same = same && ( cipher[ i ] ^ plain[ i ] ) == block.data[ i % BLOCK_BYTES ];
+    }
+    TestCase( same );
+
+    // Decrypt a range that starts and ends partway through a block.
+    byte part[ 1000 ];
+    desCtrCrypt( &ctx, nonce, 333, part, cipher + 333, 500 );
+    TestCase( cmpBytes( part, plain + 333, 500 ) );
+  }
+
+  // Test desCbcEncrypt(), desCbcDecrypt() and desCbcEncryptInterleaved()
+
+  {
+    // Known answer for "hello world 12345" with PKCS#7 padding, as
+    // produced by openssl enc -des-cbc with the same key and IV.
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "Claudius" );
+    DESKey ctx;
+    desKeySetup( &ctx, key );
+
+    byte plain[ 24 ] = "hello world 12345\7\7\7\7\7\7\7";
+    byte cipher[ 24 ];
+    uint64_t iv = 0x0102030405060708ULL;
+    desCbcEncrypt( &ctx, &iv, cipher, plain, 3 );
+    TestCase( cmpBytes( cipher, (byte []){0x20, 0x49, 0x04, 0xAF, 0xDE, 0xF5, 0x0C, 0x96,
+                                          0x59, 0x0E, 0x74, 0xB9, 0xAE, 0x8E, 0x50, 0xA9,
+                                          0x9C, 0x08, 0xD5, 0x11, 0xC5, 0x68, 0x4E, 0x8F},
+                        24 ) );
+    TestCase( iv == 0x9C08D511C5684E8FULL );
+
+    // Decrypt in place, in two calls that carry the chain over.
+    iv = 0x0102030405060708ULL;
+    desCbcDecrypt( &ctx, &iv, cipher, cipher, 1 );
+    desCbcDecrypt( &ctx, &iv, cipher + 8, cipher + 8, 2 );
+    TestCase( cmpBytes( cipher, plain, 24 ) );
+
+    // 50 streams side by side, enough to use the bitsliced engine, must
+    // match encrypting each stream on its own.
+    static byte streams[ 50 ][ 5 * BLOCK_BYTES ], result[ 50 ][ 5 * BLOCK_BYTES ];
+    byte *dst[ 50 ];
+    byte const *src[ 50 ];
+    uint64_t ivs[ 50 ];
+    for ( int s = 0; s < 50; s++ ) {
+      for ( int i = 0; i < 5 * BLOCK_BYTES; i++ )
+        streams[ s ][ i ] = ( s * 31 + i * 7 ) & 0xFF;
+      dst[ s ] = result[ s ];
+      src[ s ] = streams[ s ];
+      ivs[ s ] = s * 0x0101010101010101ULL;
+    }
+    desCbcEncryptInterleaved( &ctx, 50, ivs, dst, src, 5 );
+
+    bool same = true;
+    for ( int s = 0; s < 50; s++ ) {
+      byte single[ 5 * BLOCK_BYTES ];
+      uint64_t chain = s * 0x0101010101010101ULL;
+      desCbcEncrypt( &ctx, &chain, single, streams[ s ], 5 );
+      same = same && cmpBytes( single, result[ s ], 5 * BLOCK_BYTES ) && chain == ivs[ s ];
+    }
+    TestCase( same );
+
+    // Tied to any bitsliced engine, the key gives the same answers one
+    // stream at a time and side by side.
+    DESEngine const *engines[ DES_ENGINE_MAX ];
+    int count = desEngines( engines );
+    bool tied = true;
+    for ( int e = 0; e < count; e++ ) {
+      if ( !( engines[ e ]->caps & DES_ENGINE_BITSLICED ) )
+        continue;
+      DESKey bitsliced;
+      desKeySetup( &bitsliced, key );
+      desKeyUseEngine( &bitsliced, engines[ e ] );
+
+      byte again[ 5 * BLOCK_BYTES ];
+      uint64_t chain = 0;
+      desCbcEncrypt( &bitsliced, &chain, again, streams[ 0 ], 5 );
+      tied = tied && cmpBytes( again, result[ 0 ], 5 * BLOCK_BYTES ) && chain == ivs[ 0 ];
+
+      static byte side[ 50 ][ 5 * BLOCK_BYTES ];
+      uint64_t sideIvs[ 50 ];
+      for ( int s = 0; s < 50; s++ ) {
+        dst[ s ] = side[ s ];
+        sideIvs[ s ] = s * 0x0101010101010101ULL;
+      }
+      desCbcEncryptInterleaved( &bitsliced, 50, sideIvs, dst, src, 5 );
+      for ( int s = 0; s < 50; s++ )
+        tied = tied && cmpBytes( side[ s ], result[ s ], 5 * BLOCK_BYTES ) &&
+               sideIvs[ s ] == ivs[ s ];
+    }
+    TestCase( tied );
+  }
+
+  // Test desTripleKeySetup() with both engines
+
+  {
+    byte key1[ BLOCK_BYTES ], key2[ BLOCK_BYTES ], key3[ BLOCK_BYTES ];
+    prepareKey( key1, "Claudius" );
+    prepareKey( key2, "passw0rd" );
+    prepareKey( key3, "ciaba++a" );
+    DESKey ctx;
+    desTripleKeySetup( &ctx, key1, key2, key3 );
+
+    // Known answer from openssl enc -des-ede3 with the same keys, for
+    // one block on its own and for 64 copies through the bitsliced
+    // engine.
+    static byte blocks[ 64 * BLOCK_BYTES ];
+    for ( int i = 0; i < 64; i++ )
+      memcpy( blocks + i * BLOCK_BYTES, "hello wo", BLOCK_BYTES );
+    byte one[ BLOCK_BYTES ];
+    desEncryptBuffer( &ctx, one, blocks, 1 );
+    desEncryptBuffer( &ctx, blocks, blocks, 64 );
+
+    byte expected[ BLOCK_BYTES ] = {0x20, 0x12, 0xB5, 0xA9, 0xE9, 0x12, 0x0F, 0xA8};
+    TestCase( cmpBytes( one, expected, BLOCK_BYTES ) );
+    bool same = true;
+    for ( int i = 0; i < 64; i++ )
+      same = same && cmpBytes( blocks + i * BLOCK_BYTES, expected, BLOCK_BYTES );
+    TestCase( same );
+
+    desDecryptBuffer( &ctx, blocks, blocks, 64 );
+    TestCase( memcmp( blocks, "hello wo", BLOCK_BYTES ) == 0 );
+
+    // The same key three times is single DES.
+    DESKey single;
+    desKeySetup( &single, key1 );
+    desTripleKeySetup( &ctx, key1, key1, key1 );
+    byte a[ 64 * BLOCK_BYTES ], b[ 64 * BLOCK_BYTES ];
+    desEncryptBuffer( &single, a, blocks, 64 );
+    desEncryptBuffer( &ctx, b, blocks, 64 );
+    TestCase( cmpBytes( a, b, 64 * BLOCK_BYTES ) );
+  }
+
+  // Test every bitsliced kernel this processor can run
+
+  {
+    // A full group, then a short one, for each kernel.
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "abcd1234" );
+    DESKey ctx;
+    desKeySetup( &ctx, key );
+    static uint64_t KP[ DES_MAX_STAGES ][ ROUND_COUNT ][ SUBKEY_BITS ];
+    desKeyPlanes( KP, &ctx, false );
+
+    static byte plain[ 512 * BLOCK_BYTES ], cipher[ 512 * BLOCK_BYTES ];
+    for ( int i = 0; i < 512 * BLOCK_BYTES; i++ )
+      plain[ i ] = ( i * 131 + ( i >> 9 ) ) & 0xFF;
+
+    BitsliceKernel const *kernels[ BITSLICE_KERNEL_MAX ];
+    int count = bitsliceKernels( kernels );
+    TestCase( count >= 1 && strcmp( kernels[ count - 1 ]->name, "scalar" ) == 0 );
+
+    bool same = true;
+    for ( int k = 0; k < count; k++ ) {
+      int widths[] = { kernels[ k ]->width, kernels[ k ]->width - 3 };
+      for ( int w = 0; w < 2; w++ ) {
+        memset( cipher, 0, sizeof( cipher ) );
+        kernels[ k ]->crypt( cipher, plain, widths[ w ],
+                             (uint64_t const (*)[ ROUND_COUNT ][ SUBKEY_BITS ]) KP, 1 );
+        for ( int i = 0; i < widths[ w ]; i++ ) {
+          uint64_t expect = tableCrypt64( loadBlock64( plain + i * BLOCK_BYTES ), ctx.enc, 1 );
+          same = same && loadBlock64( cipher + i * BLOCK_BYTES ) == expect;
+        }
+        // Nothing is written past the short group
+        if ( w == 1 )
+          same = same && loadBlock64( cipher + widths[ w ] * BLOCK_BYTES ) == 0;
+      }
+    }
+    TestCase( same );
+  }
+
+  {
+    // 64 different keys side by side, each checked in its own lane
+    // against the block engine with that key alone.
+    static byte keys[ 64 ][ BLOCK_BYTES ];
+    char text[ BLOCK_BYTES + 1 ];
+    for ( int j = 0; j < 64; j++ ) {
+      snprintf( text, sizeof( text ), "key%02d~%c", j, 'a' + j % 26 );
+      prepareKey( keys[ j ], text );
+    }
+
+    uint64_t keyPlanes[ BLOCK_BITS ], planes[ BLOCK_BITS ];
+    static uint64_t KP[ ROUND_COUNT ][ SUBKEY_BITS ];
+    bitsliceLoad( keyPlanes, keys[ 0 ], BLOCK_BYTES, 64 );
+    bitsliceKeySchedule( KP, keyPlanes );
+
+    uint64_t in = 0x0123456789ABCDEFull;
+    for ( int b = 0; b < BLOCK_BITS; b++ )
+      planes[ b ] = -( ( in >> ( BLOCK_BITS - 1 - b ) ) & 1 );
+    bitsliceCrypt( planes, KP, false );
+
+    static byte cipher[ 64 ][ BLOCK_BYTES ];
+    bitsliceStore( cipher[ 0 ], BLOCK_BYTES, planes, 64 );
+
+    bool same = true;
+    for ( int j = 0; j < 64; j++ ) {
+      DESKey ctx;
+      desKeySetup( &ctx, keys[ j ] );
+      same = same && loadBlock64( cipher[ j ] ) == tableCrypt64( in, ctx.enc, 1 );
+    }
+    TestCase( same );
+  }
+
+  // Test the engine registry
+
+  {
+    DESEngine const *engines[ DES_ENGINE_MAX ];
+    int count = desEngines( engines );
+    TestCase( count >= 4 && strcmp( engines[ 0 ]->name, "auto" ) == 0 &&
+              desEngineFind( "table" ) != NULL && desEngineFind( "fast" ) == NULL );
+
+    // Every engine gets the known answers, and agrees with the table
+    // engine on random data; the reference is slow, so it gets less.
+    bool passed = true, agreed = true;
+    DESEngine const *table = desEngineFind( "table" );
+    for ( int i = 0; i < count; i++ ) {
+      passed = passed && desEngineSelfTest( engines[ i ] );
+      size_t blocks = strcmp( engines[ i ]->name, "reference" ) == 0 ? 300 : 20000;
+      agreed = agreed && desEngineCrossCheck( engines[ i ], table, i + 1, blocks ) == 0;
+    }
+    TestCase( passed );
+    TestCase( agreed );
+
+    // A broken engine is caught both ways.
+    DESEngine broken = { "broken", DES_ENGINE_TRIPLE, 1, brokenCrypt, NULL };
+    TestCase( !desEngineSelfTest( &broken ) &&
+              desEngineCrossCheck( &broken, table, 1, 5000 ) > 0 );
+
+    // A context on a chosen engine gives the same CBC ciphertext, and
+    // refuses the broken one.
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "Claudius" );
+    DESContext *fast = desContextCreate( key, MODE_CBC );
+    DESContext *slow = desContextCreate( key, MODE_CBC );
+    static byte plain[ 1000 ], a[ 1008 ], b[ 1008 ];
+    for ( int i = 0; i < 1000; i++ )
+      plain[ i ] = i * 7;
+    TestCase( desContextSetEngine( slow, desEngineFind( "reference" ) ) &&
+              !desContextSetEngine( slow, &broken ) &&
+              desEncrypt( fast, 42, a, plain, 1000 ) == 1008 &&
+              desEncrypt( slow, 42, b, plain, 1000 ) == 1008 &&
+              cmpBytes( a, b, 1008 ) );
+    desContextFree( fast );
+    desContextFree( slow );
+  }
+
+  // Test the context interface
+
+  {
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "abcd1234" );
+    DESContext *ecb = desContextCreate( key, MODE_ECB );
+    DESContext *cbc = desContextCreate( key, MODE_CBC );
+    DESContext *ctr = desContextCreate( key, MODE_CTR );
+    TestCase( ecb != NULL && cbc != NULL && ctr != NULL );
+
+    // ECB is the buffer engine, with zero padding.
+    DESKey single;
+    desKeySetup( &single, key );
+    byte plain[ 21 ] = "hello world, 21 bytes";
+    byte out[ 32 ], expect[ 24 ] = { 0 };
+    memcpy( expect, plain, sizeof( plain ) );
+    desEncryptBuffer( &single, expect, expect, 3 );
+    TestCase( desEncrypt( ecb, 0, out, plain, sizeof( plain ) ) == 24 &&
+              cmpBytes( out, expect, 24 ) );
+    TestCase( desDecrypt( ecb, 0, out, out, 24 ) == sizeof( plain ) &&
+              cmpBytes( out, plain, sizeof( plain ) ) );
+
+    // CBC pads to a whole block more, and round-trips.
+    TestCase( desOutputBound( cbc, false, sizeof( plain ) ) == 24 );
+    TestCase( desEncrypt( cbc, 42, out, plain, sizeof( plain ) ) == 24 );
+    TestCase( desDecrypt( cbc, 42, out, out, 24 ) == sizeof( plain ) &&
+              cmpBytes( out, plain, sizeof( plain ) ) );
+
+    // A wrong IV spoils the padding of a one-block message.
+    byte small[ BLOCK_BYTES ];
+    desEncrypt( cbc, 1, small, plain, 3 );
+    TestCase( desDecrypt( cbc, 2, small, small, BLOCK_BYTES ) == DES_INVALID );
+
+    // A stream fed in pieces gives the same output as one call.
+    byte whole[ 21 ], pieces[ 21 ];
+    desEncrypt( ctr, 7, whole, plain, sizeof( plain ) );
+    DESStream stream;
+    desStreamInit( &stream, false, 7 );
+    desStreamCrypt( ctr, &stream, pieces, plain, 16, false );
+    desStreamCrypt( ctr, &stream, pieces + 16, plain + 16, 5, true );
+    TestCase( cmpBytes( whole, pieces, sizeof( plain ) ) && stream.pos == sizeof( plain ) );
+
+    // Messages of different lengths encrypted side by side, in place,
+    // match encrypting each one on its own.
+    static byte many[ 50 ][ 64 ], one[ 64 ];
+    byte *manyDst[ 50 ];
+    byte const *manySrc[ 50 ];
+    uint64_t manyIv[ 50 ];
+    size_t manyLen[ 50 ];
+    for ( int s = 0; s < 50; s++ ) {
+      manyLen[ s ] = s % 7 * 9;
+      for ( size_t i = 0; i < manyLen[ s ]; i++ )
+        many[ s ][ i ] = ( s * 13 + i ) & 0xFF;
+      manyDst[ s ] = many[ s ];
+      manySrc[ s ] = many[ s ];
+      manyIv[ s ] = s * 0x0102030405060708ULL;
+    }
+    bool matches = true;
+    byte copies[ 50 ][ 64 ];
+    memcpy( copies, many, sizeof( copies ) );
+    desCbcEncryptMany( cbc, 50, manyIv, manyDst, manySrc, manyLen );
+    for ( int s = 0; s < 50; s++ ) {
+      size_t outLen = desEncrypt( cbc, manyIv[ s ], one, copies[ s ], manyLen[ s ] );
+      matches = matches && cmpBytes( one, many[ s ], outLen );
+    }
+    TestCase( matches );
+
+    // Files round-trip through the header.
+    FILE *in = tmpfile(), *mid = tmpfile(), *back = tmpfile();
+    fwrite( plain, 1, sizeof( plain ), in );
+    rewind( in );
+    bool ok = desEncryptFile( cbc, in, mid );
+    rewind( mid );
+    ok = ok && desDecryptFile( cbc, mid, back );
+    rewind( back );
+    byte got[ 32 ];
+    TestCase( ok && fread( got, 1, sizeof( got ), back ) == sizeof( plain ) &&
+              cmpBytes( got, plain, sizeof( plain ) ) );
+    rewind( mid );
+    TestCase( !desDecryptFile( ctr, mid, back ) );
+    fclose( in );
+    fclose( mid );
+    fclose( back );
+
+    desContextFree( ecb );
+    desContextFree( cbc );
+    desContextFree( ctr );
+  }
+
+  {
+    // Pool buffers are page aligned, and one given back is reused for
+    // the next buffer of the same size, but not for another size.
+    byte *first = poolTake( 5000, false );
+    TestCase( first != NULL && (uintptr_t) first % 4096 == 0 );
+    poolGive( first, 5000 );
+    byte *again = poolTake( 5000, false );
+    byte *other = poolTake( 100, false );
+    TestCase( again == first && other != first && other != NULL );
+    poolGive( again, 5000 );
+    poolGive( other, 100 );
+
+    // Threads sharing the free list never get the same buffer at once.
+    pthread_t threads[ 4 ];
+    bool clean = true;
+    for ( uintptr_t t = 0; t < 4; t++ )
+      pthread_create( &threads[ t ], NULL, poolChurn, (void *) ( t + 1 ) );
+    for ( int t = 0; t < 4; t++ ) {
+      void *result;
+      pthread_join( threads[ t ], &result );
+      clean = clean && result == NULL;
+    }
+    TestCase( clean );
+
+    // Huge page buffers are aligned to a huge page and kept apart from
+    // others of the same size, and trimming unmaps every buffer given
+    // back, once.
+    byte *huge = poolTake( HUGE_PAGE_BYTES, true );
+    byte *plain = poolTake( HUGE_PAGE_BYTES, false );
+    TestCase( huge != NULL && plain != NULL && (uintptr_t) huge % HUGE_PAGE_BYTES == 0 );
+    poolGive( huge, HUGE_PAGE_BYTES );
+    poolGive( plain, HUGE_PAGE_BYTES );
+    byte *hugeAgain = poolTake( HUGE_PAGE_BYTES, true );
+    byte *plainAgain = poolTake( HUGE_PAGE_BYTES, false );
+    TestCase( hugeAgain == huge && plainAgain == plain );
+    poolGive( hugeAgain, HUGE_PAGE_BYTES );
+    poolGive( plainAgain, HUGE_PAGE_BYTES );
+    TestCase( poolTrim() > 2 * HUGE_PAGE_BYTES && poolTrim() == 0 );
+  }
+
+  {
+    // Text with repeats compresses, and comes back the same.
+    static byte text[ 20000 ], packed[ 20000 ], back[ 20000 ], noise[ 4000 ];
+    for ( int i = 0; i < 20000; i++ )
+      text[ i ] = "the quick brown fox jumps over the lazy dog "[ i % 44 ] + ( i / 4000 );
+    size_t packedLen = lzCompress( packed, sizeof( packed ), text, sizeof( text ) );
+    TestCase( packedLen > 0 && packedLen < sizeof( text ) / 10 &&
+              lzDecompress( back, sizeof( back ), packed, packedLen ) &&
+              cmpBytes( back, text, sizeof( text ) ) );
+
+    // Data with no repeats doesn't fit in fewer bytes.
+    uint32_t x = 12345;
+    for ( int i = 0; i < 4000; i++ ) {
+      x = x * 1103515245 + 12345;
+      noise[ i ] = x >> 24;
+    }
+    TestCase( lzCompress( packed, sizeof( noise ) - 1, noise, sizeof( noise ) ) == 0 );
+
+    // Cut short or asked for the wrong length, the data is rejected.
+    packedLen = lzCompress( packed, sizeof( packed ), text, sizeof( text ) );
+    TestCase( !lzDecompress( back, sizeof( back ), packed, packedLen - 1 ) &&
+              !lzDecompress( back, sizeof( back ) - 1, packed, packedLen ) &&
+              !lzDecompress( back, sizeof( back ), packed, 3 ) );
+
+    // Frames round-trip in both chained modes, compressed or stored.
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "Claudius" );
+    DESContext *ctr = desContextCreate( key, MODE_CTR );
+    DESContext *cbc = desContextCreate( key, MODE_CBC );
+    static byte frame[ 20000 + 16 ];
+    bool ok = true;
+    for ( int m = 0; m < 2; m++ ) {
+      DESContext *ctx = m == 0 ? ctr : cbc;
+      size_t frameLen = frameSeal( ctx, 99, 3, frame, text, sizeof( text ), true );
+      ok = ok && frameLen < sizeof( text ) / 10 &&
+           frameOpen( ctx, 99, 3, back, frame + FRAME_HEADER_BYTES, frame ) == sizeof( text ) &&
+           cmpBytes( back, text, sizeof( text ) );
+      frameLen = frameSeal( ctx, 99, 4, frame, noise, sizeof( noise ), true );
+      ok = ok && frameLen <= frameBound( sizeof( noise ) ) &&
+           frameOpen( ctx, 99, 4, back, frame + FRAME_HEADER_BYTES, frame ) == sizeof( noise ) &&
+           cmpBytes( back, noise, sizeof( noise ) );
+    }
+    TestCase( ok );
+
+    // Frames with different indexes are encrypted differently.
+    byte first[ 64 ], second[ 64 ];
+    frameSeal( ctr, 99, 0, first, noise, 40, true );
+    frameSeal( ctr, 99, 1, second, noise, 40, true );
+    TestCase( !cmpBytes( first + FRAME_HEADER_BYTES, second + FRAME_HEADER_BYTES, 40 ) );
+
+    // A frame header that doesn't add up is caught before any reading.
+    size_t payload, len;
+    byte empty[ FRAME_HEADER_BYTES ] = { 0, 0, 0, 8, 0, 0, 0, 0 };
+    byte huge[ FRAME_HEADER_BYTES ] = { 0, 0, 0, 8, 0x7F, 0xFF, 0xFF, 0xFF };
+    byte overlong[ FRAME_HEADER_BYTES ] = { 0, 0, 1, 0, 0, 0, 0, 16 };
+    TestCase( !frameSizes( empty, &payload, &len ) && !frameSizes( huge, &payload, &len ) &&
+              !frameSizes( overlong, &payload, &len ) );
+    desContextFree( ctr );
+    desContextFree( cbc );
+  }
+
+  {
+    // The parameters of an indexed file round-trip, and ones out of
+    // range are rejected.
+    IndexParams params = { 16, 3, 20 }, got;
+    byte data[ INDEX_PARAMS_BYTES ];
+    encodeIndexParams( data, &params );
+    TestCase( decodeIndexParams( data, &got ) && got.chunkBytes == 16 && got.keys == 3 &&
+              got.length == 20 );
+    params.keys = 2;
+    encodeIndexParams( data, &params );
+    bool badKeys = !decodeIndexParams( data, &got );
+    params.keys = 1;
+    params.chunkBytes = 12;
+    encodeIndexParams( data, &params );
+    TestCase( badKeys && !decodeIndexParams( data, &got ) );
+
+    // ECB frames keep the zero bytes at the end of the plaintext.
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, "Claudius" );
+    DESContext *ecb = desContextCreate( key, MODE_ECB );
+    byte text[ 20 ] = "sixteen bytes...ab";
+    byte frames[ 2 ][ 40 ], back[ 40 ];
+    size_t frameLen[ 2 ];
+    frameLen[ 0 ] = frameSeal( ecb, 0, 0, frames[ 0 ], text, 16, false );
+    frameLen[ 1 ] = frameSeal( ecb, 0, 1, frames[ 1 ], text + 16, 4, false );
+    TestCase( frameOpen( ecb, 0, 1, back, frames[ 1 ] + FRAME_HEADER_BYTES, frames[ 1 ] ) == 4 &&
+              cmpBytes( back, text + 16, 4 ) );
+
+    // An index written after the frames finds them again, and a file
+    // cut short is caught from the index alone.
+    FILE *fp = tmpfile();
+    byte head[ HEADER_BYTES + INDEX_PARAMS_BYTES ] = { 0 };
+    byte tail[ FRAME_HEADER_BYTES + 2 * INDEX_ENTRY_BYTES + INDEX_TRAILER_BYTES ] = { 0 };
+    uint64_t start = sizeof( head );
+    storeBlock64( tail + FRAME_HEADER_BYTES, start );
+    storeBlock64( tail + FRAME_HEADER_BYTES + INDEX_ENTRY_BYTES, start + frameLen[ 0 ] );
+    encodeTrailer( tail + FRAME_HEADER_BYTES + 2 * INDEX_ENTRY_BYTES, 2, 20 );
+    fwrite( head, 1, sizeof( head ), fp );
+    fwrite( frames[ 0 ], 1, frameLen[ 0 ], fp );
+    fwrite( frames[ 1 ], 1, frameLen[ 1 ], fp );
+    fwrite( tail, 1, sizeof( tail ), fp );
+    fflush( fp );
+    off_t size = ftello( fp );
+    IndexParams file = { 16, 1, LENGTH_UNKNOWN };
+    uint64_t *offsets, chunks;
+    bool found = readIndex( fileno( fp ), size, start, &file, &offsets, &chunks ) &&
+                 chunks == 2 && file.length == 20 && offsets[ 1 ] == start + frameLen[ 0 ] &&
+                 offsets[ 2 ] == start + frameLen[ 0 ] + frameLen[ 1 ] &&
+                 indexChunkBytes( &file, 1 ) == 4;
+    if ( found )
+      free( offsets );
+    TestCase( found && !readIndex( fileno( fp ), size - 1, start, &file, &offsets, &chunks ) &&
+              errno == 0 );
+    fclose( fp );
+    desContextFree( ecb );
+  }
+
     #ifdef DISABLE_TESTS
 
   // Once you move the #ifdef DISABLE_TESTS to here, you've enabled
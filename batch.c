@@ -0,0 +1,932 @@
+/**
+    @file batch.c
+    @author John Butterfield (jpbutte2)
+    Batch component. The files are listed and planned into tasks on the
+    main thread, and then a pool of workers runs the tasks. Every task
+    is known before the workers start, so each worker's queue only ever
+    shrinks, and a worker is done once every queue is empty.
+*/
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "batch.h"
+#include "io.h"
+#include "pool.h"
+#include "stats.h"
+#include "DESPerm.h"
+
+/** One file to process. The fields after chunkCount are only used
+    when the file is split between tasks. */
+typedef struct {
+  /** Path of the input file. */
+  char *inPath;
+
+  /** Path of the output file. */
+  char *outPath;
+
+  /** Number of data bytes in the input file, after any header. */
+  off_t size;
+
+  /** Number of chunks the data is processed in, at least 1. */
+  size_t chunkCount;
+
+  /** True if each chunk is a task of its own. */
+  bool split;
+
+  /** Protects the fields below. */
+  pthread_mutex_t lock;
+
+  /** True once the first task has tried to open the file. */
+  bool opened;
+
+  /** True if any chunk failed. */
+  bool failed;
+
+  /** Number of chunks finished, successfully or not. */
+  size_t chunksDone;
+
+  /** Descriptor of the input file, or -1. */
+  int inFd;
+
+  /** Descriptor of the output file, or -1. */
+  int outFd;
+
+  /** Nonce from the file header, for modes that have one. */
+  uint64_t nonce;
+} BatchFile;
+
+/** A piece of work: either one chunk of a split file, or a group of
+    whole files. */
+typedef struct {
+  /** Index of the first file. */
+  size_t file;
+
+  /** Number of files, which is 1 for a chunk. */
+  size_t fileCount;
+
+  /** Index of the chunk, for a split file. */
+  size_t chunk;
+} BatchTask;
+
+/** Tasks waiting for a worker: tasks[ head ] up to tasks[ tail - 1 ]. */
+typedef struct {
+  /** Protects head and tail. */
+  pthread_mutex_t lock;
+
+  /** Index of the first task, which the owner takes next. */
+  size_t head;
+
+  /** Index just past the last task, which thieves take first. */
+  size_t tail;
+} TaskQueue;
+
+/** Everything the workers share. */
+typedef struct {
+  /** The parsed command line. */
+  Options const *opts;
+
+  /** The key and mode to use. */
+  DESContext const *ctx;
+
+  /** True to decrypt, false to encrypt. */
+  bool decrypt;
+
+  /** Number of header bytes before the data in each input file. */
+  off_t inStart;
+
+  /** Number of header bytes before the data in each output file. */
+  off_t outStart;
+
+  /** Number of input bytes in each chunk, a multiple of BLOCK_BYTES. */
+  size_t chunkBytes;
+
+  /** The files. */
+  BatchFile *files;
+
+  /** Number of files. */
+  size_t fileCount;
+
+  /** Room allocated for files. */
+  size_t fileCapacity;
+
+  /** The tasks, in file order. */
+  BatchTask *tasks;
+
+  /** Number of tasks. */
+  size_t taskCount;
+
+  /** One queue for each worker. */
+  TaskQueue *queues;
+
+  /** Number of workers. */
+  int workerCount;
+
+  /** Set when any file fails. */
+  bool failed;
+} Batch;
+
+/** A worker thread and the queue it owns. */
+typedef struct {
+  /** The batch. */
+  Batch *batch;
+
+  /** Index of the worker and of its queue. */
+  int index;
+
+  /** The worker thread. */
+  pthread_t thread;
+} BatchWorker;
+
+/**
+    Join a directory and a relative path.
+    @param dir the directory
+    @param rel the relative path
+    @return the joined path in new memory, or NULL
+*/
+static char *joinPath( char const *dir, char const *rel )
+{
+    size_t dirLen = strlen( dir );
+    char *path = malloc( dirLen + strlen( rel ) + 2 );
+    if ( path != NULL ) {
+        sprintf( path, "%s%s%s", dir, dirLen > 0 && dir[ dirLen - 1 ] == '/' ? "" : "/", rel );
+    }
+    return path;
+}
+
+/**
+    Add a file to the batch. The input file is looked up to find its
+    size, which decides how it is split up.
+    @param batch the batch
+    @param inPath path of the input file, which is copied
+    @param outPath path of the output file, which the batch takes over
+    @return false if the batch ran out of memory
+*/
+static bool addFile( Batch *batch, char const *inPath, char *outPath )
+{
+    struct stat st;
+    bool found = stat( inPath, &st ) == 0;
+    if ( !found || !S_ISREG( st.st_mode ) ) {
+        if ( found ) {
+            fprintf( stderr, "%s: Not a regular file\n", inPath );
+        } else {
+            perror( inPath );
+        }
+        batch->failed = true;
+        free( outPath );
+        return true;
+    }
+
+    if ( batch->fileCount == batch->fileCapacity ) {
+        size_t capacity = batch->fileCapacity == 0 ? 64 : batch->fileCapacity * 2;
+        BatchFile *files = realloc( batch->files, capacity * sizeof( BatchFile ) );
+        if ( files == NULL ) {
+            free( outPath );
+            return false;
+        }
+        batch->files = files;
+        batch->fileCapacity = capacity;
+    }
+
+    BatchFile *file = &batch->files[ batch->fileCount ];
+    memset( file, 0, sizeof( *file ) );
+    file->inPath = strdup( inPath );
+    file->outPath = outPath;
+    if ( file->inPath == NULL ) {
+        free( outPath );
+        return false;
+    }
+
+    // A short file fails when it is opened, as the header is read
+    file->size = st.st_size > batch->inStart ? st.st_size - batch->inStart : 0;
+    file->chunkCount = file->size == 0 ? 1 : ( file->size + batch->chunkBytes - 1 ) /
+                                             batch->chunkBytes;
+    file->inFd = -1;
+    file->outFd = -1;
+    batch->fileCount++;
+    return true;
+}
+
+/**
+    Report whether the entries of a manifest path stay inside the
+    output directory.
+    @param path the path, after any leading slashes
+    @return true if no component of the path is ".."
+*/
+static bool staysInside( char const *path )
+{
+    for ( char const *part = path; *part != '\0'; ) {
+        size_t len = strcspn( part, "/" );
+        if ( len == 2 && part[ 0 ] == '.' && part[ 1 ] == '.' ) {
+            return false;
+        }
+        part += len;
+        part += strspn( part, "/" );
+    }
+    return true;
+}
+
+/**
+    Read the list of files from a manifest, one path per line.
+    @param batch the batch
+    @param fp the manifest
+    @return false if the batch ran out of memory
+*/
+static bool readManifest( Batch *batch, FILE *fp )
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    bool ok = true;
+
+    while ( ok && ( len = getline( &line, &capacity, fp ) ) >= 0 ) {
+        if ( len > 0 && line[ len - 1 ] == '\n' ) {
+            line[ --len ] = '\0';
+        }
+        if ( len == 0 ) {
+            continue;
+        }
+
+        char const *rel = line + strspn( line, "/" );
+        if ( !staysInside( rel ) || *rel == '\0' ) {
+            fprintf( stderr, "%s: Path leaves the output directory\n", line );
+            batch->failed = true;
+            continue;
+        }
+
+        char *outPath = joinPath( batch->opts->outputFile, rel );
+        ok = outPath != NULL && addFile( batch, line, outPath );
+    }
+
+    free( line );
+    return ok;
+}
+
+/**
+    Add every regular file under a directory to the batch, searching
+    subdirectories too. Symbolic links are not followed.
+    @param batch the batch
+    @param root the directory given on the command line
+    @param rel path of the directory to search, relative to root, or ""
+    @return false if the batch ran out of memory
+*/
+static bool walkDirectory( Batch *batch, char const *root, char const *rel )
+{
+    char *dirPath = *rel == '\0' ? strdup( root ) : joinPath( root, rel );
+    if ( dirPath == NULL ) {
+        return false;
+    }
+
+    DIR *dir = opendir( dirPath );
+    if ( dir == NULL ) {
+        perror( dirPath );
+        batch->failed = true;
+        free( dirPath );
+        return true;
+    }
+
+    bool ok = true;
+    struct dirent *entry;
+    while ( ok && ( entry = readdir( dir ) ) != NULL ) {
+        if ( strcmp( entry->d_name, "." ) == 0 || strcmp( entry->d_name, ".." ) == 0 ) {
+            continue;
+        }
+
+        char *entryRel = *rel == '\0' ? strdup( entry->d_name ) : joinPath( rel, entry->d_name );
+        char *entryPath = entryRel == NULL ? NULL : joinPath( root, entryRel );
+        if ( entryPath == NULL ) {
+            free( entryRel );
+            ok = false;
+            break;
+        }
+
+        unsigned char type = entry->d_type;
+        if ( type == DT_UNKNOWN ) {
+            struct stat st;
+            type = lstat( entryPath, &st ) != 0 ? DT_UNKNOWN
+                 : S_ISDIR( st.st_mode ) ? DT_DIR
+                 : S_ISREG( st.st_mode ) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if ( type == DT_DIR ) {
+            ok = walkDirectory( batch, root, entryRel );
+        } else if ( type == DT_REG ) {
+            char *outPath = joinPath( batch->opts->outputFile, entryRel );
+            ok = outPath != NULL && addFile( batch, entryPath, outPath );
+        }
+
+        free( entryPath );
+        free( entryRel );
+    }
+
+    closedir( dir );
+    free( dirPath );
+    return ok;
+}
+
+/**
+    Report whether each chunk's output has a fixed place, so the chunks
+    of a file can be done in any order. CBC encryption chains every
+    block to the one before, and decrypted ECB blocks lose their
+    padding, so the place of each chunk's output depends on the ones
+    before.
+    @param batch the batch
+    @return true if files can be split into chunks
+*/
+static bool canSplit( Batch const *batch )
+{
+    CipherMode mode = desContextMode( batch->ctx );
+    return batch->decrypt ? mode != MODE_ECB : mode != MODE_CBC;
+}
+
+/**
+    Turn the files into tasks and share them out between the workers'
+    queues, giving each worker a run of tasks of about the same cost.
+    @param batch the batch
+    @return false if there isn't enough memory
+*/
+static bool planTasks( Batch *batch )
+{
+    // Every file makes at most one task per chunk
+    size_t most = 0;
+    for ( size_t i = 0; i < batch->fileCount; i++ ) {
+        most += batch->files[ i ].chunkCount;
+    }
+    batch->tasks = malloc( ( most > 0 ? most : 1 ) * sizeof( BatchTask ) );
+    if ( batch->tasks == NULL ) {
+        return false;
+    }
+
+    uint64_t totalCost = 0;
+    BatchTask *group = NULL;
+    off_t groupBytes = 0;
+    for ( size_t i = 0; i < batch->fileCount; i++ ) {
+        BatchFile *file = &batch->files[ i ];
+        file->split = file->chunkCount > 1 && canSplit( batch );
+        totalCost += file->size + BATCH_FILE_COST;
+
+        if ( file->split ) {
+            for ( size_t c = 0; c < file->chunkCount; c++ ) {
+                batch->tasks[ batch->taskCount++ ] = (BatchTask) { i, 1, c };
+            }
+            pthread_mutex_init( &file->lock, NULL );
+            group = NULL;
+            continue;
+        }
+
+        // Whole files join the group before if there's room
+        if ( group != NULL && group->fileCount < BATCH_GROUP_FILES &&
+             groupBytes + file->size <= (off_t) batch->chunkBytes ) {
+            group->fileCount++;
+            groupBytes += file->size;
+        } else {
+            group = &batch->tasks[ batch->taskCount++ ];
+            *group = (BatchTask) { i, 1, 0 };
+            groupBytes = file->size;
+        }
+    }
+
+    batch->queues = malloc( batch->workerCount * sizeof( TaskQueue ) );
+    if ( batch->queues == NULL ) {
+        return false;
+    }
+
+    // Cut the list of tasks where the running cost passes each share
+    uint64_t cost = 0;
+    size_t next = 0;
+    for ( int w = 0; w < batch->workerCount; w++ ) {
+        TaskQueue *queue = &batch->queues[ w ];
+        pthread_mutex_init( &queue->lock, NULL );
+        queue->head = next;
+
+        uint64_t share = totalCost * ( w + 1 ) / batch->workerCount;
+        while ( next < batch->taskCount && ( cost < share || w == batch->workerCount - 1 ) ) {
+            BatchTask const *task = &batch->tasks[ next++ ];
+            for ( size_t f = task->file; f < task->file + task->fileCount; f++ ) {
+                BatchFile const *file = &batch->files[ f ];
+                cost += file->split ? ( file->size + BATCH_FILE_COST ) / file->chunkCount
+                                    : file->size + BATCH_FILE_COST;
+            }
+        }
+        queue->tail = next;
+    }
+
+    return true;
+}
+
+/**
+    Take the next task for a worker: the first one left in its own
+    queue, or failing that the last one left in another worker's.
+    @param batch the batch
+    @param index index of the worker
+    @param task where to store the task
+    @return false if there are no tasks left anywhere
+*/
+static bool takeTask( Batch *batch, int index, BatchTask *task )
+{
+    TaskQueue *own = &batch->queues[ index ];
+    pthread_mutex_lock( &own->lock );
+    bool found = own->head < own->tail;
+    if ( found ) {
+        *task = batch->tasks[ own->head++ ];
+    }
+    pthread_mutex_unlock( &own->lock );
+
+    // Tasks are never added, so one pass over the others is enough
+    for ( int i = 1; !found && i < batch->workerCount; i++ ) {
+        TaskQueue *victim = &batch->queues[ ( index + i ) % batch->workerCount ];
+        pthread_mutex_lock( &victim->lock );
+        found = victim->head < victim->tail;
+        if ( found ) {
+            *task = batch->tasks[ --victim->tail ];
+        }
+        pthread_mutex_unlock( &victim->lock );
+    }
+
+    return found;
+}
+
+/**
+    Create the directories leading up to a path, as mkdir -p does.
+    @param path the path of a file
+*/
+static void makeParents( char const *path )
+{
+    char *copy = strdup( path );
+    if ( copy == NULL ) {
+        return;
+    }
+
+    for ( char *slash = strchr( copy + 1, '/' ); slash != NULL; slash = strchr( slash + 1, '/' ) ) {
+        *slash = '\0';
+        mkdir( copy, 0777 );
+        *slash = '/';
+    }
+    free( copy );
+}
+
+/**
+    Open the input and output of a file and handle the header for modes
+    that have one. The directories for the output are only created if
+    opening it fails without them.
+    @param batch the batch
+    @param file the file, which gets its descriptors and nonce
+    @return true if successful, false after printing an error message
+*/
+static bool openBatchFile( Batch *batch, BatchFile *file )
+{
+    StatsMark mark;
+    statsBegin( &mark );
+    file->inFd = open( file->inPath, O_RDONLY );
+    if ( file->inFd < 0 ) {
+        perror( file->inPath );
+        return false;
+    }
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    file->outFd = open( file->outPath, flags, 0666 );
+    if ( file->outFd < 0 && errno == ENOENT ) {
+        makeParents( file->outPath );
+        file->outFd = open( file->outPath, flags, 0666 );
+    }
+    statsEnd( PHASE_OPEN, &mark );
+    if ( file->outFd < 0 ) {
+        perror( file->outPath );
+        close( file->inFd );
+        file->inFd = -1;
+        return false;
+    }
+
+    CipherMode mode = desContextMode( batch->ctx );
+    if ( mode == MODE_ECB ) {
+        return true;
+    }
+
+    if ( batch->decrypt ) {
+        statsBegin( &mark );
+        int headerFlags;
+        bool ok = readHeader( file->inFd, mode, &file->nonce, &headerFlags );
+        statsEnd( PHASE_READ, &mark );
+        if ( !ok ) {
+            fprintf( stderr, "%s: Invalid header\n", file->inPath );
+        } else if ( headerFlags != 0 ) {
+            fprintf( stderr, "%s: Compressed and indexed files can't be batch decrypted\n",
+                     file->inPath );
+            ok = false;
+        }
+        return ok;
+    }
+
+    byte nonce[ BLOCK_BYTES ];
+    if ( !randomBytes( nonce, sizeof( nonce ) ) ) {
+        perror( "getrandom" );
+        return false;
+    }
+    file->nonce = loadBlock64( nonce );
+
+    statsBegin( &mark );
+    bool ok = writeHeader( file->outFd, mode, file->nonce, 0 );
+    statsEnd( PHASE_WRITE, &mark );
+    if ( !ok ) {
+        perror( file->outPath );
+    }
+    return ok;
+}
+
+/**
+    Close the descriptors of a file, removing the output if the file
+    failed.
+    @param file the file
+    @param failed true if the file failed
+*/
+static void closeBatchFile( BatchFile *file, bool failed )
+{
+    StatsMark mark;
+    statsBegin( &mark );
+    if ( file->inFd >= 0 ) {
+        close( file->inFd );
+    }
+    if ( file->outFd >= 0 ) {
+        close( file->outFd );
+        if ( failed ) {
+            unlink( file->outPath );
+        }
+    }
+    file->inFd = -1;
+    file->outFd = -1;
+    statsEnd( PHASE_CLOSE, &mark );
+}
+
+/**
+    Read a chunk of a file, run it through a stream and write the
+    output.
+    @param batch the batch
+    @param file the file, already open
+    @param stream the stream, positioned at the chunk
+    @param buffer room for a chunk and a block of padding
+    @param outPos where the chunk's output goes, moved past it
+    @return true if successful, false after printing an error message
+*/
+static bool cryptChunk( Batch *batch, BatchFile *file, DESStream *stream, byte *buffer,
+                        off_t *outPos )
+{
+    uint64_t pos = stream->pos;
+    size_t len = file->size - pos < (off_t) batch->chunkBytes ? file->size - pos
+                                                              : batch->chunkBytes;
+    bool last = pos + len == (uint64_t) file->size;
+
+    StatsMark mark;
+    statsBegin( &mark );
+    bool ok = readAt( file->inFd, buffer, len, batch->inStart + pos ) == (ssize_t) len;
+    statsEnd( PHASE_READ, &mark );
+    if ( !ok ) {
+        perror( file->inPath );
+        return false;
+    }
+
+    statsBegin( &mark );
+    size_t outLen = desStreamCrypt( batch->ctx, stream, buffer, buffer, len, last );
+    statsEnd( PHASE_CIPHER, &mark );
+    if ( outLen == DES_INVALID ) {
+        fprintf( stderr, "%s: Invalid padding\n", file->inPath );
+        return false;
+    }
+
+    statsBegin( &mark );
+    ok = writeAt( file->outFd, buffer, outLen, *outPos );
+    statsEnd( PHASE_WRITE, &mark );
+    if ( !ok ) {
+        perror( file->outPath );
+        return false;
+    }
+
+    statsBytes( len, outLen );
+    *outPos += outLen;
+    return true;
+}
+
+/**
+    Process a whole file, a chunk at a time in order.
+    @param batch the batch
+    @param file the file
+    @param buffer room for a chunk and a block of padding
+    @return true if successful
+*/
+static bool cryptWholeFile( Batch *batch, BatchFile *file, byte *buffer )
+{
+    bool ok = openBatchFile( batch, file );
+
+    DESStream stream;
+    desStreamInit( &stream, batch->decrypt, file->nonce );
+    off_t outPos = batch->outStart;
+    for ( size_t c = 0; ok && c < file->chunkCount; c++ ) {
+        ok = cryptChunk( batch, file, &stream, buffer, &outPos );
+    }
+
+    closeBatchFile( file, !ok );
+    return ok;
+}
+
+/**
+    Report whether groups of whole files are encrypted side by side.
+    CBC encryption can't split a file, but files don't chain into one
+    another, so a group of them can share the cipher a block at a time.
+    @param batch the batch
+    @return true if groups are interleaved
+*/
+static bool interleavesGroups( Batch const *batch )
+{
+    return !batch->decrypt && desContextMode( batch->ctx ) == MODE_CBC;
+}
+
+/**
+    Encrypt a group of whole files in CBC mode side by side. Every file
+    that opens is read into its own part of one buffer, the group goes
+    through desCbcEncryptMany() together, and each file is written
+    back out. A group never holds more than a chunk of data.
+    @param batch the batch
+    @param task the group
+    @return true if every file in the group was encrypted
+*/
+static bool cryptGroup( Batch *batch, BatchTask const *task )
+{
+    BatchFile *files[ BATCH_GROUP_FILES ];
+    byte *data[ BATCH_GROUP_FILES ];
+    byte const *plain[ BATCH_GROUP_FILES ];
+    uint64_t ivs[ BATCH_GROUP_FILES ];
+    size_t lens[ BATCH_GROUP_FILES ];
+
+    size_t total = 0;
+    for ( size_t f = 0; f < task->fileCount; f++ ) {
+        total += desOutputBound( batch->ctx, false, batch->files[ task->file + f ].size );
+    }
+    byte *buffer = poolTake( total, batch->opts->hugePages );
+    if ( buffer == NULL ) {
+        perror( "chunk buffer" );
+        return false;
+    }
+
+    // Files that don't open or read drop out of the group
+    bool ok = true;
+    int count = 0;
+    byte *at = buffer;
+    for ( size_t f = 0; f < task->fileCount; f++ ) {
+        BatchFile *file = &batch->files[ task->file + f ];
+        bool fileOk = openBatchFile( batch, file );
+        if ( fileOk ) {
+            StatsMark mark;
+            statsBegin( &mark );
+            fileOk = readAt( file->inFd, at, file->size, batch->inStart ) == (ssize_t) file->size;
+            statsEnd( PHASE_READ, &mark );
+            if ( !fileOk ) {
+                perror( file->inPath );
+            }
+        }
+        if ( !fileOk ) {
+            closeBatchFile( file, true );
+            ok = false;
+            continue;
+        }
+
+        files[ count ] = file;
+        data[ count ] = at;
+        plain[ count ] = at;
+        ivs[ count ] = file->nonce;
+        lens[ count ] = file->size;
+        at += desOutputBound( batch->ctx, false, file->size );
+        count++;
+    }
+
+    StatsMark mark;
+    statsBegin( &mark );
+    bool ciphered = desCbcEncryptMany( batch->ctx, count, ivs, data, plain, lens );
+    statsEnd( PHASE_CIPHER, &mark );
+    if ( !ciphered ) {
+        perror( "batch" );
+        ok = false;
+    }
+
+    for ( int i = 0; i < count; i++ ) {
+        size_t outLen = desOutputBound( batch->ctx, false, lens[ i ] );
+        bool fileOk = ciphered;
+        if ( fileOk ) {
+            statsBegin( &mark );
+            fileOk = writeAt( files[ i ]->outFd, data[ i ], outLen, batch->outStart );
+            statsEnd( PHASE_WRITE, &mark );
+            if ( fileOk ) {
+                statsBytes( lens[ i ], outLen );
+            } else {
+                perror( files[ i ]->outPath );
+                ok = false;
+            }
+        }
+        closeBatchFile( files[ i ], !fileOk );
+    }
+
+    poolGive( buffer, total );
+    return ok;
+}
+
+/**
+    Process one chunk of a split file. The first chunk to get there
+    opens the file and the last one to finish closes it.
+    @param batch the batch
+    @param file the file
+    @param chunk index of the chunk
+    @param buffer room for a chunk and a block of padding
+    @return true if successful
+*/
+static bool cryptSplitChunk( Batch *batch, BatchFile *file, size_t chunk, byte *buffer )
+{
+    pthread_mutex_lock( &file->lock );
+    if ( !file->opened ) {
+        file->opened = true;
+        file->failed = !openBatchFile( batch, file );
+    }
+    bool ok = !file->failed;
+    pthread_mutex_unlock( &file->lock );
+
+    if ( ok ) {
+        uint64_t pos = (uint64_t) chunk * batch->chunkBytes;
+        DESStream stream;
+        desStreamInit( &stream, batch->decrypt, file->nonce );
+        stream.pos = pos;
+
+        // CBC chunks chain from the last ciphertext block of the chunk
+        // before, which is still there in the input file
+        if ( batch->decrypt && desContextMode( batch->ctx ) == MODE_CBC && pos > 0 ) {
+            byte block[ BLOCK_BYTES ];
+            ok = readAt( file->inFd, block, BLOCK_BYTES,
+                         batch->inStart + pos - BLOCK_BYTES ) == BLOCK_BYTES;
+            if ( ok ) {
+                stream.chain = loadBlock64( block );
+            } else {
+                perror( file->inPath );
+            }
+        }
+
+        // Every chunk but the last is whole blocks in and out, so its
+        // output starts where its input does
+        off_t outPos = batch->outStart + pos;
+        ok = ok && cryptChunk( batch, file, &stream, buffer, &outPos );
+    }
+
+    pthread_mutex_lock( &file->lock );
+    file->failed = file->failed || !ok;
+    bool failed = file->failed;
+    bool done = ++file->chunksDone == file->chunkCount;
+    pthread_mutex_unlock( &file->lock );
+
+    if ( done ) {
+        closeBatchFile( file, failed );
+    }
+    return ok;
+}
+
+/**
+    Body of each worker thread. It runs tasks until there are none left
+    in any queue.
+    @param arg the BatchWorker
+    @return NULL
+*/
+static void *batchWorker( void *arg )
+{
+    BatchWorker *worker = arg;
+    Batch *batch = worker->batch;
+    statsThread( "batch", worker->index );
+
+    byte *buffer = poolTake( batch->chunkBytes + BLOCK_BYTES, batch->opts->hugePages );
+    if ( buffer == NULL ) {
+        perror( "chunk buffer" );
+        __atomic_store_n( &batch->failed, true, __ATOMIC_RELAXED );
+        return NULL;
+    }
+
+    BatchTask task;
+    while ( takeTask( batch, worker->index, &task ) ) {
+        bool ok = true;
+        if ( task.fileCount > 1 && interleavesGroups( batch ) ) {
+            ok = cryptGroup( batch, &task );
+        } else {
+            for ( size_t f = task.file; f < task.file + task.fileCount; f++ ) {
+                BatchFile *file = &batch->files[ f ];
+                bool fileOk = file->split ? cryptSplitChunk( batch, file, task.chunk, buffer )
+                                          : cryptWholeFile( batch, file, buffer );
+                ok = ok && fileOk;
+            }
+        }
+        if ( !ok ) {
+            __atomic_store_n( &batch->failed, true, __ATOMIC_RELAXED );
+        }
+    }
+
+    poolGive( buffer, batch->chunkBytes + BLOCK_BYTES );
+    return NULL;
+}
+
+/**
+    Run the tasks on the worker threads.
+    @param batch the batch, with its tasks planned
+    @return false if no worker could be started
+*/
+static bool runWorkers( Batch *batch )
+{
+    BatchWorker *workers = malloc( batch->workerCount * sizeof( BatchWorker ) );
+    if ( workers == NULL ) {
+        perror( "batch" );
+        return false;
+    }
+
+    // Workers that don't start leave their tasks for the others to steal
+    int started = 0;
+    for ( int w = 0; w < batch->workerCount; w++ ) {
+        workers[ w ] = (BatchWorker) { .batch = batch, .index = w };
+        if ( pthread_create( &workers[ w ].thread, NULL, batchWorker, &workers[ w ] ) == 0 ) {
+            workers[ started++ ] = workers[ w ];
+        }
+    }
+
+    if ( started == 0 ) {
+        fprintf( stderr, "Can't start worker threads\n" );
+    }
+    for ( int w = 0; w < started; w++ ) {
+        pthread_join( workers[ w ].thread, NULL );
+    }
+
+    free( workers );
+    return started > 0;
+}
+
+/**
+    Free everything the batch allocated.
+    @param batch the batch
+*/
+static void freeBatch( Batch *batch )
+{
+    for ( size_t i = 0; i < batch->fileCount; i++ ) {
+        if ( batch->files[ i ].split ) {
+            pthread_mutex_destroy( &batch->files[ i ].lock );
+        }
+        free( batch->files[ i ].inPath );
+        free( batch->files[ i ].outPath );
+    }
+    free( batch->files );
+    free( batch->tasks );
+    if ( batch->queues != NULL ) {
+        for ( int w = 0; w < batch->workerCount; w++ ) {
+            pthread_mutex_destroy( &batch->queues[ w ].lock );
+        }
+    }
+    free( batch->queues );
+}
+
+bool cryptBatch( Options const *opts, DESContext const *ctx, bool decrypt )
+{
+    bool header = desContextMode( ctx ) != MODE_ECB;
+    Batch batch = {
+        .opts = opts,
+        .ctx = ctx,
+        .decrypt = decrypt,
+        .inStart = header && decrypt ? HEADER_BYTES : 0,
+        .outStart = header && !decrypt ? HEADER_BYTES : 0,
+        .chunkBytes = ( opts->chunkBytes + BLOCK_BYTES - 1 ) / BLOCK_BYTES * BLOCK_BYTES,
+        .workerCount = opts->threads,
+    };
+    statsPath( "batch" );
+
+    if ( isStdio( opts->outputFile ) ) {
+        fprintf( stderr, "Batch output must be a directory\n" );
+        return false;
+    }
+
+    bool ok;
+    struct stat st;
+    if ( !isStdio( opts->inputFile ) && stat( opts->inputFile, &st ) == 0 &&
+         S_ISDIR( st.st_mode ) ) {
+        ok = walkDirectory( &batch, opts->inputFile, "" );
+    } else {
+        FILE *manifest = openFile( opts->inputFile, "r" );
+        if ( manifest == NULL ) {
+            perror( opts->inputFile );
+            return false;
+        }
+        ok = readManifest( &batch, manifest );
+        if ( !isStdio( opts->inputFile ) ) {
+            fclose( manifest );
+        }
+    }
+
+    if ( !ok || !planTasks( &batch ) ) {
+        perror( "batch" );
+        ok = false;
+    }
+    ok = ok && runWorkers( &batch );
+
+    freeBatch( &batch );
+    return ok && !batch.failed;
+}
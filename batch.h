@@ -0,0 +1,48 @@
+/**
+    @file batch.h
+    @author John Butterfield (jpbutte2)
+    Header for the batch component. With --batch, the encrypt and
+    decrypt programs process a whole list of files in one run, on a
+    pool of worker threads that steal work from each other.
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include "options.h"
+#include "DESContext.h"
+
+/** Most small files grouped together into one task. */
+#define BATCH_GROUP_FILES 64
+
+/** What opening and closing a file is taken to cost, in bytes of
+    data, when sharing the tasks out between workers. */
+#define BATCH_FILE_COST 16384
+
+/**
+    This function encrypts or decrypts every file named by the batch
+    input into the output directory. opts->inputFile is either a
+    directory, which is walked for regular files, or a manifest listing
+    one input file per line; opts->outputFile is the directory each
+    output goes to, under the same relative path as its input. Leading
+    slashes are dropped from manifest entries, and entries with a ".."
+    component are refused.
+    The files are planned into tasks up front: files that are larger
+    than opts->chunkBytes, in modes where each chunk's output has a
+    fixed place, are split into one task per chunk, and small files
+    are grouped together, so a task is never much less than a chunk of
+    work. Each of the opts->threads workers starts with an equal share
+    of the tasks in its own queue, takes tasks from the front of it,
+    and when it runs dry steals from the back of another worker's.
+    A file that fails is reported and its output removed, and the rest
+    carry on.
+    @param opts the parsed command line
+    @param ctx the key and mode to use
+    @param decrypt true to decrypt, false to encrypt
+    @return true if every file was processed, false after printing an
+    error message for each one that wasn't
+*/
+bool cryptBatch( Options const *opts, DESContext const *ctx, bool decrypt );
+
+#endif
@@ -0,0 +1,166 @@
+/**
+    @file container.c
+    @author John Butterfield (jpbutte2)
+    Container component. The index is checked as a whole when it is
+    read, so the code decrypting the chunks can trust every position in
+    it, and only has to check each frame header against its entry.
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include "container.h"
+#include "frame.h"
+#include "io.h"
+#include "DESPerm.h"
+
+/** Magic number at the end of the trailer. */
+static byte const trailerMagic[ BLOCK_BYTES ] = { 'D', 'E', 'S', 'I', 'N', 'D', 'E', 'X' };
+
+/** Position of the number of keys in the parameters. */
+#define PARAMS_KEYS_POS 4
+
+/** Position of the plaintext length in the parameters. */
+#define PARAMS_LENGTH_POS 8
+
+/** Position of the plaintext length in the trailer. */
+#define TRAILER_LENGTH_POS 8
+
+/** Position of the magic number in the trailer. */
+#define TRAILER_MAGIC_POS 16
+
+void encodeIndexParams( byte data[ INDEX_PARAMS_BYTES ], IndexParams const *params )
+{
+    memset( data, 0, INDEX_PARAMS_BYTES );
+    storeBlock64( data, (uint64_t) params->chunkBytes << 32 );
+    data[ PARAMS_KEYS_POS ] = params->keys;
+    storeBlock64( data + PARAMS_LENGTH_POS, params->length );
+}
+
+bool decodeIndexParams( byte const data[ INDEX_PARAMS_BYTES ], IndexParams *params )
+{
+    uint64_t first = loadBlock64( data );
+    params->chunkBytes = first >> 32;
+    params->keys = data[ PARAMS_KEYS_POS ];
+    params->length = loadBlock64( data + PARAMS_LENGTH_POS );
+
+    // The three bytes after the number of keys are zero for now
+    return ( first & 0xFFFFFFFFU ) == (uint64_t) params->keys << 24 &&
+           ( params->keys == 1 || params->keys == 3 ) && params->chunkBytes > 0 &&
+           params->chunkBytes % BLOCK_BYTES == 0 && params->chunkBytes <= FRAME_MAX_BYTES;
+}
+
+bool writeIndexParams( int fd, IndexParams const *params )
+{
+    byte data[ INDEX_PARAMS_BYTES ];
+    encodeIndexParams( data, params );
+    return writeAll( fd, data, INDEX_PARAMS_BYTES );
+}
+
+bool readIndexParams( int fd, IndexParams *params )
+{
+    byte data[ INDEX_PARAMS_BYTES ];
+    return readAll( fd, data, INDEX_PARAMS_BYTES ) && decodeIndexParams( data, params );
+}
+
+void encodeTrailer( byte data[ INDEX_TRAILER_BYTES ], uint64_t chunks, uint64_t length )
+{
+    storeBlock64( data, chunks );
+    storeBlock64( data + TRAILER_LENGTH_POS, length );
+    memcpy( data + TRAILER_MAGIC_POS, trailerMagic, sizeof( trailerMagic ) );
+}
+
+bool decodeTrailer( byte const data[ INDEX_TRAILER_BYTES ], uint64_t *chunks, uint64_t *length )
+{
+    *chunks = loadBlock64( data );
+    *length = loadBlock64( data + TRAILER_LENGTH_POS );
+    return memcmp( data + TRAILER_MAGIC_POS, trailerMagic, sizeof( trailerMagic ) ) == 0 &&
+           *length != LENGTH_UNKNOWN;
+}
+
+uint64_t indexChunkCount( IndexParams const *params, uint64_t length )
+{
+    return length / params->chunkBytes + ( length % params->chunkBytes != 0 );
+}
+
+size_t indexChunkBytes( IndexParams const *params, uint64_t chunk )
+{
+    uint64_t pos = chunk * params->chunkBytes;
+    return params->length - pos < params->chunkBytes ? params->length - pos
+                                                      : params->chunkBytes;
+}
+
+/**
+    Read exactly len bytes from a position in a file.
+    @param fd descriptor of the file
+    @param data where to store the bytes
+    @param len number of bytes
+    @param offset position of the first byte
+    @return false with errno set if reading failed, or with errno zero
+    if the file ended first
+*/
+static bool readExactly( int fd, byte *data, size_t len, off_t offset )
+{
+    ssize_t got = readAt( fd, data, len, offset );
+    if ( got >= 0 ) {
+        errno = 0;
+    }
+    return got == (ssize_t) len;
+}
+
+bool readIndex( int fd, off_t size, off_t start, IndexParams *params, uint64_t **offsets,
+                uint64_t *chunks )
+{
+    byte trailer[ INDEX_TRAILER_BYTES ];
+    uint64_t length;
+    off_t least = start + FRAME_HEADER_BYTES + INDEX_TRAILER_BYTES;
+    if ( size < least || !readExactly( fd, trailer, sizeof( trailer ), size - sizeof( trailer ) ) ||
+         !decodeTrailer( trailer, chunks, &length ) ) {
+        return false;
+    }
+
+    // The header only has the length if it was known up front
+    errno = 0;
+    if ( ( params->length != LENGTH_UNKNOWN && params->length != length ) ||
+         *chunks != indexChunkCount( params, length ) ||
+         *chunks > (uint64_t) ( size - least ) / INDEX_ENTRY_BYTES ) {
+        return false;
+    }
+    params->length = length;
+
+    // The end marker and the index are read in one go, and the marker
+    // takes the last entry, as the end of the last frame
+    size_t entries = *chunks + 1;
+    off_t marker = size - INDEX_TRAILER_BYTES - *chunks * INDEX_ENTRY_BYTES - FRAME_HEADER_BYTES;
+    byte *data = malloc( entries * INDEX_ENTRY_BYTES );
+    *offsets = malloc( entries * sizeof( uint64_t ) );
+    if ( data == NULL || *offsets == NULL ||
+         !readExactly( fd, data, entries * INDEX_ENTRY_BYTES, marker ) ) {
+        free( data );
+        free( *offsets );
+        return false;
+    }
+
+    bool ok = loadBlock64( data ) == 0;
+    for ( size_t i = 0; i < *chunks; i++ ) {
+        ( *offsets )[ i ] = loadBlock64( data + ( i + 1 ) * INDEX_ENTRY_BYTES );
+    }
+    ( *offsets )[ *chunks ] = marker;
+    free( data );
+
+    // Frames start right after the header and follow one another with
+    // no gaps, each no bigger than a frame for a whole chunk
+    uint64_t pos = start;
+    for ( size_t i = 0; ok && i < *chunks; i++ ) {
+        uint64_t span = ( *offsets )[ i + 1 ] - ( *offsets )[ i ];
+        ok = ( *offsets )[ i ] == pos && ( *offsets )[ i + 1 ] > pos &&
+             span > FRAME_HEADER_BYTES && span <= frameBound( params->chunkBytes );
+        pos = ( *offsets )[ i + 1 ];
+    }
+    ok = ok && pos == (uint64_t) marker;
+
+    if ( !ok ) {
+        free( *offsets );
+        errno = 0;
+    }
+    return ok;
+}
@@ -0,0 +1,146 @@
+/**
+    @file container.h
+    @author John Butterfield (jpbutte2)
+    Header for the container component, which reads and writes the
+    metadata of indexed files. An indexed file has the HEADER_INDEXED
+    flag in its file header, which is then followed by the parameters
+    of the file: the chunk size, the number of keys and the exact
+    length of the plaintext. The plaintext is split into chunks of the
+    chunk size, the last one shorter, and each chunk is stored as a
+    frame, as frame.h describes. After the last frame come an end
+    marker of FRAME_HEADER_BYTES zero bytes, an index holding the
+    8-byte big-endian file position of each frame, and a trailer with
+    the number of chunks and the plaintext length. Reading the trailer
+    and index is enough to find any chunk, or to tell that the file
+    has been cut short, without reading any of the frames.
+*/
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "DES.h"
+
+/** Number of bytes of parameters after the file header of an indexed
+    file: a 4-byte chunk size, a byte with the number of keys, three
+    zero bytes and the 8-byte plaintext length, all big-endian. */
+#define INDEX_PARAMS_BYTES 16
+
+/** Number of bytes in the trailer at the end of an indexed file: the
+    8-byte number of chunks, the 8-byte plaintext length and an 8-byte
+    magic number. */
+#define INDEX_TRAILER_BYTES 24
+
+/** Number of bytes in each entry of the index. */
+#define INDEX_ENTRY_BYTES 8
+
+/** Plaintext length in the parameters when it wasn't known before
+    the file was written, as when encrypting a pipe. The trailer
+    always has it. */
+#define LENGTH_UNKNOWN UINT64_MAX
+
+/** Parameters of an indexed file, which don't depend on how it was
+    encrypted, only on what it holds. */
+typedef struct {
+  /** Number of plaintext bytes in every chunk but the last, a whole
+      number of blocks. */
+  size_t chunkBytes;
+
+  /** Number of keys: 1 for DES, 3 for triple DES. */
+  int keys;
+
+  /** Number of plaintext bytes, or LENGTH_UNKNOWN. */
+  uint64_t length;
+} IndexParams;
+
+/**
+    This function fills in the parameters that follow the file header.
+    @param data where to store them
+    @param params the parameters
+*/
+void encodeIndexParams( byte data[ INDEX_PARAMS_BYTES ], IndexParams const *params );
+
+/**
+    This function gets the parameters that follow the file header.
+    @param data the parameters as stored
+    @param params where to store them
+    @return false if they are out of range
+*/
+bool decodeIndexParams( byte const data[ INDEX_PARAMS_BYTES ], IndexParams *params );
+
+/**
+    This function writes the parameters at the current position of a
+    file descriptor, just after the file header.
+    @param fd descriptor of the file
+    @param params the parameters
+    @return true if successful
+*/
+bool writeIndexParams( int fd, IndexParams const *params );
+
+/**
+    This function reads the parameters from the current position of a
+    file descriptor, which may be a pipe, just after the file header.
+    @param fd descriptor of the file
+    @param params where to store them
+    @return false if they couldn't be read or are out of range
+*/
+bool readIndexParams( int fd, IndexParams *params );
+
+/**
+    This function fills in the trailer at the end of an indexed file.
+    @param data where to store it
+    @param chunks number of chunks in the file
+    @param length number of plaintext bytes
+*/
+void encodeTrailer( byte data[ INDEX_TRAILER_BYTES ], uint64_t chunks, uint64_t length );
+
+/**
+    This function checks the trailer at the end of an indexed file and
+    gets what it holds.
+    @param data the trailer
+    @param chunks where to store the number of chunks
+    @param length where to store the number of plaintext bytes
+    @return false if it isn't a trailer
+*/
+bool decodeTrailer( byte const data[ INDEX_TRAILER_BYTES ], uint64_t *chunks, uint64_t *length );
+
+/**
+    This function returns the number of chunks plaintext of a given
+    length is split into.
+    @param params the parameters of the file
+    @param length number of plaintext bytes
+    @return number of chunks
+*/
+uint64_t indexChunkCount( IndexParams const *params, uint64_t length );
+
+/**
+    This function returns the number of plaintext bytes in a chunk.
+    @param params the parameters of the file, with the length known
+    @param chunk index of the chunk
+    @return number of plaintext bytes in it
+*/
+size_t indexChunkBytes( IndexParams const *params, uint64_t chunk );
+
+/**
+    This function reads the trailer and index of an indexed file and
+    checks that they agree with each other, with the parameters and
+    with the size of the file, so a file that has been cut short or
+    added to is caught here.
+    @param fd descriptor of the file
+    @param size size of the file
+    @param start file position of the first frame
+    @param params the parameters from the header; a LENGTH_UNKNOWN
+    length is filled in from the trailer
+    @param offsets where to store a new array of the file position of
+    each frame, with one more entry for the end marker, to be freed
+    by the caller
+    @param chunks where to store the number of chunks
+    @return false with errno set if reading failed, or with errno zero
+    if the index isn't valid
+*/
+bool readIndex( int fd, off_t size, off_t start, IndexParams *params, uint64_t **offsets,
+                uint64_t *chunks );
+
+#endif
@@ -0,0 +1,2196 @@
+/**
+    @file driver.c
+    @author John Butterfield (jpbutte2)
+    Driver component shared by the encrypt and decrypt programs. Files
+    are either streamed through the chunk reader and writer, mapped
+    into memory a window at a time so the cipher can work straight from
+    one mapping into the other, split into chunks that a pool of
+    worker threads reads and writes with positional I/O, or passed
+    through a pipeline of reader, cipher and writer threads, which
+    works on pipes too. Compressed and indexed data is stored a frame
+    per chunk, and passed through the pipeline, except that indexed
+    files that can be read at any position are decrypted straight from
+    their index by the worker threads.
+*/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "container.h"
+#include "driver.h"
+#include "frame.h"
+#include "io.h"
+#include "pool.h"
+#include "ring.h"
+#include "stats.h"
+#include "uring.h"
+#include "DESPerm.h"
+
+/** Number of frame positions an indexed file being encrypted first
+    gets room for in its index. */
+#define FIRST_OFFSETS 64
+
+/** Outcome of trying to run a job on mapped files or worker threads. */
+typedef enum {
+  /** The job is done. */
+  JOB_DONE,
+
+  /** The files aren't suitable, and nothing has been written yet. */
+  JOB_UNAVAILABLE,
+
+  /** Something went wrong partway through. */
+  JOB_FAILED
+} JobResult;
+
+/** Everything needed to turn input bytes into output bytes. */
+typedef struct {
+  /** The parsed command line. */
+  Options const *opts;
+
+  /** The key and mode of operation to use. */
+  DESContext const *ctx;
+
+  /** True to decrypt, false to encrypt. */
+  bool decrypt;
+
+  /** Nonce or IV from the file header, for modes that have one. */
+  uint64_t nonce;
+
+  /** True if the data is stored as compressed frames. */
+  bool compressed;
+
+  /** True if the data is stored as an indexed file. */
+  bool indexed;
+
+  /** Parameters of an indexed file. */
+  IndexParams params;
+
+  /** Number of header bytes before the data in the input file. */
+  off_t inStart;
+
+  /** Number of header bytes before the data in the output file. */
+  off_t outStart;
+} CryptJob;
+
+/** Work shared by the threads of a parallel job. */
+typedef struct {
+  /** What to do with each chunk. */
+  CryptJob const *job;
+
+  /** Descriptor of the input file. */
+  int inFd;
+
+  /** Descriptor of the output file. */
+  int outFd;
+
+  /** Number of data bytes in the input file, after any header. */
+  off_t size;
+
+  /** Number of input bytes in each chunk, a multiple of BLOCK_BYTES. */
+  size_t chunkBytes;
+
+  /** Number of chunks in the input file. */
+  size_t chunkCount;
+
+  /** Protects the fields below. */
+  pthread_mutex_t lock;
+
+  /** Signalled each time a chunk gets its place in the output. */
+  pthread_cond_t placed;
+
+  /** Number of workers started so far, which numbers them. */
+  int workerCount;
+
+  /** Index of the next chunk to hand to a worker. */
+  size_t nextChunk;
+
+  /** Index of the next chunk to be given a place in the output. */
+  size_t nextPlaced;
+
+  /** Output position for the chunk with index nextPlaced. */
+  off_t outPos;
+
+  /** File position of each frame of an indexed file, and of the end
+      marker after the last; NULL for other files. */
+  uint64_t *offsets;
+
+  /** Set when any worker fails, so the others stop. */
+  bool failed;
+} ParallelJob;
+
+/** One chunk of data on its way through the pipeline. */
+typedef struct {
+  /** Buffer with room for a chunk and a block of padding, or for the
+      payload of a frame. */
+  byte *data;
+
+  /** Size of the data buffer. */
+  size_t dataBytes;
+
+  /** Buffer for the frame made from the chunk, or the plaintext from
+      its frame, when the data is framed; otherwise NULL. */
+  byte *out;
+
+  /** Size of the out buffer. */
+  size_t outBytes;
+
+  /** Index of the chunk in the data, and of its frame. */
+  uint64_t index;
+
+  /** Header of the frame the chunk holds, when decrypting framed
+      data. */
+  byte head[ FRAME_HEADER_BYTES ];
+
+  /** Number of input bytes in the chunk. */
+  size_t len;
+
+  /** Number of output bytes the chunk produced. */
+  size_t outLen;
+
+  /** Position of the chunk in the data. */
+  uint64_t pos;
+
+  /** Last ciphertext block of the chunk before, for CBC decryption. */
+  uint64_t chain;
+
+  /** True for the last chunk of the data. */
+  bool last;
+
+  /** Index of the buffer registered with io_uring, or -1. */
+  int buffer;
+
+  /** File position of an io_uring read or write of the chunk. */
+  off_t offset;
+
+  /** True once an io_uring read of the chunk has finished. */
+  bool ready;
+} PipeChunk;
+
+typedef struct Pipeline Pipeline;
+
+/** A cipher thread of the pipeline and the rings on either side of it. */
+typedef struct {
+  /** Chunks from the reader thread. */
+  Ring in;
+
+  /** Chunks for the writer thread. */
+  Ring out;
+
+  /** The pipeline the thread belongs to. */
+  Pipeline *pipe;
+
+  /** The cipher thread. */
+  pthread_t thread;
+} PipeLane;
+
+/** Work shared by the threads of a pipeline. Chunk i goes from the
+    reader to lane i % laneCount and from there to the writer, so every
+    ring has one producer and one consumer, and the writer gets the
+    chunks back in order just by visiting the lanes in turn. */
+struct Pipeline {
+  /** What to do with each chunk. */
+  CryptJob const *job;
+
+  /** File the reader thread reads from. */
+  FILE *inputFile;
+
+  /** File the writer thread writes to. */
+  FILE *outputFile;
+
+  /** Number of input bytes in each chunk, a multiple of BLOCK_BYTES. */
+  size_t chunkBytes;
+
+  /** Most chunks allowed at once, which keeps the memory bounded. */
+  size_t chunkLimit;
+
+  /** Number of chunks with buffers so far, used only by the reader. */
+  size_t chunkCount;
+
+  /** Room for chunkLimit chunks, whose buffers are taken from the pool
+      as needed. */
+  PipeChunk *chunks;
+
+  /** Chunks the writer is done with, on their way back to the reader. */
+  Ring free;
+
+  /** The cipher threads. */
+  PipeLane *lanes;
+
+  /** Number of cipher threads. */
+  int laneCount;
+
+  /** Sent to lanes that won't get the last chunk, to tell them to stop. */
+  PipeChunk end;
+
+  /** True if the reader and writer use io_uring instead of stdio. */
+  bool uring;
+
+  /** Ring the reader thread reads with. */
+  Uring readRing;
+
+  /** Ring the writer thread writes with. */
+  Uring writeRing;
+
+  /** Descriptor of the input file, for io_uring. */
+  int inFd;
+
+  /** Descriptor of the output file, for io_uring. */
+  int outFd;
+
+  /** Number of data bytes in the input file, for io_uring. */
+  off_t size;
+
+  /** File position of each frame of an indexed file so far, noted by
+      the writer when encrypting and by the reader when decrypting. */
+  uint64_t *offsets;
+
+  /** Number of entries in offsets. */
+  size_t offsetCount;
+
+  /** Number of entries offsets has room for. */
+  size_t offsetRoom;
+
+  /** File position of the next frame of an indexed file. */
+  uint64_t framePos;
+
+  /** Number of plaintext bytes in the frames of an indexed file so far. */
+  uint64_t plainBytes;
+
+  /** True once a frame shorter than a whole chunk has been read, which
+      only the last frame of an indexed file may be. */
+  bool shortFrame;
+
+  /** Set when any thread fails, so the others stop. */
+  bool failed;
+};
+
+/**
+    Round a number of bytes up to a whole number of blocks.
+    @param len number of bytes
+    @return len rounded up to a multiple of BLOCK_BYTES
+*/
+static size_t roundToBlocks( size_t len )
+{
+    return ( len + BLOCK_BYTES - 1 ) / BLOCK_BYTES * BLOCK_BYTES;
+}
+
+/**
+    Report whether the job removes padding, so the amount of output for
+    a piece of the input isn't known until it has been decrypted.
+    @param job the job
+    @return true if the output of each piece has to be placed in order
+*/
+static bool stripsPadding( CryptJob const *job )
+{
+    return job->decrypt && job->opts->mode == MODE_ECB;
+}
+
+/**
+    Report whether the data is stored as frames, because it is
+    compressed, indexed or both.
+    @param job the job
+    @return true if the data is framed
+*/
+static bool isFramed( CryptJob const *job )
+{
+    return job->compressed || job->indexed;
+}
+
+/**
+    Report whether each block of output depends on the output for the
+    block before it, so the job can't be split up. Frames each have
+    their own IV, so they never do.
+    @param job the job
+    @return true if the job has to be done in order
+*/
+static bool isSerial( CryptJob const *job )
+{
+    return !job->decrypt && job->opts->mode == MODE_CBC && !isFramed( job );
+}
+
+/**
+    Encrypt or decrypt len bytes from src into dst. There must be room
+    for desOutputBound() bytes at dst.
+    @param job the job
+    @param dst where the result goes
+    @param src the input bytes
+    @param len number of input bytes
+    @param pos position of src in the data, a multiple of BLOCK_BYTES
+    @param chain the ciphertext block before src, for CBC; updated to
+    the last ciphertext block of this range
+    @param last true if this range is the end of the data
+    @return number of bytes left in dst, or DES_INVALID
+*/
+static size_t cryptRange( CryptJob const *job, byte *dst, byte const *src, size_t len,
+                          uint64_t pos, uint64_t *chain, bool last )
+{
+    DESStream stream = {
+        .decrypt = job->decrypt,
+        .nonce = job->nonce,
+        .pos = pos,
+        .chain = *chain,
+    };
+    size_t outLen = desStreamCrypt( job->ctx, &stream, dst, src, len, last );
+    *chain = stream.chain;
+    return outLen;
+}
+
+/**
+    Run the job by reading and writing the files in chunks.
+    @param job the job
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @return true if successful
+*/
+static bool cryptStreamed( CryptJob const *job, FILE *inputFile, FILE *outputFile )
+{
+    ChunkReader reader;
+    ChunkWriter writer;
+    bool huge = job->opts->hugePages;
+    if ( !openChunkReader( &reader, inputFile, job->opts->chunkBytes, huge ) ||
+         !openChunkWriter( &writer, outputFile, job->opts->chunkBytes, huge ) ) {
+        perror( "chunk buffer" );
+        return false;
+    }
+
+    uint64_t pos = 0;
+    uint64_t chain = job->nonce;
+    bool ok = true;
+    do {
+        // An empty input still gets its end handled, for padding
+        StatsMark mark;
+        statsBegin( &mark );
+        readChunk( &reader );
+        statsEnd( PHASE_READ, &mark );
+        if ( ferror( inputFile ) ) {
+            perror( "read" );
+            ok = false;
+            break;
+        }
+        if ( reader.len == 0 && pos > 0 ) {
+            break;
+        }
+
+        statsBegin( &mark );
+        size_t outLen = cryptRange( job, reader.data, reader.data, reader.len, pos,
+                                    &chain, reader.last );
+        statsEnd( PHASE_CIPHER, &mark );
+        if ( outLen == DES_INVALID ) {
+            fprintf( stderr, "Invalid padding\n" );
+            ok = false;
+            break;
+        }
+
+        statsBegin( &mark );
+        bool written = writeChunk( &writer, reader.data, outLen );
+        statsEnd( PHASE_WRITE, &mark );
+        statsBytes( reader.len, outLen );
+        if ( !written ) {
+            perror( "write" );
+            ok = false;
+            break;
+        }
+        pos += reader.len;
+    } while ( !reader.last );
+
+    // Whatever the writer still holds gets written as it closes
+    StatsMark mark;
+    statsBegin( &mark );
+    closeChunkReader( &reader );
+    bool closed = closeChunkWriter( &writer );
+    statsEnd( PHASE_WRITE, &mark );
+    if ( ok && !closed ) {
+        perror( "write" );
+        ok = false;
+    }
+
+    return ok;
+}
+
+/**
+    Run the job on memory-mapped files, a window at a time, so files
+    bigger than memory work too. Other paths are only tried when the
+    files can't be mapped at all; once the output is known to be a
+    regular file, failing to size or map it is an error, since the
+    file can't be written any other way either.
+    @param job the job
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @return how the attempt turned out
+*/
+static JobResult cryptMapped( CryptJob const *job, FILE *inputFile, FILE *outputFile )
+{
+    off_t size, outputSize;
+    if ( !regularFileSize( inputFile, &size ) || !regularFileSize( outputFile, &outputSize ) ) {
+        return JOB_UNAVAILABLE;
+    }
+    size -= job->inStart;
+
+    // An empty file has nothing to map
+    if ( size == 0 || ( job->opts->mmap == MMAP_AUTO && size < MMAP_AUTO_BYTES ) ) {
+        return JOB_UNAVAILABLE;
+    }
+
+    // A shared writable mapping needs a descriptor open for reading
+    // too, which standard output doesn't have
+    if ( isStdio( job->opts->outputFile ) ) {
+        return JOB_UNAVAILABLE;
+    }
+    int outFd = open( job->opts->outputFile, O_RDWR );
+    if ( outFd < 0 ) {
+        return JOB_UNAVAILABLE;
+    }
+
+    // Decrypted output is at most as long as the input, and gets cut
+    // back to size at the end
+    outputSize = job->outStart + desOutputBound( job->ctx, job->decrypt, size );
+    if ( ftruncate( outFd, outputSize ) != 0 ) {
+        perror( job->opts->outputFile );
+        close( outFd );
+        return JOB_FAILED;
+    }
+
+    int inFd = fileno( inputFile );
+    off_t outPos = job->outStart;
+    uint64_t chain = job->nonce;
+
+    for ( off_t pos = 0; pos < size; pos += MAP_WINDOW_BYTES ) {
+        size_t len = size - pos < MAP_WINDOW_BYTES ? size - pos : MAP_WINDOW_BYTES;
+        size_t outLen = desOutputBound( job->ctx, job->decrypt, len );
+
+        // Pages are faulted in as the cipher touches them, so that time
+        // counts as cipher time
+        StatsMark mark;
+        statsBegin( &mark );
+        byte *src = mapRegion( inFd, job->inStart + pos, len, false );
+        statsEnd( PHASE_READ, &mark );
+        statsBegin( &mark );
+        byte *dst = mapRegion( outFd, outPos, outLen, true );
+        statsEnd( PHASE_WRITE, &mark );
+        if ( src == NULL || dst == NULL ) {
+            perror( "mmap" );
+            close( outFd );
+            return JOB_FAILED;
+        }
+
+        statsBegin( &mark );
+        size_t written = cryptRange( job, dst, src, len, pos, &chain, pos + len == size );
+        statsEnd( PHASE_CIPHER, &mark );
+
+        statsBegin( &mark );
+        unmapRegion( src, job->inStart + pos, len );
+        statsEnd( PHASE_READ, &mark );
+        statsBegin( &mark );
+        unmapRegion( dst, outPos, outLen );
+        statsEnd( PHASE_WRITE, &mark );
+        if ( written == DES_INVALID ) {
+            fprintf( stderr, "Invalid padding\n" );
+            close( outFd );
+            return JOB_FAILED;
+        }
+        statsBytes( len, written );
+        outPos += written;
+    }
+
+    if ( job->decrypt && ftruncate( outFd, outPos ) != 0 ) {
+        perror( job->opts->outputFile );
+        close( outFd );
+        return JOB_FAILED;
+    }
+
+    close( outFd );
+    return JOB_DONE;
+}
+
+/**
+    Mark a parallel job as failed and wake any workers waiting for
+    their turn to be placed.
+    @param work the job that failed
+    @param what name to pass to perror(), or NULL if the error has
+    already been reported
+*/
+static void failJob( ParallelJob *work, char const *what )
+{
+    if ( what != NULL ) {
+        perror( what );
+    }
+
+    pthread_mutex_lock( &work->lock );
+    work->failed = true;
+    pthread_cond_broadcast( &work->placed );
+    pthread_mutex_unlock( &work->lock );
+}
+
+/**
+    Decide where the output of a chunk goes. Usually every chunk but
+    the last produces as much output as it has input, so its place is
+    known up front.
+    Decrypted ECB chunks shrink by however much padding they held, so
+    each chunk waits for the one before it to be placed and starts where
+    it ends. Chunks are handed out in order, so the wait always ends.
+    @param work the job the chunk belongs to
+    @param index index of the chunk
+    @param outLen number of output bytes the chunk produced
+    @param outPos where to store the output position of the chunk
+    @return false if the job failed while waiting
+*/
+static bool placeChunk( ParallelJob *work, size_t index, size_t outLen, off_t *outPos )
+{
+    if ( !stripsPadding( work->job ) ) {
+        *outPos = work->job->outStart + (off_t) index * work->chunkBytes;
+        return true;
+    }
+
+    pthread_mutex_lock( &work->lock );
+    while ( work->nextPlaced != index && !work->failed ) {
+        pthread_cond_wait( &work->placed, &work->lock );
+    }
+
+    bool ok = !work->failed;
+    if ( ok ) {
+        *outPos = work->outPos;
+        work->outPos += outLen;
+        work->nextPlaced++;
+        pthread_cond_broadcast( &work->placed );
+    }
+    pthread_mutex_unlock( &work->lock );
+
+    return ok;
+}
+
+/**
+    Body of each worker thread. Workers take chunks in order until
+    there are none left, then encrypt or decrypt each one in their own
+    buffer and write it to its place in the output.
+    @param arg the ParallelJob the worker belongs to
+    @return NULL
+*/
+static void *cryptWorker( void *arg )
+{
+    ParallelJob *work = arg;
+
+    pthread_mutex_lock( &work->lock );
+    int worker = work->workerCount++;
+    pthread_mutex_unlock( &work->lock );
+    statsThread( "worker", worker );
+
+    byte *data = poolTake( work->chunkBytes, work->job->opts->hugePages );
+    if ( data == NULL ) {
+        failJob( work, "chunk buffer" );
+        return NULL;
+    }
+
+    while ( true ) {
+        pthread_mutex_lock( &work->lock );
+        bool done = work->failed || work->nextChunk == work->chunkCount;
+        size_t index = done ? 0 : work->nextChunk++;
+        pthread_mutex_unlock( &work->lock );
+        if ( done ) {
+            break;
+        }
+
+        off_t pos = (off_t) index * work->chunkBytes;
+        size_t len = work->size - pos < (off_t) work->chunkBytes ? work->size - pos
+                                                                : work->chunkBytes;
+        StatsMark mark;
+        statsBegin( &mark );
+        if ( readAt( work->inFd, data, len, work->job->inStart + pos ) != (ssize_t) len ) {
+            failJob( work, "read" );
+            break;
+        }
+
+        // CBC chunks chain from the last ciphertext block of the chunk
+        // before, which is still there in the input file
+        uint64_t chain = work->job->nonce;
+        if ( work->job->opts->mode == MODE_CBC && pos > 0 ) {
+            byte block[ BLOCK_BYTES ];
+            off_t at = work->job->inStart + pos - BLOCK_BYTES;
+            if ( readAt( work->inFd, block, BLOCK_BYTES, at ) != BLOCK_BYTES ) {
+                failJob( work, "read" );
+                break;
+            }
+            chain = loadBlock64( block );
+        }
+        statsEnd( PHASE_READ, &mark );
+
+        statsBegin( &mark );
+        size_t outLen = cryptRange( work->job, data, data, len, pos, &chain,
+                                    index == work->chunkCount - 1 );
+        statsEnd( PHASE_CIPHER, &mark );
+        if ( outLen == DES_INVALID ) {
+            fprintf( stderr, "Invalid padding\n" );
+            failJob( work, NULL );
+            break;
+        }
+
+        // Waiting for a place counts as writing, since it only happens
+        // when output positions depend on earlier chunks
+        statsBegin( &mark );
+        off_t outPos;
+        if ( !placeChunk( work, index, outLen, &outPos ) ) {
+            break;
+        }
+
+        if ( !writeAt( work->outFd, data, outLen, outPos ) ) {
+            failJob( work, "write" );
+            break;
+        }
+        statsEnd( PHASE_WRITE, &mark );
+        statsBytes( len, outLen );
+    }
+
+    poolGive( data, work->chunkBytes );
+    return NULL;
+}
+
+/**
+    Run the job on a pool of worker threads, each reading a chunk with
+    pread(), running it through the cipher and writing it with pwrite().
+    The output is the same as a single-threaded run. CBC encryption and
+    empty files are left to the other paths.
+    @param job the job
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @return how the attempt turned out
+*/
+static JobResult cryptParallel( CryptJob const *job, FILE *inputFile, FILE *outputFile )
+{
+    off_t size, outputSize;
+    if ( isSerial( job ) || !regularFileSize( inputFile, &size ) ||
+         !regularFileSize( outputFile, &outputSize ) || size == job->inStart ) {
+        return JOB_UNAVAILABLE;
+    }
+
+    ParallelJob work = {
+        .job = job,
+        .inFd = fileno( inputFile ),
+        .outFd = fileno( outputFile ),
+        .size = size - job->inStart,
+        .chunkBytes = roundToBlocks( job->opts->chunkBytes ),
+        .outPos = job->outStart,
+    };
+    work.chunkCount = ( work.size + work.chunkBytes - 1 ) / work.chunkBytes;
+    pthread_mutex_init( &work.lock, NULL );
+    pthread_cond_init( &work.placed, NULL );
+
+    pthread_t workers[ MAX_THREADS ];
+    int started = 0;
+    while ( started < job->opts->threads ) {
+        if ( pthread_create( &workers[ started ], NULL, cryptWorker, &work ) != 0 ) {
+            break;
+        }
+        started++;
+    }
+
+    // Whatever workers did start can still finish the job
+    if ( started == 0 ) {
+        work.failed = true;
+        fprintf( stderr, "Can't start worker threads\n" );
+    }
+
+    for ( int i = 0; i < started; i++ ) {
+        pthread_join( workers[ i ], NULL );
+    }
+
+    pthread_cond_destroy( &work.placed );
+    pthread_mutex_destroy( &work.lock );
+
+    return work.failed ? JOB_FAILED : JOB_DONE;
+}
+
+/**
+    Mark a pipeline as failed, so threads waiting on its rings give up.
+    @param pipe the pipeline that failed
+    @param what name to pass to perror(), or NULL if the error has
+    already been reported
+*/
+static void failPipeline( Pipeline *pipe, char const *what )
+{
+    if ( what != NULL ) {
+        perror( what );
+    }
+
+    __atomic_store_n( &pipe->failed, true, __ATOMIC_RELEASE );
+}
+
+/**
+    Get an empty chunk for the reader. Chunks come back from the writer
+    once their output is written; a new one is allocated only when none
+    has come back yet and the limit allows it, and otherwise the reader
+    waits, which holds it back to the speed of the rest of the pipeline.
+    @param pipe the pipeline
+    @return an empty chunk, or NULL if the pipeline failed
+*/
+static PipeChunk *takeChunk( Pipeline *pipe )
+{
+    PipeChunk *chunk = ringPop( &pipe->free );
+    if ( chunk != NULL ) {
+        return chunk;
+    }
+
+    if ( pipe->chunkCount < pipe->chunkLimit ) {
+        chunk = &pipe->chunks[ pipe->chunkCount ];
+        chunk->dataBytes = pipe->chunkBytes + BLOCK_BYTES;
+        chunk->data = poolTake( chunk->dataBytes, pipe->job->opts->hugePages );
+        if ( chunk->data == NULL ) {
+            failPipeline( pipe, "chunk buffer" );
+            return NULL;
+        }
+        pipe->chunkCount++;
+        return chunk;
+    }
+
+    return ringPopWait( &pipe->free, &pipe->failed );
+}
+
+/**
+    Make sure a chunk buffer has room for a number of bytes, replacing
+    it with a bigger one if not. Buffers are never made smaller than a
+    frame for a whole chunk, so they all come from one size of buffer
+    in the pool unless the frames are bigger than that.
+    @param pipe the pipeline
+    @param buffer the buffer, or NULL if there isn't one yet
+    @param bytes size of the buffer, updated along with it
+    @param need number of bytes it needs room for
+    @return false if there isn't enough memory
+*/
+static bool reserveBuffer( Pipeline *pipe, byte **buffer, size_t *bytes, size_t need )
+{
+    if ( *buffer != NULL && *bytes >= need ) {
+        return true;
+    }
+
+    size_t size = frameBound( pipe->chunkBytes );
+    if ( size < need ) {
+        size = need;
+    }
+    poolGive( *buffer, *bytes );
+    *buffer = poolTake( size, pipe->job->opts->hugePages );
+    *bytes = *buffer == NULL ? 0 : size;
+    return *buffer != NULL;
+}
+
+/**
+    Note the file position of a frame of an indexed file.
+    @param pipe the pipeline
+    @param offset position of the frame
+    @return false if there isn't enough memory
+*/
+static bool addOffset( Pipeline *pipe, uint64_t offset )
+{
+    if ( pipe->offsetCount == pipe->offsetRoom ) {
+        size_t room = pipe->offsetRoom == 0 ? FIRST_OFFSETS : 2 * pipe->offsetRoom;
+        uint64_t *offsets = realloc( pipe->offsets, room * sizeof( uint64_t ) );
+        if ( offsets == NULL ) {
+            return false;
+        }
+        pipe->offsets = offsets;
+        pipe->offsetRoom = room;
+    }
+
+    pipe->offsets[ pipe->offsetCount++ ] = offset;
+    return true;
+}
+
+/**
+    Write what follows the last frame of an indexed file: the end
+    marker, the index of frame positions and the trailer.
+    @param pipe the pipeline
+    @return false if writing failed
+*/
+static bool writeIndex( Pipeline *pipe )
+{
+    size_t count = pipe->offsetCount;
+    size_t bytes = FRAME_HEADER_BYTES + count * INDEX_ENTRY_BYTES + INDEX_TRAILER_BYTES;
+    byte *data = calloc( bytes, sizeof( byte ) );
+    if ( data == NULL ) {
+        return false;
+    }
+
+    for ( size_t i = 0; i < count; i++ ) {
+        storeBlock64( data + FRAME_HEADER_BYTES + i * INDEX_ENTRY_BYTES, pipe->offsets[ i ] );
+    }
+    encodeTrailer( data + bytes - INDEX_TRAILER_BYTES, count, pipe->plainBytes );
+
+    bool ok = fwrite( data, sizeof( byte ), bytes, pipe->outputFile ) == bytes;
+    statsBytes( 0, bytes );
+    free( data );
+    return ok;
+}
+
+/**
+    Read the index and trailer after the end marker of an indexed file
+    and check them against the frames read before it, which catches a
+    file that was cut short or added to. The chunk is left empty and
+    marked as the last one.
+    @param pipe the pipeline
+    @param chunk the chunk, whose data buffer holds the index for now
+    @return false if the index doesn't match, after marking the
+    pipeline as failed
+*/
+static bool readIndexTail( Pipeline *pipe, PipeChunk *chunk )
+{
+    FILE *fp = pipe->inputFile;
+    IndexParams const *params = &pipe->job->params;
+    size_t count = pipe->offsetCount;
+    size_t bytes = count * INDEX_ENTRY_BYTES + INDEX_TRAILER_BYTES;
+    if ( !reserveBuffer( pipe, &chunk->data, &chunk->dataBytes, bytes + 1 ) ) {
+        failPipeline( pipe, "chunk buffer" );
+        return false;
+    }
+
+    // Asking for one byte more than there should be shows up anything
+    // after the trailer
+    size_t got = fread( chunk->data, sizeof( byte ), bytes + 1, fp );
+    if ( ferror( fp ) ) {
+        failPipeline( pipe, "read" );
+        return false;
+    }
+
+    uint64_t chunks, length;
+    bool ok = got == bytes &&
+              decodeTrailer( chunk->data + count * INDEX_ENTRY_BYTES, &chunks, &length ) &&
+              chunks == count && length == pipe->plainBytes &&
+              ( params->length == LENGTH_UNKNOWN || params->length == length );
+    for ( size_t i = 0; ok && i < count; i++ ) {
+        ok = loadBlock64( chunk->data + i * INDEX_ENTRY_BYTES ) == pipe->offsets[ i ];
+    }
+    if ( !ok ) {
+        fprintf( stderr, "Invalid index\n" );
+        failPipeline( pipe, NULL );
+        return false;
+    }
+
+    chunk->last = true;
+    return true;
+}
+
+/**
+    Read the next frame of framed data into a chunk, for decryption,
+    making room for its payload and plaintext. At the end of the data
+    the chunk is left empty and marked as the last one. The frames of
+    an indexed file end with a marker instead of the end of the input,
+    and every one but the last must hold a whole chunk.
+    @param pipe the pipeline
+    @param chunk the chunk, which gets the frame header and payload
+    @return false if the frame couldn't be read, after marking the
+    pipeline as failed
+*/
+static bool readFrame( Pipeline *pipe, PipeChunk *chunk )
+{
+    FILE *fp = pipe->inputFile;
+    bool indexed = pipe->job->indexed;
+    size_t got = fread( chunk->head, sizeof( byte ), FRAME_HEADER_BYTES, fp );
+    chunk->len = 0;
+    if ( got == 0 && !ferror( fp ) && !indexed ) {
+        chunk->last = true;
+        return true;
+    }
+
+    // No frame has a zero header, since none is empty
+    bool whole = got == FRAME_HEADER_BYTES;
+    if ( whole && indexed && loadBlock64( chunk->head ) == 0 ) {
+        return readIndexTail( pipe, chunk );
+    }
+
+    size_t payload, len;
+    if ( whole && ( !frameSizes( chunk->head, &payload, &len ) ||
+                    ( indexed && ( pipe->shortFrame || len > pipe->job->params.chunkBytes ) ) ) ) {
+        fprintf( stderr, "Invalid frame\n" );
+        failPipeline( pipe, NULL );
+        return false;
+    }
+    if ( whole && ( !reserveBuffer( pipe, &chunk->data, &chunk->dataBytes, payload ) ||
+                    !reserveBuffer( pipe, &chunk->out, &chunk->outBytes, frameBound( len ) ) ||
+                    ( indexed && !addOffset( pipe, pipe->framePos ) ) ) ) {
+        failPipeline( pipe, "chunk buffer" );
+        return false;
+    }
+    if ( whole && fread( chunk->data, sizeof( byte ), payload, fp ) == payload ) {
+        chunk->len = payload;
+        pipe->framePos += FRAME_HEADER_BYTES + payload;
+        pipe->plainBytes += len;
+        pipe->shortFrame = len < pipe->job->params.chunkBytes;
+        return true;
+    }
+
+    if ( ferror( fp ) ) {
+        failPipeline( pipe, "read" );
+    } else {
+        fprintf( stderr, indexed ? "Truncated file\n" : "Truncated frame\n" );
+        failPipeline( pipe, NULL );
+    }
+    return false;
+}
+
+/**
+    Body of the reader thread. It fills chunks from the input in order
+    and deals them out to the lanes, noting for each one where it starts
+    and which ciphertext block comes before it. After the last chunk,
+    the other lanes are told to stop. Framed data is read a frame at a
+    time when decrypting.
+    @param arg the Pipeline
+    @return NULL
+*/
+static void *pipeReader( void *arg )
+{
+    Pipeline *pipe = arg;
+    uint64_t pos = 0;
+    uint64_t chain = pipe->job->nonce;
+    statsThread( "reader", 0 );
+
+    for ( size_t index = 0; ; index++ ) {
+        PipeChunk *chunk = takeChunk( pipe );
+        if ( chunk == NULL ) {
+            break;
+        }
+
+        // An empty input still makes one chunk, so its end is handled
+        StatsMark mark;
+        statsBegin( &mark );
+        chunk->last = false;
+        chunk->index = index;
+        if ( isFramed( pipe->job ) && pipe->job->decrypt ) {
+            bool ok = readFrame( pipe, chunk );
+            statsEnd( PHASE_READ, &mark );
+            statsBytes( chunk->len, 0 );
+            if ( !ok ) {
+                break;
+            }
+        } else {
+            chunk->len = readFull( pipe->inputFile, chunk->data, pipe->chunkBytes, &chunk->last );
+            statsEnd( PHASE_READ, &mark );
+            statsBytes( chunk->len, 0 );
+            if ( ferror( pipe->inputFile ) ) {
+                failPipeline( pipe, "read" );
+                break;
+            }
+        }
+
+        if ( isFramed( pipe->job ) && !pipe->job->decrypt &&
+             !reserveBuffer( pipe, &chunk->out, &chunk->outBytes, frameBound( chunk->len ) ) ) {
+            failPipeline( pipe, "chunk buffer" );
+            break;
+        }
+
+        chunk->pos = pos;
+        chunk->chain = chain;
+        if ( chunk->len >= BLOCK_BYTES ) {
+            chain = loadBlock64( chunk->data + chunk->len / BLOCK_BYTES * BLOCK_BYTES - BLOCK_BYTES );
+        }
+        pos += chunk->len;
+
+        PipeLane *lane = &pipe->lanes[ index % pipe->laneCount ];
+        if ( !ringPushWait( &lane->in, chunk, &pipe->failed ) ) {
+            break;
+        }
+
+        if ( chunk->last ) {
+            for ( int i = 0; i < pipe->laneCount; i++ ) {
+                if ( &pipe->lanes[ i ] != lane ) {
+                    ringPushWait( &pipe->lanes[ i ].in, &pipe->end, &pipe->failed );
+                }
+            }
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+    Body of each cipher thread. It encrypts or decrypts the chunks of
+    its lane in place and passes them on to the writer. Framed chunks
+    are turned into frames, or frames back into plaintext, in the
+    chunk's out buffer instead.
+    @param arg the PipeLane of the thread
+    @return NULL
+*/
+static void *pipeCipher( void *arg )
+{
+    PipeLane *lane = arg;
+    Pipeline *pipe = lane->pipe;
+    CryptJob const *job = pipe->job;
+
+    // CBC encryption has a single lane, which carries the chain from
+    // one chunk to the next; other jobs take it from the reader
+    uint64_t running = job->nonce;
+    statsThread( "cipher", lane - pipe->lanes );
+
+    while ( true ) {
+        PipeChunk *chunk = ringPopWait( &lane->in, &pipe->failed );
+        if ( chunk == NULL || chunk == &pipe->end ) {
+            break;
+        }
+
+        StatsMark mark;
+        statsBegin( &mark );
+        if ( !isFramed( job ) ) {
+            uint64_t chain = isSerial( job ) ? running : chunk->chain;
+            chunk->outLen = cryptRange( job, chunk->data, chunk->data, chunk->len, chunk->pos,
+                                        &chain, chunk->last );
+            running = chain;
+        } else if ( !job->decrypt ) {
+            chunk->outLen = frameSeal( job->ctx, job->nonce, chunk->index, chunk->out,
+                                       chunk->data, chunk->len, job->compressed );
+        } else {
+            chunk->outLen = chunk->len == 0 ? 0 : frameOpen( job->ctx, job->nonce, chunk->index,
+                                                             chunk->out, chunk->data, chunk->head );
+        }
+        statsEnd( PHASE_CIPHER, &mark );
+        if ( chunk->outLen == DES_INVALID ) {
+            fprintf( stderr, isFramed( job ) ? "Invalid frame\n" : "Invalid padding\n" );
+            failPipeline( pipe, NULL );
+            break;
+        }
+
+        if ( !ringPushWait( &lane->out, chunk, &pipe->failed ) || chunk->last ) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+    Body of the writer thread. It collects the chunks from the lanes in
+    turn, writes their output and hands them back to the reader. When
+    encrypting an indexed file, it notes where each frame goes, and
+    writes the index after the last one.
+    @param arg the Pipeline
+    @return NULL
+*/
+static void *pipeWriter( void *arg )
+{
+    Pipeline *pipe = arg;
+    bool indexes = pipe->job->indexed && !pipe->job->decrypt;
+    statsThread( "writer", 0 );
+
+    for ( size_t index = 0; ; index++ ) {
+        PipeLane *lane = &pipe->lanes[ index % pipe->laneCount ];
+        PipeChunk *chunk = ringPopWait( &lane->out, &pipe->failed );
+        if ( chunk == NULL ) {
+            break;
+        }
+
+        StatsMark mark;
+        statsBegin( &mark );
+        // The empty last chunk of framed data may not have an out buffer
+        byte const *output = isFramed( pipe->job ) ? chunk->out : chunk->data;
+        bool written = chunk->outLen == 0 ||
+                       fwrite( output, sizeof( byte ), chunk->outLen, pipe->outputFile ) ==
+                           chunk->outLen;
+        statsEnd( PHASE_WRITE, &mark );
+        statsBytes( 0, chunk->outLen );
+        if ( !written ) {
+            failPipeline( pipe, "write" );
+            break;
+        }
+
+        if ( indexes && chunk->outLen > 0 ) {
+            if ( !addOffset( pipe, pipe->framePos ) ) {
+                failPipeline( pipe, "index" );
+                break;
+            }
+            pipe->framePos += chunk->outLen;
+            pipe->plainBytes += chunk->len;
+        }
+
+        // The free ring has room for every chunk, so this can't fail
+        bool last = chunk->last;
+        ringPush( &pipe->free, chunk );
+        if ( last ) {
+            statsBegin( &mark );
+            if ( indexes && !writeIndex( pipe ) ) {
+                failPipeline( pipe, "write" );
+            }
+            statsEnd( PHASE_WRITE, &mark );
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+    Work out the chunk size and the number of chunks for a pipeline, so
+    the chunk buffers fit in opts->pipelineBytes. Chunks are made
+    smaller than opts->chunkBytes if that's what it takes for every
+    thread to have a chunk to work on. Framed chunks count twice, since
+    each has a buffer for its frame as well, and are never bigger than
+    a frame can hold. Indexed files keep the chunk size they were
+    given, which their index depends on.
+    @param pipe the pipeline, which gets its chunkBytes and chunkLimit
+*/
+static void sizePipeline( Pipeline *pipe )
+{
+    size_t memory = pipe->job->opts->pipelineBytes;
+    size_t share = memory / ( pipe->laneCount + 2 );
+    size_t copies = isFramed( pipe->job ) ? 2 : 1;
+    size_t overhead = copies * BLOCK_BYTES + ( copies - 1 ) * FRAME_HEADER_BYTES +
+                      sizeof( PipeChunk );
+
+    pipe->chunkBytes = roundToBlocks( pipe->job->opts->chunkBytes );
+    if ( pipe->job->compressed && pipe->chunkBytes > FRAME_MAX_BYTES ) {
+        pipe->chunkBytes = FRAME_MAX_BYTES;
+    }
+    if ( pipe->job->indexed ) {
+        pipe->chunkBytes = pipe->job->params.chunkBytes;
+    } else if ( copies * pipe->chunkBytes + overhead > share ) {
+        pipe->chunkBytes = share > overhead + copies * BLOCK_BYTES
+                               ? ( share - overhead ) / copies / BLOCK_BYTES * BLOCK_BYTES
+                               : BLOCK_BYTES;
+    }
+
+    pipe->chunkLimit = memory / ( copies * pipe->chunkBytes + overhead );
+    if ( pipe->chunkLimit == 0 ) {
+        pipe->chunkLimit = 1;
+    }
+}
+
+/**
+    Finish the reads or writes a thread still has in flight on a ring
+    when the pipeline fails, so the kernel is done with the chunk
+    buffers before they are freed.
+    @param ring the ring
+    @param inFlight number of requests still in flight
+*/
+static void drainRing( Uring *ring, int inFlight )
+{
+    uint64_t tag;
+    int result;
+    while ( inFlight > 0 && uringWait( ring, &tag, &result ) ) {
+        inFlight--;
+    }
+}
+
+/**
+    Body of the reader thread when io_uring does the reading. It keeps
+    up to URING_QUEUE_DEPTH reads in flight into free chunks, and deals
+    the chunks out to the lanes in order as their reads finish.
+    @param arg the Pipeline
+    @return NULL
+*/
+static void *pipeUringReader( void *arg )
+{
+    Pipeline *pipe = arg;
+    size_t total = pipe->size == 0 ? 1 : ( pipe->size + pipe->chunkBytes - 1 ) / pipe->chunkBytes;
+    uint64_t chain = pipe->job->nonce;
+
+    // Chunks with reads queued, oldest first. Reads only count as in
+    // flight once they have been submitted
+    PipeChunk *queue[ URING_QUEUE_DEPTH ];
+    int first = 0, queued = 0, inFlight = 0, unsubmitted = 0;
+    size_t next = 0;
+    bool ok = true;
+    statsThread( "reader", 0 );
+
+    for ( size_t index = 0; ok && index < total; index++ ) {
+        // Top up the queue; only wait for a free chunk if nothing is queued
+        while ( queued < URING_QUEUE_DEPTH && next < total ) {
+            PipeChunk *chunk = queued == 0 ? ringPopWait( &pipe->free, &pipe->failed )
+                                           : ringPop( &pipe->free );
+            if ( chunk == NULL ) {
+                break;
+            }
+
+            chunk->pos = next * pipe->chunkBytes;
+            chunk->len = pipe->size - chunk->pos < (off_t) pipe->chunkBytes
+                             ? pipe->size - chunk->pos : pipe->chunkBytes;
+            chunk->last = next == total - 1;
+            chunk->offset = pipe->job->inStart + chunk->pos;
+            chunk->ready = chunk->len == 0;
+            if ( !chunk->ready ) {
+                if ( !uringRead( &pipe->readRing, 0, chunk->data, chunk->len, chunk->offset,
+                                 chunk->buffer, (uintptr_t) chunk ) ) {
+                    failPipeline( pipe, "io_uring" );
+                    ok = false;
+                    break;
+                }
+                unsubmitted++;
+            }
+
+            queue[ ( first + queued ) % URING_QUEUE_DEPTH ] = chunk;
+            queued++;
+            next++;
+        }
+        if ( !ok || queued == 0 ) {
+            break;
+        }
+
+        StatsMark mark;
+        statsBegin( &mark );
+        if ( !uringSubmit( &pipe->readRing ) ) {
+            failPipeline( pipe, "io_uring" );
+            break;
+        }
+        inFlight += unsubmitted;
+        unsubmitted = 0;
+
+        PipeChunk *chunk = queue[ first ];
+        while ( !chunk->ready ) {
+            uint64_t tag;
+            int result;
+            if ( !uringWait( &pipe->readRing, &tag, &result ) ) {
+                failPipeline( pipe, "io_uring" );
+                return NULL;
+            }
+            inFlight--;
+
+            // A short read is finished off with an ordinary one
+            PipeChunk *done = (PipeChunk *) (uintptr_t) tag;
+            size_t got = result < 0 ? 0 : result;
+            if ( result < 0 ) {
+                errno = -result;
+            } else if ( got < done->len &&
+                        readAt( pipe->inFd, done->data + got, done->len - got,
+                                done->offset + got ) == (ssize_t) ( done->len - got ) ) {
+                got = done->len;
+            }
+            if ( got != done->len ) {
+                failPipeline( pipe, "read" );
+                drainRing( &pipe->readRing, inFlight );
+                return NULL;
+            }
+            done->ready = true;
+        }
+        statsEnd( PHASE_READ, &mark );
+        statsBytes( chunk->len, 0 );
+        first = ( first + 1 ) % URING_QUEUE_DEPTH;
+        queued--;
+
+        // Zero the rest of the last block, as readFull() does
+        memset( chunk->data + chunk->len, 0, roundToBlocks( chunk->len ) - chunk->len );
+        chunk->chain = chain;
+        if ( chunk->len >= BLOCK_BYTES ) {
+            chain = loadBlock64( chunk->data + chunk->len / BLOCK_BYTES * BLOCK_BYTES - BLOCK_BYTES );
+        }
+
+        PipeLane *lane = &pipe->lanes[ index % pipe->laneCount ];
+        if ( !ringPushWait( &lane->in, chunk, &pipe->failed ) ) {
+            break;
+        }
+
+        if ( chunk->last ) {
+            for ( int i = 0; i < pipe->laneCount; i++ ) {
+                if ( &pipe->lanes[ i ] != lane ) {
+                    ringPushWait( &pipe->lanes[ i ].in, &pipe->end, &pipe->failed );
+                }
+            }
+        }
+    }
+
+    // Waiting passes on any reads a failed submit left queued
+    drainRing( &pipe->readRing, inFlight + unsubmitted );
+    return NULL;
+}
+
+/**
+    Wait for one of the writer's io_uring writes to finish, and hand its
+    chunk back to the reader.
+    @param pipe the pipeline
+    @param inFlight number of writes in flight, reduced by one
+    @return false if the write failed
+*/
+static bool finishWrite( Pipeline *pipe, int *inFlight )
+{
+    uint64_t tag;
+    int result;
+    StatsMark mark;
+    statsBegin( &mark );
+    if ( !uringWait( &pipe->writeRing, &tag, &result ) ) {
+        failPipeline( pipe, "io_uring" );
+        return false;
+    }
+    ( *inFlight )--;
+
+    // A short write is finished off with an ordinary one
+    PipeChunk *chunk = (PipeChunk *) (uintptr_t) tag;
+    size_t put = result < 0 ? 0 : result;
+    if ( result < 0 ) {
+        errno = -result;
+    } else if ( put < chunk->outLen &&
+                writeAt( pipe->outFd, chunk->data + put, chunk->outLen - put,
+                         chunk->offset + put ) ) {
+        put = chunk->outLen;
+    }
+    statsEnd( PHASE_WRITE, &mark );
+    if ( put != chunk->outLen ) {
+        failPipeline( pipe, "write" );
+        return false;
+    }
+
+    statsBytes( 0, chunk->outLen );
+    ringPush( &pipe->free, chunk );
+    return true;
+}
+
+/**
+    Body of the writer thread when io_uring does the writing. Chunks
+    come from the lanes in turn as before, and each one's output is
+    known to follow the one before, so up to URING_QUEUE_DEPTH writes
+    can be in flight at once.
+    @param arg the Pipeline
+    @return NULL
+*/
+static void *pipeUringWriter( void *arg )
+{
+    Pipeline *pipe = arg;
+    off_t outPos = pipe->job->outStart;
+    int inFlight = 0, unsubmitted = 0;
+    bool ok = true;
+    statsThread( "writer", 0 );
+
+    for ( size_t index = 0; ok; index++ ) {
+        PipeLane *lane = &pipe->lanes[ index % pipe->laneCount ];
+
+        // While waiting for the next chunk, finish writes, so their
+        // chunks get back to the reader
+        PipeChunk *chunk;
+        while ( ( chunk = ringPop( &lane->out ) ) == NULL && inFlight > 0 && ok ) {
+            ok = finishWrite( pipe, &inFlight );
+        }
+        if ( chunk == NULL && ok ) {
+            chunk = ringPopWait( &lane->out, &pipe->failed );
+        }
+        if ( chunk == NULL ) {
+            break;
+        }
+
+        bool last = chunk->last;
+        if ( chunk->outLen == 0 ) {
+            ringPush( &pipe->free, chunk );
+        } else {
+            if ( inFlight == URING_QUEUE_DEPTH ) {
+                ok = finishWrite( pipe, &inFlight );
+            }
+
+            chunk->offset = outPos;
+            outPos += chunk->outLen;
+            if ( ok ) {
+                StatsMark mark;
+                statsBegin( &mark );
+                ok = uringWrite( &pipe->writeRing, 1, chunk->data, chunk->outLen,
+                                 chunk->offset, chunk->buffer, (uintptr_t) chunk );
+                if ( ok ) {
+                    unsubmitted = 1;
+                    ok = uringSubmit( &pipe->writeRing );
+                }
+                if ( ok ) {
+                    inFlight++;
+                    unsubmitted = 0;
+                } else {
+                    failPipeline( pipe, "io_uring" );
+                }
+                statsEnd( PHASE_WRITE, &mark );
+            }
+        }
+
+        if ( last ) {
+            break;
+        }
+    }
+
+    while ( ok && inFlight > 0 ) {
+        ok = finishWrite( pipe, &inFlight );
+    }
+    drainRing( &pipe->writeRing, inFlight + unsubmitted );
+
+    return NULL;
+}
+
+/**
+    Set up io_uring for a pipeline on regular files: a ring each for
+    the reader and writer, with both files registered, and every chunk
+    buffer taken up front and registered with both rings. Every chunk
+    starts out on the free ring.
+    @param pipe the pipeline, with its chunks and rings allocated
+    @param inSize size of the input file
+    @return false if io_uring isn't available
+*/
+static bool setupUring( Pipeline *pipe, off_t inSize )
+{
+    if ( !uringOpen( &pipe->readRing, URING_QUEUE_DEPTH ) ) {
+        return false;
+    }
+    if ( !uringOpen( &pipe->writeRing, URING_QUEUE_DEPTH ) ) {
+        uringClose( &pipe->readRing );
+        return false;
+    }
+    pipe->uring = true;
+
+    size_t stride = pipe->chunkBytes + BLOCK_BYTES;
+    struct iovec iov[ pipe->chunkLimit ];
+    while ( pipe->chunkCount < pipe->chunkLimit ) {
+        PipeChunk *chunk = &pipe->chunks[ pipe->chunkCount ];
+        chunk->dataBytes = stride;
+        chunk->data = poolTake( stride, pipe->job->opts->hugePages );
+        if ( chunk->data == NULL ) {
+            return false;
+        }
+        iov[ pipe->chunkCount ].iov_base = chunk->data;
+        iov[ pipe->chunkCount ].iov_len = stride;
+        ringPush( &pipe->free, chunk );
+        pipe->chunkCount++;
+    }
+
+    int fds[ URING_MAX_FILES ] = { pipe->inFd, pipe->outFd };
+    uringSetFiles( &pipe->readRing, fds, URING_MAX_FILES );
+    uringSetFiles( &pipe->writeRing, fds, URING_MAX_FILES );
+
+    // Chunks just don't use registered buffers if this fails
+    bool fixed = uringRegisterBuffers( &pipe->readRing, iov, pipe->chunkLimit ) &&
+                 uringRegisterBuffers( &pipe->writeRing, iov, pipe->chunkLimit );
+    for ( size_t i = 0; i < pipe->chunkLimit; i++ ) {
+        pipe->chunks[ i ].buffer = fixed ? (int) i : -1;
+    }
+
+    pipe->size = inSize - pipe->job->inStart;
+    return true;
+}
+
+/**
+    Free everything a pipeline allocated.
+    @param pipe the pipeline
+*/
+static void freePipeline( Pipeline *pipe )
+{
+    if ( pipe->uring ) {
+        uringClose( &pipe->readRing );
+        uringClose( &pipe->writeRing );
+    }
+
+    for ( size_t i = 0; i < pipe->chunkCount; i++ ) {
+        poolGive( pipe->chunks[ i ].data, pipe->chunks[ i ].dataBytes );
+        poolGive( pipe->chunks[ i ].out, pipe->chunks[ i ].outBytes );
+    }
+
+    for ( int i = 0; pipe->lanes != NULL && i < pipe->laneCount; i++ ) {
+        ringFree( &pipe->lanes[ i ].in );
+        ringFree( &pipe->lanes[ i ].out );
+    }
+    ringFree( &pipe->free );
+    free( pipe->lanes );
+    free( pipe->chunks );
+    free( pipe->offsets );
+}
+
+/**
+    Run the job on a pipeline: a reader thread, one or more cipher
+    threads and a writer thread, passing chunks along lock-free rings.
+    Reading, the cipher and writing all overlap. Without io_uring the
+    only file operations are sequential reads and writes, so pipes and
+    terminals work as well as regular files. With io_uring, which needs
+    regular files, the reader and writer each keep several requests in
+    flight, so the cipher threads always have chunks to work on. CBC
+    encryption gets one cipher thread, since each chunk chains from the
+    one before.
+    @param job the job
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @param uring true to read and write the files with io_uring
+    @return how the attempt turned out, which is only JOB_UNAVAILABLE
+    if io_uring was asked for and isn't available
+*/
+static JobResult cryptPipelined( CryptJob const *job, FILE *inputFile, FILE *outputFile,
+                                 bool uring )
+{
+    Pipeline pipe = {
+        .job = job,
+        .inputFile = inputFile,
+        .outputFile = outputFile,
+        .laneCount = isSerial( job ) ? 1 : job->opts->threads,
+        .inFd = fileno( inputFile ),
+        .outFd = fileno( outputFile ),
+        .framePos = job->decrypt ? job->inStart : job->outStart,
+    };
+    sizePipeline( &pipe );
+
+    off_t inSize = 0;
+    if ( uring ) {
+        // Every buffer is allocated up front, so only allow enough
+        // chunks to keep the queues full, and no more than the file has
+        regularFileSize( inputFile, &inSize );
+        size_t needed = 2 * URING_QUEUE_DEPTH + 2 * pipe.laneCount;
+        size_t total = ( inSize - job->inStart ) / pipe.chunkBytes + 1;
+        if ( pipe.chunkLimit > needed ) {
+            pipe.chunkLimit = needed;
+        }
+        if ( pipe.chunkLimit > total ) {
+            pipe.chunkLimit = total;
+        }
+    } else {
+        // Chunks go straight into our buffers, so stdio doesn't need its own
+        setvbuf( inputFile, NULL, _IONBF, 0 );
+        setvbuf( outputFile, NULL, _IONBF, 0 );
+    }
+
+    // Lanes hold rings, which want their indexes on their own cache
+    // lines, and every ring is big enough for every chunk
+    pipe.chunks = calloc( pipe.chunkLimit, sizeof( PipeChunk ) );
+    size_t laneBytes = pipe.laneCount * sizeof( PipeLane );
+    if ( posix_memalign( (void **) &pipe.lanes, RING_CACHE_LINE, laneBytes ) != 0 ) {
+        pipe.lanes = NULL;
+    } else {
+        memset( pipe.lanes, 0, laneBytes );
+    }
+    bool ok = pipe.chunks != NULL && pipe.lanes != NULL &&
+              ringInit( &pipe.free, pipe.chunkLimit );
+    for ( int i = 0; ok && i < pipe.laneCount; i++ ) {
+        pipe.lanes[ i ].pipe = &pipe;
+        // The reader's ring also needs room for the end marker
+        ok = ringInit( &pipe.lanes[ i ].in, pipe.chunkLimit + 1 ) &&
+             ringInit( &pipe.lanes[ i ].out, pipe.chunkLimit );
+    }
+    if ( !ok ) {
+        perror( "pipeline" );
+        freePipeline( &pipe );
+        return JOB_FAILED;
+    }
+
+    if ( uring && !setupUring( &pipe, inSize ) ) {
+        freePipeline( &pipe );
+        return JOB_UNAVAILABLE;
+    }
+
+    pthread_t reader, writer;
+    bool readerStarted = false, writerStarted = false;
+    int started = 0;
+    while ( started < pipe.laneCount &&
+            pthread_create( &pipe.lanes[ started ].thread, NULL, pipeCipher,
+                            &pipe.lanes[ started ] ) == 0 ) {
+        started++;
+    }
+    writerStarted = started == pipe.laneCount &&
+                    pthread_create( &writer, NULL, uring ? pipeUringWriter : pipeWriter,
+                                    &pipe ) == 0;
+    readerStarted = writerStarted &&
+                    pthread_create( &reader, NULL, uring ? pipeUringReader : pipeReader,
+                                    &pipe ) == 0;
+    if ( !readerStarted ) {
+        fprintf( stderr, "Can't start pipeline threads\n" );
+        failPipeline( &pipe, NULL );
+    }
+
+    if ( readerStarted ) {
+        pthread_join( reader, NULL );
+    }
+    if ( writerStarted ) {
+        pthread_join( writer, NULL );
+    }
+    for ( int i = 0; i < started; i++ ) {
+        pthread_join( pipe.lanes[ i ].thread, NULL );
+    }
+
+    freePipeline( &pipe );
+    return pipe.failed ? JOB_FAILED : JOB_DONE;
+}
+
+/**
+    Move the input file to the given position in the data. Regular files
+    just seek there; pipes have the bytes in front read and thrown away.
+    @param job the job
+    @param inputFile a pointer to the file to read from, which must not
+    have been read through stdio yet
+    @param pos position in the data, after any header
+    @return false if reading failed
+*/
+static bool skipInput( CryptJob const *job, FILE *inputFile, uint64_t pos )
+{
+    if ( fseeko( inputFile, job->inStart + pos, SEEK_SET ) == 0 ) {
+        return true;
+    }
+
+    byte discard[ BUFSIZ ];
+    while ( pos > 0 ) {
+        size_t n = pos < sizeof( discard ) ? pos : sizeof( discard );
+        size_t got = fread( discard, sizeof( byte ), n, inputFile );
+        if ( got < n ) {
+            return !ferror( inputFile );
+        }
+        pos -= got;
+    }
+
+    return true;
+}
+
+/**
+    Write the part of a piece of decrypted data that lies in the range
+    the user asked for.
+    @param outputFile a pointer to the file to write to
+    @param data the decrypted piece
+    @param pos position of the piece in the data
+    @param len number of bytes in the piece
+    @param first position of the first byte of the range
+    @param end position just past the last byte of the range
+    @return false if writing failed
+*/
+static bool writeSlice( FILE *outputFile, byte const *data, uint64_t pos, size_t len,
+                        uint64_t first, uint64_t end )
+{
+    uint64_t from = pos > first ? pos : first;
+    uint64_t to = end - pos > len ? pos + len : end;
+    if ( from >= to ) {
+        return true;
+    }
+
+    statsBytes( 0, to - from );
+    return fwrite( data + ( from - pos ), sizeof( byte ), to - from, outputFile ) == to - from;
+}
+
+/**
+    Decrypt a piece of the data read for a byte range and write the part
+    of it that lies in the range. ECB blocks lose their zero padding as
+    usual, so a range can come out shorter than asked for, and the CBC
+    padding is removed from the last block.
+    @param job the job
+    @param outputFile a pointer to the file to write to
+    @param data the piece, decrypted in place
+    @param len number of bytes in the piece
+    @param pos position of the piece in the data, a multiple of BLOCK_BYTES
+    @param chain the ciphertext block before the piece, for CBC
+    @param last true if the piece is the end of the data
+    @param first position of the first byte of the range
+    @param end position just past the last byte of the range
+    @return false if the padding isn't valid or writing failed, after
+    printing an error message
+*/
+static bool decryptSlice( CryptJob const *job, FILE *outputFile, byte *data, size_t len,
+                          uint64_t pos, uint64_t *chain, bool last, uint64_t first,
+                          uint64_t end )
+{
+    if ( job->opts->mode == MODE_ECB ) {
+        desCryptBlocks( job->ctx, true, data, data, len );
+        for ( size_t start = 0; start < len; start += BLOCK_BYTES ) {
+            size_t blockLen = len - start < BLOCK_BYTES ? len - start : BLOCK_BYTES;
+            while ( blockLen > 0 && data[ start + blockLen - 1 ] == '\0' ) {
+                blockLen--;
+            }
+            if ( !writeSlice( outputFile, data + start, pos + start, blockLen, first, end ) ) {
+                perror( "write" );
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Both other modes leave every byte where it was in the ciphertext
+    size_t outLen = cryptRange( job, data, data, len, pos, chain, last );
+    if ( outLen == DES_INVALID ) {
+        fprintf( stderr, "Invalid padding\n" );
+        return false;
+    }
+
+    if ( !writeSlice( outputFile, data, pos, outLen, first, end ) ) {
+        perror( "write" );
+        return false;
+    }
+    return true;
+}
+
+/**
+    Decrypt just the bytes in the range given by opts->rangeOffset and
+    opts->rangeLength. Reading starts at the block holding the first
+    byte, or for CBC the block before that, which the first block chains
+    from, and stops after the block holding the last byte, so the cost
+    depends on the length of the range and not the size of the file. A
+    range past the end of the data gives empty output.
+    @param job the job
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @return true if successful
+*/
+static bool decryptRange( CryptJob const *job, FILE *inputFile, FILE *outputFile )
+{
+    Options const *opts = job->opts;
+    uint64_t first = opts->rangeOffset;
+    uint64_t end = opts->rangeLength > RANGE_TO_END - first ? RANGE_TO_END
+                                                             : first + opts->rangeLength;
+    uint64_t pos = first / BLOCK_BYTES * BLOCK_BYTES;
+    uint64_t chain = job->nonce;
+
+    bool needChain = opts->mode == MODE_CBC && pos > 0;
+    if ( !skipInput( job, inputFile, needChain ? pos - BLOCK_BYTES : pos ) ) {
+        perror( opts->inputFile );
+        return false;
+    }
+    if ( needChain ) {
+        byte block[ BLOCK_BYTES ];
+        if ( fread( block, sizeof( byte ), BLOCK_BYTES, inputFile ) != BLOCK_BYTES ) {
+            return !ferror( inputFile );
+        }
+        chain = loadBlock64( block );
+    }
+
+    size_t chunkBytes = roundToBlocks( opts->chunkBytes );
+    byte *data = poolTake( chunkBytes + BLOCK_BYTES, opts->hugePages );
+    if ( data == NULL ) {
+        perror( "chunk buffer" );
+        return false;
+    }
+
+    bool ok = true, last = false;
+    while ( ok && !last && pos < end ) {
+        size_t want = end - pos < chunkBytes ? roundToBlocks( end - pos ) : chunkBytes;
+        StatsMark mark;
+        statsBegin( &mark );
+        size_t len = readFull( inputFile, data, want, &last );
+        statsEnd( PHASE_READ, &mark );
+        statsBytes( len, 0 );
+        if ( ferror( inputFile ) ) {
+            perror( opts->inputFile );
+            ok = false;
+        } else if ( len > 0 ) {
+            // The slices are small enough that writing them counts as
+            // part of the cipher
+            statsBegin( &mark );
+            ok = decryptSlice( job, outputFile, data, len, pos, &chain, last, first, end );
+            statsEnd( PHASE_CIPHER, &mark );
+            pos += len;
+        }
+    }
+
+    poolGive( data, chunkBytes + BLOCK_BYTES );
+    return ok;
+}
+
+/**
+    Read one frame of an indexed file and decrypt it. The index has
+    already been checked against the file, so all that is left is to
+    check the frame header against its entry in the index.
+    @param work the job the frame belongs to
+    @param chunk index of the chunk the frame holds
+    @param frame buffer for the frame, with room for a frame for a
+    whole chunk
+    @param out buffer for the plaintext, the same size
+    @return number of plaintext bytes, or DES_INVALID after printing an
+    error message
+*/
+static size_t openIndexedChunk( ParallelJob *work, uint64_t chunk, byte *frame, byte *out )
+{
+    CryptJob const *job = work->job;
+    uint64_t at = work->offsets[ chunk ];
+    size_t span = work->offsets[ chunk + 1 ] - at;
+
+    StatsMark mark;
+    statsBegin( &mark );
+    ssize_t got = readAt( work->inFd, frame, span, at );
+    statsEnd( PHASE_READ, &mark );
+    if ( got < 0 ) {
+        perror( job->opts->inputFile );
+        return DES_INVALID;
+    }
+    statsBytes( got, 0 );
+
+    size_t payload, len;
+    if ( (size_t) got != span || !frameSizes( frame, &payload, &len ) ||
+         payload != span - FRAME_HEADER_BYTES || len != indexChunkBytes( &job->params, chunk ) ) {
+        fprintf( stderr, "Invalid frame\n" );
+        return DES_INVALID;
+    }
+
+    statsBegin( &mark );
+    size_t outLen = frameOpen( job->ctx, job->nonce, chunk, out, frame + FRAME_HEADER_BYTES,
+                               frame );
+    statsEnd( PHASE_CIPHER, &mark );
+    if ( outLen == DES_INVALID ) {
+        fprintf( stderr, "Invalid frame\n" );
+    }
+    return outLen;
+}
+
+/**
+    Body of each worker thread decrypting an indexed file. Workers take
+    chunks in order until there are none left, and write each one
+    straight to its place in the output, which the chunk size gives.
+    @param arg the ParallelJob the worker belongs to
+    @return NULL
+*/
+static void *indexedWorker( void *arg )
+{
+    ParallelJob *work = arg;
+
+    pthread_mutex_lock( &work->lock );
+    int worker = work->workerCount++;
+    pthread_mutex_unlock( &work->lock );
+    statsThread( "worker", worker );
+
+    size_t bufferBytes = frameBound( work->chunkBytes );
+    bool huge = work->job->opts->hugePages;
+    byte *frame = poolTake( bufferBytes, huge );
+    byte *out = poolTake( bufferBytes, huge );
+    if ( frame == NULL || out == NULL ) {
+        failJob( work, "chunk buffer" );
+    }
+
+    while ( frame != NULL && out != NULL ) {
+        pthread_mutex_lock( &work->lock );
+        bool done = work->failed || work->nextChunk == work->chunkCount;
+        size_t index = done ? 0 : work->nextChunk++;
+        pthread_mutex_unlock( &work->lock );
+        if ( done ) {
+            break;
+        }
+
+        size_t len = openIndexedChunk( work, index, frame, out );
+        if ( len == DES_INVALID ) {
+            failJob( work, NULL );
+            break;
+        }
+
+        StatsMark mark;
+        statsBegin( &mark );
+        off_t outPos = work->job->outStart + (off_t) index * work->chunkBytes;
+        if ( !writeAt( work->outFd, out, len, outPos ) ) {
+            failJob( work, "write" );
+            break;
+        }
+        statsEnd( PHASE_WRITE, &mark );
+        statsBytes( 0, len );
+    }
+
+    poolGive( frame, bufferBytes );
+    poolGive( out, bufferBytes );
+    return NULL;
+}
+
+/**
+    Decrypt the chunks of an indexed file one after another on this
+    thread, writing them in order, which works for any output. With a
+    range, only the chunks holding it are read.
+    @param work the job, with its index read
+    @param outputFile a pointer to the file to write to
+    @return true if successful
+*/
+static bool decryptIndexedInOrder( ParallelJob *work, FILE *outputFile )
+{
+    Options const *opts = work->job->opts;
+    uint64_t first = 0, end = RANGE_TO_END;
+    if ( opts->ranged ) {
+        first = opts->rangeOffset;
+        end = opts->rangeLength > RANGE_TO_END - first ? RANGE_TO_END : first + opts->rangeLength;
+    }
+
+    size_t bufferBytes = frameBound( work->chunkBytes );
+    bool huge = work->job->opts->hugePages;
+    byte *frame = poolTake( bufferBytes, huge );
+    byte *out = poolTake( bufferBytes, huge );
+    bool ok = frame != NULL && out != NULL;
+    if ( !ok ) {
+        perror( "chunk buffer" );
+    }
+
+    for ( uint64_t chunk = first / work->chunkBytes;
+          ok && chunk < work->chunkCount && chunk * work->chunkBytes < end; chunk++ ) {
+        size_t len = openIndexedChunk( work, chunk, frame, out );
+        ok = len != DES_INVALID;
+        if ( ok ) {
+            StatsMark mark;
+            statsBegin( &mark );
+            ok = writeSlice( outputFile, out, chunk * work->chunkBytes, len, first, end );
+            statsEnd( PHASE_WRITE, &mark );
+            if ( !ok ) {
+                perror( "write" );
+            }
+        }
+    }
+
+    poolGive( frame, bufferBytes );
+    poolGive( out, bufferBytes );
+    return ok;
+}
+
+/**
+    Decrypt an indexed file from a regular input file. The index gives
+    the place of every frame and the exact length of the plaintext, so
+    nothing is scanned for padding: worker threads read, decrypt and
+    write the frames with positional I/O when the output is a regular
+    file too, and a range reads only the frames that hold it.
+    @param job the job, whose parameters get the length from the index
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @param size size of the input file
+    @return true if successful
+*/
+static bool decryptIndexed( CryptJob *job, FILE *inputFile, FILE *outputFile, off_t size )
+{
+    Options const *opts = job->opts;
+    ParallelJob work = {
+        .job = job,
+        .inFd = fileno( inputFile ),
+        .outFd = fileno( outputFile ),
+        .chunkBytes = job->params.chunkBytes,
+    };
+
+    StatsMark mark;
+    statsBegin( &mark );
+    uint64_t chunks;
+    bool ok = readIndex( work.inFd, size, job->inStart, &job->params, &work.offsets, &chunks );
+    statsEnd( PHASE_READ, &mark );
+    if ( !ok ) {
+        if ( errno != 0 ) {
+            perror( opts->inputFile );
+        } else {
+            fprintf( stderr, "Invalid index\n" );
+        }
+        return false;
+    }
+    work.size = job->params.length;
+    work.chunkCount = chunks;
+
+    off_t outputSize;
+    if ( opts->ranged || opts->threads == 1 || !regularFileSize( outputFile, &outputSize ) ) {
+        ok = decryptIndexedInOrder( &work, outputFile );
+        free( work.offsets );
+        return ok;
+    }
+
+    pthread_mutex_init( &work.lock, NULL );
+    pthread_cond_init( &work.placed, NULL );
+
+    pthread_t workers[ MAX_THREADS ];
+    int started = 0;
+    while ( started < opts->threads ) {
+        if ( pthread_create( &workers[ started ], NULL, indexedWorker, &work ) != 0 ) {
+            break;
+        }
+        started++;
+    }
+
+    // Whatever workers did start can still finish the job
+    if ( started == 0 ) {
+        work.failed = true;
+        fprintf( stderr, "Can't start worker threads\n" );
+    }
+
+    for ( int i = 0; i < started; i++ ) {
+        pthread_join( workers[ i ], NULL );
+    }
+
+    pthread_cond_destroy( &work.placed );
+    pthread_mutex_destroy( &work.lock );
+    free( work.offsets );
+    return !work.failed;
+}
+
+/**
+    Report whether an ECB input is an indexed file rather than the bare
+    blocks the original programs wrote. Only a regular file can be
+    looked at without using up its bytes, so anything else is taken to
+    be an indexed file only if opts->container says so.
+    @param opts the parsed command line
+    @param inputFile a pointer to the file to read from
+    @return true if the input starts with the header of an indexed file
+*/
+static bool isIndexedInput( Options const *opts, FILE *inputFile )
+{
+    off_t size;
+    if ( opts->container ) {
+        return true;
+    }
+    if ( !regularFileSize( inputFile, &size ) || size < HEADER_BYTES + INDEX_PARAMS_BYTES ) {
+        return false;
+    }
+
+    byte data[ HEADER_BYTES + INDEX_PARAMS_BYTES ];
+    uint64_t nonce;
+    int flags;
+    IndexParams params;
+    return readAt( fileno( inputFile ), data, sizeof( data ), 0 ) == sizeof( data ) &&
+           decodeHeader( data, MODE_ECB, &nonce, &flags ) && ( flags & HEADER_INDEXED ) &&
+           decodeIndexParams( data + HEADER_BYTES, &params );
+}
+
+/**
+    Read or write the file header for a mode that has one, or for an
+    indexed file. Encryption picks a random nonce and writes it to the
+    output, and decryption reads the nonce back from the input, along
+    with whether the data is compressed or indexed. The parameters of
+    an indexed file follow its header.
+    @param job the job, which gets the nonce and header sizes
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @return true if successful, false after printing an error message
+*/
+static bool handleHeader( CryptJob *job, FILE *inputFile, FILE *outputFile )
+{
+    if ( job->decrypt ) {
+        int flags;
+        int fd = fileno( inputFile );
+        if ( !readHeader( fd, job->opts->mode, &job->nonce, &flags ) ||
+             ( ( flags & HEADER_INDEXED ) && !readIndexParams( fd, &job->params ) ) ||
+             ( job->opts->container && !( flags & HEADER_INDEXED ) ) ) {
+            fprintf( stderr, "Invalid header\n" );
+            return false;
+        }
+        job->compressed = flags & HEADER_COMPRESSED;
+        job->indexed = flags & HEADER_INDEXED;
+        job->inStart = HEADER_BYTES + ( job->indexed ? INDEX_PARAMS_BYTES : 0 );
+
+        // The wrong number of keys would only show up as invalid frames
+        if ( job->indexed && job->params.keys != ( job->opts->key2 != NULL ? 3 : 1 ) ) {
+            fprintf( stderr, "Wrong number of keys\n" );
+            return false;
+        }
+        return true;
+    }
+
+    // ECB has no use for a nonce, so indexed ECB files get zero and
+    // come out the same every time, as the original files did
+    byte nonce[ BLOCK_BYTES ] = { 0 };
+    if ( job->opts->mode != MODE_ECB && !randomBytes( nonce, sizeof( nonce ) ) ) {
+        perror( "getrandom" );
+        return false;
+    }
+    job->nonce = loadBlock64( nonce );
+
+    int fd = fileno( outputFile );
+    int flags = ( job->compressed ? HEADER_COMPRESSED : 0 ) | ( job->indexed ? HEADER_INDEXED : 0 );
+    if ( !writeHeader( fd, job->opts->mode, job->nonce, flags ) ||
+         ( job->indexed && !writeIndexParams( fd, &job->params ) ) ) {
+        perror( job->opts->outputFile );
+        return false;
+    }
+    job->outStart = HEADER_BYTES + ( job->indexed ? INDEX_PARAMS_BYTES : 0 );
+    return true;
+}
+
+bool keysTooLong( Options const *opts )
+{
+    return strlen( opts->key ) > BYTE_SIZE ||
+           ( opts->key2 != NULL && strlen( opts->key2 ) > BYTE_SIZE ) ||
+           ( opts->key3 != NULL && strlen( opts->key3 ) > BYTE_SIZE );
+}
+
+DESContext *createContext( Options const *opts )
+{
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, opts->key );
+
+    DESContext *ctx;
+    if ( opts->key2 == NULL ) {
+        ctx = desContextCreate( key, opts->mode );
+    } else {
+        byte key2[ BLOCK_BYTES ], key3[ BLOCK_BYTES ];
+        prepareKey( key2, opts->key2 );
+        prepareKey( key3, opts->key3 != NULL ? opts->key3 : opts->key );
+        ctx = desContextCreateTriple( key, key2, key3, opts->mode );
+    }
+
+    if ( ctx == NULL ) {
+        perror( "key context" );
+        return NULL;
+    }
+
+    // Never run on an engine that gets the known answers wrong
+    if ( !desContextSetEngine( ctx, opts->engine ) ) {
+        fprintf( stderr, "Engine %s failed its self-test\n", opts->engine->name );
+        desContextFree( ctx );
+        return NULL;
+    }
+
+    return ctx;
+}
+
+bool cryptFile( Options const *opts, DESContext const *ctx, bool decrypt,
+                FILE *inputFile, FILE *outputFile )
+{
+    CryptJob job = {
+        .opts = opts,
+        .ctx = ctx,
+        .decrypt = decrypt,
+        .compressed = !decrypt && opts->compress,
+        .indexed = !decrypt && opts->container,
+    };
+
+    // An indexed file records the length up front when the input is a
+    // regular file; otherwise only its trailer has it
+    off_t inSize;
+    bool regularInput = regularFileSize( inputFile, &inSize );
+    if ( job.indexed ) {
+        size_t chunkBytes = opts->chunkBytes < FRAME_MAX_BYTES ? opts->chunkBytes : FRAME_MAX_BYTES;
+        job.params.chunkBytes = roundToBlocks( chunkBytes );
+        job.params.keys = opts->key2 != NULL ? 3 : 1;
+        job.params.length = regularInput ? (uint64_t) inSize : LENGTH_UNKNOWN;
+    }
+
+    // The header goes straight to the descriptors, before the streams
+    // have buffered anything, so every path below starts after it. ECB
+    // files only have one if they are indexed
+    bool header = opts->mode != MODE_ECB || job.indexed ||
+                  ( decrypt && isIndexedInput( opts, inputFile ) );
+    if ( header ) {
+        StatsMark mark;
+        statsBegin( &mark );
+        bool ok = handleHeader( &job, inputFile, outputFile );
+        statsEnd( decrypt ? PHASE_READ : PHASE_WRITE, &mark );
+        if ( !ok ) {
+            return false;
+        }
+    }
+
+    if ( job.indexed && decrypt && regularInput ) {
+        statsPath( "indexed" );
+        return decryptIndexed( &job, inputFile, outputFile, inSize );
+    }
+
+    // Frames vary in length, so without an index to find them framed
+    // data can't be split up or mapped; the pipeline finds them in order
+    if ( isFramed( &job ) && opts->ranged ) {
+        fprintf( stderr, job.indexed ? "Can't decrypt a range of an indexed file from a pipe\n"
+                                     : "Can't decrypt a range of compressed data\n" );
+        return false;
+    }
+    if ( isFramed( &job ) ) {
+        statsPath( "pipeline-stdio" );
+        return cryptPipelined( &job, inputFile, outputFile, false ) == JOB_DONE;
+    }
+
+    if ( decrypt && opts->ranged ) {
+        statsPath( "range" );
+        return decryptRange( &job, inputFile, outputFile );
+    }
+
+    // Worker threads, mappings and io_uring need regular files, so
+    // anything else that asks for threads gets the stdio pipeline.
+    // Threads on regular files use io_uring where the kernel has it, and
+    // otherwise, or with --io stdio, the workers below
+    off_t size;
+    bool regular = regularFileSize( inputFile, &size ) && regularFileSize( outputFile, &size );
+    bool wantsUring = opts->io == IO_URING ||
+                      ( opts->io == IO_AUTO && ( opts->threads > 1 || opts->pipeline ) );
+    if ( regular && wantsUring ) {
+        statsPath( "pipeline-uring" );
+        JobResult result = cryptPipelined( &job, inputFile, outputFile, true );
+        if ( result != JOB_UNAVAILABLE ) {
+            return result == JOB_DONE;
+        }
+    }
+
+    if ( opts->pipeline || ( opts->threads > 1 && !regular ) ) {
+        statsPath( "pipeline-stdio" );
+        return cryptPipelined( &job, inputFile, outputFile, false ) == JOB_DONE;
+    }
+
+    if ( opts->threads > 1 ) {
+        statsPath( "parallel" );
+        JobResult result = cryptParallel( &job, inputFile, outputFile );
+        if ( result != JOB_UNAVAILABLE ) {
+            return result == JOB_DONE;
+        }
+    }
+
+    if ( opts->mmap != MMAP_OFF ) {
+        statsPath( "mapped" );
+        JobResult result = cryptMapped( &job, inputFile, outputFile );
+        if ( result != JOB_UNAVAILABLE ) {
+            return result == JOB_DONE;
+        }
+    }
+
+    statsPath( "streamed" );
+    return cryptStreamed( &job, inputFile, outputFile );
+}
@@ -0,0 +1,67 @@
+/**
+    @file driver.h
+    @author John Butterfield (jpbutte2)
+    Header for the driver component. This component is shared by the
+    encrypt and decrypt programs. It moves the contents of the input
+    file through the cipher and into the output file, choosing how to
+    do the reading and writing from the options.
+*/
+
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "options.h"
+#include "DESContext.h"
+
+/**
+    This function reports whether any of the keys on the command line
+    is longer than prepareKey() can use.
+    @param opts the parsed command line
+    @return true if a key is too long
+*/
+bool keysTooLong( Options const *opts );
+
+/**
+    This function creates a context for the keys and mode on the command
+    line: single DES for one key, or triple DES when there is a second
+    key, running on the engine from opts->engine once it has passed its
+    self-test.
+    @param opts the parsed command line
+    @return the context, or NULL after printing an error message
+*/
+DESContext *createContext( Options const *opts );
+
+/**
+    This function encrypts or decrypts the whole input file into the
+    output file. In ECB mode, encryption pads the last block with zeros,
+    and decryption removes zero bytes from the end of each block, as the
+    block-at-a-time programs did. Other modes put a header with a nonce
+    in front of the ciphertext and need no padding. With
+    opts->pipeline, or when opts->threads is more than 1 and either
+    file is a pipe or a terminal, the data streams through a pipeline
+    of reader, cipher and writer threads, which read and write regular
+    files with io_uring when opts->io allows it. Otherwise regular files are
+    split among worker threads when opts->threads is more than 1, or
+    may be mapped into memory, depending on opts->mmap; anything else
+    is read and written in chunks. When decrypting with opts->ranged,
+    only the blocks holding the requested byte range are read and
+    decrypted. Compressed data, asked for with opts->compress or flagged
+    in the header of the input, always goes through the stdio pipeline
+    a frame per chunk, and can't be decrypted by range. Indexed files,
+    asked for with opts->container, are framed the same way in any
+    mode, and keep the exact length and an index of the frames after
+    them; decrypting one from a regular file reads the index first and
+    then only the frames it needs, on opts->threads worker threads.
+    @param opts the parsed command line
+    @param ctx the key and mode to use
+    @param decrypt true to decrypt, false to encrypt
+    @param inputFile a pointer to the file to read from
+    @param outputFile a pointer to the file to write to
+    @return true if successful, false after printing an error message
+*/
+bool cryptFile( Options const *opts, DESContext const *ctx, bool decrypt,
+                FILE *inputFile, FILE *outputFile );
+
+#endif
@@ -1,86 +1,112 @@
 /**
     @file encrypt.c
     @author John Butterfield (jpbutte2)
-    This is the main component for the encrypt program. It contains 
-    the main function and uses the other components to read the 
-    input file, to perform encryption and to write out the 
+    This is the main component for the encrypt program. It contains
+    the main function and uses the other components to read the
+    input file, to perform encryption and to write out the
     ciphertext output.
 */
 
 #include "io.h"
-#include <stdbool.h>
-
-/** Number of expected arguments in the command line */
-#define EXP_ARGC 4
-
-/** The expected index of the input file */
-#define INP_F_IDX 2
-
-/** The expected index of the output file */
-#define OUT_F_IDX 3
-
-/** The expected index of the text key */
-#define K_IDX 1
+#include "options.h"
+#include "batch.h"
+#include "driver.h"
+#include "stats.h"
+#include "tune.h"
 
 /**
-    Main method for the DES encryption 
+    Main method for the DES encryption
     @param argc Number of command line arguments
     @param argv Array of strings of command line arguments
     @return the program exit status
 */
 int main( int argc, char *argv[] )
 {
-    if ( argc != EXP_ARGC ) {
+    Options opts;
+    // Ranges only make sense for decryption, compression needs a mode
+    // with a header to flag it in, and batches are never framed
+    if ( !parseOptions( &opts, argc, argv ) || opts.ranged ||
+         ( opts.compress && ( opts.mode == MODE_ECB || opts.batch ) ) ||
+         ( opts.container && opts.batch ) ) {
         fprintf( stderr, "usage: encrypt <key> <input_file> <output_file>\n" );
         exit ( 1 );
     }
 
-    if ( strlen(argv[ K_IDX ]) > BYTE_SIZE) {
+    // With --autotune alone there is no key, and nothing to do after tuning
+    if ( opts.key != NULL && keysTooLong( &opts ) ) {
         fprintf( stderr, "Key too long\n" );
         exit( 1 );
     }
 
-    FILE *inputFile = fopen( argv[ INP_F_IDX ], "rb" );
-
-    if ( inputFile == NULL ) {
-        perror( argv[ INP_F_IDX ] );
+    if ( !applyProfile( &opts ) ) {
         exit( 1 );
     }
 
-    FILE *outputFile = fopen( argv[ OUT_F_IDX ], "wb" );
+    if ( opts.key == NULL ) {
+        exit( 0 );
+    }
 
-    if ( outputFile == NULL ) {
-        perror( argv[ OUT_F_IDX ] );
+    if ( opts.stats ) {
+        statsEnable();
+    }
+
+    StatsMark mark;
+    statsBegin( &mark );
+    DESContext *ctx = createContext( &opts );
+    statsEnd( PHASE_KEYS, &mark );
+    if ( ctx == NULL ) {
         exit( 1 );
     }
 
-    byte key[ BLOCK_BYTES ];
-    prepareKey( key, argv[ K_IDX ] );
+    if ( opts.batch ) {
+        bool ok = cryptBatch( &opts, ctx, false );
+        desContextFree( ctx );
+        statsReport( stderr, "encrypt", ok );
+        exit( ok ? 0 : 1 );
+    }
 
-    byte K[ ROUND_COUNT ][ SUBKEY_BYTES ];
-    generateSubkeys( K, key );
+    statsBegin( &mark );
+    FILE *inputFile = openFile( opts.inputFile, "rb" );
 
-    DESBlock block;
-    bool endOfFileReached = false;
+    if ( inputFile == NULL ) {
+        perror( opts.inputFile );
+        exit( 1 );
+    }
 
-    while (!endOfFileReached) {
-        
-        readBlock(inputFile, &block);
+    FILE *outputFile = openFile( opts.outputFile, "wb" );
 
-        if (block.len == 0) {
-            break;
-        } else if ( block.len < BYTE_SIZE ) {
-            endOfFileReached = true;
-            block.len = BYTE_SIZE; // because padding was added during readBlock
-        }
+    if ( outputFile == NULL ) {
+        perror( opts.outputFile );
+        exit( 1 );
+    }
 
-        encryptBlock( &block, K );
+    statsEnd( PHASE_OPEN, &mark );
 
-        writeBlock( outputFile, &block );
+    // Don't leave a partial output file behind
+    if ( !cryptFile( &opts, ctx, false, inputFile, outputFile ) ) {
+        fclose( outputFile );
+        if ( !isStdio( opts.outputFile ) ) {
+            remove( opts.outputFile );
+        }
+        statsReport( stderr, "encrypt", false );
+        exit( 1 );
     }
 
+    // Anything stdio still buffered only fails to write here
+    statsBegin( &mark );
     fclose( inputFile );
-    fclose( outputFile );
+    bool closed = fclose( outputFile ) == 0;
+    statsEnd( PHASE_CLOSE, &mark );
+    desContextFree( ctx );
+    if ( !closed ) {
+        perror( opts.outputFile );
+        if ( !isStdio( opts.outputFile ) ) {
+            remove( opts.outputFile );
+        }
+        statsReport( stderr, "encrypt", false );
+        exit( 1 );
+    }
+    statsReport( stderr, "encrypt", true );
 
     return 0;
 }
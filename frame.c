@@ -0,0 +1,113 @@
+/**
+    @file frame.c
+    @author John Butterfield (jpbutte2)
+    Frame component. Compressing a chunk before it is encrypted means
+    fewer bytes go through DES and out to the file; a chunk that doesn't
+    get any smaller is stored as it is, so it costs no more than it did
+    without compression.
+*/
+
+#include "frame.h"
+#include "lz.h"
+#include "DESPerm.h"
+
+/** Bit of the plaintext length in a frame header that marks a chunk
+    stored uncompressed. */
+#define FRAME_STORED 0x80000000U
+
+/**
+    Start the stream a frame is encrypted with.
+    @param ctx the context
+    @param stream the stream to set up
+    @param decrypt true to decrypt, false to encrypt
+    @param nonce nonce from the file header
+    @param index index of the frame in the file
+*/
+static void frameStream( DESContext const *ctx, DESStream *stream, bool decrypt,
+                         uint64_t nonce, uint64_t index )
+{
+    if ( desContextMode( ctx ) != MODE_CBC ) {
+        desStreamInit( stream, decrypt, nonce );
+        stream->pos = index * FRAME_SPACING;
+        return;
+    }
+
+    // Encrypting the nonce plus the index gives each frame an IV that
+    // can't be guessed from the one before
+    byte iv[ BLOCK_BYTES ];
+    storeBlock64( iv, nonce + index );
+    desCryptBlocks( ctx, false, iv, iv, BLOCK_BYTES );
+    desStreamInit( stream, decrypt, loadBlock64( iv ) );
+}
+
+size_t frameBound( size_t len )
+{
+    return FRAME_HEADER_BYTES + len + BLOCK_BYTES;
+}
+
+size_t frameSeal( DESContext const *ctx, uint64_t nonce, uint64_t index, byte *dst,
+                  byte const *src, size_t len, bool compress )
+{
+    if ( len == 0 ) {
+        return 0;
+    }
+
+    // The compressed bytes go straight where the payload goes, and are
+    // encrypted in place; they are only kept if they come out smaller
+    byte *payload = dst + FRAME_HEADER_BYTES;
+    byte const *from = payload;
+    size_t packed = compress ? lzCompress( payload, len - 1, src, len ) : 0;
+    uint32_t info = len;
+    if ( packed == 0 ) {
+        from = src;
+        packed = len;
+        info |= FRAME_STORED;
+    }
+
+    DESStream stream;
+    frameStream( ctx, &stream, false, nonce, index );
+    size_t payloadLen = desStreamCrypt( ctx, &stream, payload, from, packed, true );
+
+    storeBlock64( dst, (uint64_t) payloadLen << 32 | info );
+    return FRAME_HEADER_BYTES + payloadLen;
+}
+
+bool frameSizes( byte const header[ FRAME_HEADER_BYTES ], size_t *payload, size_t *len )
+{
+    uint64_t sizes = loadBlock64( header );
+    *payload = sizes >> 32;
+    *len = sizes & ~FRAME_STORED & 0xFFFFFFFFU;
+
+    return *len > 0 && *len <= FRAME_MAX_BYTES && *payload > 0 &&
+           *payload <= frameBound( *len ) - FRAME_HEADER_BYTES;
+}
+
+size_t frameOpen( DESContext const *ctx, uint64_t nonce, uint64_t index, byte *dst,
+                  byte *payload, byte const header[ FRAME_HEADER_BYTES ] )
+{
+    size_t payloadLen, len;
+    frameSizes( header, &payloadLen, &len );
+
+    DESStream stream;
+    frameStream( ctx, &stream, true, nonce, index );
+
+    // Stored chunks decrypt straight into place; ECB blocks keep any
+    // zero bytes at their end, since the header has the exact length
+    if ( loadBlock64( header ) & FRAME_STORED ) {
+        if ( desContextMode( ctx ) == MODE_ECB ) {
+            if ( payloadLen != ( len + BLOCK_BYTES - 1 ) / BLOCK_BYTES * BLOCK_BYTES ) {
+                return DES_INVALID;
+            }
+            desCryptBlocks( ctx, true, dst, payload, payloadLen );
+            return len;
+        }
+        size_t outLen = desStreamCrypt( ctx, &stream, dst, payload, payloadLen, true );
+        return outLen == len ? len : DES_INVALID;
+    }
+
+    size_t packed = desStreamCrypt( ctx, &stream, payload, payload, payloadLen, true );
+    if ( packed == DES_INVALID || !lzDecompress( dst, len, payload, packed ) ) {
+        return DES_INVALID;
+    }
+    return len;
+}
@@ -0,0 +1,89 @@
+/**
+    @file frame.h
+    @author John Butterfield (jpbutte2)
+    Header for the frame component. A file with the HEADER_COMPRESSED or
+    HEADER_INDEXED flag holds its data as a run of frames, one for each
+    chunk of plaintext, so chunks can be compressed and encrypted on
+    different threads. Each frame is an 8-byte header, then the payload:
+    the chunk compressed with lz.h and encrypted, or just encrypted if
+    it isn't compressed or doesn't get smaller. The frame header is not
+    encrypted. It holds the number of payload bytes in its first four
+    bytes and the number of plaintext bytes in the last four, both
+    big-endian, with the top bit of the plaintext length set for a chunk
+    stored uncompressed. Every frame is encrypted on its own: in CTR
+    mode at a position in the key stream set by the frame's index, and
+    in CBC mode with its own IV, the encrypted nonce plus index, and its
+    own padding. ECB frames are always stored uncompressed, since their
+    zero padding would hide where the compressed data ends, and the
+    length in the frame header says how much of the last block is real.
+*/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "DES.h"
+#include "DESContext.h"
+
+/** Number of bytes in the header of a frame. */
+#define FRAME_HEADER_BYTES 8
+
+/** Most plaintext bytes in one frame. */
+#define FRAME_MAX_BYTES ( 64 * 1024 * 1024 )
+
+/** Distance in bytes between the starts of neighbouring frames in the
+    CTR key stream, so no two frames share a counter. */
+#define FRAME_SPACING ( (uint64_t) 1 << 40 )
+
+/**
+    This function returns the most bytes a frame for len bytes of
+    plaintext can take, header included.
+    @param len number of plaintext bytes
+    @return the most frame bytes
+*/
+size_t frameBound( size_t len );
+
+/**
+    This function compresses and encrypts a chunk into a frame. An
+    empty chunk makes no frame at all.
+    @param ctx the context
+    @param nonce nonce from the file header
+    @param index index of the frame in the file
+    @param dst where the frame goes, with room for frameBound() bytes
+    @param src the plaintext
+    @param len number of plaintext bytes, at most FRAME_MAX_BYTES
+    @param compress true to try compressing the chunk, which needs CTR
+    or CBC mode, false to store it as it is
+    @return number of bytes in the frame
+*/
+size_t frameSeal( DESContext const *ctx, uint64_t nonce, uint64_t index, byte *dst,
+                  byte const *src, size_t len, bool compress );
+
+/**
+    This function gets the sizes out of a frame header.
+    @param header the frame header
+    @param payload where to store the number of payload bytes after it
+    @param len where to store the number of plaintext bytes
+    @return false if the sizes are out of range
+*/
+bool frameSizes( byte const header[ FRAME_HEADER_BYTES ], size_t *payload, size_t *len );
+
+/**
+    This function decrypts and decompresses the payload of a frame.
+    @param ctx the context
+    @param nonce nonce from the file header
+    @param index index of the frame in the file
+    @param dst where the plaintext goes, with room for frameBound()
+    bytes for the plaintext length in the header
+    @param payload the payload, with as many bytes as the header says;
+    it is decrypted in place
+    @param header the frame header, already checked by frameSizes()
+    @return number of plaintext bytes, or DES_INVALID if the frame
+    doesn't decrypt to what its header says
+*/
+size_t frameOpen( DESContext const *ctx, uint64_t nonce, uint64_t index, byte *dst,
+                  byte *payload, byte const header[ FRAME_HEADER_BYTES ] );
+
+#endif
@@ -5,7 +5,31 @@
     files that the DES algorithm uses.
 */
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "io.h"
+#include "pool.h"
+#include "DESPerm.h"
+
+/** Magic number at the start of a file header. */
+static byte const headerMagic[ 4 ] = { 'D', 'E', 'S', 'M' };
+
+/** Position of the version byte in a file header. */
+#define HEADER_VERSION_POS 4
+
+/** Position of the mode byte in a file header. */
+#define HEADER_MODE_POS 5
+
+/** Position of the flags byte in a file header. */
+#define HEADER_FLAGS_POS 6
+
+/** Position of the nonce in a file header. */
+#define HEADER_NONCE_POS 8
 
 void readBlock(FILE *fp, DESBlock *block) {
     
@@ -25,3 +49,299 @@ void writeBlock(FILE *fp, DESBlock const *block) {
     fwrite(block->data, sizeof(byte), block->len, fp);
     
 }
+
+bool openChunkReader( ChunkReader *reader, FILE *fp, size_t chunkBytes, bool huge )
+{
+    reader->fp = fp;
+    reader->capacity = ( chunkBytes + BLOCK_BYTES - 1 ) / BLOCK_BYTES * BLOCK_BYTES;
+    if ( reader->capacity == 0 ) {
+        reader->capacity = BLOCK_BYTES;
+    }
+    reader->len = 0;
+    reader->last = false;
+
+    // Chunks go straight into our buffer, so stdio doesn't need its own
+    setvbuf( fp, NULL, _IONBF, 0 );
+
+    // One spare block lets a mode add a block of padding in place
+    reader->data = poolTake( reader->capacity + BLOCK_BYTES, huge );
+    return reader->data != NULL;
+}
+
+size_t readFull( FILE *fp, byte *data, size_t capacity, bool *last )
+{
+    size_t len = fread( data, sizeof( byte ), capacity, fp );
+
+    // Look one byte ahead, so a full chunk at the end is marked last
+    if ( len == capacity ) {
+        int ch = getc( fp );
+        if ( ch == EOF ) {
+            *last = true;
+        } else {
+            ungetc( ch, fp );
+        }
+    } else {
+        *last = true;
+
+        // Add padding to the end of the final block
+        size_t padded = ( len + BLOCK_BYTES - 1 ) / BLOCK_BYTES * BLOCK_BYTES;
+        memset( data + len, 0, padded - len );
+    }
+
+    return len;
+}
+
+size_t readChunk( ChunkReader *reader )
+{
+    if ( reader->last ) {
+        reader->len = 0;
+        return 0;
+    }
+
+    reader->len = readFull( reader->fp, reader->data, reader->capacity, &reader->last );
+
+    return ( reader->len + BLOCK_BYTES - 1 ) / BLOCK_BYTES;
+}
+
+void closeChunkReader( ChunkReader *reader )
+{
+    poolGive( reader->data, reader->capacity + BLOCK_BYTES );
+    reader->data = NULL;
+}
+
+bool openChunkWriter( ChunkWriter *writer, FILE *fp, size_t chunkBytes, bool huge )
+{
+    writer->fp = fp;
+    writer->capacity = chunkBytes > 0 ? chunkBytes : BLOCK_BYTES;
+    writer->len = 0;
+
+    setvbuf( fp, NULL, _IONBF, 0 );
+
+    writer->data = poolTake( writer->capacity, huge );
+    return writer->data != NULL;
+}
+
+bool writeChunk( ChunkWriter *writer, byte const *data, size_t len )
+{
+    // Large writes skip the buffer if nothing is waiting in front of them
+    if ( writer->len == 0 && len >= writer->capacity ) {
+        return fwrite( data, sizeof( byte ), len, writer->fp ) == len;
+    }
+
+    while ( len > 0 ) {
+        size_t n = writer->capacity - writer->len;
+        if ( n > len ) {
+            n = len;
+        }
+
+        memcpy( writer->data + writer->len, data, n );
+        writer->len += n;
+        data += n;
+        len -= n;
+
+        if ( writer->len == writer->capacity ) {
+            size_t full = writer->len;
+            writer->len = 0;
+            if ( fwrite( writer->data, sizeof( byte ), full, writer->fp ) != full ) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool closeChunkWriter( ChunkWriter *writer )
+{
+    bool ok = writer->len == 0 ||
+              fwrite( writer->data, sizeof( byte ), writer->len, writer->fp ) == writer->len;
+    writer->len = 0;
+
+    poolGive( writer->data, writer->capacity );
+    writer->data = NULL;
+    return ok;
+}
+
+bool isStdio( char const *name )
+{
+    return strcmp( name, STDIO_NAME ) == 0;
+}
+
+FILE *openFile( char const *name, char const *mode )
+{
+    if ( isStdio( name ) ) {
+        return mode[ 0 ] == 'r' ? stdin : stdout;
+    }
+
+    return fopen( name, mode );
+}
+
+bool regularFileSize( FILE *fp, off_t *size )
+{
+    struct stat st;
+    if ( fstat( fileno( fp ), &st ) != 0 || !S_ISREG( st.st_mode ) ) {
+        return false;
+    }
+
+    *size = st.st_size;
+    return true;
+}
+
+/**
+    Return how far offset is past the start of its page.
+    @param offset a position in a file
+    @return distance from the page boundary at or before offset
+*/
+static size_t pageSlack( off_t offset )
+{
+    return offset % sysconf( _SC_PAGESIZE );
+}
+
+byte *mapRegion( int fd, off_t offset, size_t len, bool writable )
+{
+    // mmap() wants the offset on a page boundary
+    size_t slack = pageSlack( offset );
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+
+    void *addr = mmap( NULL, len + slack, prot, MAP_SHARED, fd, offset - slack );
+    if ( addr == MAP_FAILED ) {
+        return NULL;
+    }
+
+    madvise( addr, len + slack, MADV_SEQUENTIAL );
+    return (byte *) addr + slack;
+}
+
+void unmapRegion( byte *addr, off_t offset, size_t len )
+{
+    size_t slack = pageSlack( offset );
+    munmap( addr - slack, len + slack );
+}
+
+ssize_t readAt( int fd, byte *data, size_t len, off_t offset )
+{
+    size_t done = 0;
+    while ( done < len ) {
+        ssize_t n = pread( fd, data + done, len - done, offset + done );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n < 0 ) {
+            return -1;
+        }
+        if ( n == 0 ) {
+            break;
+        }
+        done += n;
+    }
+
+    return done;
+}
+
+bool writeAt( int fd, byte const *data, size_t len, off_t offset )
+{
+    size_t done = 0;
+    while ( done < len ) {
+        ssize_t n = pwrite( fd, data + done, len - done, offset + done );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return false;
+        }
+        done += n;
+    }
+
+    return true;
+}
+
+void encodeHeader( byte header[ HEADER_BYTES ], int mode, uint64_t nonce, int flags )
+{
+    memset( header, 0, HEADER_BYTES );
+    memcpy( header, headerMagic, sizeof( headerMagic ) );
+    header[ HEADER_VERSION_POS ] = flags == 0 ? HEADER_VERSION : HEADER_VERSION_FLAGS;
+    header[ HEADER_MODE_POS ] = mode;
+    header[ HEADER_FLAGS_POS ] = flags;
+    storeBlock64( header + HEADER_NONCE_POS, nonce );
+}
+
+bool decodeHeader( byte const header[ HEADER_BYTES ], int mode, uint64_t *nonce, int *flags )
+{
+    // Files without flags keep the first version, so older programs
+    // can still read them
+    int version = header[ HEADER_FLAGS_POS ] == 0 ? HEADER_VERSION : HEADER_VERSION_FLAGS;
+    if ( memcmp( header, headerMagic, sizeof( headerMagic ) ) != 0 ||
+         header[ HEADER_VERSION_POS ] != version ||
+         header[ HEADER_MODE_POS ] != mode ||
+         ( header[ HEADER_FLAGS_POS ] & ~HEADER_KNOWN_FLAGS ) != 0 ) {
+        return false;
+    }
+
+    *nonce = loadBlock64( header + HEADER_NONCE_POS );
+    *flags = header[ HEADER_FLAGS_POS ];
+    return true;
+}
+
+bool writeAll( int fd, byte const *data, size_t len )
+{
+    size_t done = 0;
+    while ( done < len ) {
+        ssize_t n = write( fd, data + done, len - done );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return false;
+        }
+        done += n;
+    }
+
+    return true;
+}
+
+bool readAll( int fd, byte *data, size_t len )
+{
+    size_t done = 0;
+    while ( done < len ) {
+        ssize_t n = read( fd, data + done, len - done );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return false;
+        }
+        done += n;
+    }
+
+    return true;
+}
+
+bool writeHeader( int fd, int mode, uint64_t nonce, int flags )
+{
+    byte header[ HEADER_BYTES ];
+    encodeHeader( header, mode, nonce, flags );
+    return writeAll( fd, header, HEADER_BYTES );
+}
+
+bool readHeader( int fd, int mode, uint64_t *nonce, int *flags )
+{
+    byte header[ HEADER_BYTES ];
+    return readAll( fd, header, HEADER_BYTES ) && decodeHeader( header, mode, nonce, flags );
+}
+
+bool randomBytes( byte *data, size_t len )
+{
+    size_t done = 0;
+    while ( done < len ) {
+        ssize_t n = getrandom( data + done, len - done, 0 );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n < 0 ) {
+            return false;
+        }
+        done += n;
+    }
+
+    return true;
+}
@@ -6,9 +6,81 @@
     files that the DES algorithm encrypted or decrypted.
 */
 
+#ifndef IO_H
+#define IO_H
+
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
 #include "DES.h"
 
+/** Number of bytes in the header at the start of files written in a
+    chained mode: a 4-byte magic number, a version byte, a mode byte,
+    a flags byte, a zero byte and an 8-byte big-endian nonce. */
+#define HEADER_BYTES 16
+
+/** Version of the file header for files with no flags set, which is
+    all that the first version had. */
+#define HEADER_VERSION 1
+
+/** Version of the file header for files with flags set, so programs
+    that don't know about the flags reject the file. */
+#define HEADER_VERSION_FLAGS 2
+
+/** Flag for data stored as compressed frames, as frame.h describes. */
+#define HEADER_COMPRESSED 0x01
+
+/** Flag for an indexed file, as container.h describes. Indexed files
+    have a header in ECB mode too. */
+#define HEADER_INDEXED 0x02
+
+/** Every flag this version knows about. */
+#define HEADER_KNOWN_FLAGS ( HEADER_COMPRESSED | HEADER_INDEXED )
+
+/** Default number of bytes moved by each read or write of a chunk. */
+#define DEFAULT_CHUNK_BYTES ( 1024 * 1024 )
+
+/** File name that stands for standard input or standard output. */
+#define STDIO_NAME "-"
+
+/** Number of bytes of a file mapped into memory at a time. */
+#define MAP_WINDOW_BYTES ( 64 * 1024 * 1024 )
+
+/** Type used to read a file a large chunk at a time. */
+typedef struct {
+  /** File the chunks are read from. */
+  FILE *fp;
+
+  /** Buffer holding the current chunk. */
+  byte *data;
+
+  /** Size of the buffer, a whole number of blocks. */
+  size_t capacity;
+
+  /** Number of bytes of the file in the current chunk. */
+  size_t len;
+
+  /** True once the last chunk of the file has been read, including
+      when that chunk is full. */
+  bool last;
+} ChunkReader;
+
+/** Type used to write a file a large chunk at a time. */
+typedef struct {
+  /** File the chunks are written to. */
+  FILE *fp;
+
+  /** Buffer collecting output until there is a whole chunk. */
+  byte *data;
+
+  /** Size of the buffer. */
+  size_t capacity;
+
+  /** Number of bytes waiting in the buffer. */
+  size_t len;
+} ChunkWriter;
+
 /**
     This function reads up to 8 bytes from the given input file, 
     storing them in the data array of block and setting the len 
@@ -28,3 +100,224 @@ void readBlock( FILE *fp, DESBlock *block );
                 block of memory to write to a given file
 */
 void writeBlock( FILE *fp, DESBlock const *block );
+
+/**
+    This function prepares to read the given file in chunks of about
+    chunkBytes bytes, rounded up to a whole number of blocks.
+    @param reader the reader to set up
+    @param fp a pointer to a file to read from
+    @param chunkBytes number of bytes to read at a time
+    @param huge true to back a large chunk buffer with huge pages
+    @return true if the chunk buffer could be allocated
+*/
+bool openChunkReader( ChunkReader *reader, FILE *fp, size_t chunkBytes, bool huge );
+
+/**
+    This function reads up to capacity bytes from the given file,
+    stopping short only at the end of the file, and works on pipes as
+    well as regular files. The last flag is set when there is nothing
+    left after these bytes, including when they fill the buffer. If
+    the bytes end partway through a block, the rest of that block is
+    filled with zero bytes, so data needs room for one block more than
+    capacity.
+    @param fp a pointer to a file to read from
+    @param data where to store the bytes
+    @param capacity number of bytes wanted, a whole number of blocks
+    @param last set to true if the file has no more bytes
+    @return number of bytes read
+*/
+size_t readFull( FILE *fp, byte *data, size_t capacity, bool *last );
+
+/**
+    This function reads the next chunk of the file into the data array
+    of reader and sets its len field. Every chunk but the last is full,
+    and the last field is set along with the last chunk. If the last
+    chunk ends partway through a block, the rest of that block is filled
+    with zero bytes. The buffer has room for one block more than a full
+    chunk.
+    @param reader the reader to fill
+    @return number of blocks in the chunk, or zero at the end of the file
+*/
+size_t readChunk( ChunkReader *reader );
+
+/**
+    This function frees the buffer of a chunk reader. It does not close
+    the file.
+    @param reader the reader to free
+*/
+void closeChunkReader( ChunkReader *reader );
+
+/**
+    This function prepares to write the given file in chunks of
+    chunkBytes bytes.
+    @param writer the writer to set up
+    @param fp a pointer to a file to write to
+    @param chunkBytes number of bytes to write at a time
+    @param huge true to back a large chunk buffer with huge pages
+    @return true if the chunk buffer could be allocated
+*/
+bool openChunkWriter( ChunkWriter *writer, FILE *fp, size_t chunkBytes, bool huge );
+
+/**
+    This function queues len bytes of data for writing. Data is written
+    to the file whenever a whole chunk is waiting, and a run of at least
+    a chunk is written straight from data without being copied.
+    @param writer the writer to use
+    @param data the bytes to write
+    @param len number of bytes to write
+    @return false if writing to the file failed
+*/
+bool writeChunk( ChunkWriter *writer, byte const *data, size_t len );
+
+/**
+    This function writes anything still waiting in a chunk writer and
+    frees its buffer, even if writing fails. It does not close the file.
+    @param writer the writer to finish
+    @return false if writing to the file failed
+*/
+bool closeChunkWriter( ChunkWriter *writer );
+
+/**
+    This function reports whether a file name given on the command line
+    stands for standard input or standard output.
+    @param name the file name
+    @return true if name is STDIO_NAME
+*/
+bool isStdio( char const *name );
+
+/**
+    This function opens the named file with fopen(), or returns stdin
+    or stdout for STDIO_NAME, depending on whether mode is for reading
+    or writing.
+    @param name the file name
+    @param mode the mode to pass to fopen()
+    @return the open file, or NULL if it can't be opened
+*/
+FILE *openFile( char const *name, char const *mode );
+
+/**
+    This function reports whether the given file is a regular file,
+    as opposed to a pipe or a terminal, and how big it is.
+    @param fp a pointer to an open file
+    @param size where to store the size of the file
+    @return true if fp is a regular file
+*/
+bool regularFileSize( FILE *fp, off_t *size );
+
+/**
+    This function maps len bytes of a file into memory, starting at the
+    given offset, which doesn't need to be page aligned. The mapping is
+    marked for sequential access.
+    @param fd descriptor of the file to map
+    @param offset position in the file of the first byte to map
+    @param len number of bytes to map
+    @param writable true to map the bytes for writing as well as reading
+    @return address of the byte at offset, or NULL if it can't be mapped
+*/
+byte *mapRegion( int fd, off_t offset, size_t len, bool writable );
+
+/**
+    This function unmaps a region mapped with mapRegion().
+    @param addr address returned by mapRegion()
+    @param offset offset passed to mapRegion()
+    @param len length passed to mapRegion()
+*/
+void unmapRegion( byte *addr, off_t offset, size_t len );
+
+/**
+    This function reads up to len bytes from the given position in a
+    file, retrying short reads, without moving the file position. It
+    stops early only at the end of the file.
+    @param fd descriptor of the file to read
+    @param data where to store the bytes
+    @param len number of bytes wanted
+    @param offset position in the file of the first byte
+    @return number of bytes read, or -1 on an error
+*/
+ssize_t readAt( int fd, byte *data, size_t len, off_t offset );
+
+/**
+    This function writes len bytes at the given position in a file,
+    retrying short writes, without moving the file position.
+    @param fd descriptor of the file to write
+    @param data the bytes to write
+    @param len number of bytes to write
+    @param offset position in the file for the first byte
+    @return true if all the bytes were written
+*/
+bool writeAt( int fd, byte const *data, size_t len, off_t offset );
+
+/**
+    This function writes len bytes at the current position of a file
+    descriptor, retrying short writes.
+    @param fd descriptor of the file to write
+    @param data the bytes to write
+    @param len number of bytes to write
+    @return true if all the bytes were written
+*/
+bool writeAll( int fd, byte const *data, size_t len );
+
+/**
+    This function reads exactly len bytes from the current position of
+    a file descriptor, retrying short reads, so it works on pipes.
+    @param fd descriptor of the file to read
+    @param data where to store the bytes
+    @param len number of bytes wanted
+    @return true if all the bytes were read, false at an error or the
+    end of the file
+*/
+bool readAll( int fd, byte *data, size_t len );
+
+/**
+    This function fills in a file header.
+    @param header where to store the header
+    @param mode mode of operation to record in the header
+    @param nonce nonce to record in the header
+    @param flags HEADER_ flags to record in the header
+*/
+void encodeHeader( byte header[ HEADER_BYTES ], int mode, uint64_t nonce, int flags );
+
+/**
+    This function checks a file header was written for the given mode
+    and gets the nonce and flags from it. A header with flags this
+    version doesn't know about isn't valid.
+    @param header the header
+    @param mode mode of operation the header should record
+    @param nonce where to store the nonce from the header
+    @param flags where to store the flags from the header
+    @return true if the header is valid for mode
+*/
+bool decodeHeader( byte const header[ HEADER_BYTES ], int mode, uint64_t *nonce, int *flags );
+
+/**
+    This function writes a file header at the current position of a
+    file descriptor.
+    @param fd descriptor of the file to write
+    @param mode mode of operation to record in the header
+    @param nonce nonce to record in the header
+    @param flags HEADER_ flags to record in the header
+    @return true if successful
+*/
+bool writeHeader( int fd, int mode, uint64_t nonce, int flags );
+
+/**
+    This function reads a file header from the current position of a
+    file descriptor and checks it was written for the given mode.
+    @param fd descriptor of the file to read
+    @param mode mode of operation the header should record
+    @param nonce where to store the nonce from the header
+    @param flags where to store the flags from the header
+    @return true if a valid header for mode was read
+*/
+bool readHeader( int fd, int mode, uint64_t *nonce, int *flags );
+
+/**
+    This function fills a buffer with random bytes from the kernel, for
+    use as a nonce.
+    @param data where to store the bytes
+    @param len number of bytes wanted
+    @return true if successful
+*/
+bool randomBytes( byte *data, size_t len );
+
+#endif
@@ -0,0 +1,817 @@
+/**
+    @file keysearch.c
+    @author John Butterfield (jpbutte2)
+    This is the main component for the keysearch program. Given a file
+    of known plaintext and the file it was encrypted into, it tries
+    every key made of characters from a charset, over a range of
+    lengths, the way prepareKey() turns text into a key, and reports
+    the ones that turn the first plaintext block into the first
+    ciphertext block.
+
+    The search runs the bitsliced engine across keys instead of across
+    blocks: each of the 64 lanes holds a different candidate key, all
+    encrypting the same block, and bitsliceKeySchedule() turns the
+    keys straight into subkey planes. Between passes each candidate is
+    stepped on like an odometer, so only the characters that change
+    are touched. The key space is cut into tasks that worker threads
+    take in order, and with --checkpoint the point every earlier task
+    has reached is saved regularly, so an interrupted search can pick
+    up from there.
+
+    DES ignores the low bit of each key byte, so characters that differ
+    only in that bit give the same key, and every such spelling of a
+    matching key is reported.
+
+    usage: keysearch [--charset <chars>] [--min-length <n>] [--max-length <n>]
+                     [--mode <ecb|ctr|cbc>] [-j <n>] [--checkpoint <file>]
+                     <plain_file> <cipher_file>
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include "io.h"
+#include "options.h"
+#include "DESBitslice.h"
+#include "DESPerm.h"
+
+/** Number of keys in one task, a whole number of passes. */
+#define TASK_KEYS ( BITSLICE_WIDTH * 4096 )
+
+/** Seconds between saves of the checkpoint file. */
+#define CHECKPOINT_SECONDS 10
+
+/** Version written on the first line of a checkpoint file. */
+#define CHECKPOINT_VERSION 1
+
+/** Most distinct characters a charset can hold: every byte but zero. */
+#define CHARSET_MAX 255
+
+/** Task number a worker reports while it isn't working on a task. */
+#define NO_TASK UINT64_MAX
+
+/** Set by SIGINT or SIGTERM to stop handing out tasks. */
+static volatile sig_atomic_t stopRequested;
+
+/** Position in the key space, held as digits in the charset. */
+typedef struct {
+  /** Number of characters in the key. */
+  int length;
+
+  /** Index into the charset of each character, most significant first. */
+  int digit[ BLOCK_BYTES ];
+
+  /** The key as prepareKey() would make it, zero after length. */
+  byte key[ BLOCK_BYTES ];
+} KeyCounter;
+
+/** State shared by the workers of one search. */
+typedef struct {
+  /** Distinct characters to build keys from. */
+  char charset[ CHARSET_MAX + 1 ];
+
+  /** Number of characters in charset. */
+  int charCount;
+
+  /** Shortest key to try. */
+  int minLength;
+
+  /** Longest key to try. */
+  int maxLength;
+
+  /** Block each candidate encrypts. */
+  uint64_t in;
+
+  /** Block the right key turns it into. */
+  uint64_t out;
+
+  /** Number of leading bits of out that are known, for a CTR file
+      with less than a block of plaintext. */
+  int knownBits;
+
+  /** Number of keys in the whole key space. */
+  uint64_t total;
+
+  /** Number of tasks the key space is cut into. */
+  uint64_t taskCount;
+
+  /** Protects everything below. */
+  pthread_mutex_t lock;
+
+  /** Next task to hand out. */
+  uint64_t nextTask;
+
+  /** Task each worker is on, or NO_TASK. */
+  uint64_t *current;
+
+  /** Number of entries in current. */
+  int workerCount;
+
+  /** Indexes of the matching keys found so far. */
+  uint64_t *found;
+
+  /** Number of entries in found. */
+  int foundCount;
+
+  /** Capacity of found. */
+  int foundCapacity;
+
+  /** File to save progress in, or NULL. */
+  char const *checkpoint;
+
+  /** When progress was last saved. */
+  double lastSave;
+} Search;
+
+/** One thread of the search. */
+typedef struct {
+  /** The search it works on. */
+  Search *search;
+
+  /** Its place in search->current. */
+  int index;
+
+  /** Number of keys it tried. */
+  uint64_t keys;
+
+  /** CPU time it used, in seconds. */
+  double cpu;
+
+  /** The thread itself. */
+  pthread_t thread;
+} Worker;
+
+/**
+    Print a usage message and exit unsuccessfully.
+*/
+static void usage( void )
+{
+    fprintf( stderr, "usage: keysearch [--charset <chars>] [--min-length <n>] "
+             "[--max-length <n>] [--mode <ecb|ctr|cbc>] [-j <n>] [--checkpoint <file>] "
+             "<plain_file> <cipher_file>\n" );
+    exit( 1 );
+}
+
+/**
+    Read a clock.
+    @param clock the clock to read
+    @return its time in seconds
+*/
+static double readClock( clockid_t clock )
+{
+    struct timespec ts;
+    clock_gettime( clock, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+    Ask the workers to stop after their current task.
+    @param sig the signal that arrived
+*/
+static void requestStop( int sig )
+{
+    stopRequested = 1;
+}
+
+/**
+    Parse a key length given to --min-length or --max-length.
+    @param text the string to parse
+    @param length where to store the length
+    @return true if text is a length from 1 to BLOCK_BYTES
+*/
+static bool parseLength( char const *text, int *length )
+{
+    char *end;
+    long value = strtol( text, &end, 10 );
+    if ( end == text || *end != '\0' || value < 1 || value > BLOCK_BYTES ) {
+        return false;
+    }
+
+    *length = value;
+    return true;
+}
+
+/**
+    Set the charset, dropping repeated characters.
+    @param search the search to set it for
+    @param text the characters
+*/
+static void setCharset( Search *search, char const *text )
+{
+    bool seen[ CHARSET_MAX + 1 ] = { false };
+    search->charCount = 0;
+
+    for ( byte const *c = (byte const *) text; *c; c++ ) {
+        if ( !seen[ *c ] ) {
+            seen[ *c ] = true;
+            search->charset[ search->charCount++ ] = *c;
+        }
+    }
+    search->charset[ search->charCount ] = '\0';
+}
+
+/**
+    Count the keys of every length the search covers. Even 255
+    characters and 8 of them give fewer than 2^64 keys.
+    @param search the search, with its charset and lengths set
+*/
+static void countKeys( Search *search )
+{
+    uint64_t perLength = 1;
+    search->total = 0;
+
+    for ( int len = 1; len <= search->maxLength; len++ ) {
+        perLength *= search->charCount;
+        if ( len >= search->minLength ) {
+            search->total += perLength;
+        }
+    }
+
+    search->taskCount = ( search->total + TASK_KEYS - 1 ) / TASK_KEYS;
+}
+
+/**
+    Move a counter to the key with the given index. Keys are numbered
+    from the shortest length up, and in charset order within a length.
+    @param search the search
+    @param counter the counter to set
+    @param index index of the key, less than search->total
+*/
+static void seekKey( Search const *search, KeyCounter *counter, uint64_t index )
+{
+    uint64_t perLength = 1;
+    for ( int len = 1; len < search->minLength; len++ ) {
+        perLength *= search->charCount;
+    }
+
+    int len = search->minLength;
+    for ( ;; ) {
+        perLength *= search->charCount;
+        if ( index < perLength ) {
+            break;
+        }
+        index -= perLength;
+        len++;
+    }
+
+    memset( counter->key, 0, BLOCK_BYTES );
+    counter->length = len;
+    for ( int i = len - 1; i >= 0; i-- ) {
+        counter->digit[ i ] = index % search->charCount;
+        counter->key[ i ] = search->charset[ counter->digit[ i ] ];
+        index /= search->charCount;
+    }
+}
+
+/**
+    Step a counter on to the next key. Usually only the last character
+    changes; when every character wraps around, the key gets longer.
+    @param search the search
+    @param counter the counter to step
+*/
+static void nextKey( Search const *search, KeyCounter *counter )
+{
+    for ( int i = counter->length - 1; i >= 0; i-- ) {
+        if ( ++counter->digit[ i ] < search->charCount ) {
+            counter->key[ i ] = search->charset[ counter->digit[ i ] ];
+            return;
+        }
+        counter->digit[ i ] = 0;
+        counter->key[ i ] = search->charset[ 0 ];
+    }
+
+    // Past the last key of this length
+    if ( counter->length < BLOCK_BYTES ) {
+        counter->digit[ counter->length ] = 0;
+        counter->key[ counter->length ] = search->charset[ 0 ];
+    }
+    counter->length++;
+}
+
+/**
+    Record a matching key, unless it was already found before a resume.
+    @param search the search
+    @param index index of the key
+    @return true if successful, false if there isn't enough memory
+*/
+static bool addFound( Search *search, uint64_t index )
+{
+    for ( int i = 0; i < search->foundCount; i++ ) {
+        if ( search->found[ i ] == index ) {
+            return true;
+        }
+    }
+
+    if ( search->foundCount == search->foundCapacity ) {
+        int capacity = search->foundCapacity ? search->foundCapacity * 2 : 16;
+        uint64_t *found = realloc( search->found, capacity * sizeof( uint64_t ) );
+        if ( found == NULL ) {
+            return false;
+        }
+        search->found = found;
+        search->foundCapacity = capacity;
+    }
+
+    search->found[ search->foundCount++ ] = index;
+    return true;
+}
+
+/**
+    Work out the first task that isn't finished yet: every key before
+    it has been tried. Called with the lock held.
+    @param search the search
+    @return the task number, or search->taskCount when all are done
+*/
+static uint64_t finishedUpTo( Search const *search )
+{
+    uint64_t task = search->nextTask;
+    for ( int i = 0; i < search->workerCount; i++ ) {
+        if ( search->current[ i ] < task ) {
+            task = search->current[ i ];
+        }
+    }
+    return task;
+}
+
+/**
+    Save the search's progress, writing a new file and renaming it over
+    the old one so a crash never leaves half a checkpoint. Called with
+    the lock held.
+    @param search the search
+    @return true if successful
+*/
+static bool saveCheckpoint( Search *search )
+{
+    size_t nameLen = strlen( search->checkpoint );
+    char *tmpName = malloc( nameLen + sizeof( ".tmp" ) );
+    if ( tmpName == NULL ) {
+        return false;
+    }
+    memcpy( tmpName, search->checkpoint, nameLen );
+    strcpy( tmpName + nameLen, ".tmp" );
+
+    FILE *fp = fopen( tmpName, "w" );
+    if ( fp == NULL ) {
+        free( tmpName );
+        return false;
+    }
+
+    fprintf( fp, "keysearch %d\ncharset ", CHECKPOINT_VERSION );
+    for ( int i = 0; i < search->charCount; i++ ) {
+        fprintf( fp, "%02x", (byte) search->charset[ i ] );
+    }
+    fprintf( fp, "\nlength %d %d\nblock %016llx %016llx %d\nnext %llu\n",
+             search->minLength, search->maxLength, (unsigned long long) search->in,
+             (unsigned long long) search->out, search->knownBits,
+             (unsigned long long) finishedUpTo( search ) );
+    for ( int i = 0; i < search->foundCount; i++ ) {
+        fprintf( fp, "found %llu\n", (unsigned long long) search->found[ i ] );
+    }
+
+    bool ok = fclose( fp ) == 0 && rename( tmpName, search->checkpoint ) == 0;
+    if ( !ok ) {
+        remove( tmpName );
+    }
+    free( tmpName );
+    search->lastSave = readClock( CLOCK_MONOTONIC );
+    return ok;
+}
+
+/**
+    Pick up the progress saved in the checkpoint file, if there is one.
+    It has to be for the same charset, lengths and blocks.
+    @param search the search, with everything but its progress set up
+    @return true if successful or there is no checkpoint yet, false
+    after printing an error message
+*/
+static bool loadCheckpoint( Search *search )
+{
+    FILE *fp = fopen( search->checkpoint, "r" );
+    if ( fp == NULL ) {
+        if ( errno == ENOENT ) {
+            return true;
+        }
+        perror( search->checkpoint );
+        return false;
+    }
+
+    // Write down what this search would save, and compare
+    char expected[ 2 * CHARSET_MAX + 128 ];
+    int len = snprintf( expected, sizeof( expected ), "keysearch %d\ncharset ",
+                        CHECKPOINT_VERSION );
+    for ( int i = 0; i < search->charCount; i++ ) {
+        len += snprintf( expected + len, sizeof( expected ) - len, "%02x",
+                         (byte) search->charset[ i ] );
+    }
+    snprintf( expected + len, sizeof( expected ) - len,
+              "\nlength %d %d\nblock %016llx %016llx %d\n", search->minLength,
+              search->maxLength, (unsigned long long) search->in,
+              (unsigned long long) search->out, search->knownBits );
+
+    char actual[ sizeof( expected ) ];
+    size_t n = fread( actual, 1, strlen( expected ), fp );
+    unsigned long long next;
+    bool ok = n == strlen( expected ) && memcmp( actual, expected, n ) == 0 &&
+              fscanf( fp, "next %llu\n", &next ) == 1 && next <= search->taskCount;
+
+    unsigned long long index;
+    while ( ok && fscanf( fp, "found %llu\n", &index ) == 1 ) {
+        ok = index < search->total && addFound( search, index );
+    }
+    ok = ok && feof( fp );
+    fclose( fp );
+
+    if ( !ok ) {
+        fprintf( stderr, "%s: Not a checkpoint for this search\n", search->checkpoint );
+        return false;
+    }
+
+    search->nextTask = next;
+    return true;
+}
+
+/**
+    Try the keys from start up to end, 64 at a time.
+    @param search the search
+    @param start index of the first key
+    @param end index just past the last key
+    @return number of keys tried, or 0 if there wasn't enough memory to
+    record a match
+*/
+static uint64_t searchKeys( Search *search, uint64_t start, uint64_t end )
+{
+    // Every lane encrypts the same block
+    uint64_t inPlanes[ BLOCK_BITS ], outPlanes[ BLOCK_BITS ];
+    for ( int b = 0; b < BLOCK_BITS; b++ ) {
+        inPlanes[ b ] = -( ( search->in >> ( BLOCK_BITS - 1 - b ) ) & 1 );
+        outPlanes[ b ] = -( ( search->out >> ( BLOCK_BITS - 1 - b ) ) & 1 );
+    }
+
+    KeyCounter counter;
+    seekKey( search, &counter, start );
+
+    byte keys[ BITSLICE_WIDTH ][ BLOCK_BYTES ];
+    uint64_t keyPlanes[ BLOCK_BITS ];
+    uint64_t KP[ ROUND_COUNT ][ SUBKEY_BITS ];
+    uint64_t planes[ BLOCK_BITS ];
+
+    for ( uint64_t pos = start; pos < end; pos += BITSLICE_WIDTH ) {
+        int n = end - pos < BITSLICE_WIDTH ? end - pos : BITSLICE_WIDTH;
+        for ( int j = 0; j < n; j++ ) {
+            memcpy( keys[ j ], counter.key, BLOCK_BYTES );
+            nextKey( search, &counter );
+        }
+
+        bitsliceLoad( keyPlanes, keys[ 0 ], BLOCK_BYTES, n );
+        bitsliceKeySchedule( KP, keyPlanes );
+        memcpy( planes, inPlanes, sizeof( planes ) );
+        bitsliceCrypt( planes, KP, false );
+
+        // Key j is in bit 63 - j; keep the lanes that match every bit
+        uint64_t match = n == BITSLICE_WIDTH ? ~0ull : ~( ~0ull >> n );
+        for ( int b = 0; match != 0 && b < search->knownBits; b++ ) {
+            match &= ~( planes[ b ] ^ outPlanes[ b ] );
+        }
+
+        for ( int j = 0; match != 0 && j < n; j++ ) {
+            if ( ( match >> ( BITSLICE_WIDTH - 1 - j ) ) & 1 ) {
+                pthread_mutex_lock( &search->lock );
+                bool ok = addFound( search, pos + j );
+                pthread_mutex_unlock( &search->lock );
+                if ( !ok ) {
+                    return 0;
+                }
+            }
+        }
+    }
+
+    return end - start;
+}
+
+/**
+    Start function for each worker. Takes tasks in order until they run
+    out, or a signal asks for the search to stop, saving progress now
+    and then.
+    @param arg the worker
+    @return NULL
+*/
+static void *searchWorker( void *arg )
+{
+    Worker *worker = arg;
+    Search *search = worker->search;
+    double cpuStart = readClock( CLOCK_THREAD_CPUTIME_ID );
+
+    pthread_mutex_lock( &search->lock );
+    while ( !stopRequested && search->nextTask < search->taskCount ) {
+        uint64_t task = search->nextTask++;
+        search->current[ worker->index ] = task;
+        pthread_mutex_unlock( &search->lock );
+
+        uint64_t start = task * TASK_KEYS;
+        uint64_t end = search->total - start < TASK_KEYS ? search->total : start + TASK_KEYS;
+        uint64_t keys = searchKeys( search, start, end );
+
+        pthread_mutex_lock( &search->lock );
+        if ( keys == 0 ) {
+            // Leave the task unfinished, so a resume tries it again
+            perror( "keysearch" );
+            stopRequested = 1;
+            break;
+        }
+        worker->keys += keys;
+        search->current[ worker->index ] = NO_TASK;
+
+        if ( search->checkpoint != NULL &&
+             readClock( CLOCK_MONOTONIC ) - search->lastSave >= CHECKPOINT_SECONDS &&
+             !saveCheckpoint( search ) ) {
+            perror( search->checkpoint );
+        }
+    }
+    pthread_mutex_unlock( &search->lock );
+
+    worker->cpu = readClock( CLOCK_THREAD_CPUTIME_ID ) - cpuStart;
+    return NULL;
+}
+
+/**
+    Read up to a block from the start of a file.
+    @param fp the file
+    @param block where to store the bytes
+    @return number of bytes read
+*/
+static size_t readStart( FILE *fp, byte block[ BLOCK_BYTES ] )
+{
+    bool last;
+    return readFull( fp, block, BLOCK_BYTES, &last );
+}
+
+/**
+    Work out the block pair to search with from the start of the two
+    files, undoing the mode of operation so it is a plain DES block
+    in and out: for CBC the IV is XORed into the plaintext, and for CTR
+    the counter is the input and the keystream is the output.
+    @param search the search to fill in
+    @param mode the mode the cipher file was written in
+    @param plainName name of the file of known plaintext
+    @param cipherName name of the file it was encrypted into
+    @return true if successful, false after printing an error message
+*/
+static bool readBlockPair( Search *search, CipherMode mode, char const *plainName,
+                           char const *cipherName )
+{
+    FILE *plainFile = openFile( plainName, "rb" );
+    if ( plainFile == NULL ) {
+        perror( plainName );
+        return false;
+    }
+    byte plain[ BLOCK_BYTES ] = { 0 };
+    size_t plainLen = readStart( plainFile, plain );
+    bool plainError = ferror( plainFile );
+    fclose( plainFile );
+    if ( plainError ) {
+        perror( plainName );
+        return false;
+    }
+
+    FILE *cipherFile = openFile( cipherName, "rb" );
+    if ( cipherFile == NULL ) {
+        perror( cipherName );
+        return false;
+    }
+    // Framed data doesn't start with the known plaintext
+    uint64_t nonce = 0;
+    int flags = 0;
+    byte header[ HEADER_BYTES ];
+    bool headerOk = mode == MODE_ECB ||
+        ( fread( header, 1, HEADER_BYTES, cipherFile ) == HEADER_BYTES &&
+          decodeHeader( header, mode, &nonce, &flags ) && flags == 0 );
+    byte cipher[ BLOCK_BYTES ] = { 0 };
+    size_t cipherLen = headerOk ? readStart( cipherFile, cipher ) : 0;
+    bool cipherError = ferror( cipherFile );
+    fclose( cipherFile );
+    if ( cipherError ) {
+        perror( cipherName );
+        return false;
+    }
+    if ( !headerOk ) {
+        fprintf( stderr, "Invalid header\n" );
+        return false;
+    }
+
+    // CTR needs no padding, so only the bytes both files have are known
+    size_t known = plainLen < cipherLen ? plainLen : cipherLen;
+    if ( known == 0 || ( mode != MODE_CTR && cipherLen < BLOCK_BYTES ) ) {
+        fprintf( stderr, "Need a block of plaintext and ciphertext\n" );
+        return false;
+    }
+
+    // Pad a short plaintext the way encrypt would have
+    if ( mode == MODE_CBC ) {
+        memset( plain + plainLen, BLOCK_BYTES - plainLen, BLOCK_BYTES - plainLen );
+    }
+
+    if ( mode == MODE_CTR ) {
+        search->in = nonce;
+        search->out = loadBlock64( plain ) ^ loadBlock64( cipher );
+        search->knownBits = known * BYTE_SIZE;
+    } else {
+        search->in = loadBlock64( plain ) ^ nonce;
+        search->out = loadBlock64( cipher );
+        search->knownBits = BLOCK_BITS;
+    }
+    return true;
+}
+
+/**
+    Compare key indexes, for sorting the keys found.
+    @param a the first index
+    @param b the second index
+    @return negative, zero or positive as a is before, the same as or
+    after b
+*/
+static int compareIndexes( void const *a, void const *b )
+{
+    uint64_t x = *(uint64_t const *) a, y = *(uint64_t const *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+    Run the workers and wait for them all to finish.
+    @param search the search
+    @param workers the workers, with their search and index set
+    @param count number of workers
+    @return number of workers that started
+*/
+static int runWorkers( Search *search, Worker workers[], int count )
+{
+    int started = 0;
+    for ( int i = 0; i < count; i++ ) {
+        if ( pthread_create( &workers[ i ].thread, NULL, searchWorker, &workers[ i ] ) == 0 ) {
+            started++;
+        } else {
+            workers[ i ].search = NULL;
+        }
+    }
+
+    for ( int i = 0; i < count; i++ ) {
+        if ( workers[ i ].search != NULL ) {
+            pthread_join( workers[ i ].thread, NULL );
+        }
+    }
+    return started;
+}
+
+/**
+    Print the matching keys and how fast each thread searched.
+    @param search the finished search
+    @param workers the workers
+    @param count number of workers
+    @param wall seconds the search took
+*/
+static void printReport( Search *search, Worker const workers[], int count, double wall )
+{
+    qsort( search->found, search->foundCount, sizeof( uint64_t ), compareIndexes );
+    for ( int i = 0; i < search->foundCount; i++ ) {
+        KeyCounter counter;
+        seekKey( search, &counter, search->found[ i ] );
+        printf( "Key: %.*s\n", counter.length, (char const *) counter.key );
+    }
+
+    uint64_t keys = 0;
+    for ( int i = 0; i < count; i++ ) {
+        keys += workers[ i ].keys;
+    }
+    printf( "Searched %llu keys in %.2f s, %.0f keys/s\n", (unsigned long long) keys, wall,
+            wall > 0 ? keys / wall : 0.0 );
+
+    for ( int i = 0; i < count; i++ ) {
+        if ( workers[ i ].search != NULL ) {
+            printf( "Thread %d: %llu keys in %.2f s of CPU, %.0f keys/s\n", i,
+                    (unsigned long long) workers[ i ].keys, workers[ i ].cpu,
+                    workers[ i ].cpu > 0 ? workers[ i ].keys / workers[ i ].cpu : 0.0 );
+        }
+    }
+}
+
+/**
+    Main method for the key search
+    @param argc Number of command line arguments
+    @param argv Array of strings of command line arguments
+    @return the program exit status
+*/
+int main( int argc, char *argv[] )
+{
+    static Search search;
+    CipherMode mode = MODE_ECB;
+    int threads;
+    parseThreads( "0", &threads );
+
+    // Every printable ASCII character, unless --charset says otherwise
+    char printable[ '~' - ' ' + 2 ];
+    for ( int c = ' '; c <= '~'; c++ ) {
+        printable[ c - ' ' ] = c;
+    }
+    printable[ '~' - ' ' + 1 ] = '\0';
+    setCharset( &search, printable );
+    search.minLength = 1;
+    search.maxLength = BLOCK_BYTES;
+
+    char const *positional[ 2 ];
+    int count = 0;
+    for ( int i = 1; i < argc; i++ ) {
+        char const *arg = argv[ i ];
+        bool hasValue = i + 1 < argc;
+
+        if ( strcmp( arg, "--charset" ) == 0 && hasValue ) {
+            setCharset( &search, argv[ ++i ] );
+        } else if ( strcmp( arg, "--min-length" ) == 0 && hasValue ) {
+            if ( !parseLength( argv[ ++i ], &search.minLength ) ) {
+                usage();
+            }
+        } else if ( strcmp( arg, "--max-length" ) == 0 && hasValue ) {
+            if ( !parseLength( argv[ ++i ], &search.maxLength ) ) {
+                usage();
+            }
+        } else if ( strcmp( arg, "--mode" ) == 0 && hasValue ) {
+            if ( !parseMode( argv[ ++i ], &mode ) ) {
+                usage();
+            }
+        } else if ( strcmp( arg, "-j" ) == 0 && hasValue ) {
+            if ( !parseThreads( argv[ ++i ], &threads ) ) {
+                usage();
+            }
+        } else if ( strcmp( arg, "--checkpoint" ) == 0 && hasValue ) {
+            search.checkpoint = argv[ ++i ];
+        } else if ( count < 2 ) {
+            positional[ count++ ] = arg;
+        } else {
+            usage();
+        }
+    }
+
+    if ( count != 2 || search.charCount == 0 || search.minLength > search.maxLength ) {
+        usage();
+    }
+
+    if ( !readBlockPair( &search, mode, positional[ 0 ], positional[ 1 ] ) ) {
+        exit( 1 );
+    }
+    countKeys( &search );
+
+    pthread_mutex_init( &search.lock, NULL );
+    search.workerCount = threads;
+    search.current = malloc( threads * sizeof( uint64_t ) );
+    Worker *workers = calloc( threads, sizeof( Worker ) );
+    if ( search.current == NULL || workers == NULL ) {
+        perror( "keysearch" );
+        exit( 1 );
+    }
+    for ( int i = 0; i < threads; i++ ) {
+        search.current[ i ] = NO_TASK;
+        workers[ i ].search = &search;
+        workers[ i ].index = i;
+    }
+
+    if ( search.checkpoint != NULL && !loadCheckpoint( &search ) ) {
+        exit( 1 );
+    }
+
+    // Finish the tasks in hand on Ctrl-C, so the checkpoint is up to date
+    struct sigaction action = { .sa_handler = requestStop };
+    sigemptyset( &action.sa_mask );
+    sigaction( SIGINT, &action, NULL );
+    sigaction( SIGTERM, &action, NULL );
+
+    double start = readClock( CLOCK_MONOTONIC );
+    search.lastSave = start;
+    if ( runWorkers( &search, workers, threads ) == 0 ) {
+        fprintf( stderr, "Can't start worker threads\n" );
+        exit( 1 );
+    }
+    double wall = readClock( CLOCK_MONOTONIC ) - start;
+
+    bool ok = true;
+    if ( search.checkpoint != NULL && !saveCheckpoint( &search ) ) {
+        perror( search.checkpoint );
+        ok = false;
+    }
+
+    printReport( &search, workers, threads, wall );
+
+    if ( search.nextTask < search.taskCount || finishedUpTo( &search ) < search.taskCount ) {
+        fprintf( stderr, "Search stopped before the end\n" );
+        ok = false;
+    }
+
+    free( workers );
+    free( search.current );
+    free( search.found );
+    pthread_mutex_destroy( &search.lock );
+    return ok ? 0 : 1;
+}
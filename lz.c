@@ -0,0 +1,298 @@
+/**
+    @file lz.c
+    @author John Butterfield (jpbutte2)
+    LZ compression component. The compressor is greedy: it looks up the
+    next four bytes in a table of the last position each hash was seen
+    at, takes the match there if there is one, and otherwise moves on,
+    skipping further ahead the longer it goes without finding one, so
+    data that doesn't compress goes through quickly.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+/** Largest length that fits in half a token. */
+#define TOKEN_MAX 15
+
+/** Misses in a row before the compressor starts skipping bytes: after
+    each 2^MISS_SHIFT misses it steps one byte further. */
+#define MISS_SHIFT 6
+
+/** Number of bytes copied at once for short runs of literals, when
+    there is room for the copy to run over. */
+#define WILD_COPY 16
+
+/** Multiplier for hashing four bytes, from Knuth. */
+#define HASH_MULTIPLIER 2654435761U
+
+/**
+    Read four bytes in the machine's byte order.
+    @param p where to read
+    @return the bytes as a number
+*/
+static uint32_t read32( byte const *p )
+{
+    uint32_t value;
+    memcpy( &value, p, sizeof( value ) );
+    return value;
+}
+
+/**
+    Read eight bytes in the machine's byte order.
+    @param p where to read
+    @return the bytes as a number
+*/
+static uint64_t read64( byte const *p )
+{
+    uint64_t value;
+    memcpy( &value, p, sizeof( value ) );
+    return value;
+}
+
+/**
+    Hash four bytes to a slot in the table of positions.
+    @param value the bytes, from read32()
+    @return the slot
+*/
+static unsigned hash4( uint32_t value )
+{
+    return ( value * HASH_MULTIPLIER ) >> ( 32 - LZ_HASH_BITS );
+}
+
+/**
+    Measure how far a match goes.
+    @param src the data
+    @param ref where the earlier copy starts
+    @param pos where the match starts, with at least LZ_MIN_MATCH bytes
+    already known to match
+    @param len number of bytes in the data
+    @return length of the match
+*/
+static size_t matchLength( byte const *src, size_t ref, size_t pos, size_t len )
+{
+    size_t n = LZ_MIN_MATCH;
+
+    // Eight bytes at a time, and the first difference gives the rest
+    while ( pos + n + sizeof( uint64_t ) <= len ) {
+        uint64_t diff = read64( src + pos + n ) ^ read64( src + ref + n );
+        if ( diff != 0 ) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return n + __builtin_ctzll( diff ) / 8;
+#else
+            return n + __builtin_clzll( diff ) / 8;
+#endif
+        }
+        n += sizeof( uint64_t );
+    }
+
+    while ( pos + n < len && src[ pos + n ] == src[ ref + n ] ) {
+        n++;
+    }
+    return n;
+}
+
+/**
+    Write the extra bytes for a length that didn't fit in its token.
+    @param op where to write
+    @param end end of the room for output
+    @param extra the length less TOKEN_MAX
+    @return where the output continues, or NULL if it didn't fit
+*/
+static byte *putLength( byte *op, byte const *end, size_t extra )
+{
+    while ( extra >= 255 ) {
+        if ( op == end ) {
+            return NULL;
+        }
+        *op++ = 255;
+        extra -= 255;
+    }
+
+    if ( op == end ) {
+        return NULL;
+    }
+    *op++ = extra;
+    return op;
+}
+
+/**
+    Write one sequence: literals, then a match unless it is the last
+    sequence.
+    @param op where to write
+    @param end end of the room for output
+    @param literals the literal bytes
+    @param literalLen number of literal bytes
+    @param srcEnd end of the data the literals are in
+    @param offset how far back the match is
+    @param matchLen length of the match, or 0 for the last sequence
+    @return where the output continues, or NULL if it didn't fit
+*/
+static byte *putSequence( byte *op, byte const *end, byte const *literals, size_t literalLen,
+                          byte const *srcEnd, size_t offset, size_t matchLen )
+{
+    if ( op == end ) {
+        return NULL;
+    }
+    byte *token = op++;
+    *token = ( literalLen < TOKEN_MAX ? literalLen : TOKEN_MAX ) << 4;
+    if ( literalLen >= TOKEN_MAX && ( op = putLength( op, end, literalLen - TOKEN_MAX ) ) == NULL ) {
+        return NULL;
+    }
+
+    if ( (size_t) ( end - op ) < literalLen ) {
+        return NULL;
+    }
+    if ( literalLen <= WILD_COPY && end - op >= WILD_COPY && srcEnd - literals >= WILD_COPY ) {
+        memcpy( op, literals, WILD_COPY );
+    } else {
+        memcpy( op, literals, literalLen );
+    }
+    op += literalLen;
+    if ( matchLen == 0 ) {
+        return op;
+    }
+
+    if ( end - op < 2 ) {
+        return NULL;
+    }
+    op[ 0 ] = offset & 0xFF;
+    op[ 1 ] = offset >> 8;
+    op += 2;
+
+    size_t extra = matchLen - LZ_MIN_MATCH;
+    *token |= extra < TOKEN_MAX ? extra : TOKEN_MAX;
+    if ( extra >= TOKEN_MAX ) {
+        op = putLength( op, end, extra - TOKEN_MAX );
+    }
+    return op;
+}
+
+size_t lzCompress( byte *dst, size_t cap, byte const *src, size_t len )
+{
+    // Positions are stored plus one, so zero means an empty slot
+    if ( len >= UINT32_MAX ) {
+        return 0;
+    }
+    uint32_t table[ 1 << LZ_HASH_BITS ];
+    memset( table, 0, sizeof( table ) );
+
+    byte *op = dst;
+    byte const *end = dst + cap;
+    size_t anchor = 0, pos = 0, misses = 0;
+    while ( len >= LZ_MIN_MATCH && pos <= len - LZ_MIN_MATCH ) {
+        uint32_t next = read32( src + pos );
+        unsigned slot = hash4( next );
+        size_t ref = table[ slot ];
+        table[ slot ] = pos + 1;
+        if ( ref == 0 || pos - ( ref - 1 ) > LZ_MAX_OFFSET || read32( src + ref - 1 ) != next ) {
+            pos += 1 + ( misses++ >> MISS_SHIFT );
+            continue;
+        }
+
+        // The match may well start before the bytes that were hashed
+        ref--;
+        size_t match = matchLength( src, ref, pos, len );
+        while ( pos > anchor && ref > 0 && src[ pos - 1 ] == src[ ref - 1 ] ) {
+            pos--;
+            ref--;
+            match++;
+        }
+        op = putSequence( op, end, src + anchor, pos - anchor, src + len, pos - ref, match );
+        if ( op == NULL ) {
+            return 0;
+        }
+        pos += match;
+        anchor = pos;
+        misses = 0;
+
+        // Note a position inside the match too, which finds repeats sooner
+        if ( pos >= 2 && pos + 2 <= len ) {
+            table[ hash4( read32( src + pos - 2 ) ) ] = pos - 1;
+        }
+    }
+
+    op = putSequence( op, end, src + anchor, len - anchor, src + len, 0, 0 );
+    return op == NULL ? 0 : op - dst;
+}
+
+/**
+    Read the extra bytes of a length.
+    @param ip where to read, moved past the bytes
+    @param end end of the compressed data
+    @param len the length, which the bytes are added to
+    @return false if the data ended first
+*/
+static bool getLength( byte const **ip, byte const *end, size_t *len )
+{
+    byte b;
+    do {
+        if ( *ip == end ) {
+            return false;
+        }
+        b = *( *ip )++;
+        *len += b;
+    } while ( b == 255 );
+
+    return true;
+}
+
+bool lzDecompress( byte *dst, size_t dstLen, byte const *src, size_t srcLen )
+{
+    byte const *ip = src, *ipEnd = src + srcLen;
+    byte *op = dst, *opEnd = dst + dstLen;
+
+    while ( ip < ipEnd ) {
+        byte token = *ip++;
+        size_t literalLen = token >> 4;
+        if ( literalLen == TOKEN_MAX && !getLength( &ip, ipEnd, &literalLen ) ) {
+            return false;
+        }
+        if ( literalLen > (size_t) ( ipEnd - ip ) || literalLen > (size_t) ( opEnd - op ) ) {
+            return false;
+        }
+        if ( literalLen <= WILD_COPY && ipEnd - ip >= WILD_COPY && opEnd - op >= WILD_COPY ) {
+            memcpy( op, ip, WILD_COPY );
+        } else {
+            memcpy( op, ip, literalLen );
+        }
+        op += literalLen;
+        ip += literalLen;
+
+        // The last sequence has no match, and there has to be one
+        if ( ip == ipEnd ) {
+            return op == opEnd;
+        }
+        if ( ipEnd - ip < 2 ) {
+            return false;
+        }
+        size_t offset = ip[ 0 ] | ip[ 1 ] << 8;
+        ip += 2;
+
+        size_t matchLen = ( token & TOKEN_MAX ) + LZ_MIN_MATCH;
+        if ( ( token & TOKEN_MAX ) == TOKEN_MAX && !getLength( &ip, ipEnd, &matchLen ) ) {
+            return false;
+        }
+        if ( offset == 0 || offset > (size_t) ( op - dst ) ||
+             matchLen > (size_t) ( opEnd - op ) ) {
+            return false;
+        }
+
+        // A match can overlap its own output, so it is copied forwards,
+        // eight bytes at a time when it starts at least that far back
+        // and there is room for the last copy to run over
+        byte const *from = op - offset;
+        if ( offset >= sizeof( uint64_t ) && matchLen + sizeof( uint64_t ) <= (size_t) ( opEnd - op ) ) {
+            for ( size_t i = 0; i < matchLen; i += sizeof( uint64_t ) ) {
+                memcpy( op + i, from + i, sizeof( uint64_t ) );
+            }
+        } else {
+            for ( size_t i = 0; i < matchLen; i++ ) {
+                op[ i ] = from[ i ];
+            }
+        }
+        op += matchLen;
+    }
+
+    return false;
+}
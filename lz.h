@@ -0,0 +1,55 @@
+/**
+    @file lz.h
+    @author John Butterfield (jpbutte2)
+    Header for the LZ compression component, a small byte-oriented
+    codec in the LZ77 family that favours speed over ratio. Compressed
+    data is a run of sequences, each a token byte, any extra literal
+    length bytes, the literal bytes, and then, unless the sequence is
+    the last one, a 2-byte little-endian offset back into the output
+    and any extra match length bytes. The high four bits of the token
+    are the number of literals and the low four bits the match length
+    less LZ_MIN_MATCH; a value of 15 means extra length bytes follow,
+    each adding up to 255, and ending with the first one below 255.
+*/
+
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "DES.h"
+
+/** Shortest match that gets encoded. */
+#define LZ_MIN_MATCH 4
+
+/** Furthest back a match can be. */
+#define LZ_MAX_OFFSET 65535
+
+/** Number of bits in a hash of the next four bytes, which picks the
+    slot in the table of recent positions. */
+#define LZ_HASH_BITS 14
+
+/**
+    This function compresses len bytes from src into dst, if they fit
+    in cap bytes.
+    @param dst where the compressed data goes
+    @param cap room at dst
+    @param src the data to compress
+    @param len number of bytes at src
+    @return number of compressed bytes, or 0 if they wouldn't fit
+*/
+size_t lzCompress( byte *dst, size_t cap, byte const *src, size_t len );
+
+/**
+    This function decompresses srcLen bytes of compressed data into
+    exactly dstLen bytes at dst. Every length and offset is checked, so
+    damaged data can't make it read or write out of bounds.
+    @param dst where the data goes
+    @param dstLen number of bytes the data should come to
+    @param src the compressed data
+    @param srcLen number of compressed bytes
+    @return true if the data was valid and came to dstLen bytes
+*/
+bool lzDecompress( byte *dst, size_t dstLen, byte const *src, size_t srcLen );
+
+#endif
@@ -0,0 +1,259 @@
+/**
+    @file options.c
+    @author John Butterfield (jpbutte2)
+    Command-line option component shared by the encrypt and decrypt
+    programs.
+*/
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "options.h"
+#include "io.h"
+
+/** Number of positional arguments: key, input file and output file. */
+#define POSITIONAL_COUNT 3
+
+/**
+    Parse a number of bytes such as "4096", "64K" or "1M", which may be
+    zero.
+    @param text the string to parse
+    @param bytes where to store the number of bytes
+    @return true if text is a valid number of bytes that fits in 64 bits
+*/
+static bool parseBytes( char const *text, uint64_t *bytes )
+{
+    // strtoull() skips spaces and quietly negates a minus sign
+    if ( !isdigit( (unsigned char) *text ) ) {
+        return false;
+    }
+
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull( text, &end, 10 );
+    if ( errno == ERANGE ) {
+        return false;
+    }
+
+    uint64_t multiplier = 1;
+    switch ( *end ) {
+    case 'G': case 'g':
+        multiplier *= 1024;
+        // fall through
+    case 'M': case 'm':
+        multiplier *= 1024;
+        // fall through
+    case 'K': case 'k':
+        multiplier *= 1024;
+        end++;
+        break;
+    }
+
+    if ( *end != '\0' || value > UINT64_MAX / multiplier ) {
+        return false;
+    }
+
+    *bytes = value * multiplier;
+    return true;
+}
+
+bool parseSize( char const *text, size_t *size )
+{
+    uint64_t value;
+    if ( !parseBytes( text, &value ) || value == 0 || value > SIZE_MAX ) {
+        return false;
+    }
+
+    *size = value;
+    return true;
+}
+
+bool parseThreads( char const *text, int *threads )
+{
+    char *end;
+    long value = strtol( text, &end, 10 );
+    if ( end == text || *end != '\0' || value < 0 || value > MAX_THREADS ) {
+        return false;
+    }
+
+    if ( value == 0 ) {
+        value = sysconf( _SC_NPROCESSORS_ONLN );
+        if ( value < 1 ) {
+            value = 1;
+        } else if ( value > MAX_THREADS ) {
+            value = MAX_THREADS;
+        }
+    }
+
+    *threads = value;
+    return true;
+}
+
+/**
+    Parse the name of a way of doing I/O.
+    @param text the string to parse
+    @param io where to store the choice
+    @return true if text names a way of doing I/O
+*/
+static bool parseIo( char const *text, IoMode *io )
+{
+    if ( strcmp( text, "auto" ) == 0 ) {
+        *io = IO_AUTO;
+    } else if ( strcmp( text, "uring" ) == 0 ) {
+        *io = IO_URING;
+    } else if ( strcmp( text, "stdio" ) == 0 ) {
+        *io = IO_STDIO;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseMode( char const *text, CipherMode *mode )
+{
+    if ( strcmp( text, "ecb" ) == 0 ) {
+        *mode = MODE_ECB;
+    } else if ( strcmp( text, "ctr" ) == 0 ) {
+        *mode = MODE_CTR;
+    } else if ( strcmp( text, "cbc" ) == 0 ) {
+        *mode = MODE_CBC;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool parseOptions( Options *opts, int argc, char *argv[] )
+{
+    opts->key = NULL;
+    opts->key2 = NULL;
+    opts->key3 = NULL;
+    opts->inputFile = NULL;
+    opts->outputFile = NULL;
+    opts->chunkBytes = DEFAULT_CHUNK_BYTES;
+    opts->mmap = MMAP_AUTO;
+    opts->threads = 1;
+    opts->mode = MODE_ECB;
+    opts->engine = desEngineFind( "auto" );
+    opts->pipeline = false;
+    opts->pipelineBytes = DEFAULT_PIPELINE_BYTES;
+    opts->io = IO_AUTO;
+    opts->ranged = false;
+    opts->rangeOffset = 0;
+    opts->rangeLength = RANGE_TO_END;
+    opts->stats = false;
+    opts->batch = false;
+    opts->hugePages = false;
+    opts->autotune = false;
+    opts->engineGiven = false;
+    opts->chunkGiven = false;
+    opts->threadsGiven = false;
+    opts->compress = false;
+    opts->container = false;
+
+    char const *positional[ POSITIONAL_COUNT ];
+    int count = 0;
+    bool optionsDone = false;
+
+    for ( int i = 1; i < argc; i++ ) {
+        char const *arg = argv[ i ];
+
+        if ( !optionsDone && strcmp( arg, "--" ) == 0 ) {
+            optionsDone = true;
+        } else if ( !optionsDone && strcmp( arg, "--chunk-size" ) == 0 ) {
+            if ( i + 1 >= argc || !parseSize( argv[ ++i ], &opts->chunkBytes ) ) {
+                return false;
+            }
+            opts->chunkGiven = true;
+        } else if ( !optionsDone && strcmp( arg, "--mmap" ) == 0 ) {
+            opts->mmap = MMAP_ON;
+        } else if ( !optionsDone && strcmp( arg, "--no-mmap" ) == 0 ) {
+            opts->mmap = MMAP_OFF;
+        } else if ( !optionsDone && strcmp( arg, "--mode" ) == 0 ) {
+            if ( i + 1 >= argc || !parseMode( argv[ ++i ], &opts->mode ) ) {
+                return false;
+            }
+        } else if ( !optionsDone && strcmp( arg, "--engine" ) == 0 ) {
+            if ( i + 1 >= argc || ( opts->engine = desEngineFind( argv[ ++i ] ) ) == NULL ) {
+                return false;
+            }
+            opts->engineGiven = true;
+        } else if ( !optionsDone && strcmp( arg, "--key2" ) == 0 ) {
+            if ( i + 1 >= argc ) {
+                return false;
+            }
+            opts->key2 = argv[ ++i ];
+        } else if ( !optionsDone && strcmp( arg, "--key3" ) == 0 ) {
+            if ( i + 1 >= argc ) {
+                return false;
+            }
+            opts->key3 = argv[ ++i ];
+        } else if ( !optionsDone && strcmp( arg, "-j" ) == 0 ) {
+            if ( i + 1 >= argc || !parseThreads( argv[ ++i ], &opts->threads ) ) {
+                return false;
+            }
+            opts->threadsGiven = true;
+        } else if ( !optionsDone && strcmp( arg, "--pipeline" ) == 0 ) {
+            opts->pipeline = true;
+        } else if ( !optionsDone && strcmp( arg, "--max-memory" ) == 0 ) {
+            if ( i + 1 >= argc || !parseSize( argv[ ++i ], &opts->pipelineBytes ) ) {
+                return false;
+            }
+        } else if ( !optionsDone && strcmp( arg, "--io" ) == 0 ) {
+            if ( i + 1 >= argc || !parseIo( argv[ ++i ], &opts->io ) ) {
+                return false;
+            }
+        } else if ( !optionsDone && strcmp( arg, "--offset" ) == 0 ) {
+            if ( i + 1 >= argc || !parseBytes( argv[ ++i ], &opts->rangeOffset ) ) {
+                return false;
+            }
+            opts->ranged = true;
+        } else if ( !optionsDone && strcmp( arg, "--length" ) == 0 ) {
+            if ( i + 1 >= argc || !parseBytes( argv[ ++i ], &opts->rangeLength ) ) {
+                return false;
+            }
+            opts->ranged = true;
+        } else if ( !optionsDone && strcmp( arg, "--batch" ) == 0 ) {
+            opts->batch = true;
+        } else if ( !optionsDone && strcmp( arg, "--huge-pages" ) == 0 ) {
+            opts->hugePages = true;
+        } else if ( !optionsDone && strcmp( arg, "--autotune" ) == 0 ) {
+            opts->autotune = true;
+        } else if ( !optionsDone && strcmp( arg, "--compress" ) == 0 ) {
+            opts->compress = true;
+        } else if ( !optionsDone && strcmp( arg, "--container" ) == 0 ) {
+            opts->container = true;
+#ifndef DES_NO_STATS
+        } else if ( !optionsDone && strcmp( arg, "--stats" ) == 0 ) {
+            opts->stats = true;
+#endif
+        } else {
+            if ( count == POSITIONAL_COUNT ) {
+                return false;
+            }
+            positional[ count++ ] = arg;
+        }
+    }
+
+    // --autotune can run on its own, but then there's nothing else to do
+    if ( count == 0 && opts->autotune ) {
+        return opts->key2 == NULL && opts->key3 == NULL && !opts->ranged && !opts->batch;
+    }
+
+    // A third key only makes sense with a second one
+    if ( count != POSITIONAL_COUNT || ( opts->key3 != NULL && opts->key2 == NULL ) ) {
+        return false;
+    }
+
+    opts->key = positional[ 0 ];
+    opts->inputFile = positional[ 1 ];
+    opts->outputFile = positional[ 2 ];
+    return true;
+}
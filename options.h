@@ -0,0 +1,241 @@
+/**
+    @file options.h
+    @author John Butterfield (jpbutte2)
+    Header for the command-line option component. This component is
+    shared by the encrypt and decrypt programs, and sorts their
+    arguments into the key, the file names and any options.
+*/
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "DESContext.h"
+
+/** When to use memory-mapped files instead of reads and writes. */
+typedef enum {
+  /** Map large regular files. */
+  MMAP_AUTO,
+
+  /** Map the files whenever they are regular files. */
+  MMAP_ON,
+
+  /** Never map the files. */
+  MMAP_OFF
+} MmapMode;
+
+/** How the pipeline reads and writes regular files. */
+typedef enum {
+  /** Use io_uring for threaded runs when the kernel supports it. */
+  IO_AUTO,
+
+  /** Use io_uring whenever the kernel supports it. */
+  IO_URING,
+
+  /** Never use io_uring. */
+  IO_STDIO
+} IoMode;
+
+/** Smallest input file that gets mapped when the mode is MMAP_AUTO. */
+#define MMAP_AUTO_BYTES ( 16 * 1024 * 1024 )
+
+/** Default limit on the chunk buffers of the pipeline, in bytes. */
+#define DEFAULT_PIPELINE_BYTES ( 64 * 1024 * 1024 )
+
+/** Length of a byte range that runs to the end of the data. */
+#define RANGE_TO_END UINT64_MAX
+
+/** Largest number of worker threads accepted by -j. */
+#define MAX_THREADS 256
+
+/** Type used to hold the parsed command line. */
+typedef struct {
+  /** Text key given on the command line. */
+  char const *key;
+
+  /** Second key for triple DES, or NULL for single DES. */
+  char const *key2;
+
+  /** Third key for triple DES, or NULL to reuse the first key. */
+  char const *key3;
+
+  /** Name of the file to read. */
+  char const *inputFile;
+
+  /** Name of the file to write. */
+  char const *outputFile;
+
+  /** Number of bytes to read or write at a time. */
+  size_t chunkBytes;
+
+  /** Whether to use memory-mapped files. */
+  MmapMode mmap;
+
+  /** Number of worker threads, or 1 to do all the work on one thread. */
+  int threads;
+
+  /** Mode of operation. */
+  CipherMode mode;
+
+  /** Engine to run DES on. */
+  DESEngine const *engine;
+
+  /** True to stream through reader, cipher and writer threads. */
+  bool pipeline;
+
+  /** Most memory the pipeline may use for chunk buffers. */
+  size_t pipelineBytes;
+
+  /** Whether regular files go through io_uring. */
+  IoMode io;
+
+  /** True if only a range of the plaintext is wanted. */
+  bool ranged;
+
+  /** Position in the plaintext of the first byte wanted. */
+  uint64_t rangeOffset;
+
+  /** Number of bytes wanted, or RANGE_TO_END. */
+  uint64_t rangeLength;
+
+  /** True to report timings and byte counts on standard error. */
+  bool stats;
+
+  /** True if the input names a list of files and the output a
+      directory. */
+  bool batch;
+
+  /** True to back large chunk buffers with huge pages. */
+  bool hugePages;
+
+  /** True to time trials on this machine and save the best settings
+      as its profile. */
+  bool autotune;
+
+  /** True if --engine was given, so the profile doesn't change it. */
+  bool engineGiven;
+
+  /** True if --chunk-size was given. */
+  bool chunkGiven;
+
+  /** True if -j was given. */
+  bool threadsGiven;
+
+  /** True to compress the data before encrypting it. */
+  bool compress;
+
+  /** True to write an indexed file, or to read the input as one. */
+  bool container;
+} Options;
+
+/**
+    This function parses the command line. Arguments that match one of
+    the options below are options, "--" ends the options, and any other
+    argument is the key, the input file or the output file, in that
+    order. Unknown arguments are never treated as options, so a key like
+    "--x--" still works. A file name of "-" means standard input or
+    standard output.
+
+      --chunk-size <bytes>   bytes per read or write, with an optional
+                             K, M or G suffix
+      --mmap                 map regular files into memory
+      --no-mmap              always use reads and writes
+      --mode <ecb|ctr|cbc>   mode of operation; the default is ecb
+      --engine <name>        run DES on this engine from desEngines():
+                             auto (the default), reference, table or
+                             bitslice-scalar, plus bitslice-avx2 and
+                             bitslice-avx512 where the processor has
+                             them
+      --key2 <key>           use triple DES (EDE) with this as the
+                             second key
+      --key3 <key>           third key for triple DES; without it the
+                             first key is used again
+      -j <n>                 split regular files into chunks and
+                             process them on n worker threads, or one
+                             per online processor if n is 0; input
+                             or output that isn't a regular file goes
+                             through the pipeline instead
+      --pipeline             stream through a reader thread, the -j
+                             cipher threads and a writer thread
+      --max-memory <bytes>   limit on the pipeline's chunk buffers,
+                             with the same suffixes as --chunk-size
+      --io <auto|uring|stdio>
+                             how regular files are read and written;
+                             auto runs -j and --pipeline through
+                             io_uring where the kernel supports it,
+                             uring does that for every run, and stdio
+                             never uses it
+      --offset <bytes>       decrypt only from this plaintext
+                             position, with the same suffixes as
+                             --chunk-size; zero is allowed
+      --length <bytes>       decrypt only this many bytes
+      --batch                process many files in one run: the
+                             input file is a manifest listing one
+                             file per line, or a directory to walk,
+                             and the output file is the directory the
+                             outputs go to; -j sets the number of
+                             workers
+      --stats                report the time spent in each phase,
+                             per thread, the bytes processed and the
+                             peak memory as a line of JSON on
+                             standard error; builds with DES_NO_STATS
+                             don't have it
+      --huge-pages           back chunk buffers of 2M or more with
+                             huge pages, reserved or transparent
+      --autotune             time the engines, chunk sizes and thread
+                             counts on this machine and save the
+                             fastest as its profile, which later runs
+                             use wherever the command line doesn't
+                             say; with no other arguments, only tune
+      --compress             compress each chunk before encrypting
+                             it, in CTR or CBC mode; the header says
+                             so, and decrypt decompresses such files
+                             without being asked
+      --container            encrypt to an indexed file, which
+                             keeps the exact length of the data and
+                             an index of its chunks, so it can be
+                             decrypted on many threads, a range at a
+                             time, or checked for truncation; in any
+                             mode, ECB included, decrypt reads such
+                             files without being asked unless the
+                             input is a pipe, when this says so
+
+    Without --autotune, the key, input file and output file are all
+    required.
+
+    @param opts the structure to fill in
+    @param argc Number of command line arguments
+    @param argv Array of strings of command line arguments
+    @return true if the command line is valid
+*/
+bool parseOptions( Options *opts, int argc, char *argv[] );
+
+/**
+    This function parses a size such as "4096", "64K" or "1M".
+    @param text the string to parse
+    @param size where to store the number of bytes
+    @return true if text is a valid size greater than zero
+*/
+bool parseSize( char const *text, size_t *size );
+
+/**
+    This function parses the thread count given to -j. Zero asks for
+    one thread per online processor.
+    @param text the string to parse
+    @param threads where to store the number of threads
+    @return true if text is a valid thread count, at most MAX_THREADS
+*/
+bool parseThreads( char const *text, int *threads );
+
+/**
+    This function parses the name of a mode of operation, as given to
+    --mode.
+    @param text the string to parse
+    @param mode where to store the mode
+    @return true if text names a mode
+*/
+bool parseMode( char const *text, CipherMode *mode );
+
+#endif
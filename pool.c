@@ -0,0 +1,281 @@
+/**
+    @file pool.c
+    @author John Butterfield (jpbutte2)
+    Buffer pool component. Each size of buffer has a free list, which
+    is a stack linked through the first bytes of the free buffers
+    themselves. The head of each stack is a pointer and a counter
+    packed into one word and changed with compare-and-swap; the counter
+    goes up on every change, so a thread that read an old head can't
+    swap it back in after other threads took the buffer and gave it
+    back. Buffers on a free list are only unmapped by poolTrim(), which
+    can't run alongside taking and giving, so reading the link of a
+    buffer another thread has just taken is always safe.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "pool.h"
+
+/** Bits of a stack head that hold the pointer. Buffers start on a page
+    boundary, so the low 12 bits of the pointer are free, and user
+    addresses fit in 48 bits, so the top 16 are too. */
+#define POINTER_MASK 0x0000FFFFFFFFF000ULL
+
+/** Number of low bits of a stack head that hold the counter. */
+#define COUNTER_LOW_BITS 12
+
+/** Shift of the counter bits at the top of a stack head. */
+#define COUNTER_HIGH_SHIFT 48
+
+/** Alignment of the tag that follows the bytes asked for in a buffer. */
+#define TAG_ALIGN 16
+
+/** Kept in every buffer just past the bytes asked for, so it can be
+    found again from the size the buffer is given back with. It says how
+    the buffer was mapped, whatever later calls ask for. A tag in front
+    would move the buffer off its page boundary. */
+typedef struct {
+  /** Bytes mapped for the buffer. */
+  size_t mapped;
+
+  /** True if the buffer was mapped for huge pages. */
+  bool huge;
+} BufferTag;
+
+/** Free list for one kind of buffer. */
+typedef struct {
+  /** Key of the buffers on this list, from classKey(), or 0 if the
+      list is still unused. */
+  size_t key;
+
+  /** Top of the stack, packed with the counter. */
+  uint64_t head;
+} __attribute__(( aligned( 64 ) )) SizeClass;
+
+/** The free lists. A list is claimed for a kind of buffer the first
+    time one is taken, and keeps that kind. These and the counters
+    below are the only state the pool keeps; the lists are a cache,
+    which poolTrim() empties. */
+static SizeClass classes[ POOL_SIZE_CLASSES ];
+
+/** Bytes of buffers taken and not given back. */
+static size_t inUse;
+
+/** Most that inUse has ever been. */
+static size_t peak;
+
+/**
+    Find where the tag goes in a buffer.
+    @param bytes the size the buffer was taken with
+    @return offset of the tag from the start of the buffer
+*/
+static size_t tagOffset( size_t bytes )
+{
+    return ( bytes + TAG_ALIGN - 1 ) / TAG_ALIGN * TAG_ALIGN;
+}
+
+/**
+    Work out how many bytes to map for a buffer and its tag: a whole
+    number of pages, or of huge pages for a huge page buffer.
+    @param bytes the size asked for
+    @param huge true if the buffer uses huge pages
+    @return the size to map
+*/
+static size_t mappedSize( size_t bytes, bool huge )
+{
+    size_t unit = huge ? HUGE_PAGE_BYTES : (size_t) sysconf( _SC_PAGESIZE );
+    size_t need = tagOffset( bytes ) + sizeof( BufferTag );
+    return ( need + unit - 1 ) / unit * unit;
+}
+
+/**
+    Make the key that picks the free list for a buffer. Mapped sizes
+    are whole pages, so the low bit is free to tell huge page buffers
+    from others of the same size.
+    @param mapped the mapped size of the buffer
+    @param huge true if the buffer was mapped for huge pages
+    @return the key
+*/
+static size_t classKey( size_t mapped, bool huge )
+{
+    return mapped | ( huge ? 1 : 0 );
+}
+
+/**
+    Find the free list for a kind of buffer.
+    @param key the key of the buffers, from classKey()
+    @param claim true to claim an unused list if the key has none
+    @return the list, or NULL if there isn't one
+*/
+static SizeClass *findClass( size_t key, bool claim )
+{
+    for ( int i = 0; i < POOL_SIZE_CLASSES; i++ ) {
+        size_t found = __atomic_load_n( &classes[ i ].key, __ATOMIC_ACQUIRE );
+        if ( found == 0 && claim ) {
+            // Another thread may claim the list first, for this key or another
+            __atomic_compare_exchange_n( &classes[ i ].key, &found, key, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+            if ( found == 0 ) {
+                return &classes[ i ];
+            }
+        }
+        if ( found == key ) {
+            return &classes[ i ];
+        }
+        if ( found == 0 ) {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+    Make the next value for a stack head.
+    @param head the current head
+    @param top the new top of the stack
+    @return the new head, with the counter one more than in the old one
+*/
+static uint64_t nextHead( uint64_t head, byte *top )
+{
+    uint64_t counter = ( head & ( ( 1ULL << COUNTER_LOW_BITS ) - 1 ) ) |
+                       ( head >> COUNTER_HIGH_SHIFT << COUNTER_LOW_BITS );
+    counter++;
+    return (uint64_t) (uintptr_t) top |
+           ( counter & ( ( 1ULL << COUNTER_LOW_BITS ) - 1 ) ) |
+           ( counter >> COUNTER_LOW_BITS << COUNTER_HIGH_SHIFT );
+}
+
+/**
+    Map a new buffer.
+    @param bytes the size to map, from mappedSize()
+    @param huge true to back the buffer with huge pages
+    @return the buffer, or NULL with errno set
+*/
+static byte *mapBuffer( size_t bytes, bool huge )
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if ( huge ) {
+        void *addr = mmap( NULL, bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0 );
+        if ( addr != MAP_FAILED ) {
+            return addr;
+        }
+    }
+
+    // Transparent huge pages only cover aligned huge pages, so map a
+    // huge page extra and trim the ends to line the buffer up
+    size_t slack = huge ? HUGE_PAGE_BYTES : 0;
+    byte *addr = mmap( NULL, bytes + slack, PROT_READ | PROT_WRITE, flags, -1, 0 );
+    if ( addr == MAP_FAILED ) {
+        return NULL;
+    }
+
+    if ( huge ) {
+        size_t lead = ( HUGE_PAGE_BYTES - (uintptr_t) addr % HUGE_PAGE_BYTES ) % HUGE_PAGE_BYTES;
+        if ( lead > 0 ) {
+            munmap( addr, lead );
+        }
+        munmap( addr + lead + bytes, slack - lead );
+        addr += lead;
+        madvise( addr, bytes, MADV_HUGEPAGE );
+    }
+
+    return addr;
+}
+
+byte *poolTake( size_t bytes, bool huge )
+{
+    huge = huge && bytes >= HUGE_PAGE_BYTES;
+    size_t mapped = mappedSize( bytes, huge );
+    SizeClass *class = findClass( classKey( mapped, huge ), true );
+    byte *buffer = NULL;
+
+    if ( class != NULL ) {
+        uint64_t head = __atomic_load_n( &class->head, __ATOMIC_ACQUIRE );
+        while ( buffer == NULL && ( head & POINTER_MASK ) != 0 ) {
+            byte *top = (byte *) (uintptr_t) ( head & POINTER_MASK );
+            byte *next = (byte *) (uintptr_t) __atomic_load_n( (uint64_t *) top, __ATOMIC_RELAXED );
+            if ( __atomic_compare_exchange_n( &class->head, &head, nextHead( head, next ), false,
+                                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+                buffer = top;
+            }
+        }
+    }
+
+    if ( buffer == NULL ) {
+        buffer = mapBuffer( mapped, huge );
+        if ( buffer == NULL ) {
+            return NULL;
+        }
+    }
+
+    // A reused buffer may have been taken with another size before, so
+    // its tag always goes in afresh
+    BufferTag *tag = (BufferTag *) ( buffer + tagOffset( bytes ) );
+    tag->mapped = mapped;
+    tag->huge = huge;
+
+    size_t now = __atomic_add_fetch( &inUse, mapped, __ATOMIC_RELAXED );
+    size_t most = __atomic_load_n( &peak, __ATOMIC_RELAXED );
+    while ( now > most && !__atomic_compare_exchange_n( &peak, &most, now, true,
+                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+    }
+
+    return buffer;
+}
+
+void poolGive( byte *buffer, size_t bytes )
+{
+    if ( buffer == NULL ) {
+        return;
+    }
+
+    BufferTag const *tag = (BufferTag const *) ( buffer + tagOffset( bytes ) );
+    size_t mapped = tag->mapped;
+    __atomic_sub_fetch( &inUse, mapped, __ATOMIC_RELAXED );
+
+    // A buffer whose address doesn't fit in a stack head can't be kept
+    SizeClass *class = findClass( classKey( mapped, tag->huge ), false );
+    if ( class == NULL || ( (uintptr_t) buffer & ~POINTER_MASK ) != 0 ) {
+        munmap( buffer, mapped );
+        return;
+    }
+
+    uint64_t head = __atomic_load_n( &class->head, __ATOMIC_RELAXED );
+    do {
+        __atomic_store_n( (uint64_t *) buffer, head & POINTER_MASK, __ATOMIC_RELAXED );
+    } while ( !__atomic_compare_exchange_n( &class->head, &head, nextHead( head, buffer ), false,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED ) );
+}
+
+size_t poolTrim( void )
+{
+    size_t released = 0;
+    for ( int i = 0; i < POOL_SIZE_CLASSES; i++ ) {
+        SizeClass *class = &classes[ i ];
+        size_t mapped = class->key & ~(size_t) 1;
+
+        // Empty the stack, then unmap what was on it
+        uint64_t head = __atomic_load_n( &class->head, __ATOMIC_ACQUIRE );
+        while ( !__atomic_compare_exchange_n( &class->head, &head, nextHead( head, NULL ), false,
+                                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+        }
+        byte *buffer = (byte *) (uintptr_t) ( head & POINTER_MASK );
+        while ( buffer != NULL ) {
+            byte *next = (byte *) (uintptr_t) *(uint64_t *) buffer;
+            munmap( buffer, mapped );
+            released += mapped;
+            buffer = next;
+        }
+    }
+
+    return released;
+}
+
+size_t poolPeakBytes( void )
+{
+    return __atomic_load_n( &peak, __ATOMIC_RELAXED );
+}
@@ -0,0 +1,70 @@
+/**
+    @file pool.h
+    @author John Butterfield (jpbutte2)
+    Header for the buffer pool component. The chunk buffers of the I/O
+    and parallel code come from here instead of malloc(). Each buffer is
+    mapped on its own, so it starts on a page boundary, and when it is
+    given back it goes on a free list for its size instead of back to
+    the system, so the next chunk of that size reuses pages that are
+    already faulted in. Taking and giving back a buffer never takes a
+    lock. The pool can also back large buffers with huge pages, for
+    callers that ask for them. Each buffer records how it was mapped,
+    so it is always given back and unmapped the way it was mapped.
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "DES.h"
+
+/** Number of different buffer sizes that get a free list. Buffers of
+    any other size are mapped and unmapped each time. */
+#define POOL_SIZE_CLASSES 16
+
+/** Size of a huge page. Huge page buffers are rounded up to a whole
+    number of huge pages. */
+#define HUGE_PAGE_BYTES ( 2 * 1024 * 1024 )
+
+/**
+    This function takes a buffer from the pool, reusing one of the same
+    size that was given back if there is one, and otherwise mapping a
+    new one. Buffers are aligned to a page, so also to a cache line,
+    and are never shared with any other allocation. The pool keeps a
+    few bytes of its own just past the size asked for, so nothing may
+    be written beyond it. With huge set, a buffer of at least
+    HUGE_PAGE_BYTES is mapped with MAP_HUGETLB, or if the system has no
+    huge pages reserved, is marked for transparent huge pages instead.
+    @param bytes the size of the buffer
+    @param huge true to back a large buffer with huge pages
+    @return the buffer, or NULL with errno set if there is no memory
+*/
+byte *poolTake( size_t bytes, bool huge );
+
+/**
+    This function gives a buffer back to the pool, to be reused by the
+    next poolTake() for the same size. Buffers that are given back stay
+    mapped until poolTrim() is called.
+    @param buffer the buffer, from poolTake(), or NULL to do nothing
+    @param bytes the size it was taken with
+*/
+void poolGive( byte *buffer, size_t bytes );
+
+/**
+    This function unmaps every buffer that has been given back, so the
+    pool holds no memory other than buffers still taken. It must not be
+    called while any other thread may be taking or giving back buffers.
+    @return the number of bytes unmapped
+*/
+size_t poolTrim( void );
+
+/**
+    This function returns the most bytes of buffers that were taken
+    from the pool and not yet given back at any one time, counting each
+    buffer at the size it was mapped with.
+    @return the peak, in bytes
+*/
+size_t poolPeakBytes( void );
+
+#endif
@@ -0,0 +1,122 @@
+/**
+    @file ring.c
+    @author John Butterfield (jpbutte2)
+    Lock-free single-producer, single-consumer ring of pointers, used
+    to pass chunks between the threads of the pipeline.
+*/
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ring.h"
+
+/** Number of waits that just yield before a waiting thread starts to sleep. */
+#define YIELD_WAITS 16
+
+/** Shortest sleep while waiting on a ring, in nanoseconds. */
+#define MIN_SLEEP_NS 1000
+
+/** Longest sleep while waiting on a ring, in nanoseconds. */
+#define MAX_SLEEP_NS 1000000
+
+bool ringInit( Ring *ring, size_t capacity )
+{
+    size_t size = 1;
+    while ( size < capacity ) {
+        size <<= 1;
+    }
+
+    ring->slots = malloc( size * sizeof( void * ) );
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+
+    return ring->slots != NULL;
+}
+
+void ringFree( Ring *ring )
+{
+    free( ring->slots );
+    ring->slots = NULL;
+}
+
+bool ringPush( Ring *ring, void *item )
+{
+    size_t tail = __atomic_load_n( &ring->tail, __ATOMIC_RELAXED );
+    size_t head = __atomic_load_n( &ring->head, __ATOMIC_ACQUIRE );
+    if ( tail - head > ring->mask ) {
+        return false;
+    }
+
+    // Release makes the item visible before the new tail is
+    ring->slots[ tail & ring->mask ] = item;
+    __atomic_store_n( &ring->tail, tail + 1, __ATOMIC_RELEASE );
+    return true;
+}
+
+void *ringPop( Ring *ring )
+{
+    size_t head = __atomic_load_n( &ring->head, __ATOMIC_RELAXED );
+    size_t tail = __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE );
+    if ( head == tail ) {
+        return NULL;
+    }
+
+    // The slot has to be read before the producer is allowed to reuse it
+    void *item = ring->slots[ head & ring->mask ];
+    __atomic_store_n( &ring->head, head + 1, __ATOMIC_RELEASE );
+    return item;
+}
+
+/**
+    Wait a little while for the other end of a ring. The first few
+    waits just give up the processor, so a busy pipeline hands over
+    quickly, and later ones sleep twice as long as the one before, so
+    an idle thread costs next to nothing.
+    @param waits number of waits so far, counted up until the sleeps
+    stop growing
+*/
+static void backOff( int *waits )
+{
+    if ( *waits < YIELD_WAITS ) {
+        sched_yield();
+    } else {
+        long ns = (long) MIN_SLEEP_NS << ( *waits - YIELD_WAITS );
+        struct timespec delay = { 0, ns < MAX_SLEEP_NS ? ns : MAX_SLEEP_NS };
+        nanosleep( &delay, NULL );
+        if ( ns >= MAX_SLEEP_NS ) {
+            return;
+        }
+    }
+
+    ( *waits )++;
+}
+
+bool ringPushWait( Ring *ring, void *item, bool const *stop )
+{
+    int waits = 0;
+    while ( !ringPush( ring, item ) ) {
+        if ( __atomic_load_n( stop, __ATOMIC_ACQUIRE ) ) {
+            return false;
+        }
+        backOff( &waits );
+    }
+
+    return true;
+}
+
+void *ringPopWait( Ring *ring, bool const *stop )
+{
+    int waits = 0;
+    void *item;
+    while ( ( item = ringPop( ring ) ) == NULL ) {
+        if ( __atomic_load_n( stop, __ATOMIC_ACQUIRE ) ) {
+            return NULL;
+        }
+        backOff( &waits );
+    }
+
+    return item;
+}
@@ -0,0 +1,88 @@
+/**
+    @file ring.h
+    @author John Butterfield (jpbutte2)
+    Header for the ring buffer component. A ring passes pointers from
+    exactly one producer thread to exactly one consumer thread without
+    any locks: each end only ever writes its own index, and reads the
+    other end's index with acquire ordering.
+*/
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Size of a cache line, used to keep the two indexes of a ring apart
+    so the producer and consumer don't keep stealing each other's line. */
+#define RING_CACHE_LINE 64
+
+/** Type for a single-producer, single-consumer ring of pointers. */
+typedef struct {
+  /** Slots holding the pointers, a power of two of them. */
+  void **slots;
+
+  /** One less than the number of slots. */
+  size_t mask;
+
+  /** Count of pointers taken out, written only by the consumer. */
+  size_t head __attribute__(( aligned( RING_CACHE_LINE ) ));
+
+  /** Count of pointers put in, written only by the producer. */
+  size_t tail __attribute__(( aligned( RING_CACHE_LINE ) ));
+} Ring;
+
+/**
+    This function sets up an empty ring with room for at least capacity
+    pointers.
+    @param ring the ring to set up
+    @param capacity number of pointers the ring must be able to hold
+    @return true if the slots could be allocated
+*/
+bool ringInit( Ring *ring, size_t capacity );
+
+/**
+    This function frees the slots of a ring.
+    @param ring the ring to free
+*/
+void ringFree( Ring *ring );
+
+/**
+    This function adds a pointer to the ring, if there is room. Only
+    the producer thread may call it.
+    @param ring the ring to add to
+    @param item the pointer to add
+    @return false if the ring is full
+*/
+bool ringPush( Ring *ring, void *item );
+
+/**
+    This function takes the oldest pointer out of the ring. Only the
+    consumer thread may call it.
+    @param ring the ring to take from
+    @return the pointer, or NULL if the ring is empty
+*/
+void *ringPop( Ring *ring );
+
+/**
+    This function adds a pointer to the ring, waiting for room if it is
+    full. That wait is what holds a fast producer back to the speed of
+    its consumer. Waiting gives up the processor, then sleeps for
+    longer and longer times, and stops early if *stop becomes true.
+    @param ring the ring to add to
+    @param item the pointer to add
+    @param stop flag another thread sets to abandon the wait
+    @return false if the wait was abandoned
+*/
+bool ringPushWait( Ring *ring, void *item, bool const *stop );
+
+/**
+    This function takes the oldest pointer out of the ring, waiting
+    for one if the ring is empty, in the same way as ringPushWait().
+    @param ring the ring to take from
+    @param stop flag another thread sets to abandon the wait
+    @return the pointer, or NULL if the wait was abandoned
+*/
+void *ringPopWait( Ring *ring, bool const *stop );
+
+#endif
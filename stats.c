@@ -0,0 +1,217 @@
+/**
+    @file stats.c
+    @author John Butterfield (jpbutte2)
+    Statistics component. Each thread finds its own record through a
+    thread-local pointer, which is NULL unless statistics are on, so
+    the cost of the calls when --stats isn't given is one test.
+*/
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "stats.h"
+#include "pool.h"
+#include "DES.h"
+
+#ifndef DES_NO_STATS
+
+/** Longest thread name kept in a record. */
+#define NAME_LENGTH 16
+
+/** Number of bytes in a megabyte, for throughput. */
+#define MEGABYTE 1e6
+
+/** Names of the phases in the report, in the order of Phase. */
+static char const *const phaseNames[ PHASE_COUNT ] = {
+    "open", "keys", "read", "cipher", "write", "close"
+};
+
+/** Statistics recorded by one thread. */
+typedef struct {
+  /** What the thread does. */
+  char name[ NAME_LENGTH ];
+
+  /** Number telling threads with the same name apart. */
+  int index;
+
+  /** Wall-clock time in each phase, in seconds. */
+  double wall[ PHASE_COUNT ];
+
+  /** CPU time in each phase, in seconds. */
+  double cpu[ PHASE_COUNT ];
+
+  /** Bytes of input read. */
+  uint64_t bytesIn;
+
+  /** Bytes of output written. */
+  uint64_t bytesOut;
+} ThreadStats;
+
+/** Record of the calling thread, or NULL if it doesn't have one. */
+static __thread ThreadStats *current;
+
+/** True once statsEnable() has been called. */
+static bool enabled;
+
+/** Wall-clock time when statistics were turned on. */
+static double startWall;
+
+/** Process CPU time when statistics were turned on. */
+static double startCpu;
+
+/** Which way the I/O was done. */
+static char const *ioPath = "none";
+
+/** Every thread's record. */
+static ThreadStats threads[ STATS_MAX_THREADS ];
+
+/** Number of records handed out. */
+static int threadCount;
+
+/** Protects threadCount while threads start. */
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+    Read one of the system clocks.
+    @param clock the clock to read
+    @return the time in seconds
+*/
+static double readClock( clockid_t clock )
+{
+    struct timespec ts;
+    clock_gettime( clock, &ts );
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void statsEnable( void )
+{
+    enabled = true;
+    startWall = readClock( CLOCK_MONOTONIC );
+    startCpu = readClock( CLOCK_PROCESS_CPUTIME_ID );
+    statsThread( "main", 0 );
+}
+
+void statsThread( char const *name, int index )
+{
+    if ( !enabled ) {
+        return;
+    }
+
+    pthread_mutex_lock( &statsLock );
+    ThreadStats *record = threadCount < STATS_MAX_THREADS ? &threads[ threadCount++ ] : NULL;
+    pthread_mutex_unlock( &statsLock );
+
+    if ( record != NULL ) {
+        snprintf( record->name, sizeof( record->name ), "%s", name );
+        record->index = index;
+    }
+    current = record;
+}
+
+void statsPath( char const *path )
+{
+    ioPath = path;
+}
+
+void statsBegin( StatsMark *mark )
+{
+    if ( current == NULL ) {
+        return;
+    }
+
+    mark->wall = readClock( CLOCK_MONOTONIC );
+    mark->cpu = readClock( CLOCK_THREAD_CPUTIME_ID );
+}
+
+void statsEnd( Phase phase, StatsMark const *mark )
+{
+    if ( current == NULL ) {
+        return;
+    }
+
+    current->wall[ phase ] += readClock( CLOCK_MONOTONIC ) - mark->wall;
+    current->cpu[ phase ] += readClock( CLOCK_THREAD_CPUTIME_ID ) - mark->cpu;
+}
+
+void statsBytes( uint64_t in, uint64_t out )
+{
+    if ( current == NULL ) {
+        return;
+    }
+
+    current->bytesIn += in;
+    current->bytesOut += out;
+}
+
+/**
+    Write the time in each phase as a JSON object.
+    @param fp the file to write to
+    @param wall wall-clock time in each phase
+    @param cpu CPU time in each phase
+*/
+static void writePhases( FILE *fp, double const wall[ PHASE_COUNT ],
+                         double const cpu[ PHASE_COUNT ] )
+{
+    fprintf( fp, "{" );
+    for ( int p = 0; p < PHASE_COUNT; p++ ) {
+        fprintf( fp, "%s\"%s\":{\"wall_s\":%.6f,\"cpu_s\":%.6f}", p > 0 ? "," : "",
+                 phaseNames[ p ], wall[ p ], cpu[ p ] );
+    }
+    fprintf( fp, "}" );
+}
+
+void statsReport( FILE *fp, char const *program, bool ok )
+{
+    if ( !enabled ) {
+        return;
+    }
+
+    double wall = readClock( CLOCK_MONOTONIC ) - startWall;
+    double cpu = readClock( CLOCK_PROCESS_CPUTIME_ID ) - startCpu;
+
+    // Every thread has finished, so the records can be read freely
+    double phaseWall[ PHASE_COUNT ] = { 0 }, phaseCpu[ PHASE_COUNT ] = { 0 };
+    uint64_t bytesIn = 0, bytesOut = 0;
+    for ( int i = 0; i < threadCount; i++ ) {
+        for ( int p = 0; p < PHASE_COUNT; p++ ) {
+            phaseWall[ p ] += threads[ i ].wall[ p ];
+            phaseCpu[ p ] += threads[ i ].cpu[ p ];
+        }
+        bytesIn += threads[ i ].bytesIn;
+        bytesOut += threads[ i ].bytesOut;
+    }
+
+    // The kernel gives the peak resident size in kilobytes
+    struct rusage usage;
+    unsigned long long peakRss = 0;
+    if ( getrusage( RUSAGE_SELF, &usage ) == 0 ) {
+        peakRss = (unsigned long long) usage.ru_maxrss * 1024;
+    }
+
+    fprintf( fp, "{\"program\":\"%s\",\"ok\":%s,\"path\":\"%s\",\"threads\":%d,"
+             "\"wall_s\":%.6f,\"cpu_s\":%.6f,\"bytes_in\":%llu,\"bytes_out\":%llu,"
+             "\"blocks\":%llu,\"mb_per_s\":%.3f,\"buffer_peak_bytes\":%llu,"
+             "\"rss_peak_bytes\":%llu,\"phases\":",
+             program, ok ? "true" : "false", ioPath, threadCount, wall, cpu,
+             (unsigned long long) bytesIn, (unsigned long long) bytesOut,
+             (unsigned long long) ( ( bytesIn + BLOCK_BYTES - 1 ) / BLOCK_BYTES ),
+             wall > 0 ? bytesIn / MEGABYTE / wall : 0.0,
+             (unsigned long long) poolPeakBytes(), peakRss );
+    writePhases( fp, phaseWall, phaseCpu );
+
+    fprintf( fp, ",\"per_thread\":[" );
+    for ( int i = 0; i < threadCount; i++ ) {
+        ThreadStats const *t = &threads[ i ];
+        fprintf( fp, "%s{\"name\":\"%s\",\"index\":%d,\"bytes_in\":%llu,\"bytes_out\":%llu,"
+                 "\"phases\":", i > 0 ? "," : "", t->name, t->index,
+                 (unsigned long long) t->bytesIn, (unsigned long long) t->bytesOut );
+        writePhases( fp, t->wall, t->cpu );
+        fprintf( fp, "}" );
+    }
+    fprintf( fp, "]}\n" );
+}
+
+#endif
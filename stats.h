@@ -0,0 +1,124 @@
+/**
+    @file stats.h
+    @author John Butterfield (jpbutte2)
+    Header for the statistics component. When --stats is given, each
+    thread that does part of a job records the wall-clock and CPU time
+    it spends in each phase, and the bytes it moves, in a record of its
+    own, so threads never contend. At the end the records are reported
+    on one JSON line. Without --stats every call returns straight away,
+    and building with DES_NO_STATS compiles the calls out altogether.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Most threads that can record statistics: every worker, plus the
+    main, reader and writer threads. */
+#define STATS_MAX_THREADS 260
+
+/** The phases a job's time is divided into. */
+typedef enum {
+  /** Opening the files. */
+  PHASE_OPEN,
+
+  /** Setting up the key schedule. */
+  PHASE_KEYS,
+
+  /** Reading input, including file headers and mapping input. */
+  PHASE_READ,
+
+  /** Running the cipher. */
+  PHASE_CIPHER,
+
+  /** Writing output, including file headers and mapping output. */
+  PHASE_WRITE,
+
+  /** Closing the files. */
+  PHASE_CLOSE,
+
+  /** Number of phases. */
+  PHASE_COUNT
+} Phase;
+
+/** Start of a timed stretch of work. */
+typedef struct {
+  /** Wall-clock time, in seconds. */
+  double wall;
+
+  /** CPU time of the calling thread, in seconds. */
+  double cpu;
+} StatsMark;
+
+#ifdef DES_NO_STATS
+
+static inline void statsEnable( void ) {}
+static inline void statsThread( char const *name, int index ) {}
+static inline void statsPath( char const *path ) {}
+static inline void statsBegin( StatsMark *mark ) {}
+static inline void statsEnd( Phase phase, StatsMark const *mark ) {}
+static inline void statsBytes( uint64_t in, uint64_t out ) {}
+static inline void statsReport( FILE *fp, char const *program, bool ok ) {}
+
+#else
+
+/**
+    This function turns statistics on, records the start of the job
+    and gives the calling thread a record named "main".
+*/
+void statsEnable( void );
+
+/**
+    This function gives the calling thread its own record, which the
+    calls below then update. It does nothing unless statistics are on.
+    @param name what the thread does, such as "worker" or "reader"
+    @param index number telling threads with the same name apart
+*/
+void statsThread( char const *name, int index );
+
+/**
+    This function records which way the job's I/O is being done.
+    @param path short name for the path, such as "mapped"
+*/
+void statsPath( char const *path );
+
+/**
+    This function marks the start of some work by the calling thread.
+    @param mark where to store the start time
+*/
+void statsBegin( StatsMark *mark );
+
+/**
+    This function adds the time since statsBegin() to a phase of the
+    calling thread's record.
+    @param phase the phase the work belongs to
+    @param mark the start time from statsBegin()
+*/
+void statsEnd( Phase phase, StatsMark const *mark );
+
+/**
+    This function adds to the bytes read and written by the calling
+    thread.
+    @param in number of bytes of input
+    @param out number of bytes of output
+*/
+void statsBytes( uint64_t in, uint64_t out );
+
+/**
+    This function writes the statistics as a single line of JSON: the
+    totals for the job, the peak memory, both in pool buffers and
+    resident, the time in each phase summed over all threads, and each
+    thread's own record. It does nothing unless statistics are
+    on.
+    @param fp the file to write to
+    @param program name of the program
+    @param ok true if the job succeeded
+*/
+void statsReport( FILE *fp, char const *program, bool ok );
+
+#endif
+
+#endif
@@ -6,6 +6,10 @@
 # Assume we've succeeded until we see otherwise.
 FAIL=0
 
+# Leave any tuned profile alone, so every case runs with the built-in
+# settings unless it sets DES_PROFILE itself.
+export DES_PROFILE=
+
 # Print an error message and set the fail flag.
 fail() {
     echo "**** $1"
@@ -170,6 +174,209 @@ testDecrypt() {
     return 0
 }
 
+# Run a test case that pipes the input file (INPUT) through a program
+# (PROG), with "-" for both of its file names.
+testPipe() {
+    TESTNO="$1"
+    PROG="$2"
+    INPUT="$3"
+    EOUTPUT="$4"
+
+    rm -f output.bin
+
+    echo "Test $TESTNO"
+    echo "   cat $INPUT | ./$PROG ${args[@]} - - > output.bin 2> stderr.txt"
+    cat "$INPUT" | ./$PROG ${args[@]} - - > output.bin 2> stderr.txt
+    ASTATUS=$?
+
+    if ! checkStatus 0 "$ASTATUS" ||
+	    ! checkFile "Piped output" "$EOUTPUT" "output.bin" ||
+	    ! checkEmpty "Stderr output" "stderr.txt"
+    then
+	FAIL=1
+	return 1
+    fi
+
+    echo "Test $TESTNO PASS"
+    return 0
+}
+
+# Run a round trip: encrypt INPUT with the options in args into
+# output.bin, then decrypt that with the options in dargs into
+# output.txt, and check it matches INPUT. The nonce is random, so the
+# ciphertext itself can't be checked.
+testRoundTrip() {
+    TESTNO="$1"
+    INPUT="$2"
+
+    rm -f output.bin output.txt
+
+    echo "Test $TESTNO"
+    echo "   ./encrypt ${args[@]} $INPUT output.bin 2> stderr.txt"
+    echo "   ./decrypt ${dargs[@]} output.bin output.txt 2>> stderr.txt"
+    ./encrypt ${args[@]} "$INPUT" output.bin 2> stderr.txt &&
+	./decrypt ${dargs[@]} output.bin output.txt 2>> stderr.txt
+    ASTATUS=$?
+
+    if ! checkStatus 0 "$ASTATUS" ||
+	    ! checkFile "Round trip output file" "$INPUT" "output.txt" ||
+	    ! checkEmpty "Stderr output" "stderr.txt"
+    then
+	FAIL=1
+	return 1
+    fi
+
+    echo "Test $TESTNO PASS"
+    return 0
+}
+
+# Run a test case with --stats on a program (PROG) writing to OUTFILE.
+# The timings vary, so stderr is only checked for being one line of
+# JSON reporting success.
+testStats() {
+    TESTNO="$1"
+    PROG="$2"
+    OUTFILE="$3"
+    EOUTPUT="$4"
+
+    rm -f "$OUTFILE"
+
+    echo "Test $TESTNO"
+    echo "   ./$PROG --stats ${args[@]} > stdout.txt 2> stderr.txt"
+    ./$PROG --stats ${args[@]} > stdout.txt 2> stderr.txt
+    ASTATUS=$?
+
+    if ! checkStatus 0 "$ASTATUS" ||
+	    ! checkEmpty "Terminal output" "stdout.txt" ||
+	    ! checkFile "Output file" "$EOUTPUT" "$OUTFILE"
+    then
+	FAIL=1
+	return 1
+    fi
+
+    if [ "$(wc -l < stderr.txt)" -ne 1 ] ||
+	    ! grep -q "^{\"program\":\"$PROG\",\"ok\":true,.*}$" stderr.txt
+    then
+	fail "FAILED - Stderr output (stderr.txt) isn't a line of statistics"
+	return 1
+    fi
+
+    echo "Test $TESTNO PASS"
+    return 0
+}
+
+# Run a test case with --batch on a program (PROG), writing into the
+# batch-out directory, and check one of the files it wrote (BFILE).
+testBatch() {
+    TESTNO="$1"
+    PROG="$2"
+    BFILE="$3"
+    EOUTPUT="$4"
+
+    rm -rf batch-out
+
+    echo "Test $TESTNO"
+    echo "   ./$PROG --batch ${args[@]} batch-out > stdout.txt 2> stderr.txt"
+    ./$PROG --batch ${args[@]} batch-out > stdout.txt 2> stderr.txt
+    ASTATUS=$?
+
+    if ! checkStatus 0 "$ASTATUS" ||
+	    ! checkEmpty "Terminal output" "stdout.txt" ||
+	    ! checkFile "Batch output file" "$EOUTPUT" "batch-out/$BFILE" ||
+	    ! checkEmpty "Stderr output" "stderr.txt"
+    then
+	FAIL=1
+	return 1
+    fi
+
+    rm -rf batch-out
+    echo "Test $TESTNO PASS"
+    return 0
+}
+
+# Run a test case on the keysearch program, and check the keys it
+# reports against the expected keys (EKEYS).
+testKeysearch() {
+    TESTNO="$1"
+    EKEYS="$2"
+
+    rm -f keysearch.ckpt
+
+    echo "Test $TESTNO"
+    echo "   ./keysearch ${args[@]} > stdout.txt 2> stderr.txt"
+    ./keysearch ${args[@]} > stdout.txt 2> stderr.txt
+    ASTATUS=$?
+
+    grep "^Key: " stdout.txt > output.txt
+    if ! checkStatus 0 "$ASTATUS" ||
+	    ! checkFile "Keys found" "$EKEYS" "output.txt" ||
+	    ! checkEmpty "Stderr output" "stderr.txt"
+    then
+	FAIL=1
+	return 1
+    fi
+
+    if ! grep -q "^Thread 0: [0-9]* keys in .*keys/s$" stdout.txt
+    then
+	fail "FAILED - Terminal output (stdout.txt) has no speed for each thread"
+	return 1
+    fi
+
+    rm -f keysearch.ckpt
+    echo "Test $TESTNO PASS"
+    return 0
+}
+
+# Run --autotune on a program (PROG) with a profile file holding a line
+# for another machine, which should be kept, and then run the program
+# with the profile it saved, which should write the expected file
+# (EOUTPUT).
+testAutotune() {
+    TESTNO="$1"
+    PROG="$2"
+    EOUTPUT="$3"
+
+    printf 'des-profile 1\nOther CPU\t64\ttable\t65536\t8\n' > test-profile
+    rm -f output.bin
+
+    echo "Test $TESTNO"
+    echo "   DES_PROFILE=test-profile ./$PROG --autotune > stdout.txt 2> stderr.txt"
+    DES_PROFILE=test-profile ./$PROG --autotune > stdout.txt 2> stderr.txt
+    ASTATUS=$?
+
+    if ! checkStatus 0 "$ASTATUS" ||
+	    ! checkEmpty "Terminal output" "stdout.txt"
+    then
+	FAIL=1
+	return 1
+    fi
+
+    if ! grep -q "^Profile: engine " stderr.txt ||
+	    [ "$(head -n 2 test-profile)" != "$(printf 'des-profile 1\nOther CPU\t64\ttable\t65536\t8')" ] ||
+	    [ "$(wc -l < test-profile)" -ne 3 ]
+    then
+	fail "FAILED - test-profile doesn't have a line for this machine after the other one"
+	return 1
+    fi
+
+    echo "   DES_PROFILE=test-profile ./$PROG ${args[@]} > stdout.txt 2> stderr.txt"
+    DES_PROFILE=test-profile ./$PROG ${args[@]} > stdout.txt 2> stderr.txt
+    ASTATUS=$?
+
+    if ! checkStatus 0 "$ASTATUS" ||
+	    ! checkEmpty "Terminal output" "stdout.txt" ||
+	    ! checkFile "Encrypted output file" "$EOUTPUT" "output.bin" ||
+	    ! checkEmpty "Stderr output" "stderr.txt"
+    then
+	FAIL=1
+	return 1
+    fi
+
+    rm -f test-profile
+    echo "Test $TESTNO PASS"
+    return 0
+}
+
 # Try the unit tests
 make clean
 make DESTest
@@ -218,6 +425,54 @@ if [ -x encrypt ]; then
     
     args=(password missing-file.txt output.bin)
     testEncrypt 08 noOutputFile.bin 1
+
+    args=(--chunk-size 1K Claudius plain-f.txt output.bin)
+    testEncrypt 16 cipher-f.bin 0
+
+    args=(--mmap ciaba++a plain-c.txt output.bin)
+    testEncrypt 18 cipher-c.bin 0
+
+    args=(-j 4 --chunk-size 1K Claudius plain-f.txt output.bin)
+    testEncrypt 20 cipher-f.bin 0
+
+    args=(--key2 passw0rd ciaba++a plain-c.txt output.bin)
+    testEncrypt 29 cipher-k.bin 0
+
+    args=(Claudius)
+    testPipe 30 encrypt plain-f.txt cipher-f.bin
+
+    args=(-j 3 --chunk-size 1K --max-memory 8K Claudius)
+    testPipe 31 encrypt plain-f.txt cipher-f.bin
+
+    args=(--io uring -j 2 --chunk-size 1K Claudius plain-f.txt output.bin)
+    testEncrypt 34 cipher-f.bin 0
+
+    args=(--offset 8 Claudius plain-f.txt output.bin)
+    testEncrypt 36 noOutputFile.bin 1
+
+    args=(-j 2 --chunk-size 1K Claudius plain-f.txt output.bin)
+    testStats 41 encrypt output.bin cipher-f.bin
+
+    args=(-j 2 --chunk-size 1K Claudius batch-enc.txt)
+    testBatch 43 encrypt plain-f.txt cipher-f.bin
+
+    args=(--engine reference Claudius plain-f.txt output.bin)
+    testEncrypt 47 cipher-f.bin 0
+
+    args=(--engine fast Claudius plain-f.txt output.bin)
+    testEncrypt 49 noOutputFile.bin 1
+
+    args=(Claudius plain-f.txt output.bin)
+    testAutotune 50 encrypt cipher-f.bin
+
+    args=(--compress Claudius plain-f.txt output.bin)
+    testEncrypt 51 noOutputFile.bin 1
+
+    args=(--container --chunk-size 1K Claudius plain-h.txt output.bin)
+    testEncrypt 56 cipher-n.bin 0
+
+    args=(--container --batch Claudius batch-enc.txt)
+    testEncrypt 57 noOutputFile.bin 1
 else
     fail "Since your encrypt program didn't compile, we couldn't test it"
 fi
@@ -244,10 +499,139 @@ if [ -x decrypt ]; then
     
     args=(hashtags cipher-g.bin)
     testDecrypt 15 noOutputFile.txt 1
+
+    args=(--chunk-size 20 Claudius cipher-f.bin output.txt)
+    testDecrypt 17 plain-f.txt 0
+
+    args=(--mmap Claudius cipher-f.bin output.txt)
+    testDecrypt 19 plain-f.txt 0
+
+    args=(-j 3 --chunk-size 1K Claudius cipher-f.bin output.txt)
+    testDecrypt 21 plain-f.txt 0
+
+    args=(--mode ctr Claudius cipher-h.bin output.txt)
+    testDecrypt 22 plain-f.txt 0
+
+    args=(--mode ctr -j 2 --chunk-size 1K Claudius cipher-h.bin output.txt)
+    testDecrypt 23 plain-f.txt 0
+
+    args=(--mode ctr Claudius cipher-f.bin output.txt)
+    testDecrypt 24 noOutputFile.txt 1
+
+    args=(--mode cbc Claudius cipher-i.bin output.txt)
+    testDecrypt 25 plain-f.txt 0
+
+    args=(--mode cbc -j 2 --chunk-size 1K Claudius cipher-i.bin output.txt)
+    testDecrypt 26 plain-f.txt 0
+
+    args=(--mode cbc Claudius cipher-f.bin output.txt)
+    testDecrypt 27 noOutputFile.txt 1
+
+    args=(--mode cbc --key2 passw0rd --key3 ciaba++a Claudius cipher-j.bin output.txt)
+    testDecrypt 28 plain-f.txt 0
+
+    args=(--pipeline --mode cbc Claudius)
+    testPipe 32 decrypt cipher-i.bin plain-f.txt
+
+    args=(-j 2 --chunk-size 1K Claudius)
+    testPipe 33 decrypt cipher-f.bin plain-f.txt
+
+    args=(--io uring --mode cbc --chunk-size 1K Claudius cipher-i.bin output.txt)
+    testDecrypt 35 plain-f.txt 0
+
+    args=(--offset 1000 --length 4K Claudius cipher-f.bin output.txt)
+    testDecrypt 37 slice-f.txt 0
+
+    args=(--mode ctr --offset 1000 --length 4K Claudius cipher-h.bin output.txt)
+    testDecrypt 38 slice-f.txt 0
+
+    args=(--mode cbc --offset 1000 --length 4K Claudius cipher-i.bin output.txt)
+    testDecrypt 39 slice-f.txt 0
+
+    args=(--mode cbc --offset 186000 Claudius cipher-i.bin output.txt)
+    testDecrypt 40 slice-g.txt 0
+
+    args=(--pipeline --mode cbc Claudius cipher-i.bin output.txt)
+    testStats 42 decrypt output.txt plain-f.txt
+
+    args=(--mode cbc -j 2 --chunk-size 1K Claudius batch-dec.txt)
+    testBatch 44 decrypt cipher-i.bin plain-f.txt
+
+    args=(--engine bitslice-scalar --mode cbc -j 2 --chunk-size 1K Claudius cipher-i.bin output.txt)
+    testDecrypt 48 plain-f.txt 0
+
+    args=(--mode ctr Claudius cipher-l.bin output.txt)
+    testDecrypt 52 plain-f.txt 0
+
+    args=(--mode cbc -j 2 Claudius cipher-m.bin output.txt)
+    testDecrypt 53 plain-f.txt 0
+
+    args=(--mode cbc Claudius)
+    testPipe 54 decrypt cipher-m.bin plain-f.txt
+
+    args=(--mode cbc --offset 1000 Claudius cipher-m.bin output.txt)
+    testDecrypt 55 noOutputFile.txt 1
+
+    args=(-j 2 Claudius cipher-n.bin output.txt)
+    testDecrypt 58 plain-h.txt 0
+
+    args=(--offset 2000 Claudius cipher-n.bin output.txt)
+    testDecrypt 59 slice-h.txt 0
+
+    args=(--container Claudius)
+    testPipe 60 decrypt cipher-n.bin plain-h.txt
+
+    args=(Claudius cipher-o.bin output.txt)
+    testDecrypt 61 noOutputFile.txt 1
+
+    args=(--offset -1 Claudius cipher-f.bin output.txt)
+    testDecrypt 62 noOutputFile.txt 1
 else
     fail "Since your decrypt program didn't compile, we couldn't test it"
 fi
 
+# Round trips through both programs, for the modes whose output has a
+# random nonce
+if [ -x encrypt ] && [ -x decrypt ]; then
+    args=(--mode ctr -j 3 --chunk-size 1K Claudius)
+    dargs=(--mode ctr Claudius)
+    testRoundTrip 63 plain-f.txt
+
+    args=(--mode ctr --io uring -j 2 --chunk-size 1K Claudius)
+    dargs=(--mode ctr -j 2 --chunk-size 4K Claudius)
+    testRoundTrip 64 plain-f.txt
+
+    args=(--mode cbc -j 3 --chunk-size 1K Claudius)
+    dargs=(--mode cbc -j 3 --chunk-size 1K Claudius)
+    testRoundTrip 65 plain-f.txt
+
+    args=(--mode cbc --key2 passw0rd --key3 ciaba++a -j 2 --chunk-size 1K Claudius)
+    dargs=(--mode cbc --key2 passw0rd --key3 ciaba++a Claudius)
+    testRoundTrip 66 plain-f.txt
+
+    args=(--mode cbc --pipeline -j 2 --chunk-size 1K Claudius)
+    dargs=(--mode cbc --pipeline -j 2 --chunk-size 1K Claudius)
+    testRoundTrip 67 plain-f.txt
+
+    args=(--compress --mode cbc -j 3 --chunk-size 1K Claudius)
+    dargs=(--mode cbc -j 3 Claudius)
+    testRoundTrip 68 plain-f.txt
+
+    args=(--compress --mode ctr --io uring -j 2 --chunk-size 1K Claudius)
+    dargs=(--mode ctr Claudius)
+    testRoundTrip 69 plain-f.txt
+fi
+
+if [ -x keysearch ]; then
+    args=(--charset hoqrst --max-length 5 plain-d.txt cipher-d.bin)
+    testKeysearch 45 keys-d.txt
+
+    args=(--charset hoqrst --min-length 3 --max-length 5 -j 2 --checkpoint keysearch.ckpt plain-d.txt cipher-d.bin)
+    testKeysearch 46 keys-d.txt
+else
+    fail "Since your keysearch program didn't compile, we couldn't test it"
+fi
+
 if [ $FAIL -ne 0 ]; then
   echo "FAILING TESTS!"
   exit 13
@@ -0,0 +1,556 @@
+/**
+    @file tune.c
+    @author John Butterfield (jpbutte2)
+    Tuning component shared by the encrypt and decrypt programs. The
+    profile file starts with a version line, followed by one line per
+    kind of machine, with tab-separated fields: the processor model,
+    the number of cores, the engine, the chunk size and the thread
+    count.
+*/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+#endif
+#include "tune.h"
+#include "driver.h"
+#include "io.h"
+
+/** Name of the profile file in the cache directory. */
+#define PROFILE_NAME "des-profile"
+
+/** Longest line in a profile file that gets read. */
+#define PROFILE_LINE_MAX 256
+
+/** Most lines, other than this machine's, kept in a profile file. */
+#define PROFILE_MAX_LINES 64
+
+/** Room for the name of a scratch file. */
+#define SCRATCH_PATH_MAX 4096
+
+/** Bytes in the buffer the engines are timed on. */
+#define TUNE_BUFFER_BYTES ( 256 * 1024 )
+
+/** Blocks encrypted one call at a time when timing an engine. */
+#define TUNE_SINGLE_BLOCKS 2048
+
+/** Key the trials encrypt with. */
+#define TUNE_KEY "autotune"
+
+/** Chunk sizes tried, with the default first so it wins ties. */
+static size_t const chunkSizes[] = {
+    DEFAULT_CHUNK_BYTES, 64 * 1024, 256 * 1024, 4 * 1024 * 1024
+};
+
+/**
+    Read a clock.
+    @param clock the clock to read
+    @return its time in seconds
+*/
+static double readClock( clockid_t clock )
+{
+    struct timespec ts;
+    clock_gettime( clock, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void machineFingerprint( Profile *profile )
+{
+    char name[ 49 ] = "";
+#if defined( __x86_64__ ) || defined( __i386__ )
+    // The brand string is in leaves 0x80000002 through 0x80000004
+    unsigned regs[ 12 ];
+    if ( __get_cpuid_max( 0x80000000, NULL ) >= 0x80000004 ) {
+        for ( int i = 0; i < 3; i++ ) {
+            __get_cpuid( 0x80000002 + i, &regs[ 4 * i ], &regs[ 4 * i + 1 ],
+                         &regs[ 4 * i + 2 ], &regs[ 4 * i + 3 ] );
+        }
+        memcpy( name, regs, sizeof( regs ) );
+        name[ sizeof( regs ) ] = '\0';
+    }
+#endif
+
+    // Without a brand string, the architecture is the best there is
+    char const *start = name + strspn( name, " " );
+    struct utsname uts;
+    if ( *start == '\0' && uname( &uts ) == 0 ) {
+        start = uts.machine;
+    }
+
+    // Tabs and newlines would split the line in the profile file
+    snprintf( profile->cpu, sizeof( profile->cpu ), "%s", *start ? start : "unknown" );
+    for ( char *c = profile->cpu; *c; c++ ) {
+        if ( *c == '\t' || *c == '\n' ) {
+            *c = ' ';
+        }
+    }
+
+    long cores = sysconf( _SC_NPROCESSORS_ONLN );
+    profile->cores = cores < 1 ? 1 : cores;
+}
+
+char const *profilePath( void )
+{
+    static char path[ 4096 ];
+
+    char const *given = getenv( "DES_PROFILE" );
+    if ( given != NULL ) {
+        return *given ? given : NULL;
+    }
+
+    char const *cache = getenv( "XDG_CACHE_HOME" );
+    char const *home = getenv( "HOME" );
+    int len;
+    if ( cache != NULL && *cache ) {
+        len = snprintf( path, sizeof( path ), "%s/%s", cache, PROFILE_NAME );
+    } else if ( home != NULL && *home ) {
+        len = snprintf( path, sizeof( path ), "%s/.cache/%s", home, PROFILE_NAME );
+    } else {
+        return NULL;
+    }
+
+    return len < (int) sizeof( path ) ? path : NULL;
+}
+
+/**
+    Time one engine on a buffer: how fast it goes on long runs of
+    blocks, and one block per call.
+    @param engine the engine
+    @param buffer the blocks to encrypt in place, TUNE_BUFFER_BYTES long
+    @param bulk where to store the long-run speed, in bytes per second
+    @param single where to store the block-at-a-time speed
+    @return true if successful, false if the engine failed its
+    self-test or there wasn't enough memory
+*/
+static bool timeEngine( DESEngine const *engine, byte *buffer, double *bulk, double *single )
+{
+    byte key[ BLOCK_BYTES ];
+    prepareKey( key, TUNE_KEY );
+    DESContext *ctx = desContextCreate( key, MODE_ECB );
+    if ( ctx == NULL || !desContextSetEngine( ctx, engine ) ) {
+        desContextFree( ctx );
+        return false;
+    }
+
+    // Once through first, so the tables are warm before the clock starts
+    desCryptBlocks( ctx, false, buffer, buffer, TUNE_BUFFER_BYTES );
+    double start = readClock( CLOCK_MONOTONIC );
+    double elapsed;
+    size_t bytes = 0;
+    do {
+        desCryptBlocks( ctx, false, buffer, buffer, TUNE_BUFFER_BYTES );
+        bytes += TUNE_BUFFER_BYTES;
+        elapsed = readClock( CLOCK_MONOTONIC ) - start;
+    } while ( elapsed < TUNE_ENGINE_SECONDS );
+    *bulk = bytes / elapsed;
+
+    start = readClock( CLOCK_MONOTONIC );
+    for ( int i = 0; i < TUNE_SINGLE_BLOCKS; i++ ) {
+        byte *block = buffer + ( i * BLOCK_BYTES ) % TUNE_BUFFER_BYTES;
+        desCryptBlocks( ctx, false, block, block, BLOCK_BYTES );
+    }
+    elapsed = readClock( CLOCK_MONOTONIC ) - start;
+    *single = TUNE_SINGLE_BLOCKS * BLOCK_BYTES / ( elapsed > 0 ? elapsed : 1e-9 );
+
+    desContextFree( ctx );
+    return true;
+}
+
+/**
+    Pick the engine for the profile. The engines all give the same
+    answers, so the trial is on whatever is in the buffer.
+    @param profile where to store the engine
+    @param report where to describe each trial, or NULL
+    @return true if successful, false after printing an error message
+*/
+static bool tuneEngine( Profile *profile, FILE *report )
+{
+    byte *buffer = malloc( TUNE_BUFFER_BYTES );
+    if ( buffer == NULL ) {
+        perror( "autotune" );
+        return false;
+    }
+    for ( size_t i = 0; i < TUNE_BUFFER_BYTES; i++ ) {
+        buffer[ i ] = i * 131 + ( i >> 8 );
+    }
+
+    DESEngine const *list[ DES_ENGINE_MAX ];
+    int count = desEngines( list );
+
+    // Auto comes first, and the reference is only there to check against
+    double bestBulk = 0, autoSingle = 0;
+    profile->engine = list[ 0 ];
+    for ( int i = 0; i < count; i++ ) {
+        double bulk, single;
+        if ( strcmp( list[ i ]->name, "reference" ) == 0 ||
+             !timeEngine( list[ i ], buffer, &bulk, &single ) ) {
+            continue;
+        }
+
+        if ( report != NULL ) {
+            fprintf( report, "Engine %s: %.1f MB/s, %.1f MB/s a block at a time\n",
+                     list[ i ]->name, bulk / 1e6, single / 1e6 );
+        }
+
+        if ( i == 0 ) {
+            bestBulk = bulk;
+            autoSingle = single;
+        } else if ( bulk > bestBulk * ( 1 + TUNE_MARGIN ) &&
+                    single >= autoSingle * ( 1 - TUNE_MARGIN ) ) {
+            bestBulk = bulk;
+            profile->engine = list[ i ];
+        }
+    }
+
+    free( buffer );
+    return true;
+}
+
+/**
+    Make the scratch input file for the file trials.
+    @param path where to store its name
+    @return true if successful, false after printing an error message
+*/
+static bool makeScratchFile( char path[ SCRATCH_PATH_MAX ] )
+{
+    char const *dir = getenv( "TMPDIR" );
+    snprintf( path, SCRATCH_PATH_MAX, "%s/des-tune-XXXXXX", dir != NULL && *dir ? dir : "/tmp" );
+    int fd = mkstemp( path );
+    if ( fd < 0 ) {
+        perror( path );
+        return false;
+    }
+
+    byte *data = malloc( TUNE_FILE_BYTES );
+    bool ok = data != NULL;
+    if ( ok ) {
+        for ( size_t i = 0; i < TUNE_FILE_BYTES; i++ ) {
+            data[ i ] = i * 131 + ( i >> 8 );
+        }
+        ok = writeAt( fd, data, TUNE_FILE_BYTES, 0 );
+    }
+
+    if ( !ok ) {
+        perror( path );
+    }
+    free( data );
+    close( fd );
+    if ( !ok ) {
+        remove( path );
+    }
+    return ok;
+}
+
+/**
+    Time encrypting the scratch file with the given settings, taking
+    the better of two runs.
+    @param opts the settings to use
+    @param ctx the key to encrypt with
+    @param inPath the scratch input file
+    @param outPath the scratch output file
+    @param rate where to store the speed, in bytes per second
+    @return true if successful, false after printing an error message
+*/
+static bool timeFile( Options const *opts, DESContext const *ctx, char const *inPath,
+                      char const *outPath, double *rate )
+{
+    *rate = 0;
+    for ( int run = 0; run < 2; run++ ) {
+        FILE *inputFile = fopen( inPath, "rb" );
+        FILE *outputFile = fopen( outPath, "wb" );
+        if ( inputFile == NULL || outputFile == NULL ) {
+            perror( inputFile == NULL ? inPath : outPath );
+            if ( inputFile != NULL ) {
+                fclose( inputFile );
+            }
+            return false;
+        }
+
+        double start = readClock( CLOCK_MONOTONIC );
+        bool ok = cryptFile( opts, ctx, false, inputFile, outputFile );
+        ok = fclose( outputFile ) == 0 && ok;
+        double elapsed = readClock( CLOCK_MONOTONIC ) - start;
+        fclose( inputFile );
+        if ( !ok ) {
+            return false;
+        }
+
+        double speed = TUNE_FILE_BYTES / ( elapsed > 0 ? elapsed : 1e-9 );
+        if ( speed > *rate ) {
+            *rate = speed;
+        }
+    }
+
+    return true;
+}
+
+/**
+    Pick the chunk size and thread count for the profile by encrypting
+    the scratch file with each in turn. The chunk sizes are tried on one
+    thread, streaming, and the thread counts with the best chunk size,
+    the way -j runs them.
+    @param profile where to store the results, with the engine to use
+    @param inPath the scratch input file
+    @param outPath the scratch output file
+    @param report where to describe each trial, or NULL
+    @return true if successful, false after printing an error message
+*/
+static bool tuneFiles( Profile *profile, char const *inPath, char const *outPath,
+                       FILE *report )
+{
+    char *argv[] = { "autotune", TUNE_KEY, "-", "-", NULL };
+    Options opts;
+    parseOptions( &opts, 4, argv );
+    opts.engine = profile->engine;
+    opts.mmap = MMAP_OFF;
+    DESContext *ctx = createContext( &opts );
+    if ( ctx == NULL ) {
+        return false;
+    }
+
+    double best = 0;
+    bool ok = true;
+    profile->chunkBytes = chunkSizes[ 0 ];
+    for ( size_t i = 0; ok && i < sizeof( chunkSizes ) / sizeof( chunkSizes[ 0 ] ); i++ ) {
+        double rate;
+        opts.chunkBytes = chunkSizes[ i ];
+        ok = timeFile( &opts, ctx, inPath, outPath, &rate );
+        if ( ok && report != NULL ) {
+            fprintf( report, "Chunk size %zu: %.1f MB/s\n", chunkSizes[ i ], rate / 1e6 );
+        }
+        if ( ok && rate > best * ( 1 + TUNE_MARGIN ) ) {
+            best = rate;
+            profile->chunkBytes = chunkSizes[ i ];
+        }
+    }
+
+    // Fewer threads win ties, since they leave the other cores free
+    best = 0;
+    opts.chunkBytes = profile->chunkBytes;
+    profile->threads = 1;
+    int limit = profile->cores < MAX_THREADS ? profile->cores : MAX_THREADS;
+    for ( int threads = 1; ok && threads <= limit;
+          threads = threads < limit && threads * 2 > limit ? limit : threads * 2 ) {
+        double rate;
+        opts.threads = threads;
+        ok = timeFile( &opts, ctx, inPath, outPath, &rate );
+        if ( ok && report != NULL ) {
+            fprintf( report, "Threads %d: %.1f MB/s\n", threads, rate / 1e6 );
+        }
+        if ( ok && rate > best * ( 1 + TUNE_MARGIN ) ) {
+            best = rate;
+            profile->threads = threads;
+        }
+    }
+
+    desContextFree( ctx );
+    return ok;
+}
+
+bool tuneMachine( Profile *profile, FILE *report )
+{
+    machineFingerprint( profile );
+    if ( report != NULL ) {
+        fprintf( report, "Tuning for %s, %d cores\n", profile->cpu, profile->cores );
+    }
+
+    if ( !tuneEngine( profile, report ) ) {
+        return false;
+    }
+
+    char inPath[ SCRATCH_PATH_MAX ], outPath[ SCRATCH_PATH_MAX + sizeof( ".out" ) ];
+    if ( !makeScratchFile( inPath ) ) {
+        return false;
+    }
+    snprintf( outPath, sizeof( outPath ), "%s.out", inPath );
+
+    bool ok = tuneFiles( profile, inPath, outPath, report );
+    remove( inPath );
+    remove( outPath );
+    return ok;
+}
+
+/**
+    Split a profile line into its fields.
+    @param line the line, whose tabs and newline are overwritten
+    @param fields where to store the five fields
+    @return true if the line has exactly five fields
+*/
+static bool splitLine( char *line, char *fields[ 5 ] )
+{
+    line[ strcspn( line, "\n" ) ] = '\0';
+    for ( int i = 0; i < 5; i++ ) {
+        fields[ i ] = line;
+        line += strcspn( line, "\t" );
+        if ( i < 4 ) {
+            if ( *line != '\t' ) {
+                return false;
+            }
+            *line++ = '\0';
+        }
+    }
+
+    return *line == '\0';
+}
+
+/**
+    Report whether a profile line is for the given machine.
+    @param line the line, which is left as it was
+    @param profile the machine
+    @return true if the line's processor and core count match
+*/
+static bool sameMachine( char const *line, Profile const *profile )
+{
+    size_t len = strlen( profile->cpu );
+    char *end;
+    return strncmp( line, profile->cpu, len ) == 0 && line[ len ] == '\t' &&
+           strtol( line + len + 1, &end, 10 ) == profile->cores && *end == '\t';
+}
+
+bool loadProfile( char const *path, Profile *profile )
+{
+    FILE *fp = fopen( path, "r" );
+    if ( fp == NULL ) {
+        return false;
+    }
+
+    char line[ PROFILE_LINE_MAX ];
+    int version;
+    bool found = false;
+    if ( fgets( line, sizeof( line ), fp ) != NULL &&
+         sscanf( line, "des-profile %d", &version ) == 1 && version == PROFILE_VERSION ) {
+        while ( !found && fgets( line, sizeof( line ), fp ) != NULL ) {
+            char *fields[ 5 ];
+            if ( !sameMachine( line, profile ) || !splitLine( line, fields ) ) {
+                continue;
+            }
+
+            // A line naming an engine this build doesn't have is stale
+            char *end;
+            unsigned long long chunk = strtoull( fields[ 3 ], &end, 10 );
+            long threads = strtol( fields[ 4 ], &end, 10 );
+            profile->engine = desEngineFind( fields[ 2 ] );
+            profile->chunkBytes = chunk;
+            profile->threads = threads;
+            found = profile->engine != NULL && chunk > 0 && chunk <= SIZE_MAX &&
+                    threads >= 1 && threads <= MAX_THREADS;
+        }
+    }
+
+    fclose( fp );
+    return found;
+}
+
+/**
+    Make the directory a file goes in, if it's missing. Only the last
+    directory is made, which is enough for ~/.cache.
+    @param path the file
+*/
+static void makeParentDirectory( char const *path )
+{
+    char const *slash = strrchr( path, '/' );
+    if ( slash == NULL || slash == path ) {
+        return;
+    }
+
+    char *dir = strndup( path, slash - path );
+    if ( dir != NULL ) {
+        mkdir( dir, 0755 );
+        free( dir );
+    }
+}
+
+bool saveProfile( char const *path, Profile const *profile )
+{
+    // Keep the lines for other machines that share the file
+    char *kept[ PROFILE_MAX_LINES ];
+    int keptCount = 0;
+    FILE *fp = fopen( path, "r" );
+    if ( fp != NULL ) {
+        char line[ PROFILE_LINE_MAX ];
+        int version;
+        if ( fgets( line, sizeof( line ), fp ) != NULL &&
+             sscanf( line, "des-profile %d", &version ) == 1 && version == PROFILE_VERSION ) {
+            while ( keptCount < PROFILE_MAX_LINES && fgets( line, sizeof( line ), fp ) != NULL ) {
+                if ( !sameMachine( line, profile ) && strchr( line, '\t' ) != NULL ) {
+                    kept[ keptCount ] = strdup( line );
+                    keptCount += kept[ keptCount ] != NULL;
+                }
+            }
+        }
+        fclose( fp );
+    }
+
+    makeParentDirectory( path );
+    char *tmpName = NULL;
+    if ( asprintf( &tmpName, "%s.%ld", path, (long) getpid() ) < 0 ) {
+        tmpName = NULL;
+    }
+    bool ok = false;
+    fp = tmpName != NULL ? fopen( tmpName, "w" ) : NULL;
+    if ( fp != NULL ) {
+        fprintf( fp, "des-profile %d\n", PROFILE_VERSION );
+        for ( int i = 0; i < keptCount; i++ ) {
+            fputs( kept[ i ], fp );
+        }
+        fprintf( fp, "%s\t%d\t%s\t%zu\t%d\n", profile->cpu, profile->cores,
+                 profile->engine->name, profile->chunkBytes, profile->threads );
+        ok = fclose( fp ) == 0 && rename( tmpName, path ) == 0;
+        if ( !ok ) {
+            perror( path );
+            remove( tmpName );
+        }
+    } else {
+        perror( path );
+    }
+
+    free( tmpName );
+    for ( int i = 0; i < keptCount; i++ ) {
+        free( kept[ i ] );
+    }
+    return ok;
+}
+
+bool applyProfile( Options *opts )
+{
+    char const *path = profilePath();
+    Profile profile;
+    machineFingerprint( &profile );
+
+    if ( opts->autotune ) {
+        if ( !tuneMachine( &profile, stderr ) ) {
+            return false;
+        }
+        fprintf( stderr, "Profile: engine %s, chunk size %zu, threads %d\n",
+                 profile.engine->name, profile.chunkBytes, profile.threads );
+        if ( path != NULL && saveProfile( path, &profile ) ) {
+            fprintf( stderr, "Saved to %s\n", path );
+        }
+    } else if ( path == NULL || !loadProfile( path, &profile ) ) {
+        // Only re-tune when a profile file has been made, by --autotune
+        // on this machine or another, and it has no line for this one
+        if ( path == NULL || access( path, F_OK ) != 0 || !tuneMachine( &profile, NULL ) ) {
+            return true;
+        }
+        saveProfile( path, &profile );
+    }
+
+    if ( !opts->engineGiven ) {
+        opts->engine = profile.engine;
+    }
+    if ( !opts->chunkGiven ) {
+        opts->chunkBytes = profile.chunkBytes;
+    }
+    if ( !opts->threadsGiven ) {
+        opts->threads = profile.threads;
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+/**
+    @file tune.h
+    @author John Butterfield (jpbutte2)
+    Header for the tuning component. This component is shared by the
+    encrypt and decrypt programs. It times short trials of the engines,
+    chunk sizes and thread counts on this machine, and keeps the winners
+    in a profile file, one line per kind of machine, so later runs can
+    start with them without timing anything.
+*/
+
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "options.h"
+
+/** Format version on the first line of a profile file. */
+#define PROFILE_VERSION 1
+
+/** Longest processor name kept in a profile. */
+#define CPU_NAME_MAX 80
+
+/** Bytes in the file the chunk size and thread trials run on. */
+#define TUNE_FILE_BYTES ( 8 * 1024 * 1024 )
+
+/** How long each engine is timed for, in seconds. */
+#define TUNE_ENGINE_SECONDS 0.02
+
+/** How much faster, as a fraction, a later candidate has to be to
+    replace an earlier one, so noise doesn't decide. */
+#define TUNE_MARGIN 0.05
+
+/** What a profile records for one kind of machine. */
+typedef struct {
+  /** Name of the processor model. */
+  char cpu[ CPU_NAME_MAX ];
+
+  /** Number of online processors. */
+  int cores;
+
+  /** Engine to run DES on. */
+  DESEngine const *engine;
+
+  /** Number of bytes to read or write at a time. */
+  size_t chunkBytes;
+
+  /** Number of worker threads. */
+  int threads;
+} Profile;
+
+/**
+    This function fills in the processor model and core count of this
+    machine, which is what a profile is keyed by. On x86 the model comes
+    straight from the processor, so this takes microseconds.
+    @param profile where to store the fingerprint; the other fields are
+    left alone
+*/
+void machineFingerprint( Profile *profile );
+
+/**
+    This function returns the path of the profile file: the DES_PROFILE
+    environment variable if it is set, or des-profile in the user's
+    cache directory, $XDG_CACHE_HOME or ~/.cache.
+    @return the path, or NULL if DES_PROFILE is set to an empty string
+    or there is no cache directory, which turns profiles off
+*/
+char const *profilePath( void );
+
+/**
+    This function runs the trials and picks the fastest settings for
+    this machine: each engine on a buffer in memory, then each chunk
+    size streaming a scratch file, then 1, 2, 4 and so on up to one
+    worker per core. An engine only replaces "auto" if it is faster on
+    long runs of blocks without being slower a block at a time, which
+    is how CBC encryption uses it. The scratch files go in $TMPDIR, or
+    /tmp.
+    @param profile where to store the results, with the fingerprint
+    @param report where to describe each trial, or NULL for none
+    @return true if the trials ran, false after printing an error
+    message
+*/
+bool tuneMachine( Profile *profile, FILE *report );
+
+/**
+    This function looks up the profile for this machine in the profile
+    file.
+    @param path the profile file
+    @param profile where to store it; its fingerprint says which
+    machine to look for
+    @return true if the file has a usable line for this machine
+*/
+bool loadProfile( char const *path, Profile *profile );
+
+/**
+    This function stores the profile for this machine in the profile
+    file, replacing any line for the same kind of machine and keeping
+    the others. The file is written under a new name and renamed over
+    the old one, so a run loading it never sees half a file.
+    @param path the profile file
+    @param profile the profile to store
+    @return true if successful, false after printing an error message
+*/
+bool saveProfile( char const *path, Profile const *profile );
+
+/**
+    This function sets up the options from this machine's profile,
+    leaving alone any setting given on the command line. With
+    opts->autotune, the trials run first, with a report on standard
+    error, and the result is saved. Otherwise the profile is loaded, and
+    if the file exists but has no line for this machine, because the
+    processor or number of cores has changed, the trials run quietly
+    and their result is saved for next time. With no profile file at
+    all the built-in defaults are used.
+    @param opts the parsed command line
+    @return false if --autotune was given and the trials failed, after
+    printing an error message
+*/
+bool applyProfile( Options *opts );
+
+#endif
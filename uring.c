@@ -0,0 +1,294 @@
+/**
+    @file uring.c
+    @author John Butterfield (jpbutte2)
+    io_uring component, using the system calls directly so the programs
+    don't need liburing. The submission and completion queues are
+    shared with the kernel through mappings, and each side only moves
+    its own end of each queue.
+*/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include "uring.h"
+
+#ifdef DES_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+    Set up a ring in the kernel.
+    @param entries number of submission queue entries wanted
+    @param params filled in with the layout of the queues
+    @return descriptor of the ring, or -1 on an error
+*/
+static int setupRing( unsigned entries, struct io_uring_params *params )
+{
+    return syscall( __NR_io_uring_setup, entries, params );
+}
+
+/**
+    Pass submissions to the kernel and optionally wait for completions.
+    @param fd descriptor of the ring
+    @param submit number of submissions to pass
+    @param wait number of completions to wait for
+    @return number of submissions consumed, or -1 on an error
+*/
+static int enterRing( int fd, unsigned submit, unsigned wait )
+{
+    unsigned flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0;
+    return syscall( __NR_io_uring_enter, fd, submit, wait, flags, NULL, 0 );
+}
+
+/**
+    Register files or buffers with a ring.
+    @param fd descriptor of the ring
+    @param opcode what to register
+    @param arg the files or buffers
+    @param count number of files or buffers
+    @return 0 if successful, or -1 on an error
+*/
+static int registerRing( int fd, unsigned opcode, void const *arg, unsigned count )
+{
+    return syscall( __NR_io_uring_register, fd, opcode, arg, count );
+}
+
+bool uringOpen( Uring *ring, unsigned depth )
+{
+    memset( ring, 0, sizeof( *ring ) );
+
+    struct io_uring_params params;
+    memset( &params, 0, sizeof( params ) );
+    ring->fd = setupRing( depth, &params );
+    if ( ring->fd < 0 ) {
+        return false;
+    }
+
+    ring->sqMapBytes = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+    ring->cqMapBytes = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+    ring->sqesBytes = params.sq_entries * sizeof( struct io_uring_sqe );
+
+    ring->sqMap = mmap( NULL, ring->sqMapBytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING );
+    ring->cqMap = mmap( NULL, ring->cqMapBytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING );
+    ring->sqes = mmap( NULL, ring->sqesBytes, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES );
+    if ( ring->sqMap == MAP_FAILED || ring->cqMap == MAP_FAILED || ring->sqes == MAP_FAILED ) {
+        uringClose( ring );
+        return false;
+    }
+
+    byte *sq = ring->sqMap;
+    ring->sqHead = (unsigned *) ( sq + params.sq_off.head );
+    ring->sqTail = (unsigned *) ( sq + params.sq_off.tail );
+    ring->sqMask = *(unsigned *) ( sq + params.sq_off.ring_mask );
+    ring->sqEntries = params.sq_entries;
+    ring->sqArray = (unsigned *) ( sq + params.sq_off.array );
+
+    byte *cq = ring->cqMap;
+    ring->cqHead = (unsigned *) ( cq + params.cq_off.head );
+    ring->cqTail = (unsigned *) ( cq + params.cq_off.tail );
+    ring->cqMask = *(unsigned *) ( cq + params.cq_off.ring_mask );
+    ring->cqes = (struct io_uring_cqe *) ( cq + params.cq_off.cqes );
+
+    return true;
+}
+
+void uringClose( Uring *ring )
+{
+    if ( ring->sqMap != NULL && ring->sqMap != MAP_FAILED ) {
+        munmap( ring->sqMap, ring->sqMapBytes );
+    }
+    if ( ring->cqMap != NULL && ring->cqMap != MAP_FAILED ) {
+        munmap( ring->cqMap, ring->cqMapBytes );
+    }
+    if ( ring->sqes != NULL && ring->sqes != MAP_FAILED ) {
+        munmap( ring->sqes, ring->sqesBytes );
+    }
+    if ( ring->fd >= 0 ) {
+        close( ring->fd );
+    }
+
+    // Closing the ring drops its registered files and buffers too
+    memset( ring, 0, sizeof( *ring ) );
+    ring->fd = -1;
+}
+
+void uringSetFiles( Uring *ring, int const fds[], int count )
+{
+    memcpy( ring->files, fds, count * sizeof( int ) );
+    ring->fixedFiles = registerRing( ring->fd, IORING_REGISTER_FILES, fds, count ) == 0;
+}
+
+bool uringRegisterBuffers( Uring *ring, struct iovec const iov[], int count )
+{
+    ring->fixedBuffers = registerRing( ring->fd, IORING_REGISTER_BUFFERS, iov, count ) == 0;
+    return ring->fixedBuffers;
+}
+
+/**
+    Queue a read or write request.
+    @param ring the ring
+    @param opcode IORING_OP_READ or IORING_OP_WRITE
+    @param file index of the file
+    @param data the buffer
+    @param len number of bytes
+    @param offset position in the file
+    @param buffer index of the registered buffer holding data, or -1
+    @param tag value reported back on completion
+    @return false if the submission queue is full
+*/
+static bool queueRequest( Uring *ring, int opcode, int file, byte const *data, size_t len,
+                          off_t offset, int buffer, uint64_t tag )
+{
+    unsigned tail = *ring->sqTail;
+    unsigned head = __atomic_load_n( ring->sqHead, __ATOMIC_ACQUIRE );
+    if ( tail - head >= ring->sqEntries ) {
+        return false;
+    }
+
+    unsigned index = tail & ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[ index ];
+    memset( sqe, 0, sizeof( *sqe ) );
+
+    if ( buffer >= 0 && ring->fixedBuffers ) {
+        sqe->opcode = opcode == IORING_OP_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe->buf_index = buffer;
+    } else {
+        sqe->opcode = opcode;
+    }
+
+    if ( ring->fixedFiles ) {
+        sqe->fd = file;
+        sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+        sqe->fd = ring->files[ file ];
+    }
+
+    sqe->off = offset;
+    sqe->addr = (uint64_t) (uintptr_t) data;
+    sqe->len = len;
+    sqe->user_data = tag;
+
+    // The kernel mustn't see the new tail before the entry is filled in
+    ring->sqArray[ index ] = index;
+    __atomic_store_n( ring->sqTail, tail + 1, __ATOMIC_RELEASE );
+    ring->unsubmitted++;
+
+    return true;
+}
+
+bool uringRead( Uring *ring, int file, byte *data, size_t len, off_t offset, int buffer,
+                uint64_t tag )
+{
+    return queueRequest( ring, IORING_OP_READ, file, data, len, offset, buffer, tag );
+}
+
+bool uringWrite( Uring *ring, int file, byte const *data, size_t len, off_t offset,
+                 int buffer, uint64_t tag )
+{
+    return queueRequest( ring, IORING_OP_WRITE, file, data, len, offset, buffer, tag );
+}
+
+/**
+    Pass queued requests to the kernel, waiting for a completion too if
+    asked to.
+    @param ring the ring
+    @param wait number of completions to wait for
+    @return false on an error
+*/
+static bool enterQueued( Uring *ring, unsigned wait )
+{
+    while ( ring->unsubmitted > 0 || wait > 0 ) {
+        int n = enterRing( ring->fd, ring->unsubmitted, wait );
+        if ( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( n < 0 ) {
+            return false;
+        }
+
+        ring->unsubmitted -= n;
+        wait = 0;
+    }
+
+    return true;
+}
+
+bool uringSubmit( Uring *ring )
+{
+    return enterQueued( ring, 0 );
+}
+
+bool uringWait( Uring *ring, uint64_t *tag, int *result )
+{
+    while ( true ) {
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n( ring->cqTail, __ATOMIC_ACQUIRE );
+        if ( head != tail ) {
+            struct io_uring_cqe const *cqe = &ring->cqes[ head & ring->cqMask ];
+            *tag = cqe->user_data;
+            *result = cqe->res;
+
+            // Hand the slot back once it has been read
+            __atomic_store_n( ring->cqHead, head + 1, __ATOMIC_RELEASE );
+            return true;
+        }
+
+        if ( !enterQueued( ring, 1 ) ) {
+            return false;
+        }
+    }
+}
+
+#else
+
+bool uringOpen( Uring *ring, unsigned depth )
+{
+    memset( ring, 0, sizeof( *ring ) );
+    ring->fd = -1;
+    errno = ENOSYS;
+    return false;
+}
+
+void uringClose( Uring *ring )
+{
+}
+
+void uringSetFiles( Uring *ring, int const fds[], int count )
+{
+}
+
+bool uringRegisterBuffers( Uring *ring, struct iovec const iov[], int count )
+{
+    return false;
+}
+
+bool uringRead( Uring *ring, int file, byte *data, size_t len, off_t offset, int buffer,
+                uint64_t tag )
+{
+    return false;
+}
+
+bool uringWrite( Uring *ring, int file, byte const *data, size_t len, off_t offset,
+                 int buffer, uint64_t tag )
+{
+    return false;
+}
+
+bool uringSubmit( Uring *ring )
+{
+    return false;
+}
+
+bool uringWait( Uring *ring, uint64_t *tag, int *result )
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,180 @@
+/**
+    @file uring.h
+    @author John Butterfield (jpbutte2)
+    Header for the io_uring component. This component talks to the
+    kernel's io_uring interface with raw system calls, so several large
+    reads or writes can be in flight while the cipher works. Files and
+    buffers can be registered with the ring, which saves the kernel
+    from looking them up and pinning them again for every request.
+    Without DES_IO_URING, uringOpen() always fails and callers use
+    ordinary reads and writes.
+*/
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "DES.h"
+
+/** Number of requests each pipeline thread keeps in flight. */
+#define URING_QUEUE_DEPTH 8
+
+/** Most files that can be registered with a ring. */
+#define URING_MAX_FILES 2
+
+/** Type for one io_uring instance, used by only one thread at a time. */
+typedef struct {
+  /** Descriptor of the ring. */
+  int fd;
+
+  /** Mapped submission queue ring. */
+  void *sqMap;
+
+  /** Size of the submission queue mapping. */
+  size_t sqMapBytes;
+
+  /** Mapped completion queue ring. */
+  void *cqMap;
+
+  /** Size of the completion queue mapping. */
+  size_t cqMapBytes;
+
+  /** Mapped array of submission queue entries. */
+  struct io_uring_sqe *sqes;
+
+  /** Size of the submission queue entry mapping. */
+  size_t sqesBytes;
+
+  /** Submission queue head, moved by the kernel. */
+  unsigned *sqHead;
+
+  /** Submission queue tail, moved by us. */
+  unsigned *sqTail;
+
+  /** Mask for submission queue indexes. */
+  unsigned sqMask;
+
+  /** Number of submission queue entries. */
+  unsigned sqEntries;
+
+  /** Maps submission queue slots to entries. */
+  unsigned *sqArray;
+
+  /** Completion queue head, moved by us. */
+  unsigned *cqHead;
+
+  /** Completion queue tail, moved by the kernel. */
+  unsigned *cqTail;
+
+  /** Mask for completion queue indexes. */
+  unsigned cqMask;
+
+  /** The completion queue entries. */
+  struct io_uring_cqe *cqes;
+
+  /** Number of entries queued but not yet passed to the kernel. */
+  unsigned unsubmitted;
+
+  /** Descriptors of the files requests refer to by index. */
+  int files[ URING_MAX_FILES ];
+
+  /** True if the files are registered with the ring. */
+  bool fixedFiles;
+
+  /** True if buffers are registered with the ring. */
+  bool fixedBuffers;
+} Uring;
+
+/**
+    This function sets up an io_uring instance with room for depth
+    requests. It fails on kernels without io_uring, or where it has
+    been turned off, so callers can fall back to ordinary reads and
+    writes.
+    @param ring the ring to set up
+    @param depth number of requests that can be queued at once
+    @return true if the kernel created the ring
+*/
+bool uringOpen( Uring *ring, unsigned depth );
+
+/**
+    This function releases an io_uring instance.
+    @param ring the ring to release
+*/
+void uringClose( Uring *ring );
+
+/**
+    This function gives the ring the files that requests refer to by
+    index, and tries to register them so requests skip the descriptor
+    lookup. Requests still work if registration fails.
+    @param ring the ring
+    @param fds descriptors of the files
+    @param count number of files, at most URING_MAX_FILES
+*/
+void uringSetFiles( Uring *ring, int const fds[], int count );
+
+/**
+    This function tries to register buffers with the ring, so the kernel
+    maps them once instead of for every request. Registration can fail,
+    for example when it would go over the locked memory limit; requests
+    then just don't use the registered buffers.
+    @param ring the ring
+    @param iov the buffers
+    @param count number of buffers
+    @return true if the buffers were registered
+*/
+bool uringRegisterBuffers( Uring *ring, struct iovec const iov[], int count );
+
+/**
+    This function queues a read of len bytes at the given offset of a
+    file into data. The request isn't passed to the kernel until
+    uringSubmit() or uringWait() is called.
+    @param ring the ring
+    @param file index of the file given to uringSetFiles()
+    @param data where to store the bytes
+    @param len number of bytes to read
+    @param offset position in the file of the first byte
+    @param buffer index of the registered buffer holding data, or -1
+    @param tag value reported back when the read completes
+    @return false if the submission queue is full
+*/
+bool uringRead( Uring *ring, int file, byte *data, size_t len, off_t offset, int buffer,
+                uint64_t tag );
+
+/**
+    This function queues a write of len bytes from data at the given
+    offset of a file, in the same way as uringRead().
+    @param ring the ring
+    @param file index of the file given to uringSetFiles()
+    @param data the bytes to write
+    @param len number of bytes to write
+    @param offset position in the file for the first byte
+    @param buffer index of the registered buffer holding data, or -1
+    @param tag value reported back when the write completes
+    @return false if the submission queue is full
+*/
+bool uringWrite( Uring *ring, int file, byte const *data, size_t len, off_t offset,
+                 int buffer, uint64_t tag );
+
+/**
+    This function passes any queued requests to the kernel without
+    waiting for them.
+    @param ring the ring
+    @return false if the kernel refused the requests
+*/
+bool uringSubmit( Uring *ring );
+
+/**
+    This function waits for the next request to complete, passing any
+    queued requests to the kernel first.
+    @param ring the ring
+    @param tag where to store the tag of the request
+    @param result where to store the result of the request: the number
+    of bytes moved, or a negated errno value
+    @return false if waiting failed
+*/
+bool uringWait( Uring *ring, uint64_t *tag, int *result );
+
+#endif